@@ -100,6 +100,23 @@ typedef struct _alloc_options_t {
      */
     bool replace_nosy_allocs;
 
+    /* Only used with -replace_malloc: grow the trailing redzone in proportion
+     * to the request size (one byte per redzone_adaptive_scale bytes, up to
+     * redzone_adaptive_max), and drop the extra padding for allocation sites
+     * that client_malloc_site_quiet() says are quiet.  The client is expected
+     * to lower redzone_size, which remains the minimum, in this mode.
+     */
+    bool redzone_adaptive;
+    uint redzone_adaptive_max;
+    uint redzone_adaptive_scale;
+
+    /* Only used with -replace_malloc: grow a realloc in place when the following
+     * chunk is free or the chunk ends its arena, rather than always moving it.
+     * Moving keeps the old region in the delayed free list so that accesses
+     * through a stale pointer are reported.
+     */
+    bool realloc_in_place;
+
     /* Add new options here */
 } alloc_options_t;
 
@@ -120,6 +137,7 @@ enum {
     MALLOC_RESERVED_9 = 0x1000,
     MALLOC_RESERVED_10= 0x2000,
     MALLOC_CLIENT_5 =   0x4000,
+    MALLOC_RESERVED_11= 0x8000,
     MALLOC_POSSIBLE_CLIENT_FLAGS = (MALLOC_CLIENT_1 | MALLOC_CLIENT_2 |
                                     MALLOC_CLIENT_3 | MALLOC_CLIENT_4 |
                                     MALLOC_CLIENT_5),
@@ -287,6 +305,23 @@ bool
 alloc_replace_overlaps_malloc(byte *start, byte *end,
                               malloc_info_t *info INOUT);
 
+/* Returns the bytes currently held in the delayed-free queues of all arenas */
+size_t
+alloc_replace_delayed_bytes(void);
+
+/* Lowers the per-arena delayed-free byte limit to max_bytes (capped at
+ * alloc_ops.delay_frees_maxsz) and stops delaying chunks larger than max_chunk.
+ * Each arena evicts its oldest delayed frees on its next malloc or free.
+ * clock is a coarse millisecond clock used to measure how long frees are
+ * delayed; pass 0 to not measure.
+ */
+void
+alloc_replace_quarantine_update(size_t max_bytes, size_t max_chunk, uint clock);
+
+/* Returns the total delay of the evicted delayed frees measured so far */
+void
+alloc_replace_quarantine_residence(uint64 *total_ms OUT, uint64 *evictions OUT);
+
 /* Allocate application memory for clients.
  * This function can only be used with -replace_malloc and
  * does not work with malloc wrapping mode.
@@ -338,6 +373,13 @@ client_add_malloc_pre(malloc_info_t *info, dr_mcontext_t *mc, app_pc post_call);
 void
 client_add_malloc_post(malloc_info_t *info);
 
+/* Only called for alloc_options_t.redzone_adaptive, once per allocation, with
+ * the client data from client_add_malloc_pre() for the new allocation.  Returns
+ * whether its allocation site should only be given the minimum redzone.
+ */
+bool
+client_malloc_site_quiet(void *client_data);
+
 /* The alloc entry has NOT been freed yet and WILL show up in
  * malloc iteration: use client_remove_malloc_post to avoid this.
  */
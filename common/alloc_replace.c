@@ -148,6 +148,7 @@ enum {
      */
     CHUNK_LAYER_NOCHECK = MALLOC_RESERVED_9,
     CHUNK_SKIP_ITER   =   MALLOC_RESERVED_10,
+    CHUNK_DELAY_STAMPED = MALLOC_RESERVED_11,   /* free time in delay_stamp_slot() */
 
     /* meta-flags */
 #ifdef WINDOWS
@@ -321,6 +322,10 @@ typedef struct _arena_header_t {
      * next carved-out chunk w/ the prev free size.
      */
     heapsz_t prev_free_sz;
+    /* Space from here to commit_end has never been carved out and so is still
+     * zero as the OS handed it to us, letting calloc skip its memset.
+     */
+    byte *zero_start;
     uint magic;
 #ifdef WINDOWS
     /* A member of the alloc set for which this arena is the default heap */
@@ -393,12 +398,36 @@ static uint peak_heap_capacity;
 static uint num_arenas;
 static uint peak_num_arenas;
 static uint num_splits;
+static uint num_realloc_grows;
+static uint num_zero_skips;
+static uint num_aligned_reuses;
+static uint num_aligned_exact_carves;
 static uint num_coalesces;
 static uint num_dealloc;
 static uint dbgcrt_mismatch;
 static uint allocs_left_native;
+static uint adaptive_redzone_allocs;
+static uint adaptive_redzone_bytes;
+static uint adaptive_redzone_quiet;
 #endif
 
+/* Total delayed-free bytes across all arenas, for memory accounting */
+static uint delayed_bytes_total;
+
+/* Delayed-free limits in effect, which the client may lower under memory
+ * pressure (see alloc_replace_quarantine_update()).  quarantine_maxsz is
+ * per-arena like alloc_ops.delay_frees_maxsz.
+ */
+static volatile size_t quarantine_maxsz;
+static volatile size_t quarantine_chunk_max;
+/* Coarse clock supplied by the client for residence times.  0 means
+ * residence time is not being tracked.
+ */
+static volatile uint quarantine_clock;
+static void *quarantine_lock;
+static uint64 quarantine_residence_ms;  /* protected by quarantine_lock */
+static uint64 quarantine_evictions;     /* protected by quarantine_lock */
+
 #ifdef DEBUG
 /* used to allow use of app stack on abort */
 static bool aborting;
@@ -767,16 +796,23 @@ chunk_request_size(chunk_header_t *head)
     return (head->alloc_size - head->u.unfree.request_diff);
 }
 
+/* If non-NULL, client_data is the result of an earlier client_add_malloc_pre()
+ * call for this allocation, which is then not called again.
+ */
 static void
 notify_client_alloc(void *drcontext, byte *ptr, chunk_header_t *head,
-                    alloc_flags_t flags, dr_mcontext_t *mc, app_pc caller)
+                    alloc_flags_t flags, dr_mcontext_t *mc, app_pc caller,
+                    void *client_data)
 {
     malloc_info_t info = { sizeof(info), ptr, chunk_request_size(head),
                            head->alloc_size, false/*!pre_us*/, true/*redzone*/,
                            TEST(ALLOC_ZERO, flags), TEST(ALLOC_IS_REALLOC, flags),
                            0, head->user_data };
     if (TEST(ALLOC_INVOKE_CLIENT_DATA, flags)) {
-        head->user_data = client_add_malloc_pre(&info, mc, caller);
+        if (client_data != NULL)
+            head->user_data = client_data;
+        else
+            head->user_data = client_add_malloc_pre(&info, mc, caller);
         info.client_data = head->user_data;
         client_add_malloc_post(&info);
     }
@@ -1012,6 +1048,8 @@ arena_init(arena_header_t *arena, arena_header_t *parent)
         /* XXX: this wastes the initial redzone for !shared_redzones */
         ALIGN_FORWARD(header_size, CHUNK_ALIGNMENT) + inter_chunk_space();
     arena->next_chunk = arena->start_chunk;
+    /* The page holding our header may have stale data (pre-us brk) */
+    arena->zero_start = (byte *) ALIGN_FORWARD(arena->start_chunk, PAGE_SIZE);
     arena->magic = HEADER_MAGIC;
     arena->next_arena = NULL;
     arena->prev_free_sz = 0;
@@ -1134,7 +1172,22 @@ static inline bool
 arena_delayed_list_full(arena_header_t *arena)
 {
     return (arena->free_list->delayed_chunks >= alloc_ops.delay_frees ||
-            arena->free_list->delayed_bytes >= alloc_ops.delay_frees_maxsz);
+            arena->free_list->delayed_bytes >= quarantine_maxsz);
+}
+
+/* For residence times we store the free time in the freed chunk just beyond
+ * the free list next pointer.  With shared redzones the next pointer is either
+ * in the redzone or at the start of the user data, and CHUNK_MIN_SIZE leaves
+ * room for the stamp.  We skip this w/o shared redzones, where the client may
+ * be using the freed data (pattern mode).
+ */
+static inline uint *
+delay_stamp_slot(chunk_header_t *head)
+{
+    byte *after_next = (byte *)(&((free_header_t *)head)->next + 1);
+    byte *ptr = ptr_from_header(head);
+    ASSERT(alloc_ops.shared_redzones, "stamp requires shared redzones");
+    return (uint *) (after_next > ptr ? after_next : ptr);
 }
 
 static inline chunk_header_t *
@@ -1301,6 +1354,9 @@ consider_giving_back_memory(arena_header_t *arena, chunk_header_t *tofree)
                     arena->reserve_end = new_brk;
                     arena->next_chunk = ptr;
                     arena->prev_free_sz = 0; /* can't end in free: would be coalesced */
+                    /* [ptr, new_brk) keeps its contents */
+                    if (arena->zero_start > new_brk)
+                        arena->zero_start = new_brk;
                     return NULL;
                 } else {
                     LOG(1, "brk @"PFX"-"PFX" failed to shrink to "PFX"\n",
@@ -1421,7 +1477,18 @@ shift_from_delay_list_to_free_list(arena_header_t *arena)
     if (cur == NULL)
         return false;
     LOG(3, "%s: shifting "PFX" to regular free list\n", __FUNCTION__, cur);
-    cur->head.flags &= ~CHUNK_DELAY_FREE;
+    if (TEST(CHUNK_DELAY_STAMPED, cur->head.flags)) {
+        uint now = quarantine_clock;
+        uint freed = *delay_stamp_slot(&cur->head);
+        /* A use-after-free write could have clobbered the stamp */
+        if (freed != 0 && freed <= now) {
+            dr_mutex_lock(quarantine_lock);
+            quarantine_residence_ms += now - freed;
+            quarantine_evictions++;
+            dr_mutex_unlock(quarantine_lock);
+        }
+    }
+    cur->head.flags &= ~(CHUNK_DELAY_FREE | CHUNK_DELAY_STAMPED);
     arena->free_list->delay_front = cur->next;
     if (cur == arena->free_list->delay_last)
         arena->free_list->delay_last = NULL;
@@ -1430,6 +1497,7 @@ shift_from_delay_list_to_free_list(arena_header_t *arena)
     ASSERT(arena->free_list->delayed_bytes >= cur->head.alloc_size,
            "delay bytes counter off");
     arena->free_list->delayed_bytes -= cur->head.alloc_size;
+    ATOMIC_ADD32(delayed_bytes_total, -(int)cur->head.alloc_size);
     LOG(3, "%s: updated delayed chunks=%d, bytes="PIFX"\n", __FUNCTION__,
         arena->free_list->delayed_chunks, arena->free_list->delayed_bytes);
 
@@ -1454,21 +1522,43 @@ static void
 add_to_delay_list(arena_header_t *arena, chunk_header_t *head)
 {
     free_header_t *cur = (free_header_t *) head;
-    /* add to the end for delayed free FIFO */
-    cur->next = NULL;
+    /* Under memory pressure we do not retain large chunks: we put them at the
+     * front so they're the first shifted out below.
+     */
+    bool retain = (head->alloc_size <= quarantine_chunk_max);
+    uint now = quarantine_clock;
     head->flags |= CHUNK_DELAY_FREE;
-    if (arena->free_list->delay_last == NULL) {
-        ASSERT(arena->free_list->delay_front == NULL, "inconsistent free list");
+    /* Only write into the freed chunk when residence times are being tracked */
+    if (now != 0 && alloc_ops.shared_redzones) {
+        *delay_stamp_slot(head) = now;
+        head->flags |= CHUNK_DELAY_STAMPED;
+    }
+    if (!retain) {
+        cur->next = arena->free_list->delay_front;
         arena->free_list->delay_front = cur;
-    } else
-        arena->free_list->delay_last->next = cur;
-    arena->free_list->delay_last = cur;
+        if (arena->free_list->delay_last == NULL)
+            arena->free_list->delay_last = cur;
+    } else {
+        /* add to the end for delayed free FIFO */
+        cur->next = NULL;
+        if (arena->free_list->delay_last == NULL) {
+            ASSERT(arena->free_list->delay_front == NULL, "inconsistent free list");
+            arena->free_list->delay_front = cur;
+        } else
+            arena->free_list->delay_last->next = cur;
+        arena->free_list->delay_last = cur;
+    }
 
     arena->free_list->delayed_chunks++;
     arena->free_list->delayed_bytes += head->alloc_size;
+    ATOMIC_ADD32(delayed_bytes_total, head->alloc_size);
     LOG(3, "%s: updated delayed chunks=%d, bytes="PIFX"\n", __FUNCTION__,
         arena->free_list->delayed_chunks, arena->free_list->delayed_bytes);
 
+    if (!retain) {
+        LOG(3, "%s: not retaining large chunk "PFX"\n", __FUNCTION__, cur);
+        shift_from_delay_list_to_free_list(arena);
+    }
     while (arena_delayed_list_full(arena)) {
         /* Keep shifting first delayed entry to the free lists, until we're
          * below both thresholds.
@@ -1547,6 +1637,50 @@ split_piece_for_free_list(arena_header_t *arena, chunk_header_t *head,
     iterator_unlock(arena, true/*in alloc*/);
 }
 
+/* If the free chunk head, which must already be off the free lists, has a
+ * lot more room than aligned_size, splits the rest off as a separate free entry.
+ */
+static void
+split_free_chunk(arena_header_t *arena, chunk_header_t *head, heapsz_t aligned_size)
+{
+    if (head->alloc_size > aligned_size + CHUNK_MIN_SIZE + inter_chunk_space()) {
+        byte *split = ptr_from_header(head) + aligned_size +
+            (alloc_ops.shared_redzones ? 0 : alloc_ops.redzone_size);
+        size_t rest_size = head->alloc_size - (aligned_size + inter_chunk_space());
+        byte *chunk2_start = split + inter_chunk_space() -
+            (alloc_ops.shared_redzones ? 0 : alloc_ops.redzone_size);
+        free_header_t *rest = (free_header_t *) header_from_ptr(chunk2_start);
+        ASSERT(!TEST(CHUNK_MMAP, head->flags), "mmap not expected on free list");
+        STATS_INC(num_splits);
+        split_piece_for_free_list(arena, head, rest, rest_size, aligned_size);
+        ASSERT(is_valid_chunk(chunk2_start, &rest->head), "rest chunk inconsistent");
+    }
+}
+
+/* Turns head, which must already be off the free lists, into a live chunk of
+ * at least aligned_size, splitting any sizable remainder back onto the free lists.
+ */
+static void
+claim_free_chunk(arena_header_t *arena, chunk_header_t *head, heapsz_t aligned_size)
+{
+    chunk_header_t *next;
+    arena_header_t *container = NULL;
+
+    split_free_chunk(arena, head, aligned_size);
+
+    if (head->user_data != NULL) {
+        client_malloc_data_free(head->user_data);
+        head->user_data = NULL;
+    }
+    head->flags &= ~(CHUNK_FREED | ALLOCATOR_TYPE_FLAGS);
+
+    next = next_chunk_forward(arena, head, &container);
+    if (next != NULL)
+        next->flags &= ~CHUNK_PREV_FREE;
+    else if (container != NULL)
+        container->prev_free_sz = 0;
+}
+
 static chunk_header_t *
 find_free_list_entry(arena_header_t *arena, heapsz_t request_size, heapsz_t aligned_size)
 {
@@ -1607,38 +1741,57 @@ find_free_list_entry(arena_header_t *arena, heapsz_t request_size, heapsz_t alig
     }
 
     if (head != NULL) {
-        chunk_header_t *next;
-        arena_header_t *container = NULL;
         LOG(2, "\tusing free list size=%d for request=%d align=%d from bucket %d\n",
             head->alloc_size, request_size, aligned_size, bucket);
+        claim_free_chunk(arena, head, aligned_size);
+    }
+    return head;
+}
 
-        /* if there's a lot of extra room, split it off as a separate free entry */
-        if (head->alloc_size > aligned_size + CHUNK_MIN_SIZE + inter_chunk_space()) {
-            byte *split = ptr_from_header(head) + aligned_size +
-                (alloc_ops.shared_redzones ? 0 : alloc_ops.redzone_size);
-            size_t rest_size = head->alloc_size - (aligned_size + inter_chunk_space());
-            byte *chunk2_start = split + inter_chunk_space() -
-                (alloc_ops.shared_redzones ? 0 : alloc_ops.redzone_size);
-            free_header_t *rest = (free_header_t *) header_from_ptr(chunk2_start);
-            ASSERT(!TEST(CHUNK_MMAP, head->flags), "mmap not expected on free list");
-            STATS_INC(num_splits);
-            split_piece_for_free_list(arena, head, rest, rest_size, aligned_size);
-            ASSERT(is_valid_chunk(chunk2_start, &rest->head), "rest chunk inconsistent");
-        }
+/* How many entries of each bucket to examine when looking for a free chunk
+ * that already satisfies a special alignment.  We want this to stay cheap
+ * relative to the padded fallback.
+ */
+#define ALIGNED_SEARCH_MAX_PROBES 8
 
-        if (head->user_data != NULL) {
-            client_malloc_data_free(head->user_data);
-            head->user_data = NULL;
+/* For alignments beyond CHUNK_ALIGNMENT: looks for a free chunk whose user
+ * pointer already has the requested alignment, such as one freed by an earlier
+ * request of the same alignment class.  Re-using it avoids the alignment padding
+ * and the split of the pre-aligned piece that the padded search requires.
+ * aligned_size must not include any alignment padding.
+ */
+static chunk_header_t *
+find_aligned_free_list_entry(arena_header_t *arena, heapsz_t request_size,
+                             heapsz_t aligned_size, size_t alignment)
+{
+    uint bucket, probes;
+    free_header_t *cur;
+#ifdef UNIX
+    ASSERT(dr_recurlock_self_owns(arena->lock), "caller must hold lock");
+#endif
+    ASSERT(alignment > CHUNK_ALIGNMENT, "only for special alignments");
+    for (bucket = 0;
+         bucket < NUM_FREE_LISTS - 1 && aligned_size > free_list_sizes[bucket];
+         bucket++)
+        ; /* nothing */
+    for (; bucket < NUM_FREE_LISTS; bucket++) {
+        for (cur = arena->free_list->front[bucket], probes = 0;
+             cur != NULL && probes < ALIGNED_SEARCH_MAX_PROBES;
+             cur = cur->next, probes++) {
+            if (cur->head.alloc_size >= aligned_size &&
+                ALIGNED(ptr_from_header(&cur->head), alignment)) {
+                chunk_header_t *head = (chunk_header_t *) cur;
+                remove_from_free_list(arena, cur, bucket);
+                LOG(2, "\tusing pre-aligned free entry size=%d for request=%d "
+                    "align=%d from bucket %d\n", head->alloc_size, request_size,
+                    alignment, bucket);
+                STATS_INC(num_aligned_reuses);
+                claim_free_chunk(arena, head, aligned_size);
+                return head;
+            }
         }
-        head->flags &= ~(CHUNK_FREED | ALLOCATOR_TYPE_FLAGS);
-
-        next = next_chunk_forward(arena, head, &container);
-        if (next != NULL)
-            next->flags &= ~CHUNK_PREV_FREE;
-        else if (container != NULL)
-            container->prev_free_sz = 0;
     }
-    return head;
+    return NULL;
 }
 
 /* i#1581: to avoid retaddr local vars from callstack walks messing up app
@@ -1652,6 +1805,55 @@ find_free_list_entry(arena_header_t *arena, heapsz_t request_size, heapsz_t alig
                            (void *)(ptr_uint_t)(flags), \
                            dc, mc, caller, (void *)(ptr_uint_t)(alloc_type))
 
+/* Returns the padding to add beyond the inter-chunk redzone for an allocation
+ * of request_size under -redzone_adaptive.  The target trailing redzone is
+ * proportional to request_size, bounded by alloc_ops.redzone_size (which is the
+ * -redzone_adaptive_min value in this mode) and alloc_ops.redzone_adaptive_max.
+ * client_data is the allocation site's data from client_add_malloc_pre(), if
+ * known, which the client uses to drop the padding for quiet sites.
+ */
+static heapsz_t
+adaptive_redzone_extra(size_t request_size, void *client_data)
+{
+    size_t target = request_size / alloc_ops.redzone_adaptive_scale;
+    /* The shared space between chunks already acts as the trailing redzone */
+    size_t base = inter_chunk_space();
+    heapsz_t extra;
+    if (target > alloc_ops.redzone_adaptive_max)
+        target = alloc_ops.redzone_adaptive_max;
+    if (target <= base)
+        return 0;
+    if (client_data != NULL && client_malloc_site_quiet(client_data)) {
+        STATS_INC(adaptive_redzone_quiet);
+        return 0;
+    }
+    extra = (heapsz_t) ALIGN_FORWARD(target - base, CHUNK_ALIGNMENT);
+    STATS_INC(adaptive_redzone_allocs);
+    STATS_ADD(adaptive_redzone_bytes, extra);
+    return extra;
+}
+
+/* Returns the space to carve from arena->next_chunk, including the trailing
+ * inter-chunk space, for a chunk of unpadded_size whose user pointer must be
+ * aligned to alignment.  Rather than the worst-case padding, we take just what
+ * this arena's current position requires, which is nothing when it happens to
+ * be aligned already.
+ */
+static heapsz_t
+carve_size_aligned(arena_header_t *arena, heapsz_t unpadded_size, size_t alignment)
+{
+    /* A carved chunk's user pointer is arena->next_chunk. */
+    byte *res = arena->next_chunk;
+    heapsz_t pad = 0;
+    if (!ALIGNED(res, alignment)) {
+        /* Mirror the pre-aligned split in replace_alloc_common() */
+        pad = (heapsz_t)
+            (ALIGN_FORWARD(res + CHUNK_MIN_SIZE + inter_chunk_space(), alignment) -
+             (ptr_uint_t)res);
+    }
+    return unpadded_size + pad + inter_chunk_space();
+}
+
 /* As noted in the flag definitions, ALLOC_INVOKE_CLIENT_* in flags
  * only applies to successful allocation: client is still notified on failure
  * and when client user data is freed or shifted.
@@ -1667,8 +1869,13 @@ replace_alloc_common(arena_header_t *arena, size_t request_size, size_t alignmen
                      app_pc caller, uint alloc_type)
 {
     heapsz_t aligned_size;
+    /* aligned_size without the worst-case alignment padding */
+    heapsz_t unpadded_size;
     byte *res = NULL;
     chunk_header_t *head = NULL;
+    /* Client data obtained early for -redzone_adaptive */
+    void *site_data = NULL;
+    bool known_zero = false;
     ASSERT((alloc_type & ~(ALLOCATOR_TYPE_FLAGS)) == 0, "invalid type flags");
 
     if (request_size > UINT_MAX ||
@@ -1692,16 +1899,35 @@ replace_alloc_common(arena_header_t *arena, size_t request_size, size_t alignmen
         alignment = CHUNK_ALIGNMENT;
 
     aligned_size = ALIGN_FORWARD(request_size, CHUNK_ALIGNMENT);
+    if (aligned_size < CHUNK_MIN_SIZE)
+        aligned_size = CHUNK_MIN_SIZE;
+    unpadded_size = aligned_size;
     if (alignment > CHUNK_ALIGNMENT) {
-        /* We brute-force and alloc enough space to ensure we can back the
-         * pre-aligned-padding as a free slot, to avoid any complexity of
-         * having pre-header padding.
+        /* In the worst case we need enough space to back the pre-aligned
+         * padding as a free slot, to avoid any complexity of having
+         * pre-header padding.  We first try to avoid paying for it, below.
          */
         aligned_size += alignment + CHUNK_MIN_SIZE + inter_chunk_space();
     }
     ASSERT(aligned_size >= request_size, "overflow should have been caught");
-    if (aligned_size < CHUNK_MIN_SIZE)
-        aligned_size = CHUNK_MIN_SIZE;
+    /* The extra padding is beyond request_size and thus stays unaddressable.
+     * We skip it for special alignments, whose padding is already close to
+     * REQUEST_DIFF_MAX for large alignments.
+     */
+    if (alloc_ops.redzone_adaptive && alignment == CHUNK_ALIGNMENT) {
+        /* Per-site tuning needs the allocation's callstack before we size the
+         * chunk, so we obtain the client data now (outside of the arena lock)
+         * and hand it to notify_client_alloc() below.
+         */
+        if (TEST(ALLOC_INVOKE_CLIENT_DATA, flags)) {
+            malloc_info_t info = { sizeof(info), NULL, request_size, 0,
+                                   false/*!pre_us*/, true/*redzone*/,
+                                   TEST(ALLOC_ZERO, flags), TEST(ALLOC_IS_REALLOC, flags),
+                                   0, NULL };
+            site_data = client_add_malloc_pre(&info, mc, caller);
+        }
+        aligned_size += adaptive_redzone_extra(request_size, site_data);
+    }
 
     arena_lock(drcontext, arena, TEST(ALLOC_SYNCHRONIZE, flags));
 
@@ -1746,9 +1972,19 @@ replace_alloc_common(arena_header_t *arena, size_t request_size, size_t alignmen
         head->magic = HEADER_MAGIC;
         head->alloc_size = (map + map_size - alloc_ops.redzone_size - res);
         heap_region_add(map, map + map_size, HEAP_MMAP, mc);
+        known_zero = true; /* fresh mapping */
     } else {
+        /* Apply any limit lowered under memory pressure, oldest first */
+        while (arena->free_list->delayed_bytes > quarantine_maxsz) {
+            if (!shift_from_delay_list_to_free_list(arena))
+                break;
+        }
         /* look for free list entry */
-        head = find_free_list_entry(arena, request_size, aligned_size);
+        if (alignment > CHUNK_ALIGNMENT)
+            head = find_aligned_free_list_entry(arena, request_size, unpadded_size,
+                                                alignment);
+        if (head == NULL)
+            head = find_free_list_entry(arena, request_size, aligned_size);
         if (head != NULL) {
             malloc_info_t info;
             header_to_info(head, &info, NULL, 0);
@@ -1770,13 +2006,20 @@ replace_alloc_common(arena_header_t *arena, size_t request_size, size_t alignmen
         arena_header_t *last_arena = arena;
         byte *orig_next_chunk;
         while (arena != NULL) {
+            if (alignment > CHUNK_ALIGNMENT)
+                add_size = carve_size_aligned(arena, unpadded_size, alignment);
             if (arena->next_chunk + add_size <= arena->commit_end)
                 break;
             last_arena = arena;
             arena = arena->next_arena;
         }
-        if (arena == NULL)
+        if (arena == NULL) {
+            /* Size the extension for the worst-case padding */
+            add_size = aligned_size + inter_chunk_space();
             arena = arena_extend(last_arena, add_size);
+            if (arena != NULL && alignment > CHUNK_ALIGNMENT)
+                add_size = carve_size_aligned(arena, unpadded_size, alignment);
+        }
         if (arena == NULL) {  /* ignore ALLOC_INVOKE_CLIENT */
             /* i#1829: better to abandon the delayed frees (yes, all of them) to
              * avoid OOM in the app.  This is rare so we can afford the simple
@@ -1801,14 +2044,21 @@ replace_alloc_common(arena_header_t *arena, size_t request_size, size_t alignmen
             /* remember that arena->next_chunk always has a redzone preceding it */
             head = (chunk_header_t *)
                 (arena->next_chunk - redzone_beyond_header - header_size);
-            head->alloc_size = aligned_size;
+            head->alloc_size = add_size - inter_chunk_space();
             head->magic = HEADER_MAGIC;
             head->user_data = NULL; /* b/c we pass the old to client */
             head->flags = 0;
             LOG(2, "\tcarving out new chunk @"PFX" => head="PFX", res="PFX"\n",
                 arena->next_chunk - alloc_ops.redzone_size, head, ptr_from_header(head));
             orig_next_chunk = arena->next_chunk;
+            if (alignment > CHUNK_ALIGNMENT && ALIGNED(orig_next_chunk, alignment))
+                STATS_INC(num_aligned_exact_carves);
             arena->next_chunk += add_size;
+            /* Our header is below orig_next_chunk, so the user data is untouched */
+            if (orig_next_chunk >= arena->zero_start)
+                known_zero = true;
+            if (arena->next_chunk > arena->zero_start)
+                arena->zero_start = arena->next_chunk;
             if (arena->prev_free_sz != 0) {
                 /* There's a prior free, so we need to mark this new chunk with
                  * prev-free info.
@@ -1846,18 +2096,24 @@ replace_alloc_common(arena_header_t *arena, size_t request_size, size_t alignmen
             head->alloc_size, res - orig_res);
         split_piece_for_free_list(arena, head, pre, pre_sz,
                                   head->alloc_size - (res - orig_res));
-        ASSERT(head->alloc_size > request_size, "pre-align miscalculation");
+        /* An exactly-padded carve leaves no slack beyond unpadded_size */
+        ASSERT(head->alloc_size >= request_size, "pre-align miscalculation");
         head->u.unfree.request_diff = head->alloc_size - request_size;
     }
     LOG(2, "\treplace_alloc_common arena="PFX" flags=0x%x request=%d, align=%d alloc=%d "
         "=> "PFX"\n", arena, head->flags,
         chunk_request_size(head), alignment, head->alloc_size, res);
-    if (TEST(ALLOC_ZERO, flags))
-        memset(res, 0, request_size);
+    if (TEST(ALLOC_ZERO, flags)) {
+        /* Avoid touching every page of a large calloc that the OS already zeroed */
+        if (known_zero)
+            STATS_INC(num_zero_skips);
+        else
+            memset(res, 0, request_size);
+    }
 
     ASSERT(head->alloc_size >= request_size, "chunk too small");
 
-    notify_client_alloc(drcontext, (byte *)res, head, flags, mc, caller);
+    notify_client_alloc(drcontext, (byte *)res, head, flags, mc, caller, site_data);
 
     if (chunk_request_size(head) >= LARGE_MALLOC_MIN_SIZE)
         malloc_large_add(res, request_size);
@@ -1866,6 +2122,8 @@ replace_alloc_common(arena_header_t *arena, size_t request_size, size_t alignmen
 
  replace_alloc_common_done:
     arena_unlock(drcontext, arena, TEST(ALLOC_SYNCHRONIZE, flags));
+    if (res == NULL && site_data != NULL)
+        client_malloc_data_free(site_data);
 
     return res;
 }
@@ -2080,6 +2338,87 @@ replace_free_common(arena_header_t *arena, void *ptr, alloc_flags_t flags,
     return true;
 }
 
+/* Tries to grow the live chunk head to hold size bytes without moving it, either
+ * by absorbing the front of a following true free chunk (never a delayed free,
+ * whose use-after-free detection we want to keep) or by extending into the
+ * uncarved tail of its sub-arena.  On success, head's alloc_size and
+ * request_diff are updated but the client has not yet been notified.
+ * Caller must hold the arena lock.
+ */
+static bool
+grow_chunk_in_place(void *drcontext, arena_header_t *arena, chunk_header_t *head,
+                    size_t size, dr_mcontext_t *mc)
+{
+    arena_header_t *container = NULL;
+    chunk_header_t *next;
+    heapsz_t aligned_size = (heapsz_t) ALIGN_FORWARD(size, CHUNK_ALIGNMENT);
+    if (TESTANY(CHUNK_MMAP | CHUNK_PRE_US, head->flags))
+        return false;
+    /* Leave sizes we would mmap to the regular malloc-and-free path */
+    if (aligned_size < size || aligned_size + header_size >= CHUNK_MIN_MMAP)
+        return false;
+    if (alloc_ops.redzone_adaptive)
+        aligned_size += adaptive_redzone_extra(size, head->user_data);
+    if (aligned_size <= head->alloc_size)
+        return false;
+
+    next = next_chunk_forward(arena, head, &container);
+    if (next != NULL) {
+        malloc_info_t info;
+        /* The piece of next we need, keeping next a valid chunk for the split */
+        heapsz_t piece = aligned_size - head->alloc_size;
+        piece = (piece > inter_chunk_space()) ? piece - inter_chunk_space() : 0;
+        piece = (heapsz_t) ALIGN_FORWARD(piece, CHUNK_ALIGNMENT);
+        if (piece < CHUNK_MIN_SIZE)
+            piece = CHUNK_MIN_SIZE;
+        if (!TEST(CHUNK_FREED, next->flags) || TEST(CHUNK_DELAY_FREE, next->flags) ||
+            next->alloc_size < piece)
+            return false;
+        /* Whatever split_free_chunk() leaves in next is what we absorb */
+        if (next->alloc_size <= piece + CHUNK_MIN_SIZE + inter_chunk_space())
+            piece = next->alloc_size;
+        if (head->alloc_size + inter_chunk_space() + piece - size > REQUEST_DIFF_MAX)
+            return false;
+        LOG(2, "\t%s: absorbing %d of %d bytes of free chunk "PFX"\n", __FUNCTION__,
+            piece, next->alloc_size, next);
+        /* Synchronize with iterators (i#949) */
+        iterator_lock(arena, true/*in alloc*/);
+        remove_from_free_list(arena, (free_header_t *)next, UINT_MAX);
+        split_free_chunk(arena, next, piece);
+        header_to_info(next, &info, NULL, 0);
+        client_handle_free_reuse(drcontext, &info, mc);
+        if (next->user_data != NULL)
+            client_malloc_data_free(next->user_data);
+        head->alloc_size += inter_chunk_space() + next->alloc_size;
+        head->u.unfree.request_diff = head->alloc_size - size;
+        iterator_unlock(arena, true/*in alloc*/);
+        /* What follows, if anything, now has a live predecessor */
+        next = next_chunk_forward(arena, head, &container);
+        if (next != NULL)
+            next->flags &= ~CHUNK_PREV_FREE;
+        else if (container != NULL)
+            container->prev_free_sz = 0;
+    } else if (container != NULL &&
+               ptr_from_header(head) + head->alloc_size + inter_chunk_space() ==
+               container->next_chunk &&
+               container->next_chunk + (aligned_size - head->alloc_size) <=
+               container->commit_end) {
+        ASSERT(container->prev_free_sz == 0, "last chunk is live");
+        LOG(2, "\t%s: extending sub-arena "PFX" tail by %d bytes\n", __FUNCTION__,
+            container, aligned_size - head->alloc_size);
+        iterator_lock(arena, true/*in alloc*/);
+        container->next_chunk += aligned_size - head->alloc_size;
+        if (container->next_chunk > container->zero_start)
+            container->zero_start = container->next_chunk;
+        head->alloc_size = aligned_size;
+        head->u.unfree.request_diff = head->alloc_size - size;
+        iterator_unlock(arena, true/*in alloc*/);
+    } else
+        return false;
+    STATS_INC(num_realloc_grows);
+    return true;
+}
+
 /* See i#1581 notes above */
 #define ONDSTACK_REPLACE_REALLOC_COMMON(arena, ptr, size, flags, dc, mc, caller, type) \
     dr_call_on_clean_stack(dc, (void* (*)(void)) replace_realloc_common, arena, ptr,   \
@@ -2156,13 +2495,30 @@ replace_realloc_common(arena_header_t *arena, byte *ptr, size_t size,
         res = ptr;
         header_to_info(head, &new_info, NULL, flags | ALLOC_IS_REALLOC);
         client_handle_realloc(drcontext, &old_info, &new_info, false, mc);
+    } else if (head->alloc_size < size &&
+               /* Moving lets use-after-realloc be detected, so growing is optional,
+                * but an in-place-only request can't move anyway.
+                */
+               (alloc_ops.realloc_in_place || TEST(ALLOC_IN_PLACE_ONLY, flags)) &&
+               grow_chunk_in_place(drcontext, arena, head, size, mc)) {
+        LOG(2, "\t%s: grew in place from %d to %d bytes\n", __FUNCTION__,
+            old_info.request_size, size);
+        if (old_info.request_size >= LARGE_MALLOC_MIN_SIZE)
+            malloc_large_remove(ptr);
+        if (TEST(ALLOC_ZERO, flags))
+            memset(ptr + old_info.request_size, 0, size - old_info.request_size);
+        if (size >= LARGE_MALLOC_MIN_SIZE)
+            malloc_large_add(ptr, size);
+        res = ptr;
+        /* The client only adjusts shadow and redzone for the delta */
+        header_to_info(head, &new_info, NULL, flags | ALLOC_IS_REALLOC);
+        client_handle_realloc(drcontext, &old_info, &new_info, false, mc);
     } else if (!TEST(ALLOC_IN_PLACE_ONLY, flags) || head->alloc_size >= size) {
         size_t old_request_size = chunk_request_size(head);
         bool was_mmap = TEST(CHUNK_MMAP, head->flags);
         LOG(2, "\t%s: malloc-and-free realloc from %d to %d bytes\n", __FUNCTION__,
             old_request_size, size);
         /* XXX: use mremap for mmapped alloc! */
-        /* XXX: if final chunk in arena, extend in-place */
         res = (void *) replace_alloc_common(arena, size, 0,
                                             sub_flags | ALLOC_IS_REALLOC /*no client*/,
                                             drcontext, mc, caller, alloc_type);
@@ -2190,7 +2546,7 @@ replace_realloc_common(arena_header_t *arena, byte *ptr, size_t size,
              */
             notify_client_alloc(drcontext, (byte *)res, head,
                                 flags | ALLOC_IS_REALLOC | ALLOC_INVOKE_CLIENT_DATA,
-                                mc, caller);
+                                mc, caller, NULL);
             client_handle_realloc(drcontext, &old_info, &new_info, was_mmap, mc);
         }
     }
@@ -2250,6 +2606,8 @@ destroy_arena_family(arena_header_t *arena, dr_mcontext_t *mc, bool free_chunks,
     arena_header_t *a, *next_a;
     chunk_header_t *head;
     malloc_info_t info;
+    /* The family shares a single free list */
+    ATOMIC_ADD32(delayed_bytes_total, -(int)arena->free_list->delayed_bytes);
     for (a = arena; a != NULL; a = next_a) {
         next_a = a->next_arena;
         if (free_chunks) {
@@ -2530,6 +2888,31 @@ alloc_replace_overlaps_malloc(byte *start, byte *end,
     return alloc_replace_overlaps_region(start, end, info, 0, CHUNK_FREED);
 }
 
+size_t
+alloc_replace_delayed_bytes(void)
+{
+    return delayed_bytes_total;
+}
+
+void
+alloc_replace_quarantine_update(size_t max_bytes, size_t max_chunk, uint clock)
+{
+    if (max_bytes > alloc_ops.delay_frees_maxsz)
+        max_bytes = alloc_ops.delay_frees_maxsz;
+    quarantine_maxsz = max_bytes;
+    quarantine_chunk_max = max_chunk;
+    quarantine_clock = clock;
+}
+
+void
+alloc_replace_quarantine_residence(uint64 *total_ms OUT, uint64 *evictions OUT)
+{
+    dr_mutex_lock(quarantine_lock);
+    *total_ms = quarantine_residence_ms;
+    *evictions = quarantine_evictions;
+    dr_mutex_unlock(quarantine_lock);
+}
+
 /***************************************************************************
  * app-facing interface
  */
@@ -3239,6 +3622,8 @@ pre_existing_heap_init(HANDLE heap)
 
         arena_init(arena, NULL);
         arena->flags |= ARENA_PRE_US_MAPPED;
+        /* The committed part of the pre-us Heap may have stale data (i#1823) */
+        arena->zero_start = arena->commit_end;
         LOG(2, "new arena inside mmapped pre-us Heap "PFX" is "PFX"-"PFX"-"PFX"\n",
             heap, arena, arena->commit_end, arena->reserve_end);
     } else {
@@ -5101,7 +5486,7 @@ malloc_replace__add(app_pc start, app_pc end, app_pc real_end,
     ASSERT(new_entry, "should be no pre-us dups");
     notify_client_alloc(NULL, start, head,
                         /* no client action: caller can do that on its own */
-                        ALLOC_INVOKE_CLIENT_DATA, mc, post_call);
+                        ALLOC_INVOKE_CLIENT_DATA, mc, post_call, NULL);
 }
 
 static bool
@@ -5291,6 +5676,17 @@ alloc_replace_init(void)
 
     hashtable_init(&pre_us_table, PRE_US_TABLE_HASH_BITS, HASH_INTPTR, false/*!strdup*/);
 
+    quarantine_maxsz = alloc_ops.delay_frees_maxsz;
+    quarantine_chunk_max = alloc_ops.delay_frees_maxsz;
+    quarantine_lock = dr_mutex_create();
+
+    if (alloc_ops.redzone_adaptive) {
+        ASSERT(alloc_ops.redzone_adaptive_scale > 0, "invalid redzone scale");
+        /* Keep the padding well within request_diff's range */
+        ASSERT(alloc_ops.redzone_adaptive_max + PAGE_SIZE < REQUEST_DIFF_MAX,
+               "adaptive redzone max too large");
+    }
+
 #ifdef WINDOWS
     if (alloc_ops.global_lock)
         global_lock = dr_recurlock_create();
@@ -5400,9 +5796,16 @@ alloc_replace_exit(void)
     LOG(1, "  peak heap capacity: %9d\n", peak_heap_capacity);
     LOG(1, "  splits:             %9d\n", num_splits);
     LOG(1, "  coalesces:          %9d\n", num_coalesces);
+    LOG(1, "  in-place grows:     %9d\n", num_realloc_grows);
+    LOG(1, "  zeroing skipped:    %9d\n", num_zero_skips);
+    LOG(1, "  aligned reuses:     %9d\n", num_aligned_reuses);
+    LOG(1, "  aligned carves:     %9d\n", num_aligned_exact_carves);
     LOG(1, "  deallocs:           %9d\n", num_dealloc);
     LOG(1, "  dbgcrt mismatches:  %9d\n", dbgcrt_mismatch);
     LOG(1, "  allocs left native: %9d\n", allocs_left_native);
+    LOG(1, "  adaptive redzones:  %9d\n", adaptive_redzone_allocs);
+    LOG(1, "  adaptive rz bytes:  %9d\n", adaptive_redzone_bytes);
+    LOG(1, "  quiet-site allocs:  %9d\n", adaptive_redzone_quiet);
 #endif
 
     /* On Win10 at process exit, RtlLockHeap is called but the private
@@ -5428,6 +5831,8 @@ alloc_replace_exit(void)
     }
     hashtable_delete_with_stats(&pre_us_table, "pre_us");
 
+    dr_mutex_destroy(quarantine_lock);
+
 #ifdef WINDOWS
 # ifdef X64
     replace_nosy_exit();
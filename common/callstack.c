@@ -62,6 +62,8 @@ static uint cstack_is_retaddr;
 static uint cstack_is_retaddr_backdecode;
 static uint cstack_is_retaddr_unreadable;
 static uint cstack_is_retaddr_unseen;
+static uint callstacks_scratch_recorded;
+static uint callstacks_scratch_persisted;
 #endif
 
 /* Cached frame pointer values to avoid repeated scans (i#1186) */
@@ -92,6 +94,13 @@ typedef struct _tls_callstack_t {
     /* Optimization for FPO-optimized apps */
     fpscan_cache_entry fpcache[FPSCAN_CACHE_ENTRIES];
     uint fpcache_idx;
+    /* Scratch space for packed_callstack_record_scratch(), so that recording a
+     * callstack that is already interned costs no heap allocation.  The frames
+     * buffer holds ops.global_max_frames full_frame_t entries.
+     */
+    struct _packed_callstack_t *scratch_pcs;
+    void *scratch_frames;
+    syscall_loc_t scratch_sysloc;
 } tls_callstack_t;
 
 static int tls_idx_callstack = -1;
@@ -192,12 +201,22 @@ struct _packed_callstack_t {
     bool first_is_retaddr:1;
     /* whether first frame is a syscall (invariant: later frames never are) */
     bool first_is_syscall:1;
+    /* whether this is a thread's scratch callstack, owned by tls_callstack_t */
+    bool is_scratch:1;
     union {
         packed_frame_t *packed;
         full_frame_t *full;
     } frames;
+    /* Running identity hash, updated as each frame is added.  It hashes what
+     * the frame refers to rather than its encoding, so it is the same for
+     * packed and full frames.
+     */
+    hash128_t hash;
 };
 
+/* Each frame adds this many words to packed_callstack_t.hash */
+#define PCS_HASH_WORDS_PER_FRAME 3
+
 /* multiplexing between packed and full frames */
 #define PCS_FRAME_LOC(pcs, n) \
     ((pcs)->is_packed ? (pcs)->frames.packed[n].loc : (pcs)->frames.full[n].loc)
@@ -385,6 +404,8 @@ callstack_dump_statistics(file_t f)
     dr_fprintf(f, "callstack is_retaddr cont'd: unseen %8u\n",
                cstack_is_retaddr_unseen);
     dr_fprintf(f, "symbol names truncated: %8u\n", symbol_names_truncated);
+    dr_fprintf(f, "scratch callstacks: %8u, persisted: %8u\n",
+               callstacks_scratch_recorded, callstacks_scratch_persisted);
 }
 #endif
 
@@ -428,6 +449,12 @@ callstack_thread_init(void *drcontext)
     pt->errbuf = (char *) thread_alloc(drcontext, pt->errbufsz, HEAPSTAT_CALLSTACK);
     /* We take the space hit to avoid serializing all mallocs just for callstacks */
     pt->page_buf = (byte *) thread_alloc(drcontext, PAGE_SIZE, HEAPSTAT_CALLSTACK);
+    pt->scratch_pcs = (packed_callstack_t *)
+        thread_alloc(drcontext, sizeof(*pt->scratch_pcs), HEAPSTAT_CALLSTACK);
+    /* Sized for full frames so that it can hold either kind */
+    ASSERT(sizeof(full_frame_t) >= sizeof(packed_frame_t), "frame size mismatch");
+    pt->scratch_frames = thread_alloc(drcontext, sizeof(full_frame_t) *
+                                      ops.global_max_frames, HEAPSTAT_CALLSTACK);
 #ifdef WINDOWS
     if (get_TEB() != NULL) {
         pt->stack_lowest_frame = get_TEB()->StackBase;
@@ -485,6 +512,10 @@ callstack_thread_exit(void *drcontext)
         drmgr_get_tls_field(drcontext, tls_idx_callstack);
     thread_free(drcontext, (void *) pt->errbuf, pt->errbufsz, HEAPSTAT_CALLSTACK);
     thread_free(drcontext, (void *) pt->page_buf, PAGE_SIZE, HEAPSTAT_CALLSTACK);
+    thread_free(drcontext, pt->scratch_pcs, sizeof(*pt->scratch_pcs),
+                HEAPSTAT_CALLSTACK);
+    thread_free(drcontext, pt->scratch_frames, sizeof(full_frame_t) *
+                ops.global_max_frames, HEAPSTAT_CALLSTACK);
     drmgr_set_tls_field(drcontext, tls_idx_callstack, NULL);
     thread_free(drcontext, pt, sizeof(*pt), HEAPSTAT_MISC);
 }
@@ -857,6 +888,15 @@ print_frame(symbolized_frame_t *frame IN,
     BUFPRINT(buf, bufsz, *sofar, len, NL);
 }
 
+static inline void
+packed_callstack_hash_frame(packed_callstack_t *pcs, app_pc pc,
+                           modname_info_t *name_info, size_t modoffs)
+{
+    hash128_update(&pcs->hash, (ptr_uint_t)pc);
+    hash128_update(&pcs->hash, (ptr_uint_t)name_info);
+    hash128_update(&pcs->hash, modoffs);
+}
+
 /* Fills in frame xor pcs.
  * Returns whether a new frame was added (won't be if skip_non_module and pc
  * is not in a module)
@@ -913,6 +953,7 @@ address_to_frame(symbolized_frame_t *frame OUT, packed_callstack_t *pcs OUT,
                 pcs->frames.full[pcs_idx].modoffs = sz;
                 pcs->frames.full[pcs_idx].modname = name_info;
             }
+            packed_callstack_hash_frame(pcs, pc, name_info, pc - mod_start);
             pcs->num_frames++;
         } else {
             const char *modname = (name_info->name == NULL) ?
@@ -944,6 +985,7 @@ address_to_frame(symbolized_frame_t *frame OUT, packed_callstack_t *pcs OUT,
                 pcs->frames.full[pcs->num_frames].modoffs = 0;
                 pcs->frames.full[pcs->num_frames].modname = NULL;
             }
+            packed_callstack_hash_frame(pcs, pc, NULL, 0);
             pcs->num_frames++;
         } else {
             ASSERT(!frame->is_module, "frame not initialized");
@@ -1982,11 +2024,10 @@ app_pc
 callstack_next_retaddr(dr_mcontext_t *mc)
 {
     app_pc res = NULL;
-    packed_callstack_t *pcs;
-    packed_callstack_record(&pcs, mc, NULL, 1);
+    packed_callstack_t *pcs = packed_callstack_record_scratch(mc, NULL, 1);
     if (pcs->num_frames > 0)
         res = PCS_FRAME_LOC(pcs, 0).addr;
-    packed_callstack_destroy(pcs);
+    packed_callstack_discard(pcs);
     return res;
 }
 
@@ -1994,31 +2035,14 @@ callstack_next_retaddr(dr_mcontext_t *mc)
  * Binary callstacks for storing callstacks of allocation sites.
  */
 
-/* Used for standalone allocation, rather than printing as part of an error report.
- * Caller must call free_callstack() to free buf_out.
+/* Walks the callstack into pcs, whose frames array must have room for max_frames.
+ * sysloc is the storage for the top frame if loc is a syscall.
  */
-void
-packed_callstack_record(packed_callstack_t **pcs_out/*out*/, dr_mcontext_t *mc,
-                        app_loc_t *loc, uint max_frames)
+static void
+packed_callstack_fill(packed_callstack_t *pcs, dr_mcontext_t *mc, app_loc_t *loc,
+                      uint max_frames, syscall_loc_t *sysloc)
 {
-    packed_callstack_t *pcs = (packed_callstack_t *)
-        global_alloc(sizeof(*pcs), HEAPSTAT_CALLSTACK);
-    size_t sz_out;
     int num_frames_printed = 0;
-    ASSERT(max_frames <= ops.global_max_frames, "max_frames > global_max_frames");
-    ASSERT(pcs_out != NULL, "invalid args");
-    memset(pcs, 0, sizeof(*pcs));
-    pcs->refcount = 1;
-    if (modname_array_end < MAX_MODNAMES_STORED) {
-        pcs->is_packed = true;
-        pcs->frames.packed = (packed_frame_t *)
-            global_alloc(sizeof(*pcs->frames.packed) * max_frames,
-                         HEAPSTAT_CALLSTACK);
-    } else {
-        pcs->is_packed = false;
-        pcs->frames.full = (full_frame_t *)
-            global_alloc(sizeof(*pcs->frames.full) * max_frames, HEAPSTAT_CALLSTACK);
-    }
     if (loc != NULL) {
         if (loc->type == APP_LOC_SYSCALL) {
             /* For syscalls, we use index 0 and external storage.
@@ -2026,18 +2050,20 @@ packed_callstack_record(packed_callstack_t **pcs_out/*out*/, dr_mcontext_t *mc,
              * is supposed to be a string literal and so we can clone it
              * and compare it by just using its address.
              */
+            ASSERT(sysloc != NULL, "no storage for syscall frame");
             pcs->first_is_syscall = true;
+            *sysloc = loc->u.syscall;
             if (pcs->is_packed) {
                 pcs->frames.packed[0].modname_idx = 0;
-                pcs->frames.packed[0].loc.sysloc = (syscall_loc_t *)
-                    global_alloc(sizeof(syscall_loc_t), HEAPSTAT_CALLSTACK);
-                *pcs->frames.packed[0].loc.sysloc = loc->u.syscall;
+                pcs->frames.packed[0].loc.sysloc = sysloc;
             } else {
                 pcs->frames.full[0].modname = (modname_info_t *) &MODNAME_INFO_SYSCALL;
-                pcs->frames.full[0].loc.sysloc = (syscall_loc_t *)
-                    global_alloc(sizeof(syscall_loc_t), HEAPSTAT_CALLSTACK);
-                *pcs->frames.full[0].loc.sysloc = loc->u.syscall;
+                pcs->frames.full[0].loc.sysloc = sysloc;
             }
+            /* The syscall aux string is a literal so its address identifies it */
+            hash128_update(&pcs->hash, (uint)loc->u.syscall.sysnum.number);
+            hash128_update(&pcs->hash, (uint)loc->u.syscall.sysnum.secondary);
+            hash128_update(&pcs->hash, (ptr_uint_t)loc->u.syscall.syscall_aux);
             pcs->num_frames++;
         } else {
             app_pc pc = loc_to_pc(loc);
@@ -2048,6 +2074,39 @@ packed_callstack_record(packed_callstack_t **pcs_out/*out*/, dr_mcontext_t *mc,
     }
     print_callstack(NULL, 0, NULL, mc, false, pcs, num_frames_printed, false,
                     max_frames, NULL, NULL);
+}
+
+/* Used for standalone allocation, rather than printing as part of an error report.
+ * Caller must call free_callstack() to free buf_out.
+ */
+void
+packed_callstack_record(packed_callstack_t **pcs_out/*out*/, dr_mcontext_t *mc,
+                        app_loc_t *loc, uint max_frames)
+{
+    packed_callstack_t *pcs = (packed_callstack_t *)
+        global_alloc(sizeof(*pcs), HEAPSTAT_CALLSTACK);
+    syscall_loc_t *sysloc = NULL;
+    size_t sz_out;
+    ASSERT(max_frames <= ops.global_max_frames, "max_frames > global_max_frames");
+    ASSERT(pcs_out != NULL, "invalid args");
+    memset(pcs, 0, sizeof(*pcs));
+    pcs->refcount = 1;
+    hash128_init(&pcs->hash);
+    if (modname_array_end < MAX_MODNAMES_STORED) {
+        pcs->is_packed = true;
+        pcs->frames.packed = (packed_frame_t *)
+            global_alloc(sizeof(*pcs->frames.packed) * max_frames,
+                         HEAPSTAT_CALLSTACK);
+    } else {
+        pcs->is_packed = false;
+        pcs->frames.full = (full_frame_t *)
+            global_alloc(sizeof(*pcs->frames.full) * max_frames, HEAPSTAT_CALLSTACK);
+    }
+    if (loc != NULL && loc->type == APP_LOC_SYSCALL) {
+        sysloc = (syscall_loc_t *)
+            global_alloc(sizeof(syscall_loc_t), HEAPSTAT_CALLSTACK);
+    }
+    packed_callstack_fill(pcs, mc, loc, max_frames, sysloc);
     if (pcs->is_packed) {
         packed_frame_t *frames_out;
         sz_out = sizeof(*pcs->frames.packed) * pcs->num_frames;
@@ -2076,6 +2135,62 @@ packed_callstack_record(packed_callstack_t **pcs_out/*out*/, dr_mcontext_t *mc,
     *pcs_out = pcs;
 }
 
+packed_callstack_t *
+packed_callstack_record_scratch(dr_mcontext_t *mc, app_loc_t *loc, uint max_frames)
+{
+    void *drcontext = dr_get_current_drcontext();
+    tls_callstack_t *pt = (tls_callstack_t *)
+        ((drcontext == NULL) ? NULL : drmgr_get_tls_field(drcontext, tls_idx_callstack));
+    packed_callstack_t *pcs;
+    ASSERT(max_frames <= ops.global_max_frames, "max_frames > global_max_frames");
+    if (pt == NULL) {
+        /* No per-thread storage yet (or any more), so fall back to the heap */
+        packed_callstack_record(&pcs, mc, loc, max_frames);
+        return pcs;
+    }
+    pcs = pt->scratch_pcs;
+    memset(pcs, 0, sizeof(*pcs));
+    pcs->is_scratch = true;
+    hash128_init(&pcs->hash);
+    if (modname_array_end < MAX_MODNAMES_STORED) {
+        pcs->is_packed = true;
+        pcs->frames.packed = (packed_frame_t *) pt->scratch_frames;
+    } else {
+        pcs->is_packed = false;
+        pcs->frames.full = (full_frame_t *) pt->scratch_frames;
+    }
+    packed_callstack_fill(pcs, mc, loc, max_frames, &pt->scratch_sysloc);
+    /* Match packed_callstack_record() for packed_callstack_cmp() */
+    if (pcs->num_frames == 0) {
+        if (pcs->is_packed)
+            pcs->frames.packed = NULL;
+        else
+            pcs->frames.full = NULL;
+    }
+    STATS_INC(callstacks_scratch_recorded);
+    return pcs;
+}
+
+packed_callstack_t *
+packed_callstack_persist(packed_callstack_t *pcs)
+{
+    ASSERT(pcs != NULL, "invalid args");
+    if (!pcs->is_scratch)
+        return pcs;
+    STATS_INC(callstacks_scratch_persisted);
+    return packed_callstack_clone(pcs);
+}
+
+void
+packed_callstack_discard(packed_callstack_t *pcs)
+{
+    ASSERT(pcs != NULL, "invalid args");
+    if (!pcs->is_scratch) {
+        IF_DEBUG(uint count =) packed_callstack_free(pcs);
+        ASSERT(count == 0, "refcount should be 0");
+    }
+}
+
 void
 packed_callstack_first_frame_retaddr(packed_callstack_t *pcs)
 {
@@ -2128,6 +2243,31 @@ packed_callstack_frame_modinfo(packed_callstack_t *pcs, uint frame,
     return true;
 }
 
+bool
+packed_callstack_frame_module(packed_callstack_t *pcs, uint frame,
+                              const char **modname OUT, void **user_data OUT,
+                              size_t *modoffs OUT, size_t *sym_modoffs OUT)
+{
+    modname_info_t *info = NULL;
+    size_t offs;
+    if (!packed_callstack_frame_modinfo(pcs, frame, &info, &offs))
+        return false;
+    if (modname != NULL) {
+        /* Must match packed_frame_to_symbolized() */
+        if (info == NULL)
+            *modname = NULL;
+        else
+            *modname = (info->name == NULL) ? "<name unavailable>" : info->name;
+    }
+    if (user_data != NULL)
+        *user_data = (info == NULL) ? NULL : info->user_data;
+    if (modoffs != NULL)
+        *modoffs = offs;
+    if (sym_modoffs != NULL)
+        *sym_modoffs = (frame == 0 && !pcs->first_is_retaddr) ? offs : offs-1;
+    return true;
+}
+
 static void
 packed_frame_to_symbolized(packed_callstack_t *pcs IN, symbolized_frame_t *frame OUT,
                            uint idx)
@@ -2325,13 +2465,15 @@ packed_callstack_clone(packed_callstack_t *src)
     dst->is_packed = src->is_packed;
     dst->first_is_retaddr = src->first_is_retaddr;
     dst->first_is_syscall = src->first_is_syscall;
-    if (dst->is_packed) {
+    dst->hash = src->hash;
+    /* Empty callstacks have NULL frames, as in packed_callstack_record() */
+    if (dst->num_frames > 0 && dst->is_packed) {
         dst->frames.packed = (packed_frame_t *)
             global_alloc(sizeof(*dst->frames.packed) * src->num_frames,
                          HEAPSTAT_CALLSTACK);
         memcpy(dst->frames.packed, src->frames.packed,
                sizeof(*dst->frames.packed) * src->num_frames);
-    } else {
+    } else if (dst->num_frames > 0) {
         dst->frames.full = (full_frame_t *)
             global_alloc(sizeof(*dst->frames.full) * src->num_frames,
                          HEAPSTAT_CALLSTACK);
@@ -2421,6 +2563,12 @@ packed_callstack_md5(packed_callstack_t *pcs, byte digest[MD5_RAW_BYTES])
     }
 }
 
+void
+packed_callstack_hash128(packed_callstack_t *pcs, hash128_t *digest OUT)
+{
+    hash128_final(&pcs->hash, pcs->num_frames * PCS_HASH_WORDS_PER_FRAME, digest);
+}
+
 void
 packed_callstack_crc32(packed_callstack_t *pcs, uint crc[2])
 {
@@ -2452,7 +2600,9 @@ packed_callstack_destroy(packed_callstack_t *pcs)
     } while (count > 0);
 }
 
-/* add the packed callstack into the hashtable, assuming the caller is holding the lock */
+/* add the packed callstack into the hashtable, assuming the caller is holding the lock.
+ * pcs may be a scratch callstack, which is only copied to the heap if it is new.
+ */
 packed_callstack_t *
 packed_callstack_add_to_table(hashtable_t *table, packed_callstack_t *pcs
                               _IF_STATS(uint *callstack_count))
@@ -2461,6 +2611,8 @@ packed_callstack_add_to_table(hashtable_t *table, packed_callstack_t *pcs
 
     existing = hashtable_lookup(table, (void *)pcs);
     if (existing == NULL) {
+        /* Only a new callstack needs to be on the heap */
+        pcs = packed_callstack_persist(pcs);
         /* avoid calling lookup twice by not calling hashtable_add() */
         IF_DEBUG(void *prior =)
             hashtable_add_replace(table, (void *)pcs, (void *)pcs);
@@ -2471,8 +2623,7 @@ packed_callstack_add_to_table(hashtable_t *table, packed_callstack_t *pcs
         });
         STATS_INC(*callstack_count);
     } else {
-        IF_DEBUG(uint count =) packed_callstack_free(pcs);
-        ASSERT(count == 0, "refcount should be 0");
+        packed_callstack_discard(pcs);
         pcs = existing;
     }
     /* The callstack in table is one reference, and the other references
@@ -303,6 +303,23 @@ void
 packed_callstack_record(packed_callstack_t **pcs_out/*out*/, dr_mcontext_t *mc,
                         app_loc_t *loc, uint max_frames);
 
+/* Records into the calling thread's scratch callstack rather than the heap.
+ * The result is only valid until this thread's next call.  Pass it to
+ * packed_callstack_add_to_table(), or to packed_callstack_persist() to keep
+ * it, or else to packed_callstack_discard().  Falls back to a heap callstack
+ * if the thread has no callstack state.
+ */
+packed_callstack_t *
+packed_callstack_record_scratch(dr_mcontext_t *mc, app_loc_t *loc, uint max_frames);
+
+/* Returns pcs itself if it is on the heap, or else a heap copy of a scratch pcs */
+packed_callstack_t *
+packed_callstack_persist(packed_callstack_t *pcs);
+
+/* Frees a heap pcs with no other references; a no-op for a scratch pcs */
+void
+packed_callstack_discard(packed_callstack_t *pcs);
+
 void
 packed_callstack_first_frame_retaddr(packed_callstack_t *pcs);
 
@@ -340,14 +357,34 @@ packed_callstack_md5(packed_callstack_t *pcs, byte digest[MD5_RAW_BYTES]);
 void
 packed_callstack_crc32(packed_callstack_t *pcs, uint crc[2]);
 
+/* Returns a 128-bit hash of the frames, which is accumulated as the callstack
+ * is recorded and so is much cheaper than the md5 or crc32.  As the hash is
+ * not cryptographic, use packed_callstack_cmp() to confirm a match.
+ */
+void
+packed_callstack_hash128(packed_callstack_t *pcs, hash128_t *digest OUT);
+
 uint
 packed_callstack_num_frames(packed_callstack_t *pcs);
 
+/* Returns a frame's module information without symbolizing it.  Returns false
+ * for a system call frame.  Otherwise, *modname is NULL if the frame is not in
+ * a module, and *user_data is the module's callstack_options_t.module_load()
+ * result.  *modoffs is the frame's module offset while *sym_modoffs is the
+ * offset its symbol is looked up at (one less for a retaddr).
+ */
+bool
+packed_callstack_frame_module(packed_callstack_t *pcs, uint frame,
+                              const char **modname OUT, void **user_data OUT,
+                              size_t *modoffs OUT, size_t *sym_modoffs OUT);
+
 /* destroy the packted callstack */
 void
 packed_callstack_destroy(packed_callstack_t *pcs);
 
-/* add the packed callstack into the hashtable, assuming the caller is holding the lock */
+/* add the packed callstack into the hashtable, assuming the caller is holding the lock.
+ * pcs may be a scratch callstack, which is only copied to the heap if it is new.
+ */
 packed_callstack_t *
 packed_callstack_add_to_table(hashtable_t *table, packed_callstack_t *pcs
                               _IF_STATS(uint *callstack_count));
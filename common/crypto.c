@@ -465,3 +465,174 @@ crc32_whole_and_half_hash(const uint crc[2])
 {
     return (crc[0] + crc[1]);
 }
+
+/* Finalization mix forcing all bits of a word to avalanche */
+static inline uint64
+hash128_fmix(uint64 k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+void
+hash128_final(const hash128_t *hash, uint num_words, hash128_t *digest OUT)
+{
+    uint64 h1 = hash->h1 ^ (uint64)num_words * sizeof(uint64);
+    uint64 h2 = hash->h2 ^ (uint64)num_words * sizeof(uint64);
+    h1 += h2;
+    h2 += h1;
+    h1 = hash128_fmix(h1);
+    h2 = hash128_fmix(h2);
+    h1 += h2;
+    h2 += h1;
+    digest->h1 = h1;
+    digest->h2 = h2;
+}
+
+bool
+hash128_equal(const hash128_t *hash1, const hash128_t *hash2)
+{
+    return (hash1->h1 == hash2->h1 && hash1->h2 == hash2->h2);
+}
+
+/* Produces a single uint suitable for a hashtable index */
+uint
+hash128_hash(const hash128_t *hash)
+{
+    return (uint)(hash->h1 ^ (hash->h1 >> 32));
+}
+
+/***************************************************************************
+ * Unit tests
+ */
+
+#ifdef BUILD_UNIT_TESTS
+# define TEST_FRAMES 24
+# define TEST_STACKS (64*1024)
+# define TEST_BENCH_ITERS (256*1024)
+
+/* Builds a callstack-like sequence of words: each frame is a retaddr, a
+ * module identifier, and a module offset, as packed_callstack_t hashes them.
+ */
+static void
+test_make_stack(uint64 frames[TEST_FRAMES*3], uint seed)
+{
+    uint i;
+    uint64 x = seed * 0x9e3779b97f4a7c15ULL + 1;
+    for (i = 0; i < TEST_FRAMES; i++) {
+        /* xorshift to spread retaddrs across a few "modules" */
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        frames[i*3+1] = 0x7f0000001000ULL + (x % 4) * 0x100;
+        frames[i*3+2] = x & 0xfffff;
+        frames[i*3] = 0x400000 + (x % 4) * 0x1000000 + frames[i*3+2];
+    }
+}
+
+static void
+test_hash_words(const uint64 *words, uint num_words, hash128_t *digest OUT)
+{
+    hash128_t state;
+    uint i;
+    hash128_init(&state);
+    for (i = 0; i < num_words; i++)
+        hash128_update(&state, words[i]);
+    hash128_final(&state, num_words, digest);
+}
+
+static void
+test_hash128_collisions(void)
+{
+    static uint64 frames[TEST_FRAMES*3];
+    hash128_t *digests = (hash128_t *)
+        global_alloc(sizeof(*digests) * (TEST_STACKS + TEST_FRAMES*3*2 + 2),
+                     HEAPSTAT_MISC);
+    hashtable_t table;
+    uint i, n = 0;
+    hashtable_init_ex(&table, 16, HASH_CUSTOM, false/*!str_dup*/, false/*!synch*/,
+                      NULL, (uint (*)(void*)) hash128_hash,
+                      (bool (*)(void*, void*)) hash128_equal);
+    /* Distinct pseudo-random stacks */
+    for (i = 0; i < TEST_STACKS; i++, n++) {
+        test_make_stack(frames, i);
+        test_hash_words(frames, TEST_FRAMES*3, &digests[n]);
+        EXPECT(hashtable_add(&table, &digests[n], &digests[n]));
+    }
+    /* Stacks that differ from stack 0 in a single bit of a single word, which
+     * is how most real allocation sites differ.
+     */
+    test_make_stack(frames, 0);
+    for (i = 0; i < TEST_FRAMES*3; i++, n++) {
+        frames[i] ^= 1;
+        test_hash_words(frames, TEST_FRAMES*3, &digests[n]);
+        frames[i] ^= 1;
+        EXPECT(hashtable_add(&table, &digests[n], &digests[n]));
+    }
+    /* Truncations of stack 1 (every proper prefix, including empty) */
+    test_make_stack(frames, 1);
+    for (i = 0; i < TEST_FRAMES*3; i++, n++) {
+        test_hash_words(frames, i, &digests[n]);
+        EXPECT(hashtable_add(&table, &digests[n], &digests[n]));
+    }
+    /* Swapping two frames must change the hash */
+    test_make_stack(frames, 2);
+    frames[0] ^= frames[3];
+    frames[3] ^= frames[0];
+    frames[0] ^= frames[3];
+    test_hash_words(frames, TEST_FRAMES*3, &digests[n]);
+    EXPECT(hashtable_add(&table, &digests[n], &digests[n]));
+    n++;
+    /* Incremental hashing is deterministic */
+    test_make_stack(frames, 3);
+    test_hash_words(frames, TEST_FRAMES*3, &digests[n]);
+    EXPECT(hashtable_lookup(&table, &digests[n]) == &digests[3]);
+    hashtable_delete(&table);
+    global_free(digests, sizeof(*digests) * (TEST_STACKS + TEST_FRAMES*3*2 + 2),
+                HEAPSTAT_MISC);
+}
+
+/* Not a pass/fail test: prints the relative cost of each callstack hash */
+void
+crypto_unit_benchmark(void)
+{
+    static uint64 frames[TEST_FRAMES*3];
+    byte md5[MD5_RAW_BYTES];
+    uint crc[2];
+    hash128_t digest;
+    uint64 start, t_md5, t_crc, t_hash128;
+    uint i;
+    test_make_stack(frames, 42);
+    start = dr_get_milliseconds();
+    for (i = 0; i < TEST_BENCH_ITERS; i++) {
+        frames[0] = i;
+        get_md5_for_region((const byte *)frames, sizeof(frames), md5);
+    }
+    t_md5 = dr_get_milliseconds() - start;
+    start = dr_get_milliseconds();
+    for (i = 0; i < TEST_BENCH_ITERS; i++) {
+        frames[0] = i;
+        crc32_whole_and_half((const char *)frames, sizeof(frames), crc);
+    }
+    t_crc = dr_get_milliseconds() - start;
+    start = dr_get_milliseconds();
+    for (i = 0; i < TEST_BENCH_ITERS; i++) {
+        frames[0] = i;
+        test_hash_words(frames, TEST_FRAMES*3, &digest);
+    }
+    t_hash128 = dr_get_milliseconds() - start;
+    dr_fprintf(STDERR, "%d-frame callstack hash x%d: md5 %dms, crc32 %dms, "
+               "hash128 %dms\n", TEST_FRAMES, TEST_BENCH_ITERS, (int)t_md5,
+               (int)t_crc, (int)t_hash128);
+}
+
+void
+crypto_unit_tests(void)
+{
+    test_hash128_collisions();
+}
+#endif /* BUILD_UNIT_TESTS */
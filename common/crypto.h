@@ -111,4 +111,63 @@ crc32_whole_and_half_equal(const uint crc1[2], const uint crc2[2]);
 uint
 crc32_whole_and_half_hash(const uint crc[2]);
 
+/* 128-bit non-cryptographic hash */
+/* This is much faster than MD5 and can be computed incrementally one 64-bit
+ * word at a time, but it is not collision-resistant: users should compare the
+ * hashed data itself whenever two hashes match.  The mixing is modeled after
+ * MurmurHash3's x64 128-bit variant.
+ */
+typedef struct _hash128_t {
+    uint64 h1;
+    uint64 h2;
+} hash128_t;
+
+#define HASH128_C1 0x87c37b91114253d5ULL
+#define HASH128_C2 0x4cf5ad432745937fULL
+#define HASH128_ROTL(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static inline void
+hash128_init(hash128_t *hash)
+{
+    hash->h1 = 0;
+    hash->h2 = 0;
+}
+
+static inline void
+hash128_update(hash128_t *hash, uint64 word)
+{
+    uint64 k1 = word * HASH128_C1;
+    uint64 k2 = word * HASH128_C2;
+    k1 = HASH128_ROTL(k1, 31) * HASH128_C2;
+    hash->h1 ^= k1;
+    hash->h1 = HASH128_ROTL(hash->h1, 27) + hash->h2;
+    hash->h1 = hash->h1 * 5 + 0x52dce729;
+    k2 = HASH128_ROTL(k2, 33) * HASH128_C1;
+    hash->h2 ^= k2;
+    hash->h2 = HASH128_ROTL(hash->h2, 31) + hash->h1;
+    hash->h2 = hash->h2 * 5 + 0x38495ab5;
+}
+
+/* Produces the final hash in digest from the state after num_words updates.
+ * The state itself is not modified, so more words can still be added.
+ */
+void
+hash128_final(const hash128_t *hash, uint num_words, hash128_t *digest OUT);
+
+bool
+hash128_equal(const hash128_t *hash1, const hash128_t *hash2);
+
+/* Produces a single uint suitable for a hashtable index */
+uint
+hash128_hash(const hash128_t *hash);
+
+#ifdef BUILD_UNIT_TESTS
+void
+crypto_unit_tests(void);
+
+/* Prints timings rather than checking results, so is not run by default */
+void
+crypto_unit_benchmark(void);
+#endif
+
 #endif /* _CRYPTO_H_ */
@@ -35,6 +35,7 @@
 #ifdef WINDOWS
 # include "windefs.h"
 # include "../wininc/ndk_extypes.h" /* for SYSTEM_INFORMATION_CLASS */
+# include "../wininc/ndk_psfuncs.h" /* for PROCESSINFOCLASS, VM_COUNTERS */
 #else
 # include <string.h>
 #  include <signal.h> /* for SIGSEGV */
@@ -1001,8 +1002,53 @@ module_imports_from_msvc(const module_data_t *mod)
     return res;
 }
 
+GET_NTDLL(NtQueryInformationProcess, (IN HANDLE ProcessHandle,
+                                      IN PROCESSINFOCLASS ProcessInformationClass,
+                                      OUT PVOID ProcessInformation,
+                                      IN ULONG ProcessInformationLength,
+                                      OUT PULONG ReturnLength OPTIONAL));
 #endif /* WINDOWS */
 
+size_t
+get_process_rss(void)
+{
+#ifdef WINDOWS
+    /* The kernel rejects any length other than sizeof(VM_COUNTERS) (or the
+     * larger VM_COUNTERS_EX), so we must pass the exact size.
+     */
+    VM_COUNTERS counters;
+    ULONG got;
+    NTSTATUS res = NtQueryInformationProcess(NT_CURRENT_PROCESS, ProcessVmCounters,
+                                             &counters, sizeof(counters), &got);
+    if (!NT_SUCCESS(res))
+        return 0;
+    return counters.WorkingSetSize;
+#elif defined(LINUX)
+    /* The 2nd field of statm is the resident page count */
+    char buf[128];
+    ssize_t len;
+    char *c;
+    size_t pages = 0;
+    file_t f = dr_open_file("/proc/self/statm", DR_FILE_READ);
+    if (f == INVALID_FILE)
+        return 0;
+    len = dr_read_file(f, buf, BUFFER_SIZE_BYTES(buf) - 1);
+    dr_close_file(f);
+    if (len <= 0)
+        return 0;
+    buf[len] = '\0';
+    c = strchr(buf, ' ');
+    if (c == NULL)
+        return 0;
+    for (c++; *c >= '0' && *c <= '9'; c++)
+        pages = pages * 10 + (*c - '0');
+    return pages * dr_page_size();
+#else
+    /* XXX: add MacOS support via task_info() */
+    return 0;
+#endif
+}
+
 reg_t
 syscall_get_param(void *drcontext, uint num)
 {
@@ -1019,7 +1065,6 @@ syscall_get_param(void *drcontext, uint num)
  *
  */
 
-#ifdef STATISTICS
 /* We could have each client define this to avoid ifdefs in common/,
  * but the shared hashtable code needs a shared define, so going w/
  * ifdefs.
@@ -1040,9 +1085,14 @@ static const char * heapstat_names[] = {
     "misc",
 };
 
+/* Current and peak usage are maintained in all builds for runtime memory
+ * accounting; the allocation counts are only kept for statistics.
+ */
 static uint heap_usage[HEAPSTAT_NUMTYPES];  /* cur usage  */
 static uint heap_max[HEAPSTAT_NUMTYPES];    /* peak usage */
+#ifdef STATISTICS
 static uint heap_count[HEAPSTAT_NUMTYPES];  /* # allocs   */
+#endif
 
 static void
 heap_usage_inc(heapstat_t type, size_t size)
@@ -1056,7 +1106,7 @@ heap_usage_inc(heapstat_t type, size_t size)
     usage = heap_usage[type];
     if (usage > heap_max[type])
         heap_max[type] = usage;
-    ATOMIC_INC32(heap_count[type]);
+    STATS_INC(heap_count[type]);
 }
 
 static void
@@ -1066,9 +1116,27 @@ heap_usage_dec(heapstat_t type, size_t size)
     ASSERT_TRUNCATE(delta, int, size);
     delta = (int)size;
     ATOMIC_ADD32(heap_usage[type], -delta);
-    ATOMIC_DEC32(heap_count[type]);
+    STATS_DEC(heap_count[type]);
+}
+
+const char *
+heapstat_name(heapstat_t type)
+{
+    ASSERT(type < HEAPSTAT_NUMTYPES, "invalid heapstat type");
+    return heapstat_names[type];
 }
 
+void
+heap_usage_query(heapstat_t type, size_t *cur OUT, size_t *peak OUT)
+{
+    ASSERT(type < HEAPSTAT_NUMTYPES, "invalid heapstat type");
+    if (cur != NULL)
+        *cur = heap_usage[type];
+    if (peak != NULL)
+        *peak = heap_max[type];
+}
+
+#ifdef STATISTICS
 void
 heap_dump_stats(file_t f)
 {
@@ -1094,9 +1162,7 @@ heap_dump_stats(file_t f)
 void *
 global_alloc(size_t size, heapstat_t type)
 {
-#ifdef STATISTICS
     heap_usage_inc(type, size);
-#endif
     /* Note that the recursive lock inside DR is a perf hit for
      * malloc-intensive apps: we're already holding the malloc_lock,
      * so could use own heap alloc, or add option to DR to not use
@@ -1108,45 +1174,35 @@ global_alloc(size_t size, heapstat_t type)
 void
 global_free(void *p, size_t size, heapstat_t type)
 {
-#ifdef STATISTICS
     heap_usage_dec(type, size);
-#endif
     dr_global_free(p, size);
 }
 
 void *
 thread_alloc(void *drcontext, size_t size, heapstat_t type)
 {
-#ifdef STATISTICS
     heap_usage_inc(type, size);
-#endif
     return dr_thread_alloc(drcontext, size);
 }
 
 void
 thread_free(void *drcontext, void *p, size_t size, heapstat_t type)
 {
-#ifdef STATISTICS
     heap_usage_dec(type, size);
-#endif
     dr_thread_free(drcontext, p, size);
 }
 
 void *
 nonheap_alloc(size_t size, uint prot, heapstat_t type)
 {
-#ifdef STATISTICS
     heap_usage_inc(type, size);
-#endif
     return dr_nonheap_alloc(size, prot);
 }
 
 void
 nonheap_free(void *p, size_t size, heapstat_t type)
 {
-#ifdef STATISTICS
     heap_usage_dec(type, size);
-#endif
     dr_nonheap_free(p, size);
 }
 
@@ -949,6 +949,10 @@ module_imports_from_msvc(const module_data_t *mod);
 
 #endif /* WINDOWS */
 
+/* Returns the resident set size of the process in bytes, or 0 if unknown */
+size_t
+get_process_rss(void);
+
 reg_t
 syscall_get_param(void *drcontext, uint num);
 
@@ -997,6 +1001,15 @@ nonheap_free(void *p, size_t size, heapstat_t type);
 void
 heap_dump_stats(file_t f);
 
+const char *
+heapstat_name(heapstat_t type);
+
+/* Returns the current and peak tool heap usage in bytes for type.
+ * Unlike heap_dump_stats(), this is available in all builds.
+ */
+void
+heap_usage_query(heapstat_t type, size_t *cur OUT, size_t *peak OUT);
+
 #define dr_global_alloc DO_NOT_USE_use_global_alloc
 #define dr_global_free  DO_NOT_USE_use_global_free
 #define dr_thread_alloc DO_NOT_USE_use_thread_alloc
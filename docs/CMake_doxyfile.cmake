@@ -212,6 +212,7 @@ endif()
 # XXX: share w/ list of source paths in CMakeLists.txt ${headers}
 set(headers "${commondir}/../drsyscall/drsyscall.h ${commondir}/../umbra/umbra.h ${commondir}/../drfuzz/drfuzz.h ${commondir}/../drfuzz/drfuzz_mutator.h")
 set(headers "${headers} ${commondir}/../drsymcache/drsymcache.h")
+set(headers "${headers} ${commondir}/../drworkpool/drworkpool.h")
 set(headers "${headers} ${outdir}/../drmf/include/drmemory_framework.h")
 if (TOOL_DR_MEMORY)
   string(REGEX REPLACE
@@ -40,6 +40,7 @@
 #include "../drmemory/shadow.h"
 #include "../drmemory/instru.h"
 #include "../drmemory/slowpath.h"
+#include "../drmemory/flush.h"
 #ifdef MACOS
 # error NYI i#1438
 #elif defined(LINUX)
@@ -52,12 +53,6 @@
 #endif
 #include <stddef.h> /* for offsetof */
 
-#ifdef USE_MD5
-# define IF_MD5_ELSE(x, y) x
-#else
-# define IF_MD5_ELSE(x, y) y
-#endif
-
 /* for sharing data among instrumentation passes */
 typedef struct _instru_info_t {
     bb_info_t bi;
@@ -132,6 +127,7 @@ static void
 dump_statistics(void);
 # define STATS_DUMP_FREQ 10000
 uint alloc_stack_count;
+static uint alloc_stack_collisions;
 static uint peaks_detected;
 static uint peaks_skipped;
 #endif
@@ -144,10 +140,6 @@ static uint peaks_skipped;
  */
 #define ASTACK_TABLE_HASH_BITS 8
 static hashtable_t alloc_stack_table;
-#ifdef CHECK_WITH_MD5
-/* Used to check collisions with crc32 */
-static hashtable_t alloc_md5_table;
-#endif
 
 /***************************************************************************
  * TLS and CLS
@@ -278,21 +270,20 @@ static uint64 allocfree_cur, allocfree_last_peak;
 #define SNAPSHOT_LOG_BUF_SIZE   (32*1024)
 static char snaps_log_buf[SNAPSHOT_LOG_BUF_SIZE];   /* PR 551841 */
 
+/* Key for alloc_stack_table.  We compare the 128-bit hash first and only
+ * compare the frames themselves when the hashes match, to rule out a collision.
+ * This costs keeping each unique callstack around (PR 496304 kept just a
+ * checksum), but the hash is computed while the callstack is walked, which is
+ * much cheaper than a separate md5 or crc32 pass per malloc.
+ */
+typedef struct _callstack_key_t {
+    hash128_t hash;
+    packed_callstack_t *pcs;
+} callstack_key_t;
+
 struct _per_callstack_t {
     uint id;
-#if defined(USE_MD5) || defined(CHECK_WITH_MD5)
-    /* PR 496304: we keep just the md5 to save memory.  We either do so
-     * instead of crc32, or in addition as a debug check on collisions.
-     */
-    byte md5[MD5_RAW_BYTES];
-#endif
-#ifndef USE_MD5
-    /* PR 496304: we keep just a checksum to save memory.  Since crc32 could
-     * collide we use crc32 of the whole callstack plus a separate crc32
-     * of the first half of the callstack.
-     */
-    uint crc[2];
-#endif
+    callstack_key_t key;
     /* for the current snapshot */
     heap_used_t *used;
     /* for node removal w/o keeping a prev per heap_used_t per snapshot */
@@ -325,9 +316,28 @@ void
 alloc_callstack_free(void *p)
 {
     per_callstack_t *per = (per_callstack_t *) p;
+    packed_callstack_free(per->key.pcs);
     global_free(per, sizeof(*per), HEAPSTAT_CALLSTACK);
 }
 
+static uint
+callstack_key_hash(callstack_key_t *key)
+{
+    return hash128_hash(&key->hash);
+}
+
+static bool
+callstack_key_equal(callstack_key_t *key1, callstack_key_t *key2)
+{
+    if (!hash128_equal(&key1->hash, &key2->hash))
+        return false;
+    if (!packed_callstack_cmp(key1->pcs, key2->pcs)) {
+        STATS_INC(alloc_stack_collisions);
+        return false;
+    }
+    return true;
+}
+
 void
 client_malloc_data_free(void *data)
 {
@@ -747,63 +757,39 @@ client_add_malloc_pre(malloc_info_t *info, dr_mcontext_t *mc, app_pc post_call)
         IF_DEBUG({
             hashtable_lock(&alloc_stack_table);
             ASSERT(hashtable_lookup(&alloc_stack_table,
-                                    (void *)per->IF_MD5_ELSE(md5, crc)) == (void*)per,
+                                    (void *)&per->key) == (void*)per,
                    "malloc re-add should still be in table");
             hashtable_unlock(&alloc_stack_table);
         });
     } else {
-#if defined(USE_MD5) || defined(CHECK_WITH_MD5)
-        byte md5[MD5_RAW_BYTES];
-#endif
-#ifndef USE_MD5
-        uint crc[2];
-#endif
         /* Printing to a buffer is slow (quite noticeable: 2x on cfrac) so it's
-         * faster to create a packed callstack for computing the checksum to
-         * decide uniqueness, limiting printing to new callstacks only.
+         * faster to create a packed callstack for identifying it, limiting
+         * printing to new callstacks only.
          */
-        packed_callstack_t *pcs;
+        callstack_key_t key;
         app_loc_t loc;
         pc_to_loc(&loc, post_call);
-        packed_callstack_record(&pcs, mc, &loc, options.callstack_max_frames);
-
-#if defined(USE_MD5) || defined(CHECK_WITH_MD5)
-        packed_callstack_md5(pcs, md5);
-#endif
-#ifndef USE_MD5
-        packed_callstack_crc32(pcs, crc);
-#endif
+        key.pcs = packed_callstack_record_scratch(mc, &loc, options.callstack_max_frames);
+        packed_callstack_hash128(key.pcs, &key.hash);
 
         hashtable_lock(&alloc_stack_table);
-        per = (per_callstack_t *)
-            hashtable_lookup(&alloc_stack_table, (void *)IF_MD5_ELSE(md5, crc));
-#ifdef CHECK_WITH_MD5
-        /* Check for collisions with crc32 */
-        ASSERT(per == hashtable_lookup(&alloc_md5_table, (void *)md5),
-               "crc and md5 do not agree");
-#endif
+        per = (per_callstack_t *) hashtable_lookup(&alloc_stack_table, (void *)&key);
         if (per == NULL) {
             per = (per_callstack_t *) global_alloc(sizeof(*per), HEAPSTAT_CALLSTACK);
             memset(per, 0, sizeof(*per));
             /* we could do ++ since there's an outer lock */
             per->id = atomic_add32_return_sum((volatile int *)&num_callstacks, 1);
-#if defined(USE_MD5) || defined(CHECK_WITH_MD5)
-            memcpy(per->md5, md5, BUFFER_SIZE_BYTES(md5));
-            hashtable_add(IF_MD5_ELSE(&alloc_stack_table, &alloc_md5_table),
-                          (void *)per->md5, (void *)per);
-#endif
-#ifndef USE_MD5
-            per->crc[0] = crc[0];
-            per->crc[1] = crc[1];
-            hashtable_add(&alloc_stack_table, (void *)per->crc, (void *)per);
-#endif
+            /* The table keeps our reference to key.pcs */
+            key.pcs = packed_callstack_persist(key.pcs);
+            per->key = key;
+            hashtable_add(&alloc_stack_table, (void *)&per->key, (void *)per);
             STATS_INC(alloc_stack_count);
 
-            dump_callstack(pcs, per, buf, bufsz, &sofar);
+            dump_callstack(key.pcs, per, buf, bufsz, &sofar);
+        } else {
+            packed_callstack_discard(key.pcs);
         }
         hashtable_unlock(&alloc_stack_table);
-        sofar = packed_callstack_free(pcs);
-        ASSERT(sofar == 0, "pcs should have 0 ref count");
     }
 
 #ifdef X64
@@ -830,6 +816,12 @@ client_add_malloc_post(malloc_info_t *info)
     account_for_bytes_post(info->request_size, info->pad_size, HEADER_SIZE);
 }
 
+bool
+client_malloc_site_quiet(void *client_data)
+{
+    return false; /* we do not use adaptive redzones */
+}
+
 /* A lock is held around the call to this routine */
 void
 client_remove_malloc_pre(malloc_info_t *info)
@@ -1449,6 +1441,7 @@ dump_statistics(void)
     dr_fprintf(f_global, "app mallocs: %8u, frees: %8u, large mallocs; %6u\n",
                num_mallocs, num_frees, num_large_mallocs);
     dr_fprintf(f_global, "unique malloc stacks: %8u\n", alloc_stack_count);
+    dr_fprintf(f_global, "malloc stack hash collisions: %8u\n", alloc_stack_collisions);
     dr_fprintf(f_global, "app heap regions: %8u\n", heap_regions);
     dr_fprintf(f_global, "peaks detected: %8u, skipped: %8u\n",
                peaks_detected, peaks_skipped);
@@ -2124,12 +2117,10 @@ event_exit(void)
     LOG(1, "final alloc stack table size: %u bits, %u entries\n",
         alloc_stack_table.table_bits, alloc_stack_table.entries);
     hashtable_delete(&alloc_stack_table);
-#ifdef CHECK_WITH_MD5
-    hashtable_delete(&alloc_md5_table);
-#endif
     callstack_exit();
     if (options.check_leaks || options.staleness) {
         instrument_exit();
+        flush_exit();
         shadow_exit();
     }
     free_shared_code();
@@ -2289,22 +2280,8 @@ dr_init(client_id_t client_id)
                       false/*!str_dup*/, false/* !synch; + higher-level synch covered
                                                * by malloc_table's lock */,
                       alloc_callstack_free,
-#ifdef USE_MD5
-                      (uint (*)(void*)) md5_hash,
-                      (bool (*)(void*, void*)) md5_digests_equal
-#else
-                      (uint (*)(void*)) crc32_whole_and_half_hash,
-                      (bool (*)(void*, void*)) crc32_whole_and_half_equal
-#endif
-                      );
-#ifdef CHECK_WITH_MD5
-    hashtable_init_ex(&alloc_md5_table, ASTACK_TABLE_HASH_BITS, HASH_CUSTOM,
-                      false/*!str_dup*/, false/* !synch; + higher-level synch covered
-                                               * by malloc_table's lock */,
-                      NULL/*points at md5 data stored in alloc_stack_table*/,
-                      (uint (*)(void*)) md5_hash,
-                      (bool (*)(void*, void*)) md5_digests_equal);
-#endif
+                      (uint (*)(void*)) callstack_key_hash,
+                      (bool (*)(void*, void*)) callstack_key_equal);
 
     memset(&alloc_ops, 0, sizeof(alloc_ops));
     alloc_ops.track_allocs = true;
@@ -2318,14 +2295,17 @@ dr_init(client_id_t client_id)
     alloc_ops.conservative = options.conservative;
     alloc_ops.global_lock = true; /* we want to serialize w/ our snapshots */
     alloc_ops.replace_malloc = true;
+    alloc_ops.realloc_in_place = true;
     alloc_ops.use_symcache = options.use_symcache;
     alloc_init(&alloc_ops, sizeof(alloc_ops));
 
     /* must be after heap_region_init and snapshot_init */
     heap_walk();
 
-    if (options.check_leaks || options.staleness)
+    if (options.check_leaks || options.staleness) {
+        flush_init();
         instrument_init();
+    }
 
     create_shared_code();
 
@@ -65,6 +65,50 @@ static file_t outf;
 /* Avoid exe exports, as on Linux many apps have a ton of global symbols. */
 static app_pc exe_start;
 
+/* Everything lib_entry needs about an export is resolved once, when the
+ * export is wrapped, and handed to lib_entry as the drwrap user_data.
+ * This keeps module lookups, allocations, and prototype searches off of
+ * the per-call path.
+ */
+typedef struct _wrapped_func_t {
+    /* "module!func", or just "func" if the module has no name */
+    char *qualified_name;
+    size_t qualified_name_sz;
+    /* Prototype from the config file, or NULL */
+    std::vector<drsys_arg_t *> *args_vec;
+    /* Prototype known to drsyscall, or NULL */
+    drsys_syscall_t *syscall;
+    /* Next in wrapped_list */
+    struct _wrapped_func_t *next;
+} wrapped_func_t;
+
+/* Maps an export's entry pc to its wrapped_func_t.  Several exports can
+ * share one entry; the first name wins, matching what drwrap passes us.
+ * An unload removes its exports from the table, but another thread may
+ * still be inside lib_entry with one of them, so the table does not own
+ * them: every wrapped_func_t stays on wrapped_list until exit.
+ */
+#define WRAPPED_TABLE_HASH_BITS 12
+static hashtable_t wrapped_table;
+static wrapped_func_t *wrapped_list;
+static void *wrapped_list_lock;
+
+/* For -only_from_app we cache the bounds of the last module segment each
+ * thread returned to (segments, as another module can sit in a gap between
+ * them), so that the common case of repeated calls from the same
+ * caller needs no dr_lookup_module().  Any module unload bumps
+ * module_unload_gen, which invalidates every thread's cache.
+ */
+typedef struct _caller_cache_t {
+    app_pc start;
+    app_pc end;
+    bool from_exe;
+    int unload_gen;
+} caller_cache_t;
+
+static int tls_idx = -1;
+static volatile int module_unload_gen;
+
 /****************************************************************************
  * Arguments printing
  */
@@ -194,27 +238,19 @@ print_libcall_args(std::vector<drsys_arg_t*> *args_vec, void *wrapcxt)
 }
 
 static void
-print_symbolic_args(const char *name, void *wrapcxt, app_pc func)
+print_symbolic_args(wrapped_func_t *wrapped, void *wrapcxt, app_pc func)
 {
     drmf_status_t res;
-    drsys_syscall_t *syscall;
-    std::vector<drsys_arg_t *> *args_vec;
 
     if (op_max_args.get_value() == 0)
         return;
 
-    if (op_use_config.get_value()) {
-        /* looking for libcall in libcalls hashtable */
-        args_vec = libcalls_search(name);
-        if (print_libcall_args(args_vec, wrapcxt)) {
-            dr_fprintf(outf, op_print_ret_addr.get_value() ? "\n   ": "");
-            return; /* we found libcall and sucessfully printed all arguments */
-        }
+    if (print_libcall_args(wrapped->args_vec, wrapcxt)) {
+        dr_fprintf(outf, op_print_ret_addr.get_value() ? "\n   ": "");
+        return; /* we found libcall and sucessfully printed all arguments */
     }
-    /* trying to find a prototype of the libcall using drsyscall */
-    res = drsys_name_to_syscall(name, &syscall);
-    if (res == DRMF_SUCCESS) {
-        res = drsys_iterate_arg_types(syscall, drlib_iter_arg_cb, wrapcxt);
+    if (wrapped->syscall != NULL) {
+        res = drsys_iterate_arg_types(wrapped->syscall, drlib_iter_arg_cb, wrapcxt);
         if (res != DRMF_SUCCESS && res != DRMF_ERROR_DETAILS_UNKNOWN)
             ASSERT(false, "drsys_iterate_arg_types failed in print_symbolic_args");
         /* all args have been sucessfully printed */
@@ -231,13 +267,50 @@ print_symbolic_args(const char *name, void *wrapcxt, app_pc func)
  * Library entry wrapping
  */
 
+static bool
+caller_is_exe(void *drcontext, app_pc retaddr)
+{
+    caller_cache_t *cache = (caller_cache_t *) drmgr_get_tls_field(drcontext, tls_idx);
+    int gen = module_unload_gen;
+    module_data_t *mod;
+    if (cache->unload_gen == gen && retaddr >= cache->start && retaddr < cache->end)
+        return cache->from_exe;
+    mod = dr_lookup_module(retaddr);
+    if (mod == NULL) {
+        /* Not from any module (e.g., generated code): we do not filter these. */
+        return true;
+    }
+    cache->start = mod->start;
+    cache->end = mod->end;
+#ifdef UNIX
+    if (!mod->contiguous) {
+        uint i;
+        for (i = 0; i < mod->num_segments; i++) {
+            if (retaddr >= mod->segments[i].start && retaddr < mod->segments[i].end) {
+                cache->start = mod->segments[i].start;
+                cache->end = mod->segments[i].end;
+                break;
+            }
+        }
+        if (i == mod->num_segments) {
+            /* Not in any segment: answer without caching */
+            bool from_exe = (mod->start == exe_start);
+            dr_free_module_data(mod);
+            return from_exe;
+        }
+    }
+#endif
+    cache->from_exe = (mod->start == exe_start);
+    cache->unload_gen = gen;
+    dr_free_module_data(mod);
+    return cache->from_exe;
+}
+
 static void
 lib_entry(void *wrapcxt, INOUT void **user_data)
 {
-    const char *name = (const char *) *user_data;
-    const char *modname = NULL;
+    wrapped_func_t *wrapped = (wrapped_func_t *) *user_data;
     app_pc func = drwrap_get_func(wrapcxt);
-    module_data_t *mod;
     thread_id_t tid;
     uint mod_id;
     app_pc mod_start, ret_addr;
@@ -254,13 +327,8 @@ lib_entry(void *wrapcxt, INOUT void **user_data)
             retaddr = NULL;
         });
         if (retaddr != NULL) {
-            mod = dr_lookup_module(retaddr);
-            if (mod != NULL) {
-                bool from_exe = (mod->start == exe_start);
-                dr_free_module_data(mod);
-                if (!from_exe)
-                    return;
-            }
+            if (!caller_is_exe(drcontext, retaddr))
+                return;
         } else {
             /* Nearly all of these cases should be things like KiUserCallbackDispatcher
              * or other abnormal transitions.
@@ -270,20 +338,13 @@ lib_entry(void *wrapcxt, INOUT void **user_data)
             return;
         }
     }
-    /* XXX: it may be better to heap-allocate the "module!func" string and
-     * pass in, to avoid this lookup.
-     */
-    mod = dr_lookup_module(func);
-    if (mod != NULL)
-        modname = dr_module_preferred_name(mod);
 
     tid = dr_get_thread_id(drcontext);
     if (tid != INVALID_THREAD_ID)
         dr_fprintf(outf, "~~%d~~ ", tid);
     else
         dr_fprintf(outf, "~~Dr.L~~ ");
-    dr_fprintf(outf, "%s%s%s", modname == NULL ? "" : modname,
-               modname == NULL ? "" : "!", name);
+    dr_fprintf(outf, "%s", wrapped->qualified_name);
 
     /* XXX: We employ three schemes of arguments printing. drsyscall is used
      * to get a symbolic representation of arguments for known library calls.
@@ -291,7 +352,7 @@ lib_entry(void *wrapcxt, INOUT void **user_data)
      * specified by user. If there is no info in both sources we employ type-blind
      * printing and use -num_unknown_args to get a count of arguments to print.
      */
-    print_symbolic_args(name, wrapcxt, func);
+    print_symbolic_args(wrapped, wrapcxt, func);
 
     if (op_print_ret_addr.get_value()) {
         ret_addr = drwrap_get_retaddr(wrapcxt);
@@ -304,8 +365,46 @@ lib_entry(void *wrapcxt, INOUT void **user_data)
         }
     }
     dr_fprintf(outf, "\n");
-    if (mod != NULL)
-        dr_free_module_data(mod);
+}
+
+static wrapped_func_t *
+wrapped_func_create(const module_data_t *info, const char *name)
+{
+    wrapped_func_t *wrapped = (wrapped_func_t *)
+        global_alloc(sizeof(*wrapped), HEAPSTAT_MISC);
+    const char *modname = dr_module_preferred_name(info);
+    wrapped->qualified_name_sz = strlen(name) + 1;
+    if (modname != NULL)
+        wrapped->qualified_name_sz += strlen(modname) + 1/*!*/;
+    wrapped->qualified_name = (char *)
+        global_alloc(wrapped->qualified_name_sz, HEAPSTAT_MISC);
+    dr_snprintf(wrapped->qualified_name, wrapped->qualified_name_sz, "%s%s%s",
+                modname == NULL ? "" : modname, modname == NULL ? "" : "!", name);
+    wrapped->qualified_name[wrapped->qualified_name_sz - 1] = '\0';
+
+    wrapped->args_vec = NULL;
+    wrapped->syscall = NULL;
+    dr_mutex_lock(wrapped_list_lock);
+    wrapped->next = wrapped_list;
+    wrapped_list = wrapped;
+    dr_mutex_unlock(wrapped_list_lock);
+    if (op_max_args.get_value() > 0) {
+        if (op_use_config.get_value())
+            wrapped->args_vec = libcalls_search(name);
+        if (wrapped->args_vec == NULL || wrapped->args_vec->empty()) {
+            wrapped->args_vec = NULL;
+            if (drsys_name_to_syscall(name, &wrapped->syscall) != DRMF_SUCCESS)
+                wrapped->syscall = NULL;
+        }
+    }
+    return wrapped;
+}
+
+static void
+wrapped_func_free(wrapped_func_t *wrapped)
+{
+    global_free(wrapped->qualified_name, wrapped->qualified_name_sz, HEAPSTAT_MISC);
+    global_free(wrapped, sizeof(*wrapped), HEAPSTAT_MISC);
 }
 
 static void
@@ -336,8 +435,14 @@ iterate_exports(const module_data_t *info, bool add)
             func = NULL;
         if (func != NULL) {
             if (add) {
+                wrapped_func_t *wrapped = (wrapped_func_t *)
+                    hashtable_lookup(&wrapped_table, (void *)func);
+                if (wrapped == NULL) {
+                    wrapped = wrapped_func_create(info, sym->name);
+                    hashtable_add(&wrapped_table, (void *)func, (void *)wrapped);
+                }
                 IF_DEBUG(bool ok =)
-                    drwrap_wrap_ex(func, lib_entry, NULL, (void *) sym->name, 0);
+                    drwrap_wrap_ex(func, lib_entry, NULL, (void *) wrapped, 0);
                 ASSERT(ok, "wrap request failed");
                 VNOTIFY(2, "wrapping export %s!%s @" PFX NL,
                        dr_module_preferred_name(info), sym->name, func);
@@ -345,6 +450,10 @@ iterate_exports(const module_data_t *info, bool add)
                 IF_DEBUG(bool ok =)
                     drwrap_unwrap(func, lib_entry, NULL);
                 ASSERT(ok, "unwrap request failed");
+                /* Aliases share an entry, so only the first removal succeeds.
+                 * This does not free the entry: see wrapped_list.
+                 */
+                hashtable_remove(&wrapped_table, (void *)func);
             }
         }
     }
@@ -379,6 +488,26 @@ event_module_unload(void *drcontext, const module_data_t *info)
 {
     if (info->start != exe_start && library_matches_filter(info))
         iterate_exports(info, false/*remove*/);
+    if (op_only_from_app.get_value())
+        dr_atomic_add32_return_sum(&module_unload_gen, 1);
+}
+
+static void
+event_thread_init(void *drcontext)
+{
+    caller_cache_t *cache = (caller_cache_t *)
+        dr_thread_alloc(drcontext, sizeof(*cache));
+    memset(cache, 0, sizeof(*cache));
+    /* Start out stale so the first lookup always fills it in. */
+    cache->unload_gen = module_unload_gen - 1;
+    drmgr_set_tls_field(drcontext, tls_idx, (void *)cache);
+}
+
+static void
+event_thread_exit(void *drcontext)
+{
+    caller_cache_t *cache = (caller_cache_t *) drmgr_get_tls_field(drcontext, tls_idx);
+    dr_thread_free(drcontext, cache, sizeof(*cache));
 }
 
 /****************************************************************************
@@ -421,8 +550,18 @@ event_exit(void)
     if (op_max_args.get_value() > 0)
         drsys_exit();
 
+    /* Free our per-export data before the config prototypes it points at. */
+    hashtable_delete(&wrapped_table);
+    while (wrapped_list != NULL) {
+        wrapped_func_t *next = wrapped_list->next;
+        wrapped_func_free(wrapped_list);
+        wrapped_list = next;
+    }
+    dr_mutex_destroy(wrapped_list_lock);
     if (op_use_config.get_value())
         libcalls_hashtable_delete();
+    if (op_only_from_app.get_value())
+        drmgr_unregister_tls_field(tls_idx);
 
     if (outf != STDERR) {
         if (op_print_ret_addr.get_value())
@@ -483,8 +622,12 @@ dr_client_main(client_id_t id, int argc, const char *argv[])
 #ifdef UNIX
     dr_register_fork_init_event(event_fork);
 #endif
-    drmgr_register_module_load_event(event_module_load);
-    drmgr_register_module_unload_event(event_module_unload);
+    if (op_only_from_app.get_value()) {
+        tls_idx = drmgr_register_tls_field();
+        ASSERT(tls_idx > -1, "unable to reserve TLS field");
+        drmgr_register_thread_init_event(event_thread_init);
+        drmgr_register_thread_exit_event(event_thread_exit);
+    }
 
 #ifdef WINDOWS
     dr_enable_console_printing();
@@ -523,5 +666,14 @@ dr_client_main(client_id_t id, int argc, const char *argv[])
         parse_config();
     }
 
+    /* Exports are bound to their prototypes when wrapped, so the module events
+     * must not be registered until drsyscall and the config file are ready.
+     */
+    wrapped_list_lock = dr_mutex_create();
+    hashtable_init_ex(&wrapped_table, WRAPPED_TABLE_HASH_BITS, HASH_INTPTR,
+                      false/*!strdup*/, true/*synch*/, NULL, NULL, NULL);
+    drmgr_register_module_load_event(event_module_load);
+    drmgr_register_module_unload_event(event_module_unload);
+
     open_log_file();
 }
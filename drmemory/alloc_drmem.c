@@ -49,6 +49,7 @@
 # include "stack.h"
 #endif
 #include "pattern.h"
+#include "flush.h"
 
 /* PR 465174: share allocation site callstacks.  We do not rely on
  * global malloc synchronization and instead use the
@@ -115,6 +116,7 @@ typedef struct _delay_free_t {
     size_t real_size; /* includes redzones */
     bool has_redzone;
     packed_callstack_t *pcs; /* i#205 for reporting where freed */
+    uint freed_clock; /* quarantine_clock at free time */
 } delay_free_t;
 
 /* We need a separate free queue per malloc routine (PR 476805) */
@@ -148,8 +150,31 @@ static rb_tree_t *delay_free_tree;
 
 #ifdef STATISTICS
 uint delayed_free_bytes; /* includes redzones */
+static uint quarantine_adjustments;
+static uint redzone_error_sites;
 #endif
 
+/* Always maintained, unlike delayed_free_bytes, for memory accounting */
+static uint delay_free_total_bytes;
+
+/* Delayed-free limits in effect, lowered from -delay_frees_maxsz under
+ * -quarantine_rss_limit memory pressure.  quarantine_maxsz is per routine set
+ * like -delay_frees_maxsz.
+ */
+static volatile size_t quarantine_maxsz;
+static volatile size_t quarantine_chunk_max;
+/* Coarse millisecond clock advanced by alloc_drmem_quarantine_tick(), or 0 */
+static volatile uint quarantine_clock;
+static uint64 quarantine_start_ms;
+static uint64 quarantine_residence_ms; /* protected by delay_free_lock */
+static uint64 quarantine_evictions;    /* protected by delay_free_lock */
+
+/* Under pressure we keep at least this much delayed per routine set or arena,
+ * and keep delaying chunks up to this size, to retain use-after-free detection.
+ */
+#define QUARANTINE_MIN_BYTES (1024*1024)
+#define QUARANTINE_MIN_CHUNK (4*1024)
+
 /***************************************************************************/
 
 static void
@@ -200,6 +225,10 @@ alloc_drmem_init(void)
     alloc_ops.shared_redzones = (options.pattern == 0);
     alloc_ops.delay_frees = options.delay_frees;
     alloc_ops.delay_frees_maxsz = options.delay_frees_maxsz;
+    alloc_ops.redzone_adaptive = options.redzone_adaptive;
+    alloc_ops.redzone_adaptive_max = options.redzone_adaptive_max;
+    alloc_ops.redzone_adaptive_scale = options.redzone_adaptive_scale;
+    alloc_ops.realloc_in_place = options.realloc_in_place;
 #ifdef WINDOWS
     alloc_ops.skip_msvc_importers = options.skip_msvc_importers;
 #endif
@@ -215,6 +244,11 @@ alloc_drmem_init(void)
                       alloc_callstack_free,
                       (uint (*)(void*)) packed_callstack_hash,
                       (bool (*)(void*, void*)) packed_callstack_cmp);
+    if (options.redzone_adaptive) {
+        hashtable_init_ex(&redzone_site_table, REDZONE_SITE_TABLE_HASH_BITS,
+                          HASH_CUSTOM, false/*!str_dup*/, false/*using external synch*/,
+                          redzone_site_free, redzone_site_hash, redzone_site_cmp);
+    }
 
 #ifdef UNIX
     mmap_tree = rb_tree_create(NULL);
@@ -235,6 +269,8 @@ alloc_drmem_init(void)
 
     memlayout_init();
 
+    quarantine_maxsz = options.delay_frees_maxsz;
+    quarantine_chunk_max = options.delay_frees_maxsz;
     if (options.delay_frees > 0) {
         delay_free_lock = dr_mutex_create();
         delay_free_tree = rb_tree_create(NULL);
@@ -250,10 +286,16 @@ alloc_drmem_init(void)
 void
 alloc_drmem_exit(void)
 {
+#ifdef STATISTICS
+    LOG(1, "quarantine limit adjustments: %u\n", quarantine_adjustments);
+    LOG(1, "redzone error sites: %u\n", redzone_error_sites);
+#endif
     process_exiting = true;
     leak_exit();
     alloc_exit(); /* must be before deleting alloc_stack_table */
     hashtable_delete_with_stats(&alloc_stack_table, "alloc stack table");
+    if (options.redzone_adaptive)
+        hashtable_delete_with_stats(&redzone_site_table, "redzone site table");
 #ifdef UNIX
     rb_tree_destroy(mmap_tree);
     dr_mutex_destroy(mmap_tree_lock);
@@ -421,7 +463,10 @@ get_shared_callstack(packed_callstack_t *existing_data, dr_mcontext_t *mc,
     else {
         app_loc_t loc;
         pc_to_loc(&loc, post_call);
-        packed_callstack_record(&pcs, mc, &loc, max_frames);
+        /* The walk goes into per-thread scratch space and is only copied to
+         * the heap below if it is not already in alloc_stack_table.
+         */
+        pcs = packed_callstack_record_scratch(mc, &loc, max_frames);
         /* our malloc and free callstacks use post-call as the top frame when wrapping */
         if (!options.replace_malloc)
             packed_callstack_first_frame_retaddr(pcs);
@@ -463,6 +508,88 @@ client_add_malloc_post(malloc_info_t *mal)
     /* nothing to do */
 }
 
+/* -redzone_adaptive per-site tuning.  A site is an allocation callstack,
+ * identified by its 128-bit hash: unlike the packed callstack itself, that
+ * persists after all of the site's allocations are freed.  Callstacks whose
+ * hashes collide share their tuning, which only affects redzone sizes.
+ * Entries are never removed until exit.
+ */
+typedef struct _redzone_site_t {
+    hash128_t key;
+    uint allocs;
+    bool had_error;
+} redzone_site_t;
+
+#define REDZONE_SITE_TABLE_HASH_BITS 10
+static hashtable_t redzone_site_table;
+
+static uint
+redzone_site_hash(void *key)
+{
+    return hash128_hash((hash128_t *) key);
+}
+
+static bool
+redzone_site_cmp(void *key1, void *key2)
+{
+    return hash128_equal((hash128_t *) key1, (hash128_t *) key2);
+}
+
+static void
+redzone_site_free(void *p)
+{
+    global_free(p, sizeof(redzone_site_t), HEAPSTAT_MISC);
+}
+
+/* Caller must hold the redzone_site_table lock */
+static redzone_site_t *
+redzone_site_lookup(packed_callstack_t *pcs)
+{
+    hash128_t key;
+    redzone_site_t *site;
+    packed_callstack_hash128(pcs, &key);
+    site = (redzone_site_t *) hashtable_lookup(&redzone_site_table, &key);
+    if (site == NULL) {
+        site = (redzone_site_t *) global_alloc(sizeof(*site), HEAPSTAT_MISC);
+        site->key = key;
+        site->allocs = 0;
+        site->had_error = false;
+        hashtable_add(&redzone_site_table, &site->key, site);
+    }
+    return site;
+}
+
+bool
+client_malloc_site_quiet(void *client_data)
+{
+    redzone_site_t *site;
+    bool quiet;
+    if (options.redzone_adaptive_quiet == 0)
+        return false;
+    hashtable_lock(&redzone_site_table);
+    site = redzone_site_lookup((packed_callstack_t *) client_data);
+    if (site->allocs < UINT_MAX)
+        site->allocs++;
+    quiet = !site->had_error && site->allocs > options.redzone_adaptive_quiet;
+    hashtable_unlock(&redzone_site_table);
+    return quiet;
+}
+
+void
+alloc_drmem_redzone_error(packed_callstack_t *alloc_pcs)
+{
+    redzone_site_t *site;
+    hashtable_lock(&redzone_site_table);
+    site = redzone_site_lookup(alloc_pcs);
+    if (!site->had_error) {
+        LOG(2, "%s: allocation site %u hit a redzone\n", __FUNCTION__,
+            packed_callstack_hash(alloc_pcs));
+        site->had_error = true;
+        STATS_INC(redzone_error_sites);
+    }
+    hashtable_unlock(&redzone_site_table);
+}
+
 void
 client_remove_malloc_pre(malloc_info_t *mal)
 {
@@ -730,6 +857,11 @@ next_to_free(delay_free_info_t *info, int idx _IF_WINDOWS(ptr_int_t *auxarg OUT)
 #endif
     if (pass_to_free != NULL) {
         rb_node_t *node = rb_find(delay_free_tree, pass_to_free);
+        uint now = quarantine_clock;
+        if (now != 0 && info->delay_free_list[idx].freed_clock != 0) {
+            quarantine_residence_ms += now - info->delay_free_list[idx].freed_clock;
+            quarantine_evictions++;
+        }
         if (node != NULL) {
             DOLOG(2, {
                 byte *start;
@@ -746,6 +878,8 @@ next_to_free(delay_free_info_t *info, int idx _IF_WINDOWS(ptr_int_t *auxarg OUT)
         info->delay_free_bytes -= info->delay_free_list[idx].real_size;
         STATS_ADD(delayed_free_bytes,
                   -(int)info->delay_free_list[idx].real_size);
+        ATOMIC_ADD32(delay_free_total_bytes,
+                     -(int)info->delay_free_list[idx].real_size);
         LOG(2, "%s: freeing "PFX"-"PFX
             IF_WINDOWS(" auxarg="PFX) "\n", reason, pass_to_free,
             pass_to_free + info->delay_free_list[idx].real_size
@@ -797,16 +931,17 @@ client_handle_free(malloc_info_t *mal, byte *tofree, dr_mcontext_t *mc,
         bool full;
 #endif
         uint idx;
+        int evict = -1;
         size_t rz_sz = options.redzone_size;
         byte *rz_start = mal->base - (mal->has_redzone ? rz_sz : 0);
         size_t tot_sz = mal->pad_size + (mal->has_redzone ? rz_sz*2 : 0);
         ASSERT(info != NULL, "invalid param");
         ASSERT(rz_start == tofree, "tofree should equal start of redzone");
         dr_mutex_lock(delay_free_lock);
-        if (tot_sz > options.delay_frees_maxsz) {
+        if (tot_sz > quarantine_chunk_max) {
             /* we have to free this one, it's too big */
             LOG(2, "malloc size %d is larger than max delay %d so freeing immediately\n",
-                tot_sz, options.delay_frees_maxsz);
+                tot_sz, quarantine_chunk_max);
             dr_mutex_unlock(delay_free_lock);
             if (options.pattern != 0)
                 pattern_handle_real_free(mal, false);
@@ -814,44 +949,31 @@ client_handle_free(malloc_info_t *mal, byte *tofree, dr_mcontext_t *mc,
         }
         /* Store real base and real size: i.e., including redzones (PR 572716) */
         info->delay_free_bytes += tot_sz;
-        if (info->delay_free_bytes > options.delay_frees_maxsz) {
-            int head_start = info->delay_free_head;
-            int idx = info->delay_free_head;
+        if (info->delay_free_bytes > quarantine_maxsz) {
             LOG(2, "total delayed %d larger than max delay %d\n",
-                info->delay_free_bytes, options.delay_frees_maxsz);
+                info->delay_free_bytes, quarantine_maxsz);
             /* we can't invoke the app's free() routine safely
-             * so we look for a single free that's bigger than this one:
-             * if none, we have to free this one.
+             * so we can only hand back a single free, which must be bigger
+             * than this one: if none, we have to free this one.
+             * We pick the largest so that once -quarantine_rss_limit lowers
+             * quarantine_maxsz each free gets us as far under it as possible.
              * XXX: either need call-app-routine support in DR (though
              * still have potential deadlock problems since holding lock here)
              * or switch to replacing malloc&co.
              */
-            do {
-                /* XXX: we could end up doing a linear walk on every free.
-                 * we can also end up always freeing immediately once the
-                 * queue gets full of small objects and the app is freeing large
-                 * objects.  not ideal!
+            for (idx = 0; idx < (uint)info->delay_free_fill; idx++) {
+                /* XXX: this is a linear walk on every free once over the
+                 * limit.  We can also end up always freeing immediately once
+                 * the queue gets full of small objects and the app is freeing
+                 * large objects.  not ideal!
                  */
                 if (info->delay_free_list[idx].addr != NULL &&
-                    info->delay_free_list[idx].real_size >= tot_sz) {
-                    LOG(2, "freeing delayed idx=%d "PFX" w/ size=%d (head=%d, fill=%d)\n",
-                        idx, info->delay_free_list[idx].addr,
-                        info->delay_free_list[idx].real_size,
-                        info->delay_free_head, info->delay_free_fill);
-                    pass_to_free = next_to_free(info, idx _IF_WINDOWS(&pass_auxarg),
-                                                "exceeded delay_frees_maxsz");
-                    ASSERT(info->delay_free_bytes <= options.delay_frees_maxsz,
-                           "cannot happen");
-                    info->delay_free_list[idx].addr = NULL;
-                    break;
-                }
-                idx++;
-                if (idx >= info->delay_free_fill)
-                    break;
-                if (idx >= options.delay_frees)
-                    idx = 0;
-            } while (idx != head_start);
-            if (pass_to_free == NULL) {
+                    info->delay_free_list[idx].real_size >= tot_sz &&
+                    (evict < 0 || info->delay_free_list[idx].real_size >
+                     info->delay_free_list[evict].real_size))
+                    evict = idx;
+            }
+            if (evict < 0) {
                 LOG(2, "malloc size %d larger than any entry + over size limit\n",
                     tot_sz);
                 info->delay_free_bytes -= tot_sz;
@@ -861,20 +983,31 @@ client_handle_free(malloc_info_t *mal, byte *tofree, dr_mcontext_t *mc,
                 }
                 return tofree;
             }
+            LOG(2, "freeing delayed idx=%d "PFX" w/ size=%d (head=%d, fill=%d)\n",
+                evict, info->delay_free_list[evict].addr,
+                info->delay_free_list[evict].real_size,
+                info->delay_free_head, info->delay_free_fill);
+            pass_to_free = next_to_free(info, evict _IF_WINDOWS(&pass_auxarg),
+                                        "exceeded delay_frees_maxsz");
+            ASSERT(info->delay_free_bytes <= options.delay_frees_maxsz,
+                   "cannot happen");
         }
 
         LOG(2, "inserting into delay_free_tree (queue idx=%d): "PFX
             "-"PFX" %d bytes redzone=%d\n",
-            DELAY_FREE_FULL(info) ? info->delay_free_head : info->delay_free_fill,
+            evict >= 0 ? evict : (DELAY_FREE_FULL(info) ? info->delay_free_head :
+                                  info->delay_free_fill),
             rz_start, rz_start + tot_sz, tot_sz, mal->has_redzone);
 
-        if (DELAY_FREE_FULL(info)) {
+        if (evict >= 0) {
+            /* This free takes over the evicted slot */
             IF_WINDOWS(full = true;)
-            if (pass_to_free == NULL) {
-                pass_to_free = next_to_free(info, info->delay_free_head
-                                            _IF_WINDOWS(&pass_auxarg),
-                                            "delayed free queue full");
-            }
+            idx = evict;
+        } else if (DELAY_FREE_FULL(info)) {
+            IF_WINDOWS(full = true;)
+            pass_to_free = next_to_free(info, info->delay_free_head
+                                        _IF_WINDOWS(&pass_auxarg),
+                                        "delayed free queue full");
             idx = info->delay_free_head;
             info->delay_free_head++;
             if (info->delay_free_head >= options.delay_frees)
@@ -911,6 +1044,7 @@ client_handle_free(malloc_info_t *mal, byte *tofree, dr_mcontext_t *mc,
 #endif
         info->delay_free_list[idx].real_size = tot_sz;
         info->delay_free_list[idx].has_redzone = mal->has_redzone;
+        info->delay_free_list[idx].freed_clock = quarantine_clock;
         if (options.delay_frees_stack) {
             info->delay_free_list[idx].pcs =
                 get_shared_callstack(NULL, mc, free_routine, options.free_max_frames);
@@ -918,6 +1052,7 @@ client_handle_free(malloc_info_t *mal, byte *tofree, dr_mcontext_t *mc,
             info->delay_free_list[idx].pcs = NULL;
 
         STATS_ADD(delayed_free_bytes, (uint)tot_sz);
+        ATOMIC_ADD32(delay_free_total_bytes, (uint)tot_sz);
 
         dr_mutex_unlock(delay_free_lock);
         if (options.pattern != 0)
@@ -2225,8 +2360,8 @@ add_alloca_exception(void *drcontext, app_pc pc)
         LOG(1, "ignore_unaddr_table entry came to slowpath: likely no problem"
             " (delay flush just hasn't started yet)\n");
     } else {
-        success = dr_delay_flush_region(pc, 1, 0, NULL);
-        ASSERT(success, "ignore_unaddr_table flush failed");
+        /* Nearby probes are coalesced into one flush by the scheduler. */
+        flush_schedule(pc, 1, FLUSH_DELAY);
     }
 }
 
@@ -2504,6 +2639,118 @@ handle_removed_heap_region(app_pc start, app_pc end, dr_mcontext_t *mc)
  * LEAK CHECKING
  */
 
+/* During a leak scan we aggregate leaks by allocation callstack and leak type
+ * and then report each unique site once with summed counts and bytes, rather
+ * than going through the error table, the suppression checks, and error_lock
+ * for every leaked chunk.  Only leaks found on the scanning thread are
+ * aggregated, so no lock is needed: app threads can also report leaks (e.g.,
+ * -check_leaks_on_destroy) and may run during the scan if suspension fails
+ * and once it resumes them.  Each site holds a reference on its callstack as
+ * the scan resumes the other threads (which may free the leaked chunks)
+ * before we report.
+ */
+#define LEAK_SITE_TABLE_HASH_BITS 10
+
+enum {
+    LEAK_SITE_LEAK,
+    LEAK_SITE_POSSIBLE,
+    LEAK_SITE_REACHABLE,
+    LEAK_SITE_NUM_TYPES,
+};
+
+typedef struct _leak_site_t {
+    packed_callstack_t *pcs;
+    /* the first leak seen at this site, for the printed report */
+    app_pc start;
+    app_pc end;
+    size_t indirect_bytes;
+    bool reachable;
+    bool maybe_reachable;
+    bool show_reachable;
+    uint count;
+    size_t total_bytes;
+    /* in order of first occurrence, to keep error numbering unchanged */
+    struct _leak_site_t *next;
+} leak_site_t;
+
+/* The scanning thread while aggregating, else NULL */
+static void *leak_sites_drcontext;
+static hashtable_t leak_site_table[LEAK_SITE_NUM_TYPES];
+static leak_site_t *leak_site_head;
+static leak_site_t *leak_site_tail;
+
+static void
+leak_sites_init(void)
+{
+    uint i;
+    for (i = 0; i < LEAK_SITE_NUM_TYPES; i++) {
+        hashtable_init_ex(&leak_site_table[i], LEAK_SITE_TABLE_HASH_BITS, HASH_INTPTR,
+                          false/*!str_dup*/, false/*!synch*/, NULL, NULL, NULL);
+    }
+    leak_site_head = NULL;
+    leak_site_tail = NULL;
+    leak_sites_drcontext = dr_get_current_drcontext();
+}
+
+static void
+leak_site_add(app_pc start, app_pc end, size_t indirect_bytes, bool reachable,
+              bool maybe_reachable, packed_callstack_t *pcs, bool show_reachable)
+{
+    /* same type precedence as report_leak() */
+    uint idx = reachable ? LEAK_SITE_REACHABLE :
+        (maybe_reachable ? LEAK_SITE_POSSIBLE : LEAK_SITE_LEAK);
+    leak_site_t *site = (leak_site_t *) hashtable_lookup(&leak_site_table[idx], pcs);
+    if (site == NULL) {
+        site = (leak_site_t *) global_alloc(sizeof(*site), HEAPSTAT_MISC);
+        packed_callstack_add_ref(pcs);
+        site->pcs = pcs;
+        site->start = start;
+        site->end = end;
+        site->indirect_bytes = indirect_bytes;
+        site->reachable = reachable;
+        site->maybe_reachable = maybe_reachable;
+        site->show_reachable = show_reachable;
+        site->count = 0;
+        site->total_bytes = 0;
+        site->next = NULL;
+        hashtable_add(&leak_site_table[idx], (void *)pcs, (void *)site);
+        if (leak_site_tail == NULL)
+            leak_site_head = site;
+        else
+            leak_site_tail->next = site;
+        leak_site_tail = site;
+    }
+    site->count++;
+    site->total_bytes += (end - start) + indirect_bytes;
+}
+
+static void
+leak_sites_report(void)
+{
+    leak_site_t *site, *next;
+    uint i;
+    uint num_sites = 0, num_leaks = 0;
+    ASSERT(leak_sites_drcontext == dr_get_current_drcontext(), "wrong thread");
+    leak_sites_drcontext = NULL;
+    for (site = leak_site_head; site != NULL; site = next) {
+        next = site->next;
+        num_sites++;
+        num_leaks += site->count;
+        report_leak_site(true, site->start, site->end - site->start,
+                         site->indirect_bytes, false/*!early*/, site->reachable,
+                         site->maybe_reachable, SHADOW_UNKNOWN, site->pcs,
+                         true/*count_reachable*/, site->show_reachable,
+                         site->count, site->total_bytes);
+        shared_callstack_free(site->pcs);
+        global_free(site, sizeof(*site), HEAPSTAT_MISC);
+    }
+    for (i = 0; i < LEAK_SITE_NUM_TYPES; i++)
+        hashtable_delete(&leak_site_table[i]);
+    leak_site_head = NULL;
+    leak_site_tail = NULL;
+    LOG(1, "leak scan: %u leaks aggregated into %u sites\n", num_leaks, num_sites);
+}
+
 void
 client_found_leak(app_pc start, app_pc end, size_t indirect_bytes,
                   bool pre_us, bool reachable,
@@ -2515,6 +2762,16 @@ client_found_leak(app_pc start, app_pc end, size_t indirect_bytes,
         ASSERT(false, "shouldn't get here");
         return;
     }
+    /* Ignore reachable on extra iter from leak scan, as report_leak() does */
+    if (reachable && !count_reachable)
+        return;
+    if (leak_sites_drcontext != NULL &&
+        leak_sites_drcontext == dr_get_current_drcontext() &&
+        !pre_us && pcs != NULL) {
+        leak_site_add(start, end, indirect_bytes, reachable, maybe_reachable,
+                      pcs, show_reachable);
+        return;
+    }
     report_leak(true, start, end - start, indirect_bytes, pre_us, reachable,
                 maybe_reachable, SHADOW_UNKNOWN, pcs, count_reachable, show_reachable);
 }
@@ -2551,7 +2808,14 @@ check_reachability(bool at_exit)
         return;
     if (!options.leak_scan)
         return;
+    /* Aggregation needs callstacks to key on (-check_leaks), and the
+     * -report_leak_max cutoff is per leak so we only aggregate when unlimited.
+     */
+    if (options.check_leaks && options.report_leak_max < 0)
+        leak_sites_init();
     leak_scan_for_leaks(at_exit);
+    if (leak_sites_drcontext != NULL)
+        leak_sites_report();
 }
 
 /***************************************************************************
@@ -2614,6 +2878,70 @@ region_overlap_with_malloc_block(malloc_iter_data_t *iter_data)
     return iter_data->found;
 }
 
+size_t
+alloc_drmem_quarantine_bytes(void)
+{
+    if (options.replace_malloc)
+        return alloc_replace_delayed_bytes();
+    return delay_free_total_bytes;
+}
+
+void
+alloc_drmem_quarantine_tick(void)
+{
+    size_t rss, limit, floor;
+    size_t maxsz = quarantine_maxsz, chunk_max = quarantine_chunk_max;
+    uint64 now = dr_get_milliseconds();
+    if (quarantine_start_ms == 0)
+        quarantine_start_ms = now;
+    /* Keep 0 as the not-tracking value */
+    quarantine_clock = (uint)(now - quarantine_start_ms) + 1;
+    if (options.quarantine_rss_limit > 0 && options.delay_frees > 0) {
+        limit = (size_t)options.quarantine_rss_limit * 1024 * 1024;
+        floor = (options.delay_frees_maxsz < QUARANTINE_MIN_BYTES) ?
+            options.delay_frees_maxsz : QUARANTINE_MIN_BYTES;
+        rss = get_process_rss();
+        if (rss > limit - limit/8) {
+            /* Close to the limit: halve what we retain, oldest evicted first */
+            maxsz = (maxsz/2 < floor) ? floor : maxsz/2;
+            chunk_max = (chunk_max/2 < QUARANTINE_MIN_CHUNK) ?
+                QUARANTINE_MIN_CHUNK : chunk_max/2;
+        } else if (rss < limit - limit/4) {
+            maxsz = (maxsz*2 > options.delay_frees_maxsz) ?
+                options.delay_frees_maxsz : maxsz*2;
+            chunk_max = (chunk_max*2 > options.delay_frees_maxsz) ?
+                options.delay_frees_maxsz : chunk_max*2;
+        }
+        if (maxsz != quarantine_maxsz || chunk_max != quarantine_chunk_max) {
+            LOG(1, "rss "PIFX" vs limit "PIFX": quarantine max "PIFX" chunk max "
+                PIFX"\n", rss, limit, maxsz, chunk_max);
+            STATS_INC(quarantine_adjustments);
+        }
+        quarantine_maxsz = maxsz;
+        quarantine_chunk_max = chunk_max;
+    }
+    if (options.replace_malloc)
+        alloc_replace_quarantine_update(maxsz, chunk_max, quarantine_clock);
+}
+
+void
+alloc_drmem_quarantine_residence(uint64 *total_ms OUT, uint64 *evictions OUT)
+{
+    if (options.replace_malloc) {
+        alloc_replace_quarantine_residence(total_ms, evictions);
+        return;
+    }
+    if (options.delay_frees == 0) {
+        *total_ms = 0;
+        *evictions = 0;
+        return;
+    }
+    dr_mutex_lock(delay_free_lock);
+    *total_ms = quarantine_residence_ms;
+    *evictions = quarantine_evictions;
+    dr_mutex_unlock(delay_free_lock);
+}
+
 /* check if region [addr, addr + size) overlaps with any malloc redzone
  * or padding.
  * - if overlaps, return true and fill all the passed in parameters,
@@ -88,6 +88,29 @@ region_in_redzone(byte *addr, size_t size,
                   app_pc *redzone_start OUT,
                   app_pc *redzone_end OUT);
 
+/* Returns the bytes currently held in the delayed-free quarantine */
+size_t
+alloc_drmem_quarantine_bytes(void);
+
+/* Called periodically: advances the quarantine clock and, for
+ * -quarantine_rss_limit, shrinks or regrows the delayed-free limits
+ * according to the process RSS.
+ */
+void
+alloc_drmem_quarantine_tick(void);
+
+/* Returns the total time evicted delayed frees spent in the quarantine.
+ * Only measured while alloc_drmem_quarantine_tick() is being called.
+ */
+void
+alloc_drmem_quarantine_residence(uint64 *total_ms OUT, uint64 *evictions OUT);
+
+/* For -redzone_adaptive: records that an allocation from alloc_pcs had a
+ * redzone error, so that its site keeps its full adaptive redzone.
+ */
+void
+alloc_drmem_redzone_error(packed_callstack_t *alloc_pcs);
+
 /* Synchronizes access to malloc callstacks (malloc_get_client_data()) */
 void
 alloc_callstack_lock(void);
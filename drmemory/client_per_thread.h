@@ -72,9 +72,9 @@ typedef struct _tls_drmem_t {
 #ifdef WINDOWS
     /* since we can't get TEB via syscall for some threads (i#442) */
     TEB *teb;
-#else
-    void *empty; /* not worth code ugliness to have no TLS at all */
 #endif
+    /* per-thread cache of decoded slowpath instrs, allocated on first use */
+    struct _decode_cache_t *decode_cache;
 } tls_drmem_t;
 
 extern int tls_idx_drmem;
@@ -0,0 +1,422 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/* Dr. Memory: the memory debugger
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License, and no later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/***************************************************************************
+ * coverage.c: Dr. Memory compact code coverage (-coverage_bitmap)
+ */
+
+#include "dr_api.h"
+#include "drmgr.h"
+#include "drmemory.h"
+#include "utils.h"
+#include "options.h"
+#include "redblack.h"
+#include "coverage.h"
+#include "covformat.h"
+
+#define CHUNK_BITMAP_BYTES (COVFILE_CHUNK_SIZE / 8)
+
+typedef struct _cov_module_t {
+    char *path;
+    uint path_len;
+    app_pc start;     /* NULL once unloaded */
+    size_t size;      /* from start to the end of the last segment */
+    uint id;
+    uint num_chunks;
+    /* Bitmaps of CHUNK_BITMAP_BYTES each, allocated on first use so that
+     * data and never-executed code cost only a pointer per chunk.
+     */
+    byte **chunks;
+    byte *dirty;      /* per chunk: has bits not yet written to the file */
+    bool any_dirty;
+    bool announced;   /* 'M' record written to the current file */
+    struct _cov_module_t *next;
+} cov_module_t;
+
+/* Protects everything below */
+static void *cov_lock;
+/* Maps each loaded module region to its cov_module_t */
+static rb_tree_t *cov_tree;
+/* All modules ever loaded.  We keep unloaded ones for their coverage and
+ * reuse them if the same module is loaded again.
+ */
+static cov_module_t *cov_modules;
+static uint cov_num_modules;
+/* Most blocks are in the same module as the previous one */
+static cov_module_t *cov_last_hit;
+static app_pc cov_last_start;
+static app_pc cov_last_end;
+
+static file_t f_cov = INVALID_FILE;
+static char cov_path[MAXIMUM_PATH];
+
+static dr_emit_flags_t
+coverage_event_bb_analysis(void *drcontext, void *tag, instrlist_t *bb,
+                           bool for_trace, bool translating, void **user_data);
+
+/***************************************************************************
+ * Coverage file
+ */
+
+/* Caller must hold cov_lock */
+static void
+coverage_write(const void *buf, size_t size)
+{
+    if (dr_write_file(f_cov, buf, size) != (ssize_t) size)
+        LOG(1, "coverage: failed to write %d bytes\n", size);
+}
+
+/* Caller must hold cov_lock */
+static void
+coverage_open_file(const char *logdir)
+{
+    uint header[2] = {COVFILE_BOM, COVFILE_CHUNK_SIZE};
+    cov_module_t *mod;
+    dr_snprintf(cov_path, BUFFER_SIZE_ELEMENTS(cov_path), "%s%ccoverage.%d.cov",
+                logdir, DIRSEP, dr_get_process_id());
+    NULL_TERMINATE_BUFFER(cov_path);
+    f_cov = dr_open_file(cov_path, DR_FILE_WRITE_OVERWRITE |
+                         IF_UNIX_ELSE(DR_FILE_ALLOW_LARGE | DR_FILE_CLOSE_ON_FORK, 0));
+    if (f_cov == INVALID_FILE) {
+        NOTIFY_ERROR("Unable to open coverage file %s"NL, cov_path);
+        dr_abort();
+    }
+    coverage_write(COVFILE_MAGIC, COVFILE_MAGIC_LEN);
+    coverage_write(header, sizeof(header));
+    /* module ids are per file */
+    for (mod = cov_modules; mod != NULL; mod = mod->next)
+        mod->announced = false;
+}
+
+/* Caller must hold cov_lock */
+static void
+coverage_write_module(cov_module_t *mod)
+{
+    byte rec[1 + sizeof(uint) + sizeof(uint64) + sizeof(uint)];
+    uint64 size = mod->size;
+    rec[0] = COVREC_MODULE;
+    memcpy(&rec[1], &mod->id, sizeof(uint));
+    memcpy(&rec[1 + sizeof(uint)], &size, sizeof(size));
+    memcpy(&rec[1 + sizeof(uint) + sizeof(uint64)], &mod->path_len, sizeof(uint));
+    coverage_write(rec, sizeof(rec));
+    coverage_write(mod->path, mod->path_len);
+    mod->announced = true;
+}
+
+/* Caller must hold cov_lock */
+static void
+coverage_write_chunk(cov_module_t *mod, uint chunk)
+{
+    byte rec[1 + 2 * sizeof(uint) + CHUNK_BITMAP_BYTES];
+    rec[0] = COVREC_CHUNK;
+    memcpy(&rec[1], &mod->id, sizeof(uint));
+    memcpy(&rec[1 + sizeof(uint)], &chunk, sizeof(uint));
+    memcpy(&rec[1 + 2 * sizeof(uint)], mod->chunks[chunk], CHUNK_BITMAP_BYTES);
+    coverage_write(rec, sizeof(rec));
+}
+
+void
+coverage_dump(void)
+{
+    cov_module_t *mod;
+    uint i, written = 0;
+    dr_mutex_lock(cov_lock);
+    if (f_cov == INVALID_FILE) {
+        dr_mutex_unlock(cov_lock);
+        return;
+    }
+    for (mod = cov_modules; mod != NULL; mod = mod->next) {
+        if (!mod->any_dirty)
+            continue;
+        if (!mod->announced)
+            coverage_write_module(mod);
+        for (i = 0; i < mod->num_chunks; i++) {
+            if (mod->dirty[i]) {
+                coverage_write_chunk(mod, i);
+                mod->dirty[i] = false;
+                written++;
+            }
+        }
+        mod->any_dirty = false;
+    }
+    if (written > 0) {
+        byte rec[1 + sizeof(uint64)];
+        uint64 now = dr_get_milliseconds();
+        rec[0] = COVREC_DUMP;
+        memcpy(&rec[1], &now, sizeof(now));
+        coverage_write(rec, sizeof(rec));
+    }
+    dr_mutex_unlock(cov_lock);
+    LOG(1, "coverage: dumped %d chunks\n", written);
+}
+
+const char *
+coverage_logfile(void)
+{
+    return cov_path;
+}
+
+/***************************************************************************
+ * Bitmaps
+ */
+
+/* Caller must hold cov_lock */
+static cov_module_t *
+coverage_lookup(app_pc pc)
+{
+    rb_node_t *node;
+    app_pc base;
+    size_t size;
+    void *client;
+    if (pc >= cov_last_start && pc < cov_last_end)
+        return cov_last_hit;
+    node = rb_in_node(cov_tree, pc);
+    if (node == NULL)
+        return NULL;
+    rb_node_fields(node, &base, &size, &client);
+    cov_last_start = base;
+    cov_last_end = base + size;
+    cov_last_hit = (cov_module_t *) client;
+    return cov_last_hit;
+}
+
+/* Caller must hold cov_lock */
+static void
+coverage_mark(app_pc pc, uint len)
+{
+    cov_module_t *mod = coverage_lookup(pc);
+    size_t offs, end;
+    if (mod == NULL)
+        return; /* not in a module: generated code */
+    offs = pc - mod->start;
+    end = offs + len;
+    if (end > mod->size)
+        end = mod->size;
+    for (; offs < end; offs++) {
+        uint chunk = (uint)(offs / COVFILE_CHUNK_SIZE);
+        uint bit = (uint)(offs % COVFILE_CHUNK_SIZE);
+        byte *bitmap = mod->chunks[chunk];
+        if (bitmap == NULL) {
+            bitmap = (byte *) global_alloc(CHUNK_BITMAP_BYTES, HEAPSTAT_MISC);
+            memset(bitmap, 0, CHUNK_BITMAP_BYTES);
+            mod->chunks[chunk] = bitmap;
+        }
+        /* Re-built blocks (after a flush, or a thread-private copy) are not
+         * new coverage and should not cause their chunk to be dumped again.
+         */
+        if (!TEST(1 << (bit % 8), bitmap[bit / 8])) {
+            bitmap[bit / 8] |= (byte)(1 << (bit % 8));
+            mod->dirty[chunk] = true;
+            mod->any_dirty = true;
+        }
+    }
+}
+
+static dr_emit_flags_t
+coverage_event_bb_analysis(void *drcontext, void *tag, instrlist_t *bb,
+                           bool for_trace, bool translating, void **user_data)
+{
+    instr_t *inst;
+    /* Traces and re-translations contain nothing new */
+    if (for_trace || translating)
+        return DR_EMIT_DEFAULT;
+    dr_mutex_lock(cov_lock);
+    /* We walk the instrs rather than using the block bounds as DR may have
+     * elided direct branches.
+     */
+    for (inst = instrlist_first_app(bb); inst != NULL; inst = instr_get_next_app(inst)) {
+        app_pc pc = instr_get_app_pc(inst);
+        if (pc != NULL)
+            coverage_mark(pc, instr_length(drcontext, inst));
+    }
+    dr_mutex_unlock(cov_lock);
+    return DR_EMIT_DEFAULT;
+}
+
+/***************************************************************************
+ * Modules
+ */
+
+/* Caller must hold cov_lock */
+static void
+coverage_add_region(app_pc start, app_pc end, cov_module_t *mod)
+{
+    IF_DEBUG(rb_node_t *node = )
+        rb_insert(cov_tree, start, end - start, (void *)mod);
+    /* The dyld shared cache shares segments across modules, in which case
+     * we attribute the code to the first one.
+     */
+    DOLOG(2, {
+        if (node != NULL)
+            LOG(2, "coverage: module region "PFX" overlaps w/ existing\n", start);
+    });
+}
+
+/* Caller must hold cov_lock */
+static void
+coverage_remove_region(app_pc start, cov_module_t *mod)
+{
+    rb_node_t *node = rb_find(cov_tree, start);
+    void *client;
+    if (node == NULL)
+        return;
+    rb_node_fields(node, NULL, NULL, &client);
+    if (client == (void *)mod)
+        rb_delete(cov_tree, node);
+}
+
+void
+coverage_module_load(void *drcontext, const module_data_t *info, bool loaded)
+{
+    cov_module_t *mod;
+    const char *path = info->full_path;
+    size_t size = info->end - info->start;
+    if (path == NULL || path[0] == '\0')
+        path = dr_module_preferred_name(info);
+    if (path == NULL)
+        path = "<unknown>";
+    dr_mutex_lock(cov_lock);
+    for (mod = cov_modules; mod != NULL; mod = mod->next) {
+        if (mod->start == NULL && mod->size == size && strcmp(mod->path, path) == 0)
+            break;
+    }
+    if (mod == NULL) {
+        mod = (cov_module_t *) global_alloc(sizeof(*mod), HEAPSTAT_MISC);
+        memset(mod, 0, sizeof(*mod));
+        mod->path = drmem_strdup(path, HEAPSTAT_MISC);
+        mod->path_len = (uint) strlen(path);
+        mod->size = size;
+        mod->id = cov_num_modules++;
+        mod->num_chunks = (uint)((size + COVFILE_CHUNK_SIZE - 1) / COVFILE_CHUNK_SIZE);
+        mod->chunks = (byte **)
+            global_alloc(mod->num_chunks * sizeof(*mod->chunks), HEAPSTAT_MISC);
+        memset(mod->chunks, 0, mod->num_chunks * sizeof(*mod->chunks));
+        mod->dirty = (byte *) global_alloc(mod->num_chunks, HEAPSTAT_MISC);
+        memset(mod->dirty, 0, mod->num_chunks);
+        mod->next = cov_modules;
+        cov_modules = mod;
+    }
+    mod->start = info->start;
+    LOG(2, "coverage: module #%d %s "PFX"-"PFX"\n", mod->id, mod->path,
+        info->start, info->end);
+#ifdef UNIX
+    if (!info->contiguous) {
+        uint i;
+        for (i = 0; i < info->num_segments; i++) {
+            coverage_add_region(info->segments[i].start, info->segments[i].end, mod);
+        }
+    } else
+#endif
+        coverage_add_region(info->start, info->end, mod);
+    dr_mutex_unlock(cov_lock);
+}
+
+void
+coverage_module_unload(void *drcontext, const module_data_t *info)
+{
+    cov_module_t *mod;
+    dr_mutex_lock(cov_lock);
+    for (mod = cov_modules; mod != NULL; mod = mod->next) {
+        if (mod->start == info->start)
+            break;
+    }
+    if (mod != NULL) {
+#ifdef UNIX
+        if (!info->contiguous) {
+            uint i;
+            for (i = 0; i < info->num_segments; i++)
+                coverage_remove_region(info->segments[i].start, mod);
+        } else
+#endif
+            coverage_remove_region(info->start, mod);
+        mod->start = NULL;
+    }
+    cov_last_hit = NULL;
+    cov_last_start = NULL;
+    cov_last_end = NULL;
+    dr_mutex_unlock(cov_lock);
+}
+
+/***************************************************************************
+ * Init and exit
+ */
+
+void
+coverage_init(const char *logdir)
+{
+    ASSERT(options.coverage_bitmap, "should not be called");
+    cov_lock = dr_mutex_create();
+    cov_tree = rb_tree_create(NULL);
+    dr_mutex_lock(cov_lock);
+    coverage_open_file(logdir);
+    dr_mutex_unlock(cov_lock);
+    if (!drmgr_register_bb_instrumentation_event(coverage_event_bb_analysis,
+                                                 NULL, NULL))
+        ASSERT(false, "drmgr registration failed");
+}
+
+#ifdef UNIX
+void
+coverage_fork_init(const char *logdir)
+{
+    cov_module_t *mod;
+    uint i;
+    dr_mutex_lock(cov_lock);
+    /* DR closed the parent's file.  Coverage not yet dumped belongs to the
+     * parent, which will write it, so the child starts out clean.
+     */
+    for (mod = cov_modules; mod != NULL; mod = mod->next) {
+        for (i = 0; i < mod->num_chunks; i++)
+            mod->dirty[i] = false;
+        mod->any_dirty = false;
+    }
+    coverage_open_file(logdir);
+    dr_mutex_unlock(cov_lock);
+}
+#endif
+
+void
+coverage_exit(void)
+{
+    cov_module_t *mod, *next;
+    uint i;
+    coverage_dump();
+    drmgr_unregister_bb_instrumentation_event(coverage_event_bb_analysis);
+    dr_mutex_lock(cov_lock);
+    dr_close_file(f_cov);
+    f_cov = INVALID_FILE;
+    rb_tree_destroy(cov_tree);
+    for (mod = cov_modules; mod != NULL; mod = next) {
+        next = mod->next;
+        for (i = 0; i < mod->num_chunks; i++) {
+            if (mod->chunks[i] != NULL)
+                global_free(mod->chunks[i], CHUNK_BITMAP_BYTES, HEAPSTAT_MISC);
+        }
+        global_free(mod->chunks, mod->num_chunks * sizeof(*mod->chunks),
+                    HEAPSTAT_MISC);
+        global_free(mod->dirty, mod->num_chunks, HEAPSTAT_MISC);
+        global_free(mod->path, mod->path_len + 1, HEAPSTAT_MISC);
+        global_free(mod, sizeof(*mod), HEAPSTAT_MISC);
+    }
+    cov_modules = NULL;
+    dr_mutex_unlock(cov_lock);
+    dr_mutex_destroy(cov_lock);
+}
@@ -0,0 +1,62 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/* Dr. Memory: the memory debugger
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License, and no later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/***************************************************************************
+ * coverage.h: Dr. Memory compact code coverage (-coverage_bitmap)
+ *
+ * Each module has a bitmap of covered code bytes, filled in when a basic
+ * block is built.  Dumps append only the chunks that changed since the
+ * previous dump; see covformat.h for the file format.
+ */
+
+#ifndef _COVERAGE_H_
+#define _COVERAGE_H_ 1
+
+#include "utils.h"
+
+void
+coverage_init(const char *logdir);
+
+void
+coverage_exit(void);
+
+#ifdef UNIX
+void
+coverage_fork_init(const char *logdir);
+#endif
+
+void
+coverage_module_load(void *drcontext, const module_data_t *info, bool loaded);
+
+void
+coverage_module_unload(void *drcontext, const module_data_t *info);
+
+/* Appends all coverage not yet written to the coverage file.
+ * May be called from any thread.
+ */
+void
+coverage_dump(void);
+
+/* Returns the path of the coverage file */
+const char *
+coverage_logfile(void);
+
+#endif /* _COVERAGE_H_ */
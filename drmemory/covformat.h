@@ -0,0 +1,55 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/* Dr. Memory: the memory debugger
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License, and no later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _COVFORMAT_H_
+#define _COVFORMAT_H_ 1
+
+/* Constants shared between the -coverage_bitmap client code and covmerge.
+ *
+ * A coverage file is a header followed by a sequence of records, all in
+ * the byte order of the machine that wrote it:
+ *
+ *   header: COVFILE_MAGIC (8 bytes), uint32 COVFILE_BOM, uint32 chunk size
+ *   'M' record: uint32 module id, uint64 module size, uint32 path length,
+ *               path bytes (not NUL-terminated)
+ *   'C' record: uint32 module id, uint32 chunk index,
+ *               chunk size / 8 bytes of bitmap, one bit per code byte
+ *   'D' record: uint64 timestamp in milliseconds, ending one dump
+ *
+ * Module ids are local to a file and are defined by an 'M' record before
+ * their first use.  A chunk may appear many times: its bitmaps are OR-ed.
+ * Since merging is an OR, a merged file has the same format and can itself
+ * be merged.  A file cut short by a killed process is valid up to its last
+ * complete record.
+ */
+
+#define COVFILE_MAGIC "DRMCOV1\n"
+#define COVFILE_MAGIC_LEN 8
+#define COVFILE_BOM 0x01020304
+
+/* Code bytes covered by one chunk.  Must be a multiple of 8. */
+#define COVFILE_CHUNK_SIZE 4096
+
+#define COVREC_MODULE 'M'
+#define COVREC_CHUNK  'C'
+#define COVREC_DUMP   'D'
+
+#endif /* _COVFORMAT_H_ */
@@ -70,6 +70,8 @@
 #include "leak.h"
 #include "stack.h"
 #include "perturb.h"
+#include "flush.h"
+#include "coverage.h"
 #include <stddef.h> /* for offsetof */
 #include "pattern.h"
 #include "frontend.h"
@@ -120,6 +122,12 @@ event_context_init(void *drcontext, bool new_depth);
 static void
 event_context_exit(void *drcontext, bool thread_exit);
 
+/* Tells the memory report thread to stop */
+static volatile bool memory_report_exit;
+
+static void
+memory_report_residence(file_t f);
+
 /***************************************************************************
  * OPTIONS
  */
@@ -220,6 +228,8 @@ dump_statistics(void)
     dr_fprintf(f_global, "adjust_esp:%10u slow; %10u fast\n", adjust_esp_executions,
                adjust_esp_fastpath);
     dr_fprintf(f_global, "slow_path invocations: %10u\n", slowpath_executions);
+    dr_fprintf(f_global, "slow_path decode cache: %10u hits, %10u misses\n",
+               slowpath_decode_hits, slowpath_decode_misses);
 #ifdef X86
     dr_fprintf(f_global, "med_path invocations: %10u, fast movs: %10u, fast cmps: %10u\n",
                medpath_executions, movs4_med_fast, cmps1_med_fast);
@@ -266,6 +276,12 @@ dump_statistics(void)
                num_faults);
     dr_fprintf(f_global, "faults to transition to slowpath: %6u\n",
                num_slowpath_faults);
+    if (options.shadowing) {
+        uint64 faults, blocks;
+        shadow_fault_statistics(&faults, &blocks);
+        dr_fprintf(f_global, "on-touch shadow faults: %6u, blocks created: %6u\n",
+                   (uint)faults, (uint)blocks);
+    }
     dr_fprintf(f_global, "app mallocs: %8u, frees: %8u, large mallocs: %6u\n",
                num_mallocs, num_frees, num_large_mallocs);
     dr_fprintf(f_global, "unique malloc stacks: %8u\n", alloc_stack_count);
@@ -283,6 +299,8 @@ dump_statistics(void)
     dr_fprintf(f_global, "delayed free bytes: %8u\n", delayed_free_bytes);
     dr_fprintf(f_global, "app heap regions: %8u\n", heap_regions);
     dr_fprintf(f_global, "addr checks elided: %8u\n", addressable_checks_elided);
+    dr_fprintf(f_global, "dead shadow writes elided: %8u regs, %6u eflags\n",
+               dead_reg_shadow_elided, dead_eflags_shadow_elided);
     dr_fprintf(f_global, "aflags saved at top: %8u\n", aflags_saved_at_top);
     dr_fprintf(f_global, "xl8 sharing: %8u shared, %6u not:conflict, %6u not:disp-sz\n",
                xl8_shared, xl8_not_shared_reg_conflict, xl8_not_shared_disp_too_big);
@@ -294,6 +312,9 @@ dump_statistics(void)
                xl8_not_shared_scratch_conflict);
     dr_fprintf(f_global, "\t%6u instrs slowpath, %6u count slowpath\n",
                xl8_shared_slowpath_instrs, xl8_shared_slowpath_count);
+    dr_fprintf(f_global,
+               "xl8 stack cache: %6u instrs, %8u hits, %8u misses, %6u refreshes\n",
+               xl8_stack_instrs, xl8_stack_hits, xl8_stack_misses, xl8_stack_refreshes);
 #ifdef WINDOWS
     dr_fprintf(f_global,
                "encoded pointers: total: %5u, seen during leak scan: %5u\n",
@@ -311,6 +332,7 @@ dump_statistics(void)
     if (options.perturb) {
         perturb_dump_statistics(f_global);
     }
+    flush_dump_statistics(f_global);
     if (options.leaks_only) {
         dr_fprintf(f_global, "zeroing loop aborts: %6u fault, %6u thresh\n",
                    zero_loop_aborts_fault, zero_loop_aborts_thresh);
@@ -434,6 +456,9 @@ event_exit(void)
 {
     LOGF(2, f_global, "in event_exit\n");
 
+    memory_report_exit = true;
+    memory_report_residence(f_global);
+
     check_reachability(true/*at exit*/);
 
     if (options.pause_at_exit)
@@ -444,6 +469,7 @@ event_exit(void)
 #endif
 
     instrument_exit();
+    flush_exit();
 
     if (options.perturb)
         perturb_exit();
@@ -469,9 +495,15 @@ event_exit(void)
     if (options.use_symcache)
         drsymcache_exit();
 #endif
+    if (options.coverage_bitmap)
+        coverage_exit();
     utils_exit();
 
-    if (options.coverage) {
+    if (options.coverage_bitmap) {
+        ELOGF(0, f_results, "Code coverage bitmap data: %s"NL, coverage_logfile());
+        NOTIFY_COND(options.summary, f_global, "Code coverage bitmap data: %s"NL,
+                    coverage_logfile());
+    } else if (options.coverage) {
         const char *covfile;
         if (drcovlib_logfile(NULL, &covfile) == DRCOVLIB_SUCCESS) {
             ELOGF(0, f_results, "Code coverage raw data: %s"NL, covfile);
@@ -721,6 +753,7 @@ event_thread_exit(void *drcontext)
     syscall_thread_exit(drcontext);
     if (options.shadowing)
         shadow_thread_exit(drcontext);
+    slowpath_thread_exit(drcontext);
     instrument_thread_exit(drcontext);
     utils_thread_exit(drcontext);
     /* with PR 536058 we do have dcontext in exit event so indicate explicitly
@@ -1582,6 +1615,9 @@ event_fork(void *drcontext)
 
     if (options.perturb)
         perturb_fork_init();
+
+    if (options.coverage_bitmap)
+        coverage_fork_init(logsubdir);
 }
 
 static dr_signal_action_t
@@ -1602,6 +1638,211 @@ event_exception(void *drcontext, dr_exception_t *excpt)
 }
 #endif
 
+/***************************************************************************
+ * MEMORY ACCOUNTING
+ */
+
+/* Cap checking interval when -memory_report_freq is 0 */
+#define MEMORY_CAP_CHECK_SECS 10
+
+enum {
+    MEMCAT_SHADOW,
+    MEMCAT_CALLSTACK,
+    MEMCAT_QUARANTINE,
+    MEMCAT_PERBB,
+    MEMCAT_HEAP,
+    MEMCAT_DR,
+    MEMCAT_NUMTYPES,
+};
+
+static const char * const memcat_names[] = {
+    "shadow",
+    "callstack",
+    "quarantine",
+    "perbb",
+    "tool heap",
+    "DR internal",
+};
+
+/* Categories we've already warned about, to avoid flooding the log */
+static uint memcat_warned;
+
+static size_t
+memcat_cap(uint cat)
+{
+    uint mb = 0;
+    switch (cat) {
+    case MEMCAT_SHADOW:     mb = options.memory_cap_shadow; break;
+    case MEMCAT_CALLSTACK:  mb = options.memory_cap_callstack; break;
+    case MEMCAT_QUARANTINE: mb = options.memory_cap_quarantine; break;
+    case MEMCAT_PERBB:      mb = options.memory_cap_perbb; break;
+    case MEMCAT_HEAP:       mb = options.memory_cap_heap; break;
+    case MEMCAT_DR:         mb = options.memory_cap_dr; break;
+    default: ASSERT(false, "invalid memory category");
+    }
+    return (size_t)mb * 1024 * 1024;
+}
+
+/* Sums DR's own regions (its heap, including ours, and its code caches).
+ * DR has no query for these so we walk the address space.
+ */
+static size_t
+memory_usage_dr_internal(void)
+{
+    size_t total = 0;
+    byte *pc = NULL;
+    dr_mem_info_t info;
+    while (dr_query_memory_ex(pc, &info)) {
+        if (info.type != DR_MEMTYPE_FREE && dr_memory_is_dr_internal(info.base_pc))
+            total += info.size;
+        if (POINTER_OVERFLOW_ON_ADD(info.base_pc, info.size))
+            break;
+        pc = info.base_pc + info.size;
+    }
+    return total;
+}
+
+static void
+memory_usage_gather(size_t usage[MEMCAT_NUMTYPES], size_t *shadow_shared OUT)
+{
+    size_t cur;
+    int i;
+    memset(usage, 0, sizeof(usage[0]) * MEMCAT_NUMTYPES);
+    *shadow_shared = 0;
+    if (options.shadowing)
+        shadow_memory_usage(&usage[MEMCAT_SHADOW], shadow_shared);
+    heap_usage_query(HEAPSTAT_CALLSTACK, &usage[MEMCAT_CALLSTACK], NULL);
+    usage[MEMCAT_QUARANTINE] = alloc_drmem_quarantine_bytes();
+    heap_usage_query(HEAPSTAT_PERBB, &usage[MEMCAT_PERBB], NULL);
+    for (i = 0; i < HEAPSTAT_NUMTYPES; i++) {
+        heap_usage_query(i, &cur, NULL);
+        usage[MEMCAT_HEAP] += cur;
+    }
+    usage[MEMCAT_DR] = memory_usage_dr_internal();
+}
+
+static void
+memory_report_residence(file_t f)
+{
+    uint64 total_ms, evictions;
+    alloc_drmem_quarantine_residence(&total_ms, &evictions);
+    if (evictions > 0) {
+        dr_fprintf(f, "\t%12s: average delay %u ms over "UINT64_FORMAT_STRING
+                   " frees\n", "quarantine", (uint)(total_ms / evictions), evictions);
+    }
+}
+
+static void
+memory_report(file_t f, const size_t usage[MEMCAT_NUMTYPES], size_t shadow_shared)
+{
+    size_t cur, peak;
+    int i;
+    dr_fprintf(f, "\nTool memory usage:\n");
+    for (i = 0; i < MEMCAT_NUMTYPES; i++) {
+        size_t cap = memcat_cap(i);
+        dr_fprintf(f, "\t%12s: %10u KB", memcat_names[i], (uint)(usage[i]/1024));
+        if (cap > 0)
+            dr_fprintf(f, " (cap %u KB)", (uint)(cap/1024));
+        dr_fprintf(f, "\n");
+    }
+    if (options.shadowing) {
+        dr_fprintf(f, "\tShadow memory by type:\n");
+        dr_fprintf(f, "\t%12s: %10u KB\n", "private",
+                   (uint)(usage[MEMCAT_SHADOW]/1024));
+        dr_fprintf(f, "\t%12s: %10u KB mapped to shared blocks\n",
+                   "shared", (uint)(shadow_shared/1024));
+    }
+    memory_report_residence(f);
+    dr_fprintf(f, "\tTool heap by category:\n");
+    for (i = 0; i < HEAPSTAT_NUMTYPES; i++) {
+        heap_usage_query(i, &cur, &peak);
+        dr_fprintf(f, "\t%12s: %10u KB, peak %10u KB\n",
+                   heapstat_name(i), (uint)(cur/1024), (uint)(peak/1024));
+    }
+}
+
+/* Returns whether any category newly exceeded its cap */
+static bool
+memory_check_caps(const size_t usage[MEMCAT_NUMTYPES])
+{
+    bool exceeded = false;
+    int i;
+    for (i = 0; i < MEMCAT_NUMTYPES; i++) {
+        size_t cap = memcat_cap(i);
+        if (cap > 0 && usage[i] > cap && !TEST(1 << i, memcat_warned)) {
+            memcat_warned |= (1 << i);
+            WARN("WARNING: %s memory %u KB exceeds the %u KB cap\n",
+                 memcat_names[i], (uint)(usage[i]/1024), (uint)(cap/1024));
+            exceeded = true;
+        } else if (cap > 0 && usage[i] <= cap)
+            memcat_warned &= ~(1 << i);
+    }
+    return exceeded;
+}
+
+static void
+memory_report_now(bool always)
+{
+    size_t usage[MEMCAT_NUMTYPES], shadow_shared;
+    bool exceeded;
+    memory_usage_gather(usage, &shadow_shared);
+    exceeded = memory_check_caps(usage);
+    if (always || exceeded) {
+        print_timestamp_elapsed_to_file(f_global, "Memory report ");
+        memory_report(f_global, usage, shadow_shared);
+    }
+}
+
+static bool
+memory_caps_enabled(void)
+{
+    return (options.memory_cap_shadow > 0 || options.memory_cap_callstack > 0 ||
+            options.memory_cap_quarantine > 0 || options.memory_cap_perbb > 0 ||
+            options.memory_cap_heap > 0 || options.memory_cap_dr > 0);
+}
+
+/* For -memory_report_freq, the caps, -quarantine_rss_limit, and
+ * -coverage_dump_freq we need a timer: like Dr. Heapstat we use a separate thread.
+ */
+static void
+memory_report_thread(void *arg)
+{
+    uint secs = (options.memory_report_freq > 0) ? options.memory_report_freq :
+        MEMORY_CAP_CHECK_SECS;
+    uint elapsed_ms = 0, coverage_elapsed_ms = 0;
+    LOG(1, "memory report thread "TIDFMT" running\n",
+        dr_get_thread_id(dr_get_current_drcontext()));
+    while (!memory_report_exit) {
+        /* Sleep in small pieces so we notice exit promptly.  This is also
+         * the granularity of the quarantine clock.
+         */
+        dr_sleep(500);
+        alloc_drmem_quarantine_tick();
+        elapsed_ms += 500;
+        if (elapsed_ms >= secs * 1000) {
+            elapsed_ms = 0;
+            memory_report_now(options.memory_report_freq > 0);
+        }
+        if (options.coverage_dump_freq > 0) {
+            coverage_elapsed_ms += 500;
+            if (coverage_elapsed_ms >= options.coverage_dump_freq * 1000) {
+                coverage_elapsed_ms = 0;
+                coverage_dump();
+            }
+        }
+    }
+}
+
+static void
+memory_report_init(void)
+{
+    if (options.memory_report_freq > 0 || memory_caps_enabled() ||
+        options.quarantine_rss_limit > 0 || options.coverage_dump_freq > 0) {
+        if (!dr_create_client_thread(memory_report_thread, NULL))
+            ASSERT(false, "unable to create memory report thread");
+    }
+}
+
 static void
 nudge_leak_scan(void *drcontext)
 {
@@ -1631,6 +1872,8 @@ nudge_leak_scan(void *drcontext)
     if (options.count_leaks || options.check_leaks || options.leak_scan) {
         report_leak_stats_revert();
     }
+    if (options.coverage_bitmap)
+        coverage_dump();
     ELOGF(0, f_global, "NUDGE\n");
 #ifdef USE_DRSYMS
     ELOGF(0, f_results, NL"==========================================================================="NL);
@@ -1646,6 +1889,12 @@ event_nudge(void *drcontext, uint64 argument)
     uint param = (uint) (argument >> 32);
     if (code == NUDGE_LEAK_SCAN)
         nudge_leak_scan(drcontext);
+    else if (code == NUDGE_MEMORY_REPORT)
+        memory_report_now(true);
+    else if (code == NUDGE_COVERAGE_DUMP) {
+        if (options.coverage_bitmap)
+            coverage_dump();
+    }
     else if (code == NUDGE_TERMINATE) {
         /* clean exit (as opposed to parent terminating w/ no cleanup) */
         static int nudge_term_count;
@@ -1743,6 +1992,8 @@ event_module_load(void *drcontext, const module_data_t *info, bool loaded)
         perturb_module_load(drcontext, info, loaded);
     slowpath_module_load(drcontext, info, loaded);
     leak_module_load(drcontext, info, loaded);
+    if (options.coverage_bitmap)
+        coverage_module_load(drcontext, info, loaded);
 #ifdef USE_DRSYMS
     /* Free resources.  Many modules will never need symbol queries again b/c
      * they won't show up in any callstack later.  Xref i#982.
@@ -1762,6 +2013,8 @@ event_module_unload(void *drcontext, const module_data_t *info)
         dr_module_preferred_name(info), info->start, info->end);
     leak_module_unload(drcontext, info);
     slowpath_module_unload(drcontext, info);
+    if (options.coverage_bitmap)
+        coverage_module_unload(drcontext, info);
     if (!options.perturb_only)
         callstack_module_unload(drcontext, info);
     if (INSTRUMENT_MEMREFS())
@@ -2030,11 +2283,17 @@ dr_init(client_id_t id)
     if (options.perturb)
         perturb_init();
 
+    flush_init();
     instrument_init();
 
-    if (options.coverage) {
+    if (options.coverage_bitmap)
+        coverage_init(logsubdir);
+    else if (options.coverage) {
         drcovlib_options_t ops = {sizeof(ops), 0, logsubdir, };
         if (drcovlib_init(&ops) != DRCOVLIB_SUCCESS)
             ASSERT(false, "failed to init drcovlib");
     }
+
+    /* after coverage_init() as the thread may dump coverage */
+    memory_report_init();
 }
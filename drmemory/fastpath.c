@@ -36,6 +36,7 @@
 # include "report.h"
 #endif
 #include "pattern.h"
+#include "flush.h"
 
 #ifdef UNIX
 # include <signal.h> /* for SIGSEGV */
@@ -75,7 +76,7 @@ slow_path_xl8_sharing(app_loc_t *loc, size_t inst_sz, opnd_t memop, dr_mcontext_
             /* We don't need a synchronous flush: go w/ most performant.
              * dr_delay_flush_region() doesn't do any unlinking, so if in
              * a loop we'll repeatedly flush => performance problem!
-             * So we go w/ dr_unlink_flush_region(): should be ok since
+             * So we go w/ an unlink flush: should be ok since
              * we'll never want -coarse_units.
              * XXX i#1426: actually we do have -coarse_units with -persist_code!
              * To support full mode persistence we'll have to change this flush!
@@ -111,7 +112,8 @@ slow_path_xl8_sharing(app_loc_t *loc, size_t inst_sz, opnd_t memop, dr_mcontext_
                  * instrumentation to not share this app pc again.
                  */
             }
-            dr_unlink_flush_region(pc, 1);
+            /* We're in a clean call, so an unlink flush is safe here. */
+            flush_schedule(pc, 1, FLUSH_UNLINK);
         } else {
             xl8_sharing_cnt++;
             /* We don't care about races: threshold is low enough we won't overflow */
@@ -134,6 +136,11 @@ slow_path_xl8_sharing(app_loc_t *loc, size_t inst_sz, opnd_t memop, dr_mcontext_
      * the reg clear to the inlined code in instrument_slowpath() where the reg to
      * write to is known.
      */
+
+    /* Every slowpath is a clean call: a safe point for flushes that were
+     * deferred by the rate limit.
+     */
+    flush_safe_point(true/*unlink ok*/);
 }
 
 /***************************************************************************
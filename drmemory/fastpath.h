@@ -47,6 +47,9 @@ enum {
 #endif
 #define  REG_START         IF_X64_ELSE(REG_START_64, REG_START_32)
 
+/* how many app instrs per bb we record shadow liveness for */
+#define MAX_SHADOW_LIVENESS_INSTRS 64
+
 typedef struct _scratch_reg_info_t {
     reg_id_t reg;
     bool used;
@@ -176,6 +179,16 @@ struct _bb_info_t {
     bool addressable[NUM_LIVENESS_REGS];
     /* elide redundant eflags definedness check for cmp/test,jcc */
     bool eflags_defined;
+#ifdef TOOL_DR_MEMORY
+    /* i#777: per-app-instr shadow liveness from the analysis phase: bit i is
+     * set if GPR REG_START+i is dead after the instr and bit NUM_LIVENESS_REGS
+     * if the arithmetic flags are.  Instrs past the array size have no info.
+     */
+    uint shadow_dead[MAX_SHADOW_LIVENESS_INSTRS];
+    uint num_shadow_dead;
+    uint app_instr_idx;   /* index of the next app instr to instrument */
+    uint cur_shadow_dead; /* shadow_dead entry for the current app instr */
+#endif
     /* PR 493257: share shadow translation across multiple instrs */
     opnd_t shared_memop;      /* the orig memop that did a full load */
     int shared_disp_reg1;     /* disp from orig memop already in reg1 */
@@ -273,6 +286,11 @@ mark_eflags_used(void *drcontext, instrlist_t *bb, bb_info_t *bi);
 void
 fastpath_top_of_bb(void *drcontext, void *tag, instrlist_t *bb, bb_info_t *bi);
 
+#if defined(TOOL_DR_MEMORY) && defined(X86)
+void
+fastpath_shadow_liveness(instrlist_t *bb, bb_info_t *bi);
+#endif
+
 void
 fastpath_pre_instrument(void *drcontext, instrlist_t *bb, instr_t *inst, bb_info_t *bi);
 
@@ -202,6 +202,109 @@ get_aflags_and_reg_liveness(instr_t *inst, int live[NUM_LIVENESS_REGS],
     return res;
 }
 
+#ifdef TOOL_DR_MEMORY
+/* bb_info_t.shadow_dead bit for the arithmetic flags */
+# define SHADOW_DEAD_AFLAGS (1U << NUM_LIVENESS_REGS)
+
+/* i#777: rather than a forward walk per instr, a single reverse walk over the
+ * app instrs records which GPRs, and whether all 6 arithmetic flags, are
+ * written before being read after each instr.  As in
+ * get_aflags_and_reg_liveness(), nothing is assumed dead across a cti, and
+ * we also stop at syscalls and interrupts since their param regs' shadow
+ * values are read on the side.
+ */
+void
+fastpath_shadow_liveness(instrlist_t *bb, bb_info_t *bi)
+{
+    instr_t *inst;
+    uint idx = 0;
+    uint dead = 0;
+    uint aflags_killed = 0; /* in EFLAGS_READ_* bits */
+    int r;
+    bi->num_shadow_dead = 0;
+    bi->app_instr_idx = 0;
+    bi->cur_shadow_dead = 0;
+    if (!options.elide_dead_shadow || !options.check_uninitialized)
+        return;
+    for (inst = instrlist_first_app(bb); inst != NULL; inst = instr_get_next_app(inst))
+        idx++;
+    bi->num_shadow_dead = (idx < MAX_SHADOW_LIVENESS_INSTRS) ? idx :
+        MAX_SHADOW_LIVENESS_INSTRS;
+    for (inst = instrlist_last(bb); inst != NULL; inst = instr_get_prev(inst)) {
+        uint eflags;
+        if (!instr_is_app(inst))
+            continue;
+        idx--;
+        if (idx < MAX_SHADOW_LIVENESS_INSTRS)
+            bi->shadow_dead[idx] = dead;
+        if (instr_is_cti(inst) || instr_is_syscall(inst) || instr_is_interrupt(inst)) {
+            dead = 0;
+            aflags_killed = 0;
+            continue;
+        }
+        eflags = instr_get_arith_flags(inst, DR_QUERY_DEFAULT);
+        aflags_killed |= EFLAGS_WRITE_TO_READ(eflags & EFLAGS_WRITE_6);
+        aflags_killed &= ~(eflags & EFLAGS_READ_6);
+        if (TESTALL(EFLAGS_READ_6, aflags_killed))
+            dead |= SHADOW_DEAD_AFLAGS;
+        else
+            dead &= ~SHADOW_DEAD_AFLAGS;
+        for (r = 0; r < NUM_LIVENESS_REGS; r++) {
+            reg_id_t reg = r + REG_START;
+            if (instr_reads_from_reg(inst, reg, DR_QUERY_DEFAULT))
+                dead &= ~(1U << r);
+            /* make sure we don't consider writes to sub-regs */
+            else if (instr_writes_to_exact_reg(inst, reg, DR_QUERY_DEFAULT))
+                dead |= (1U << r);
+        }
+    }
+    ASSERT(idx == 0, "app instr count mismatch");
+}
+
+/* Returns whether dst is a whole GPR whose shadow value will be overwritten
+ * before it is read.
+ */
+static bool
+shadow_dst_is_dead(fastpath_info_t *mi, opnd_info_t *dst)
+{
+    reg_id_t reg;
+    if (opnd_is_null(dst->shadow) || !opnd_is_reg(dst->app) ||
+        dst->indir_size != OPSZ_NA)
+        return false;
+    reg = opnd_get_reg(dst->app);
+    /* a sub-register write merges with the rest of the shadow value */
+    if (!reg_is_gpr(reg) || !reg_is_pointer_sized(reg))
+        return false;
+    return TEST(1U << (reg - REG_START), mi->bb->cur_shadow_dead);
+}
+
+/* Drops shadow writes to registers and eflags that are dead after inst.
+ * Returns whether eflags shadow should still be written.
+ */
+static bool
+elide_dead_shadow_writes(instr_t *inst, fastpath_info_t *mi)
+{
+    int i;
+    if (mi->bb->cur_shadow_dead == 0)
+        return true;
+    for (i = 0; i < MAX_FASTPATH_DSTS; i++) {
+        if (shadow_dst_is_dead(mi, &mi->dst[i])) {
+            LOG(4, "\teliding dead shadow write to dst %d\n", i);
+            mi->dst[i].shadow = opnd_create_null();
+            STATS_INC(dead_reg_shadow_elided);
+        }
+    }
+    if (TEST(SHADOW_DEAD_AFLAGS, mi->bb->cur_shadow_dead)) {
+#ifdef STATISTICS
+        if (TESTANY(EFLAGS_WRITE_6, instr_get_eflags(inst, DR_QUERY_INCLUDE_ALL)))
+            STATS_INC(dead_eflags_shadow_elided);
+#endif
+        return false;
+    }
+    return true;
+}
+#endif /* TOOL_DR_MEMORY */
+
 static void
 initialize_opnd_info(opnd_info_t *info)
 {
@@ -2058,6 +2161,83 @@ add_check_partial_undefined(void *drcontext, instrlist_t *bb, instr_t *inst,
  *   reg1, reg3, and reg3 can be any pointer-sized regs
  * Else, they should be a,b,c,d for 8-bit sub-reg
  */
+#if defined(TOOL_DR_MEMORY) && !defined(X64)
+/* Returns whether mi's memory reference is relative to the stack or frame
+ * pointer and so is a candidate for the -stack_xl8_cache translation.
+ */
+static bool
+use_stack_xl8_cache(fastpath_info_t *mi, instr_t *inst, reg_id_t reg1)
+{
+    reg_id_t base;
+    if (!options.stack_xl8_cache || inst == NULL || reg1 != mi->reg1.reg ||
+        !opnd_is_base_disp(mi->memop))
+        return false;
+    base = opnd_get_base(mi->memop);
+    return ((base == DR_REG_XSP || base == DR_REG_XBP) &&
+            opnd_get_index(mi->memop) == REG_NULL &&
+            opnd_get_segment(mi->memop) == REG_NULL);
+}
+
+/* Translates the app address in reg1 to its shadow address using the
+ * per-thread stack cache, falling back to the regular table lookup if the
+ * address is not in the cached 64K unit.  Since the cached base is
+ * 64K-aligned the result is identical to the table lookup's:
+ *    sub reg1, [base]
+ *    cmp reg1, unit
+ *    jae miss
+ *    shr reg1, 2
+ *    add reg1, [shadow]
+ *    jmp done
+ *  miss:
+ *    add reg1, [base]
+ *    <table lookup>
+ *  done:
+ */
+static void
+gen_stack_xl8_cache_lookup(void *drcontext, instrlist_t *bb, instr_t *inst,
+                           reg_id_t reg1, reg_id_t reg2)
+{
+    instr_t *miss = INSTR_CREATE_label(drcontext);
+    instr_t *done = INSTR_CREATE_label(drcontext);
+    PRE(bb, inst,
+        INSTR_CREATE_sub(drcontext, opnd_create_reg(reg1),
+                         opnd_create_stack_xl8_slot(false/*base*/)));
+    PRE(bb, inst,
+        INSTR_CREATE_cmp(drcontext, opnd_create_reg(reg1),
+                         OPND_CREATE_INT32(shadow_stack_xl8_unit())));
+    PRE(bb, inst,
+        INSTR_CREATE_jcc(drcontext, OP_jae_short, opnd_create_instr(miss)));
+    PRE(bb, inst,
+        INSTR_CREATE_shr(drcontext, opnd_create_reg(reg1), OPND_CREATE_INT8(2)));
+    PRE(bb, inst,
+        INSTR_CREATE_add(drcontext, opnd_create_reg(reg1),
+                         opnd_create_stack_xl8_slot(true/*shadow*/)));
+# ifdef STATISTICS
+    if (options.statistics) {
+        int disp;
+        ASSERT_TRUNCATE(disp, int, (ptr_int_t)&xl8_stack_hits);
+        disp = (int)(ptr_int_t)&xl8_stack_hits;
+        PRE(bb, inst, INSTR_CREATE_inc(drcontext, OPND_CREATE_MEM32(REG_NULL, disp)));
+    }
+# endif
+    PRE(bb, inst, INSTR_CREATE_jmp_short(drcontext, opnd_create_instr(done)));
+    PRE(bb, inst, miss);
+    PRE(bb, inst,
+        INSTR_CREATE_add(drcontext, opnd_create_reg(reg1),
+                         opnd_create_stack_xl8_slot(false/*base*/)));
+# ifdef STATISTICS
+    if (options.statistics) {
+        int disp;
+        ASSERT_TRUNCATE(disp, int, (ptr_int_t)&xl8_stack_misses);
+        disp = (int)(ptr_int_t)&xl8_stack_misses;
+        PRE(bb, inst, INSTR_CREATE_inc(drcontext, OPND_CREATE_MEM32(REG_NULL, disp)));
+    }
+# endif
+    shadow_gen_translation_addr(drcontext, bb, inst, reg1, reg2);
+    PRE(bb, inst, done);
+}
+#endif
+
 void
 add_shadow_table_lookup(void *drcontext, instrlist_t *bb, instr_t *inst,
                         fastpath_info_t *mi,
@@ -2147,7 +2327,13 @@ add_shadow_table_lookup(void *drcontext, instrlist_t *bb, instr_t *inst,
     }
 
     /* translate app address in r1 to shadow address in r1 */
-    shadow_gen_translation_addr(drcontext, bb, inst, reg1, reg2);
+#if defined(TOOL_DR_MEMORY) && !defined(X64)
+    if (use_stack_xl8_cache(mi, inst, reg1)) {
+        STATS_INC(xl8_stack_instrs);
+        gen_stack_xl8_cache_lookup(drcontext, bb, inst, reg1, reg2);
+    } else
+#endif
+        shadow_gen_translation_addr(drcontext, bb, inst, reg1, reg2);
 
     if (get_value) {
         /* load value from shadow table to reg1 */
@@ -3030,6 +3216,7 @@ instrument_fastpath(void *drcontext, instrlist_t *bb, instr_t *inst,
     opnd_t heap_unaddr_shadow = opnd_create_null();
     instr_t *marker1, *marker2;
     bool mark_defined;
+    bool write_eflags;
 #endif
     bool save_aflags;
 #ifdef TOOL_DR_MEMORY
@@ -4085,6 +4272,9 @@ instrument_fastpath(void *drcontext, instrlist_t *bb, instr_t *inst,
         }
     }
 
+    /* Skip shadow writes that are overwritten before they're read (i#777) */
+    write_eflags = elide_dead_shadow_writes(inst, mi);
+
     /* Combine sources and write result to the dests, including eflags.
      */
 
@@ -4144,8 +4334,12 @@ instrument_fastpath(void *drcontext, instrlist_t *bb, instr_t *inst,
             mi->src[0].offs = opnd_create_immed_int(0, OPSZ_1);
             add_dstX2_shadow_write(drcontext, bb, inst, mi, mi->src[0],
                                    effective_opsz, effective_opsz,
-                                   scratch, si, true, false);
+                                   scratch, si, write_eflags, false);
         }
+    } else if (opnd_is_null(mi->dst[0].shadow) && opnd_is_null(mi->dst[1].shadow) &&
+               (!write_eflags ||
+                !TESTANY(EFLAGS_WRITE_6, instr_get_eflags(inst, DR_QUERY_INCLUDE_ALL)))) {
+        /* every dst's shadow is dead so there is nothing to combine */
     } else if (mi->num_to_propagate == 1) {
         /* copy src shadow to eflags shadow and dst shadow */
         mark_scratch_reg_used(drcontext, bb, mi->bb, si);
@@ -4157,7 +4351,7 @@ instrument_fastpath(void *drcontext, instrlist_t *bb, instr_t *inst,
             mi->dst[0].offs = opnd_create_immed_int(0, OPSZ_1); /* for eflags */
         }
         add_dstX2_shadow_write(drcontext, bb, inst, mi, mi->src[0], mi->src_opsz,
-                               mi->opsz, scratch3, &mi->reg3, true, false);
+                               mi->opsz, scratch3, &mi->reg3, write_eflags, false);
         ASSERT(!mi->reg3.used || mi->reg3.reg != REG_NULL, "spill error");
     } else {
         /* combine the N sources and then write to the dest + eflags.
@@ -4243,7 +4437,7 @@ instrument_fastpath(void *drcontext, instrlist_t *bb, instr_t *inst,
         }
         add_dstX2_shadow_write(drcontext, bb, inst, mi, mi->src[0],
                                mi->src_opsz, mi->opsz, scratch3, &mi->reg3,
-                               true, alu_uncombined);
+                               write_eflags, alu_uncombined);
         ASSERT(!mi->reg3.used || mi->reg3.reg != REG_NULL, "spill error");
 
         /* FIXME: for insert_shadow_op() for shifts, need to
@@ -0,0 +1,223 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/* Dr. Memory: the memory debugger
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License, and no later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/***************************************************************************
+ * flush.c: Dr. Memory code cache flush scheduler
+ */
+
+#include "dr_api.h"
+#include "drmemory.h"
+#include "utils.h"
+#include "options.h"
+#include "flush.h"
+
+/* Once this many disjoint regions are pending for one kind we collapse them
+ * into their bounding region.  DR flushes at vm-area granularity anyway
+ * (DRi#373), so a larger region rarely costs much more.
+ */
+#define FLUSH_MAX_PENDING 16
+
+/* Regions closer than this are merged. */
+#define FLUSH_COALESCE_GAP PAGE_SIZE
+
+typedef struct _flush_region_t {
+    app_pc start;
+    app_pc end; /* open; POINTER_MAX for the rest of the address space */
+} flush_region_t;
+
+typedef struct _flush_queue_t {
+    flush_region_t region[FLUSH_MAX_PENDING];
+    uint num;
+} flush_queue_t;
+
+static void *flush_lock;
+static flush_queue_t pending[FLUSH_KIND_COUNT];
+/* Read without the lock by flush_safe_point() as a cheap filter */
+static volatile uint num_pending;
+static uint64 last_batch_time;
+
+#ifdef STATISTICS
+static uint flush_requests;
+static uint flush_coalesced;
+static uint flush_overflows;
+static uint flush_batches;
+static uint flush_regions_issued;
+#endif
+
+void
+flush_init(void)
+{
+    flush_lock = dr_mutex_create();
+}
+
+void
+flush_exit(void)
+{
+    /* We do not bother to issue anything still pending at exit. */
+    dr_mutex_destroy(flush_lock);
+}
+
+#ifdef STATISTICS
+void
+flush_dump_statistics(file_t f)
+{
+    dr_fprintf(f, "flush requests: %6u, coalesced: %6u, overflows: %4u\n",
+               flush_requests, flush_coalesced, flush_overflows);
+    dr_fprintf(f, "flush batches: %6u, regions issued: %6u\n",
+               flush_batches, flush_regions_issued);
+}
+#endif
+
+static inline app_pc
+pad_end(app_pc end)
+{
+    if ((ptr_uint_t)end > POINTER_MAX - FLUSH_COALESCE_GAP)
+        return (app_pc) POINTER_MAX;
+    return end + FLUSH_COALESCE_GAP;
+}
+
+static inline bool
+regions_near(app_pc start1, app_pc end1, app_pc start2, app_pc end2)
+{
+    return start1 <= pad_end(end2) && start2 <= pad_end(end1);
+}
+
+/* Caller must hold flush_lock. */
+static void
+flush_queue_add(flush_queue_t *q, app_pc start, app_pc end)
+{
+    uint i, j;
+    for (i = 0; i < q->num; i++) {
+        flush_region_t *r = &q->region[i];
+        if (regions_near(start, end, r->start, r->end)) {
+            STATS_INC(flush_coalesced);
+            if (start < r->start)
+                r->start = start;
+            if (end > r->end)
+                r->end = end;
+            /* The grown region may now reach others: fold them in. */
+            for (j = i + 1; j < q->num; ) {
+                flush_region_t *o = &q->region[j];
+                if (regions_near(r->start, r->end, o->start, o->end)) {
+                    if (o->start < r->start)
+                        r->start = o->start;
+                    if (o->end > r->end)
+                        r->end = o->end;
+                    q->region[j] = q->region[--q->num];
+                } else
+                    j++;
+            }
+            return;
+        }
+    }
+    if (q->num < FLUSH_MAX_PENDING) {
+        q->region[q->num].start = start;
+        q->region[q->num].end = end;
+        q->num++;
+        return;
+    }
+    STATS_INC(flush_overflows);
+    for (i = 0; i < q->num; i++) {
+        if (q->region[i].start < start)
+            start = q->region[i].start;
+        if (q->region[i].end > end)
+            end = q->region[i].end;
+    }
+    q->region[0].start = start;
+    q->region[0].end = end;
+    q->num = 1;
+}
+
+void
+flush_schedule(app_pc start, size_t size, flush_kind_t kind)
+{
+    app_pc end;
+    ASSERT(kind < FLUSH_KIND_COUNT, "invalid flush kind");
+    if (size > POINTER_MAX - (ptr_uint_t)start)
+        end = (app_pc) POINTER_MAX;
+    else
+        end = start + size;
+    LOG(3, "flush requested: "PFX"-"PFX" kind %d\n", start, end, kind);
+    dr_mutex_lock(flush_lock);
+    STATS_INC(flush_requests);
+    flush_queue_add(&pending[kind], start, end);
+    num_pending = pending[FLUSH_DELAY].num + pending[FLUSH_UNLINK].num;
+    dr_mutex_unlock(flush_lock);
+    /* FLUSH_UNLINK requesters are in a clean call by contract. */
+    flush_safe_point(kind == FLUSH_UNLINK);
+}
+
+void
+flush_safe_point(bool unlink_safe)
+{
+    flush_region_t batch[FLUSH_KIND_COUNT][FLUSH_MAX_PENDING];
+    uint num[FLUSH_KIND_COUNT] = {0,};
+    uint64 now;
+    uint i;
+    if (num_pending == 0)
+        return;
+    now = dr_get_milliseconds();
+    if (now - last_batch_time < options.flush_min_interval)
+        return;
+    dr_mutex_lock(flush_lock);
+    /* Re-check: another thread may have just issued a batch. */
+    if (now - last_batch_time >= options.flush_min_interval) {
+        flush_kind_t kind;
+        for (kind = FLUSH_DELAY; kind < FLUSH_KIND_COUNT; kind++) {
+            if (kind == FLUSH_UNLINK && !unlink_safe)
+                continue;
+            num[kind] = pending[kind].num;
+            memcpy(batch[kind], pending[kind].region, num[kind] * sizeof(batch[0][0]));
+            pending[kind].num = 0;
+        }
+        if (num[FLUSH_DELAY] + num[FLUSH_UNLINK] > 0)
+            last_batch_time = now;
+        num_pending = pending[FLUSH_DELAY].num + pending[FLUSH_UNLINK].num;
+    }
+    dr_mutex_unlock(flush_lock);
+
+    /* Issue outside the lock: neither call waits for other threads, but
+     * there is no reason to make other requesters wait on us.
+     */
+    if (num[FLUSH_DELAY] + num[FLUSH_UNLINK] == 0)
+        return;
+    STATS_INC(flush_batches);
+    for (i = 0; i < num[FLUSH_DELAY]; i++) {
+        IF_DEBUG(bool ok =)
+            dr_delay_flush_region(batch[FLUSH_DELAY][i].start,
+                                  batch[FLUSH_DELAY][i].end -
+                                  batch[FLUSH_DELAY][i].start, 0, NULL);
+        ASSERT(ok, "delayed flush failed");
+        LOG(2, "flushing (delayed) "PFX"-"PFX"\n",
+            batch[FLUSH_DELAY][i].start, batch[FLUSH_DELAY][i].end);
+        STATS_INC(flush_regions_issued);
+    }
+    for (i = 0; i < num[FLUSH_UNLINK]; i++) {
+        IF_DEBUG(bool ok =)
+            dr_unlink_flush_region(batch[FLUSH_UNLINK][i].start,
+                                   batch[FLUSH_UNLINK][i].end -
+                                   batch[FLUSH_UNLINK][i].start);
+        ASSERT(ok, "unlink flush failed");
+        LOG(2, "flushing (unlink) "PFX"-"PFX"\n",
+            batch[FLUSH_UNLINK][i].start, batch[FLUSH_UNLINK][i].end);
+        STATS_INC(flush_regions_issued);
+    }
+}
@@ -0,0 +1,78 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/* Dr. Memory: the memory debugger
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License, and no later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/***************************************************************************
+ * flush.h: Dr. Memory code cache flush scheduler
+ *
+ * Features that re-instrument code at runtime queue their flushes here
+ * rather than calling DR directly.  Pending regions are coalesced and
+ * issued in batches no more often than -flush_min_interval, which avoids
+ * flush storms when many requests arrive close together.
+ *
+ * The flushes drwrap issues when the heap code wraps or replaces routines
+ * in an already-executed module do not come through here: drwrap makes
+ * them itself, and they must take effect before the routine runs again
+ * or allocations would be missed.
+ */
+
+#ifndef _FLUSH_H_
+#define _FLUSH_H_ 1
+
+#include "utils.h"
+
+typedef enum {
+    /* Issued via dr_delay_flush_region(): may be requested from any context,
+     * including fault handlers.
+     */
+    FLUSH_DELAY,
+    /* Issued via dr_unlink_flush_region(), which also unlinks so that a loop
+     * in the target code exits the cache promptly.  May only be requested
+     * from a clean call.
+     */
+    FLUSH_UNLINK,
+    FLUSH_KIND_COUNT,
+} flush_kind_t;
+
+void
+flush_init(void);
+
+void
+flush_exit(void);
+
+#ifdef STATISTICS
+void
+flush_dump_statistics(file_t f);
+#endif
+
+/* Queues [start, start+size) for flushing.  The flush may be issued before
+ * this returns or at a later safe point.
+ */
+void
+flush_schedule(app_pc start, size_t size, flush_kind_t kind);
+
+/* Issues any pending flushes whose rate limit has expired.  unlink_safe
+ * indicates that the caller is in a clean call or syscall event, where
+ * FLUSH_UNLINK regions may be issued.  Cheap when nothing is pending.
+ */
+void
+flush_safe_point(bool unlink_safe);
+
+#endif /* _FLUSH_H_ */
@@ -27,6 +27,8 @@
 enum {
     NUDGE_LEAK_SCAN = 0, /* drmemory.pl assumes this is 0 */
     NUDGE_TERMINATE,
+    NUDGE_MEMORY_REPORT,
+    NUDGE_COVERAGE_DUMP,
 };
 
 #endif /* _FRONTEND_H_ */
@@ -163,6 +163,9 @@ instrument_fragment_delete(void *drcontext/*may be NULL*/, void *tag)
         for (i = 0; i < bb_size; i++) {
             hashtable_remove(&xl8_sharing_table, (void *)(start + i));
         }
+#ifdef TOOL_DR_MEMORY
+        slowpath_fragment_delete(drcontext, start, bb_size);
+#endif
     }
 
 #ifdef X86
@@ -545,6 +545,10 @@ options_init(const char *opstr)
         if (!ALIGNED(options.redzone_size, IF_X64_ELSE(16,8)))
             usage_error("redzone size must be " IF_X64_ELSE("16","8") "-aligned", "");
     }
+    if (option_specified.coverage_dump_freq)
+        options.coverage_bitmap = true;
+    if (options.coverage_bitmap)
+        options.coverage = true;
     if (option_specified.fuzz ||
         option_specified.fuzz_module ||
         option_specified.fuzz_function ||
@@ -592,11 +596,28 @@ options_init(const char *opstr)
             usage_error("-fuzz_corpus_out requires -fuzz_corpus", "");
     }
 
+    if (options.redzone_adaptive) {
+        if (!options.replace_malloc)
+            usage_error("-redzone_adaptive requires -replace_malloc", "");
+        if (options.pattern != 0)
+            usage_error("-redzone_adaptive cannot be used with pattern mode", "");
+        if (!ALIGNED(options.redzone_adaptive_min, IF_X64_ELSE(16,8))) {
+            usage_error("-redzone_adaptive_min must be "
+                        IF_X64_ELSE("16","8") "-aligned", "");
+        }
+        if (options.redzone_adaptive_max < options.redzone_adaptive_min) {
+            usage_error("-redzone_adaptive_max must be at least -redzone_adaptive_min",
+                        "");
+        }
+    }
     if (options.replace_malloc) {
         options.replace_realloc = false; /* no need for it */
         /* whole header is in redzone, but supports redzone being smaller than header */
         options.size_in_redzone = false;
-        if (options.pattern == 0) {
+        if (options.redzone_adaptive) {
+            /* the shared redzone is the minimum: larger mallocs are padded */
+            options.redzone_size = options.redzone_adaptive_min;
+        } else if (options.pattern == 0) {
             /* for non-pattern we share redzones, so *2 to get equiv on each side */
             options.redzone_size *= 2;
         }
@@ -623,6 +644,12 @@ options_init(const char *opstr)
         options.check_stack_access = true;
         options.check_alignment = true;
     }
+#if defined(X64) || !defined(X86)
+    /* x64 translation is a mask, add, and shift with no table load to avoid */
+    options.stack_xl8_cache = false;
+#endif
+    if (!options.shadowing || options.num_spill_slots == 0)
+        options.stack_xl8_cache = false;
 # ifdef WINDOWS
     if (options.visual_studio) {
         /* Allow earlier options to override by checking all for whether specified.
@@ -686,6 +713,9 @@ options_init(const char *opstr)
     if (options.persist_code && !persistence_supported())
         usage_error("currently -persist_code only supports -light or "
                     "-no_check_uninitialized", "");
+    /* Blocks loaded from a persisted cache raise no bb event to record them */
+    if (options.persist_code && options.coverage_bitmap)
+        usage_error("-coverage_bitmap cannot be used with -persist_code", "");
     /* N.B.: avoid any NOTIFY messages here as they will not honor -quiet: place them
      * in dr_init() underneath the version printout.
      */
@@ -180,6 +180,9 @@ OPTION_CLIENT(client, prefix_style, uint, 0, 0, 2,
 OPTION_CLIENT_BOOL(client, log_suppressed_errors, false,
                    "Log suppressed error reports for postprocessing.",
                    "Log suppressed error reports for postprocessing.  Enabling this option will increase the logfile size, but will allow users to re-process suppressed reports with alternate suppressions or additional symbols.")
+OPTION_CLIENT_BOOL(internal, suppress_by_offset, true,
+                   "Match suppressions by module offset before symbolizing",
+                   "Before symbolizing a new error's callstack, try to match it against the suppressions using module offsets alone.  Each mod!func suppression frame is resolved to the address ranges of its matching symbols the first time it is compared against a module.  Only callstacks that are found to be suppressed skip symbolization; anything else is symbolized and matched as usual.  Disabled by -log_suppressed_errors.")
 #endif
 OPTION_CLIENT_BOOL(client, ignore_asserts, false,
                    "Do not abort on debug-build asserts",
@@ -428,6 +431,24 @@ OPTION_CLIENT_SCOPE(drmemscope, stack_swap_threshold, int, 0x9000, 256, INT_MAX,
 OPTION_CLIENT_SCOPE(drmemscope, redzone_size, uint, 16, 0, 32*1024,
                     "Buffer on either side of each malloc",
                     "Buffer on either side of each malloc.  This should be a multiple of 8 for 32-bit and 16 for 64-bit.")
+OPTION_CLIENT_BOOL(drmemscope, redzone_adaptive, false,
+                   "Size each malloc's redzone in proportion to its size",
+                   "Only applies with -replace_malloc.  Replaces the fixed redzone shared between adjacent mallocs with a smaller one of -redzone_adaptive_min bytes, and pads the end of each malloc beyond that in proportion to its requested size (see -redzone_adaptive_scale), up to -redzone_adaptive_max bytes.  Small allocations thus use less memory while large ones gain protection against overflows that skip past a fixed-size redzone.  Allocation callstacks that make -redzone_adaptive_quiet allocations without any redzone error lose their padding.  Per-callstack tuning requires allocation callstacks, which -count_leaks provides by default.")
+OPTION_CLIENT_SCOPE(drmemscope, redzone_adaptive_min, uint, 16, 0, 32*1024,
+                    "Minimum redzone between mallocs for -redzone_adaptive",
+                    "For -redzone_adaptive, the redzone shared between adjacent mallocs, in place of -redzone_size.  This should be a multiple of 8 for 32-bit and 16 for 64-bit.  Each malloc's header also lies in this space, so the gap between mallocs is never smaller than the header: 16 bytes for 32-bit and 32 bytes for 64-bit.")
+OPTION_CLIENT_SCOPE(drmemscope, redzone_adaptive_max, uint, 1024, 0, 16*1024,
+                    "Maximum trailing redzone for -redzone_adaptive",
+                    "Maximum trailing redzone size, in bytes, for -redzone_adaptive.")
+OPTION_CLIENT_SCOPE(drmemscope, redzone_adaptive_scale, uint, 8, 1, UINT_MAX,
+                    "Requested bytes per trailing redzone byte for -redzone_adaptive",
+                    "For -redzone_adaptive, the trailing redzone is sized to the requested size divided by this value, bounded by -redzone_adaptive_min and -redzone_adaptive_max.")
+OPTION_CLIENT_SCOPE(drmemscope, redzone_adaptive_quiet, uint, 4096, 0, UINT_MAX,
+                    "Allocations before an error-free callstack loses its extra redzone",
+                    "For -redzone_adaptive, the number of allocations an allocation callstack may make without any redzone error before its allocations only receive the -redzone_adaptive_min redzone.  0 means callstacks never lose their padding.")
+OPTION_CLIENT_BOOL(drmemscope, realloc_in_place, false,
+                   "Grow reallocations in place when possible",
+                   "Only applies with -replace_malloc.  When a realloc grows an allocation whose following memory is free (and not in the delayed free list) or unused, the allocation is extended in place rather than moved, avoiding a copy.  This is off by default because a growing realloc that moves places the old region in the delayed free list, so that accesses through a stale pointer to it are reported as use-after-free errors, while growing in place leaves such a pointer valid.")
 OPTION_CLIENT_SCOPE(drmemscope, report_max, int, 20000, -1, INT_MAX,
                     "Maximum non-leak errors to report (-1=no limit)",
                     "Maximum non-leak errors to report (-1=no limit).  This includes 'potential' errors listed separately.")
@@ -482,9 +503,33 @@ OPTION_CLIENT_SCOPE(drmemscope, delay_frees, uint, 2000, 0, UINT_MAX,
 OPTION_CLIENT_SCOPE(drmemscope, delay_frees_maxsz, uint, 20000000, 0, UINT_MAX,
                     "Maximum size of frees to delay before committing",
                     "Maximum size of frees to delay before committing.  The larger this number, the greater the likelihood that "TOOLNAME" will identify use-after-free errors.  However, the larger this number, the more memory will be used.  This value is separate for each set of allocation routines and each Windows Heap.")
+OPTION_CLIENT_SCOPE(drmemscope, quarantine_rss_limit, uint, 0, 0, UINT_MAX,
+                    "Process memory limit in MB that delayed frees adapt to (0=none)",
+                    "If non-zero, "TOOLNAME" monitors the process's resident memory and, when it nears this many megabytes, progressively lowers the amount of delayed-free memory (see -delay_frees_maxsz) and the largest free that is delayed, releasing the oldest delayed frees first.  The limits grow back once memory usage drops.  A minimum amount of memory remains delayed so that use-after-free detection is retained.  The average time frees spend delayed is included in the memory report (see -memory_report_freq).")
 OPTION_CLIENT_BOOL(drmemscope, delay_frees_stack, true,
                    "Record callstacks on free to use when reporting use-after-free",
                    "Record callstacks on free to use when reporting use-after-free or other errors that overlap with freed objects.  There is a slight performance hit incurred by this feature for malloc-intensive applications.  The callstack size is controlled by -free_max_frames.")
+OPTION_CLIENT_SCOPE(drmemscope, memory_report_freq, uint, 0, 0, UINT_MAX,
+                    "Seconds between tool memory reports (0=never)",
+                    "If non-zero, "TOOLNAME" periodically writes a report of its own memory usage to the global log file: shadow memory by type, callstack tables, the delayed-free queue, per-basic-block data, the total tool heap, and memory owned by DynamoRIO itself (its heap and code caches).  The same report can be requested at any time by nudging with code 2.")
+OPTION_CLIENT_SCOPE(drmemscope, memory_cap_shadow, uint, 0, 0, UINT_MAX,
+                    "Shadow memory limit in MB for the memory report (0=none)",
+                    "When the private shadow memory exceeds this many megabytes, a warning and a memory report are emitted.  Checked every -memory_report_freq seconds, or every 10 seconds if that is 0.")
+OPTION_CLIENT_SCOPE(drmemscope, memory_cap_callstack, uint, 0, 0, UINT_MAX,
+                    "Callstack memory limit in MB for the memory report (0=none)",
+                    "When memory used for callstacks exceeds this many megabytes, a warning and a memory report are emitted.  Checked every -memory_report_freq seconds, or every 10 seconds if that is 0.")
+OPTION_CLIENT_SCOPE(drmemscope, memory_cap_quarantine, uint, 0, 0, UINT_MAX,
+                    "Delayed-free memory limit in MB for the memory report (0=none)",
+                    "When memory held by delayed frees exceeds this many megabytes, a warning and a memory report are emitted.  Checked every -memory_report_freq seconds, or every 10 seconds if that is 0.")
+OPTION_CLIENT_SCOPE(drmemscope, memory_cap_perbb, uint, 0, 0, UINT_MAX,
+                    "Per-basic-block memory limit in MB for the memory report (0=none)",
+                    "When memory used for per-basic-block data exceeds this many megabytes, a warning and a memory report are emitted.  Checked every -memory_report_freq seconds, or every 10 seconds if that is 0.")
+OPTION_CLIENT_SCOPE(drmemscope, memory_cap_heap, uint, 0, 0, UINT_MAX,
+                    "Total tool heap limit in MB for the memory report (0=none)",
+                    "When "TOOLNAME"'s total heap usage exceeds this many megabytes, a warning and a memory report are emitted.  Checked every -memory_report_freq seconds, or every 10 seconds if that is 0.")
+OPTION_CLIENT_SCOPE(drmemscope, memory_cap_dr, uint, 0, 0, UINT_MAX,
+                    "DynamoRIO memory limit in MB for the memory report (0=none)",
+                    "When memory owned by DynamoRIO itself (its heap, which includes the tool heap, and its code caches) exceeds this many megabytes, a warning and a memory report are emitted.  Checked every -memory_report_freq seconds, or every 10 seconds if that is 0.")
 OPTION_CLIENT_BOOL(drmemscope, leaks_only, false,
                    "Check only for leaks and not memory access errors",
                    "Puts "TOOLNAME" into a leak-check-only mode that has lower overhead but does not detect other types of errors other than invalid frees.")
@@ -560,6 +605,12 @@ OPTION_CLIENT_BOOL(drmemscope, syscall_dword_granularity, true,
 OPTION_CLIENT_BOOL(drmemscope, syscall_sentinels, false,
                    "Use sentinels to detect writes on unknown syscalls.",
                    "Use sentinels to detect writes on unknown syscalls and reduce false positives, in particular for uninitialized reads.  Can potentially result in incorrect behavior if definedness information is incorrect or application threads read syscall parameter info simultaneously.  This option requires -analyze_unknown_syscalls to be enabled.")
+OPTION_CLIENT(drmemscope, unknown_syscall_cache_threshold, uint, 8, 0, UINT_MAX,
+              "Cache unknown syscall output layouts after this many consistent observations",
+              "For unknown syscall comparisons (-analyze_unknown_syscalls), once the same output parameter bytes have been written by this many consecutive successful invocations of a system call (or ioctl request code), that layout is cached and further invocations skip the memory comparison.  When -use_symcache is enabled, the cached layouts are saved in -symcache_dir and re-used by future runs.  A value of 0 disables caching.")
+OPTION_CLIENT_BOOL(drmemscope, filter_syscalls, true,
+                   "Only intercept system calls that need processing",
+                   "At initialization time, identify the system calls that need no processing by any enabled component (no parameters to check, and no allocation, thread, or perturbation tracking) and do not intercept them, avoiding the pre- and post-system call cost.  In the default mode, which shadows memory definedness, only system calls that take no parameters at all, such as getpid and sched_yield, are skipped, so common system calls like futex are still intercepted.  Unknown system calls are always intercepted.  Has no effect on Windows, where all system calls are currently intercepted.")
 /* for chromium we need to ignore malloc_usable_size, and for most windows
  * uses it doesn't exist, so we have this on by default (xref i#314, i#320)
  */
@@ -614,6 +665,12 @@ OPTION_CLIENT_STRING(drmemscope, syscall_number_path, "",
 OPTION_CLIENT_BOOL(drmemscope, coverage, false,
                    "Measure and provide code coverage information",
                    "Measure code coverage during application execution.  The resulting data is written to a separate file named with a 'drcov' prefix in the same directory as Dr. Memory's other results files.  The raw data can be turned into a human-readable format using the drcov2lcov utility.")
+OPTION_CLIENT_BOOL(drmemscope, coverage_bitmap, false,
+                   "Collect code coverage as compact per-module bitmaps",
+                   "Implies -coverage.  Rather than drcov data, code coverage is kept in a bitmap of covered code bytes per module, which is filled in when code is first seen and so adds no cost to executing it.  Newly covered code is appended to a file named coverage.<pid>.cov in the same directory as "TOOLNAME"'s other results files at exit, on a nudge with code 0 or 3, and periodically per -coverage_dump_freq, so that most coverage survives a process that is killed.  The covmerge utility combines any number of these files and can list the covered ranges.")
+OPTION_CLIENT_SCOPE(drmemscope, coverage_dump_freq, uint, 0, 0, UINT_MAX,
+                    "Seconds between incremental coverage dumps (0=never)",
+                    "Implies -coverage_bitmap.  If non-zero, newly covered code is appended to the coverage file at this interval in addition to the dumps at exit and on a nudge.")
 OPTION_CLIENT_BOOL(drmemscope, fuzz, false,
                    "Enable fuzzing by Dr. Memory",
                    "Enable fuzzing by Dr. Memory.  See the other fuzz_* options for all of the different fuzzing options.")
@@ -786,6 +843,9 @@ OPTION_CLIENT_BOOL(internal, use_stderr, true,
 OPTION_CLIENT_BOOL(internal, shadowing, true,
                    "Enable memory shadowing",
                    "For debugging and -leaks_only and -perturb_only modes: can disable all shadowing and do nothing but track mallocs")
+OPTION_CLIENT(internal, shadow_fault_batch, uint, 8, 0, 4096,
+              "Shadow blocks created per on-touch shadow fault",
+              "When a shadow fault creates shadow memory on first touch, also create it for up to this many following blocks of the same application mapping, in one allocation, to avoid a fault per block when a large new region is touched in order.  0 or 1 creates only the faulting block.  Only used on 64-bit Linux and Mac.")
 OPTION_CLIENT_BOOL(internal, track_allocs, true,
                    "Enable malloc and alloc syscall tracking",
                    "for debugging and -leaks_only and -perturb_only modes: can disable all malloc and alloc syscall tracking")
@@ -876,6 +936,17 @@ OPTION_CLIENT(internal, share_xl8_max_diff, uint, 2048, 0, SHADOW_REDZONE_SIZE*4
 OPTION_CLIENT(internal, share_xl8_max_flushes, uint, 64, 0, UINT_MAX,
               "How many flushes before abandoning sharing altogether",
               "How many flushes before abandoning sharing altogether")
+/* XXX: off until the liveness analysis has more coverage in the test suite */
+OPTION_CLIENT_BOOL(internal, elide_dead_shadow, false,
+                   "Skip shadow writes to registers and eflags that are dead",
+                   "Uses a per-basic-block liveness analysis to skip propagating shadow values to whole general-purpose registers and to the arithmetic flags when they are overwritten later in the same block before being read.")
+/* XXX: off until we have numbers showing it wins over the table lookup */
+OPTION_CLIENT_BOOL(internal, stack_xl8_cache, false,
+                   "Cache each thread's stack shadow translation for xsp/xbp-based refs",
+                   "For 32-bit only: keeps the shadow address of the 64K unit containing the current thread's stack in a TLS slot and translates xsp- and xbp-based memory references against it with a subtract, compare, and add instead of the shadow table lookup.  References outside the cached unit use the regular lookup.  The cache is refreshed from the slowpath.")
+OPTION_CLIENT(internal, flush_min_interval, uint, 50, 0, UINT_MAX,
+              "Minimum milliseconds between batches of code cache flushes",
+              "Code cache flushes requested at runtime (e.g., when abandoning translation sharing or switching pattern-mode check styles) are coalesced by region and issued in batches at most once per this many milliseconds.  0 issues each request as soon as it is made.")
 OPTION_CLIENT_BOOL(internal, check_memset_unaddr, true,
                    "Check for in-heap unaddr in memset",
                    "Check for in-heap unaddr in memset")
@@ -37,6 +37,7 @@
 #include "redblack.h"
 #include "report.h"
 #include "alloc_drmem.h"
+#include "flush.h"
 
 #ifdef UNIX
 # include <signal.h> /* for SIGSEGV */
@@ -926,7 +927,7 @@ pattern_switch_instrumentation_style(void)
         if (num_2byte_faults >= options.pattern_max_2byte_faults) {
             pattern_4byte_check_only = true;
             num_2byte_faults = 0;
-            dr_delay_flush_region(0, (size_t)-1, 0, NULL);
+            flush_schedule(0, (size_t)-1, FLUSH_DELAY);
         }
         dr_mutex_unlock(flush_lock);
     }
@@ -994,6 +995,8 @@ pattern_handle_ill_fault(void *drcontext,
         /* 2-byte checks caused too many faults, switch instrumentation style */
         pattern_switch_instrumentation_style();
     }
+    /* The switch's flush may have been deferred by the rate limit. */
+    flush_safe_point(false/*fault context: no unlink*/);
     IF_ARM(dr_set_isa_mode(drcontext, old_mode, NULL));
     return true;
 }
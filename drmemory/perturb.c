@@ -292,6 +292,27 @@ perturb_pre_synch_syscall(void)
  * Insert delays before synch-related syscalls
  */
 
+/* Returns whether perturb_pre_syscall() needs to see sysnum */
+bool
+perturb_syscall_filter(int sysnum)
+{
+#ifdef UNIX
+    switch (sysnum) {
+# ifdef LINUX
+    case SYS_clone:
+    case SYS_futex:
+# endif
+    case SYS_fork:
+        return true;
+    default:
+        return false;
+    }
+#else
+    /* we do not filter syscalls on Windows */
+    return true;
+#endif
+}
+
 bool
 perturb_pre_syscall(void *drcontext, int sysnum)
 {
@@ -56,6 +56,9 @@ perturb_module_load(void *drcontext, const module_data_t *info, bool loaded);
 void
 perturb_pre_fork(void);
 
+bool
+perturb_syscall_filter(int sysnum);
+
 bool
 perturb_pre_syscall(void *drcontext, int sysnum);
 
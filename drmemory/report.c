@@ -1231,6 +1231,15 @@ typedef struct _per_callstack_module_t {
     bool on_whitelist;
     bool in_tool;
     bool on_check_uninit_blacklist;
+#ifdef USE_DRSYMS
+    /* For suppression matching by module offset.  The path is owned by the
+     * callstack module table and outlives this struct.  The table maps function
+     * patterns to supp_ranges_t and is filled in lazily.
+     */
+    const char *path;
+    bool supp_ranges_initialized;
+    hashtable_t supp_ranges;
+#endif
 } per_callstack_module_t;
 
 static void *
@@ -1252,6 +1261,10 @@ callstack_module_load_cb(const char *path, const char *modname, byte *base)
         (modname != NULL && options.check_uninit_blacklist[0] != '\0' &&
          text_matches_any_pattern(modname, options.check_uninit_blacklist,
                                   FILESYS_CASELESS));
+#ifdef USE_DRSYMS
+    mod->path = path;
+    mod->supp_ranges_initialized = false;
+#endif
     LOG(1, "%s: %s => black=%d white=%d uninit=%d\n", __FUNCTION__, path,
         mod->on_blacklist, mod->on_whitelist, mod->on_check_uninit_blacklist);
     return (void *) mod;
@@ -1261,6 +1274,10 @@ static void
 callstack_module_unload_cb(const char *path, void *data)
 {
     per_callstack_module_t *mod = (per_callstack_module_t *) data;
+#ifdef USE_DRSYMS
+    if (mod->supp_ranges_initialized)
+        hashtable_delete(&mod->supp_ranges);
+#endif
     global_free(mod, sizeof(*mod), HEAPSTAT_CALLSTACK);
 
     if (!report_exited) {
@@ -1271,6 +1288,418 @@ callstack_module_unload_cb(const char *path, void *data)
     }
 }
 
+#ifdef USE_DRSYMS
+/***************************************************************************
+ * Suppression matching by module offset
+ *
+ * Symbolizing a callstack is expensive, and runs that suppress many distinct
+ * callstacks spend most of their reporting time symbolizing stacks only to
+ * throw them away.  Here we try to match a packed callstack against the
+ * suppressions first.  Each function pattern in a mod!func frame is resolved,
+ * the first time it is compared against a module, to the sorted module offset
+ * ranges of the symbols matching it, so a frame comparison is an interval
+ * lookup.  The matchers below mirror top_frame_matches_suppression_frame()
+ * and stack_matches_suppression() but return PRESYM_UNKNOWN whenever the
+ * answer depends on something we do not have without symbolizing.  Only a
+ * definite match is acted upon: everything else falls back to the regular
+ * symbolize-and-match path.
+ */
+
+typedef enum {
+    PRESYM_NO_MATCH,
+    PRESYM_MATCH,
+    PRESYM_UNKNOWN,
+} presym_match_t;
+
+typedef struct _supp_range_t {
+    size_t start;
+    size_t end; /* open-ended */
+} supp_range_t;
+
+typedef struct _supp_ranges_t {
+    supp_range_t *ranges; /* sorted and merged once resolved */
+    uint num;
+    uint capacity;
+    /* Set when some matching symbol could be named differently by
+     * symbolization or has an unknown extent: all lookups are then unknown.
+     */
+    bool incomplete;
+    const char *pattern;
+} supp_ranges_t;
+
+typedef struct _presym_frame_t {
+    bool is_syscall;
+    const char *modname; /* NULL if not in a module */
+    per_callstack_module_t *mod;
+    size_t modoffs;
+    size_t sym_modoffs;
+} presym_frame_t;
+
+static bool suppress_by_offset;
+static uint num_suppressions_by_offset;
+
+/* A broad wildcard can match a large part of a module's symbols.  Resolving
+ * it happens under error_lock, so past this many matches we stop the search
+ * and leave the pattern to symbolization.
+ */
+#define SUPP_RANGES_MAX 1024
+
+static void
+supp_ranges_free(void *p)
+{
+    supp_ranges_t *sr = (supp_ranges_t *) p;
+    if (sr->ranges != NULL)
+        global_free(sr->ranges, sr->capacity * sizeof(*sr->ranges), HEAPSTAT_REPORT);
+    global_free(sr, sizeof(*sr), HEAPSTAT_REPORT);
+}
+
+static bool
+supp_ranges_add_cb(drsym_info_t *info, drsym_error_t status, void *data)
+{
+    supp_ranges_t *sr = (supp_ranges_t *) data;
+    /* Re-check the name as the search may be case-insensitive (dbghelp) */
+    if (info->name == NULL ||
+        !text_matches_pattern(info->name, sr->pattern, false/*consider case*/))
+        return true; /* keep iterating */
+    if (info->end_offs <= info->start_offs ||
+        /* symbolization truncates names, which could change the match */
+        info->name_available_size >= MAX_FUNC_LEN) {
+        LOG(2, "%s: %s has no usable extent or name => unknown\n",
+            __FUNCTION__, info->name);
+        sr->incomplete = true;
+        return false; /* stop iterating */
+    }
+    if (sr->num >= SUPP_RANGES_MAX) {
+        LOG(2, "%s: %s matches over %d symbols => unknown\n",
+            __FUNCTION__, sr->pattern, SUPP_RANGES_MAX);
+        sr->incomplete = true;
+        return false; /* stop iterating */
+    }
+    if (sr->num == sr->capacity) {
+        uint new_cap = (sr->capacity == 0) ? 4 : sr->capacity * 2;
+        supp_range_t *grown = (supp_range_t *)
+            global_alloc(new_cap * sizeof(*grown), HEAPSTAT_REPORT);
+        if (sr->ranges != NULL) {
+            memcpy(grown, sr->ranges, sr->num * sizeof(*grown));
+            global_free(sr->ranges, sr->capacity * sizeof(*sr->ranges),
+                        HEAPSTAT_REPORT);
+        }
+        sr->ranges = grown;
+        sr->capacity = new_cap;
+    }
+    sr->ranges[sr->num].start = info->start_offs;
+    sr->ranges[sr->num].end = info->end_offs;
+    sr->num++;
+    return true; /* keep iterating */
+}
+
+/* Sorts by start with an insertion sort (the lists are short and nearly
+ * sorted already) and merges overlapping ranges.
+ */
+static void
+supp_ranges_finalize(supp_ranges_t *sr)
+{
+    uint i, j, merged;
+    for (i = 1; i < sr->num; i++) {
+        supp_range_t cur = sr->ranges[i];
+        for (j = i; j > 0 && sr->ranges[j-1].start > cur.start; j--)
+            sr->ranges[j] = sr->ranges[j-1];
+        sr->ranges[j] = cur;
+    }
+    merged = 0;
+    for (i = 0; i < sr->num; i++) {
+        if (merged > 0 && sr->ranges[i].start <= sr->ranges[merged-1].end) {
+            if (sr->ranges[i].end > sr->ranges[merged-1].end)
+                sr->ranges[merged-1].end = sr->ranges[i].end;
+        } else
+            sr->ranges[merged++] = sr->ranges[i];
+    }
+    sr->num = merged;
+}
+
+/* Returns the resolved ranges for pattern in mod, resolving them on first use.
+ * Caller must hold error_lock.  The symbol search then runs under the lock,
+ * as symbolization for matching does, but only once per module and pattern,
+ * and it stops at SUPP_RANGES_MAX matches.
+ */
+static supp_ranges_t *
+supp_ranges_lookup(per_callstack_module_t *mod, const char *pattern)
+{
+    supp_ranges_t *sr;
+    ASSERT(dr_mutex_self_owns(error_lock), "caller must hold error lock");
+    if (!mod->supp_ranges_initialized) {
+        hashtable_init_ex(&mod->supp_ranges, 4, HASH_STRING, false/*!strdup*/,
+                          false/*!synch: error_lock*/, supp_ranges_free, NULL, NULL);
+        mod->supp_ranges_initialized = true;
+    }
+    sr = (supp_ranges_t *) hashtable_lookup(&mod->supp_ranges, (void *)pattern);
+    if (sr != NULL)
+        return sr;
+    sr = (supp_ranges_t *) global_alloc(sizeof(*sr), HEAPSTAT_REPORT);
+    memset(sr, 0, sizeof(*sr));
+    /* The key must outlive the table: patterns come from the suppression specs
+     * and the options, both of which are only freed after the callstack modules.
+     */
+    sr->pattern = pattern;
+    if (mod->path == NULL ||
+        /* Template parameters are displayed differently from how a symbol
+         * search matches them, so we leave those to symbolization.
+         */
+        strchr(pattern, '<') != NULL) {
+        sr->incomplete = true;
+    } else {
+        /* lookup_all_symbols() only needs the path, and the module may have
+         * been unloaded by now (e.g., for leaks).
+         */
+        module_data_t data;
+        memset(&data, 0, sizeof(data));
+        data.full_path = (char *) mod->path;
+        /* A failed search leaves no ranges: that is a mismatch, just like
+         * symbolization finding no matching name.
+         */
+        lookup_all_symbols(&data, pattern, true/*full*/, supp_ranges_add_cb, sr);
+        supp_ranges_finalize(sr);
+    }
+    LOG(2, "%s: %s in %s => %d ranges%s\n", __FUNCTION__, pattern,
+        mod->path == NULL ? "<null>" : mod->path, sr->num,
+        sr->incomplete ? " (incomplete)" : "");
+    hashtable_add(&mod->supp_ranges, (void *)pattern, (void *)sr);
+    return sr;
+}
+
+static bool
+supp_ranges_contain(supp_ranges_t *sr, size_t offs)
+{
+    uint lo = 0, hi = sr->num;
+    while (lo < hi) {
+        uint mid = (lo + hi) / 2;
+        if (offs < sr->ranges[mid].start)
+            hi = mid;
+        else if (offs >= sr->ranges[mid].end)
+            lo = mid + 1;
+        else
+            return true;
+    }
+    return false;
+}
+
+static void
+presym_frame_init(packed_callstack_t *pcs, uint idx, presym_frame_t *frame OUT)
+{
+    void *user_data = NULL;
+    memset(frame, 0, sizeof(*frame));
+    frame->is_syscall =
+        !packed_callstack_frame_module(pcs, idx, &frame->modname, &user_data,
+                                       &frame->modoffs, &frame->sym_modoffs);
+    frame->mod = (per_callstack_module_t *) user_data;
+}
+
+/* Mirrors frame_matches_modname(): non-module frames have an empty name. */
+static bool
+presym_modname_matches(const presym_frame_t *frame, const char *modname_pattern)
+{
+    return text_matches_pattern(frame->modname == NULL ? "" : frame->modname,
+                                modname_pattern, FILESYS_CASELESS);
+}
+
+/* Whether the symbolized function name of a frame would match pattern */
+static presym_match_t
+presym_func_matches(const presym_frame_t *frame, const char *pattern)
+{
+    supp_ranges_t *sr;
+    if (frame->is_syscall)
+        return PRESYM_UNKNOWN; /* the name comes from the syscall table */
+    if (frame->modname == NULL) {
+        return text_matches_pattern("<not in a module>", pattern, false) ?
+            PRESYM_MATCH : PRESYM_NO_MATCH;
+    }
+    if (pattern[0] == '*' && pattern[1] == '\0')
+        return PRESYM_MATCH;
+    /* A frame with no symbol is named "?" */
+    if (text_matches_pattern("?", pattern, false) || frame->mod == NULL)
+        return PRESYM_UNKNOWN;
+    sr = supp_ranges_lookup(frame->mod, pattern);
+    if (sr->incomplete)
+        return PRESYM_UNKNOWN;
+    return supp_ranges_contain(sr, frame->sym_modoffs) ?
+        PRESYM_MATCH : PRESYM_NO_MATCH;
+}
+
+/* Mirrors top_frame_matches_suppression_frame() */
+static presym_match_t
+presym_frame_matches(const presym_frame_t *frame, const suppress_frame_t *supp)
+{
+    if (supp->is_ellipsis) {
+        if (supp->is_module) {
+            return presym_modname_matches(frame, supp->modname) ?
+                PRESYM_MATCH : PRESYM_NO_MATCH;
+        } else
+            return PRESYM_MATCH;
+    }
+    if (supp->is_star)
+        return PRESYM_MATCH;
+    if (!supp->is_module) {
+        if (frame->modname != NULL)
+            return PRESYM_NO_MATCH;
+        return presym_func_matches(frame, supp->func);
+    }
+    if (frame->modname == NULL || !presym_modname_matches(frame, supp->modname))
+        return PRESYM_NO_MATCH;
+    if (supp->func == NULL) {
+        /* "<mod+offs>" suppression frame */
+        char modoffs[MAX_PFX_LEN];
+        dr_snprintf(modoffs, BUFFER_SIZE_ELEMENTS(modoffs), PIFX, frame->modoffs);
+        NULL_TERMINATE_BUFFER(modoffs);
+        return text_matches_pattern(modoffs, supp->modoffs, true/*ignore case*/) ?
+            PRESYM_MATCH : PRESYM_NO_MATCH;
+    }
+    return presym_func_matches(frame, supp->func);
+}
+
+/* Mirrors stack_matches_suppression().  Sets *max_idx to the highest frame
+ * index that was examined.
+ */
+static presym_match_t
+presym_stack_matches(packed_callstack_t *pcs, const char *instruction,
+                     const suppress_spec_t *spec, uint *max_idx OUT)
+{
+    uint i, num_frames = packed_callstack_num_frames(pcs);
+    int scs_last_ellipsis = -1;
+    suppress_frame_t *cur_ellipsis_supp = NULL;
+    suppress_frame_t *supp = spec->frames;
+    presym_frame_t frame;
+    presym_match_t res;
+
+    *max_idx = 0;
+    if (spec->instruction != NULL &&
+        !text_matches_pattern(instruction, spec->instruction, false/*consider case*/))
+        return PRESYM_NO_MATCH;
+
+    for (i = 0; i < num_frames; i++) {
+        if (supp == NULL)
+            return PRESYM_MATCH;
+        if (i > *max_idx)
+            *max_idx = i;
+        presym_frame_init(pcs, i, &frame);
+        res = presym_frame_matches(&frame, supp);
+        if (res == PRESYM_UNKNOWN)
+            return PRESYM_UNKNOWN;
+        if (res == PRESYM_MATCH) {
+            if (supp->is_ellipsis) {
+                cur_ellipsis_supp = supp;
+                supp = supp->next;
+                ASSERT(supp != NULL, "Suppression ends with '...'");
+                scs_last_ellipsis = i;
+                i--; /* counteract for's ++ */
+            } else
+                supp = supp->next;
+        } else if (scs_last_ellipsis > -1 &&
+                   (!cur_ellipsis_supp->is_module ||
+                    presym_modname_matches(&frame, cur_ellipsis_supp->modname))) {
+            scs_last_ellipsis++;
+            i = scs_last_ellipsis - 1; /* counteract for's ++ */
+        } else if (i == 0 && options.replace_malloc && frame.modname != NULL &&
+                   text_matches_pattern(frame.modname, DRMEMORY_LIBNAME,
+                                        FILESYS_CASELESS)) {
+            /* The top replace_ frame is skipped (i#1189) */
+            res = presym_func_matches(&frame, "replace_*");
+            if (res != PRESYM_MATCH)
+                return res;
+        } else if (i == 0 && !options.replace_malloc && supp->func != NULL &&
+                   text_matches_pattern(supp->func,
+                                        "replace_*", false/*consider case*/) &&
+                   text_matches_pattern(supp->modname,
+                                        DRMEMORY_LIBNAME, FILESYS_CASELESS)) {
+            supp = supp->next;
+            i--; /* counteract for's ++ */
+        } else
+            return PRESYM_NO_MATCH;
+    }
+    return (supp == NULL) ? PRESYM_MATCH : PRESYM_NO_MATCH;
+}
+
+/* Symbolization truncates a callstack at the first frame whose function matches
+ * -callstack_truncate_below (i#700).  A match above max_idx is only valid if no
+ * frame below it would have been truncated away.
+ */
+static presym_match_t
+presym_check_truncation(packed_callstack_t *pcs, uint max_idx)
+{
+    const char *pattern;
+    presym_frame_t frame;
+    uint i;
+    if (options.callstack_truncate_below[0] == '\0')
+        return PRESYM_MATCH;
+    for (i = 0; i < max_idx; i++) {
+        presym_frame_init(pcs, i, &frame);
+        /* the option's patterns are null-separated */
+        for (pattern = options.callstack_truncate_below; *pattern != '\0';
+             pattern += strlen(pattern) + 1) {
+            if (presym_func_matches(&frame, pattern) != PRESYM_NO_MATCH)
+                return PRESYM_UNKNOWN;
+        }
+    }
+    return PRESYM_MATCH;
+}
+
+/* Mirrors on_suppression_list_helper() */
+static presym_match_t
+presym_suppression_list_helper(uint type, packed_callstack_t *pcs,
+                               error_callstack_t *ecs, suppress_spec_t **matched OUT)
+{
+    suppress_spec_t *spec;
+    presym_match_t res;
+    uint max_idx;
+    ASSERT(type >= 0 && type < ERROR_MAX_VAL, "invalid error type");
+    for (spec = supp_list[type]; spec != NULL; spec = spec->next) {
+        res = presym_stack_matches(pcs, ecs->instruction, spec, &max_idx);
+        if (res == PRESYM_MATCH)
+            res = presym_check_truncation(pcs, max_idx);
+        if (res == PRESYM_UNKNOWN) {
+            /* An earlier spec must win, so we cannot look further */
+            LOG(3, "supp: unknown without symbols for %s\n",
+                (spec->name == NULL) ? "<no name>" : spec->name);
+            return PRESYM_UNKNOWN;
+        }
+        if (res == PRESYM_MATCH) {
+            LOG(3, "matched suppression %s by module offset\n",
+                (spec->name == NULL) ? "<no name>" : spec->name);
+            if (matched != NULL)
+                *matched = spec;
+            spec->count_used++;
+            if (type_is_leak(type))
+                spec->bytes_leaked += ecs->bytes_leaked;
+            return PRESYM_MATCH;
+        }
+    }
+    return PRESYM_NO_MATCH;
+}
+
+/* Returns true only if pcs is definitely suppressed, in which case the
+ * suppression's counts are updated just like on_suppression_list() does.
+ * A false return means the caller must symbolize and call on_suppression_list().
+ * Caller must hold error_lock.
+ */
+static bool
+on_suppression_list_by_offset(uint type, packed_callstack_t *pcs,
+                              error_callstack_t *ecs, suppress_spec_t **matched OUT)
+{
+    presym_match_t res;
+    ASSERT(type >= 0 && type < ERROR_MAX_VAL, "invalid error type");
+    if (!suppress_by_offset)
+        return false;
+    res = presym_suppression_list_helper(type, pcs, ecs, matched);
+    /* qualified leak reports should be checked against LEAK suppressions */
+    if (res == PRESYM_NO_MATCH && type_is_leak(type) && type != ERROR_LEAK)
+        res = presym_suppression_list_helper(ERROR_LEAK, pcs, ecs, matched);
+    if (res == PRESYM_MATCH) {
+        num_suppressions_by_offset++;
+        return true;
+    }
+    return false;
+}
+#endif /* USE_DRSYMS */
+
 /* Returns whether the error should be treated as a false positive */
 static bool
 check_src_whitelist(error_callstack_t *ecs, uint start)
@@ -1600,6 +2029,11 @@ report_init(void)
     callstack_init(&callstack_ops);
 
 #ifdef USE_DRSYMS
+    /* Suppressed reports are only printed (and so symbolized) when logging
+     * them, and expanded PDB templates are not what a symbol search sees.
+     */
+    suppress_by_offset = options.suppress_by_offset && !options.log_suppressed_errors &&
+        options.verbose < 2 && !TEST(PRINT_EXPAND_TEMPLATES, callstack_ops.print_flags);
     suppress_file_lock = dr_mutex_create();
     ELOGF(0, f_results, "Dr. Memory results for pid %d: \"%s\""NL,
           dr_get_process_id(), dr_get_application_name());
@@ -1947,6 +2381,10 @@ report_exit(void)
     dr_mutex_destroy(suppress_file_lock);
 #endif
     report_summary();
+#ifdef USE_DRSYMS
+    LOGF(1, f_global, "%d suppressions matched by module offset\n",
+         num_suppressions_by_offset);
+#endif
 
     hashtable_delete(&error_table);
     dr_mutex_destroy(error_lock);
@@ -2817,6 +3255,23 @@ report_error(error_toprint_t *etp, dr_mcontext_t *mc, packed_callstack_t *pcs)
     if (!options.replace_malloc && etp->errtype == ERROR_INVALID_HEAP_ARG)
         packed_callstack_first_frame_retaddr(err->pcs);
 
+    if (err->count == 1 &&
+        IF_DRSYMS_ELSE(on_suppression_list_by_offset(etp->errtype, err->pcs, &ecs,
+                                                     &spec), false)) {
+        /* Suppressed without symbolizing: nothing to print */
+        ASSERT(!reporting, "suppressed error should not be reported");
+        err->suppressed = true;
+        err->suppressed_by_default = spec->is_default;
+        err->suppress_spec = spec;
+        if (err->suppress_spec->is_default)
+            num_suppressions_matched_default++;
+        else
+            num_suppressions_matched_user++;
+        num_total[ERROR_NORMAL][etp->errtype]--;
+        dr_mutex_unlock(error_lock);
+        goto report_error_done;
+    }
+
     /* Convert to symbolized so we can compare to suppressions */
     packed_callstack_to_symbolized(err->pcs, &ecs.scs);
 
@@ -3121,6 +3576,12 @@ report_unaddressable_access(app_loc_t *loc, app_pc addr, size_t sz,
                  INFO_PFX, app_start, app_end);
         etp.aux_msg = buf;
     }
+    if (options.redzone_adaptive) {
+        packed_callstack_t *alloc_pcs = NULL;
+        if (region_in_redzone(addr, sz, &alloc_pcs, NULL, NULL, NULL, NULL) &&
+            alloc_pcs != NULL)
+            alloc_drmem_redzone_error(alloc_pcs);
+    }
     report_error(&etp, mc, NULL);
 }
 
@@ -3309,6 +3770,17 @@ void
 report_leak(bool known_malloc, app_pc addr, size_t size, size_t indirect_size,
             bool early, bool reachable, bool maybe_reachable, uint shadow_state,
             packed_callstack_t *pcs, bool count_reachable, bool show_reachable)
+{
+    report_leak_site(known_malloc, addr, size, indirect_size, early, reachable,
+                     maybe_reachable, shadow_state, pcs, count_reachable,
+                     show_reachable, 1, size + indirect_size);
+}
+
+void
+report_leak_site(bool known_malloc, app_pc addr, size_t size, size_t indirect_size,
+                 bool early, bool reachable, bool maybe_reachable, uint shadow_state,
+                 packed_callstack_t *pcs, bool count_reachable, bool show_reachable,
+                 uint count, size_t total_bytes)
 {
     /* If not in a known malloc region it could be an unaddressable byte
      * that was erroneously written to (and we reported already) but
@@ -3325,6 +3797,7 @@ report_leak(bool known_malloc, app_pc addr, size_t size, size_t indirect_size,
     uint type;
     uint set = ERROR_NORMAL;
     suppress_spec_t *spec;
+    bool suppressed_by_offset = false;
     error_toprint_t etp = {0};
     error_callstack_t ecs;
     error_callstack_init(&ecs);
@@ -3345,7 +3818,7 @@ report_leak(bool known_malloc, app_pc addr, size_t size, size_t indirect_size,
         /* Combined-total throttling just like for non-leaks */
         num_total_leaks[ERROR_NORMAL] + num_total_leaks[ERROR_POTENTIAL] >=
         options.report_leak_max) {
-        num_throttled_leaks++;
+        num_throttled_leaks += count;
         DO_ONCE({
             NOTIFY(NL);
             NOTIFY("Reached maximum leak report limit (-report_leak_max). "
@@ -3355,8 +3828,9 @@ report_leak(bool known_malloc, app_pc addr, size_t size, size_t indirect_size,
         });
         return;
     }
+    ASSERT(count > 0, "leak site must have at least one leak");
     buf = report_alloc_buf(drcontext, &bufsz);
-    num_total_leaks[ERROR_NORMAL]++;
+    num_total_leaks[ERROR_NORMAL] += count;
 
     /* we need to know the type prior to dup checking */
     if (reachable && !early) {
@@ -3396,23 +3870,29 @@ report_leak(bool known_malloc, app_pc addr, size_t size, size_t indirect_size,
             ASSERT(pcs != NULL, "malloc must have callstack");
             err = record_error(type, pcs, NULL, NULL, true/*hold lock*/);
             set = ERROR_SET(err->potential);
-            if (err->count > 1) {
+            if (count > 1) {
+                /* The rest of an aggregated site count as dups of the first */
+                err->count += count - 1;
+                if (!err->suppressed)
+                    num_total[set][type] += count - 1;
+            }
+            if (err->count > count) {
                 /* Duplicate */
                 if (err->suppressed) {
                     ASSERT(err->suppress_spec != NULL, "missing suppress spec");
                     if (err->suppress_spec->is_default)
-                        num_suppressed_leaks_default++;
+                        num_suppressed_leaks_default += count;
                     else
-                        num_suppressed_leaks_user++;
-                    err->suppress_spec->bytes_leaked += size + indirect_size;
+                        num_suppressed_leaks_user += count;
+                    err->suppress_spec->bytes_leaked += total_bytes;
                 } else {
                     /* We only count bytes for non-suppressed leaks */
                     /* Total size does not distinguish direct from indirect (PR 576032) */
-                    num_bytes_leaked[set][type] += size + indirect_size;
+                    num_bytes_leaked[set][type] += total_bytes;
                 }
                 DOLOG(3, {
-                    LOG(3, "Duplicate leak of %d (%d indirect) bytes:\n",
-                        size, indirect_size);
+                    LOG(3, "Duplicate leak x%d of %d (%d indirect) bytes:\n",
+                        count, size, indirect_size);
                     packed_callstack_log(err->pcs, f_global);
                 });
                 dr_mutex_unlock(error_lock);
@@ -3429,7 +3909,13 @@ report_leak(bool known_malloc, app_pc addr, size_t size, size_t indirect_size,
          */
         if (!early && (!reachable || show_reachable)) {
             ASSERT(pcs != NULL, "non-early allocs must have stacks");
-            packed_callstack_to_symbolized(pcs, &ecs.scs);
+            if (type < ERROR_MAX_VAL &&
+                IF_DRSYMS_ELSE(on_suppression_list_by_offset(type, pcs, &ecs,
+                                                             &spec), false)) {
+                /* Suppressed without symbolizing: ecs.scs stays empty */
+                suppressed_by_offset = true;
+            } else
+                packed_callstack_to_symbolized(pcs, &ecs.scs);
         }
 
         if (locked_malloc)
@@ -3437,7 +3923,9 @@ report_leak(bool known_malloc, app_pc addr, size_t size, size_t indirect_size,
 
         /* only real, possible, and reachable leaks can be suppressed */
         if (type < ERROR_MAX_VAL) {
-            if (reachable && !show_reachable)
+            if (suppressed_by_offset)
+                reporting = false;
+            else if (reachable && !show_reachable)
                 reporting = true; /* suppressions not supported: i#1852 */
             else
                 reporting = !on_suppression_list(type, &ecs, &spec);
@@ -3459,12 +3947,14 @@ report_leak(bool known_malloc, app_pc addr, size_t size, size_t indirect_size,
                     set = ERROR_POTENTIAL;
                     if (reporting)
                         acquire_error_number(err);
-                    /* Fix up the stats */
+                    /* Fix up the stats.  As for individual leaks, only the
+                     * first one moves: the rest count as normal dups.
+                     */
                     num_total_leaks[ERROR_NORMAL]--;
                     num_total_leaks[ERROR_POTENTIAL]++;
                     /* Adjust counter set by record_error() */
-                    num_total[ERROR_NORMAL][type]--;
-                    num_total[ERROR_POTENTIAL][type]++;
+                    num_total[ERROR_NORMAL][type] -= count;
+                    num_total[ERROR_POTENTIAL][type] += count;
                     LOG(2, "Leak starts with system libs => hiding\n");
                 } else {
                     if (reporting) {
@@ -3486,7 +3976,7 @@ report_leak(bool known_malloc, app_pc addr, size_t size, size_t indirect_size,
             }
             /* We only count bytes for non-suppressed leaks */
             /* Total size does not distinguish direct from indirect (PR 576032) */
-            num_bytes_leaked[set][type] += size + indirect_size;
+            num_bytes_leaked[set][type] += total_bytes;
         } else if (type < ERROR_MAX_VAL) {
             bool already_supp = err->suppressed;
             ASSERT(err != NULL && spec != NULL, "invalid local");
@@ -3494,20 +3984,20 @@ report_leak(bool known_malloc, app_pc addr, size_t size, size_t indirect_size,
             err->suppressed_by_default = spec->is_default;
             err->suppress_spec = spec;
             if (err->suppress_spec->is_default)
-                num_suppressed_leaks_default++;
+                num_suppressed_leaks_default += count;
             else
-                num_suppressed_leaks_user++;
-            err->suppress_spec->bytes_leaked += size + indirect_size;
+                num_suppressed_leaks_user += count;
+            err->suppress_spec->bytes_leaked += total_bytes;
             if (!already_supp)
-                num_total[ERROR_NORMAL][type]--;
+                num_total[ERROR_NORMAL][type] -= count;
         }
     } else if (type < ERROR_MAX_VAL) {
         /* For -no_check_leaks, we still report leaks without callstacks and
          * count how many bytes were leaked.  Without callstacks, we can't
          * de-duplicate, and assume each leak is unique and not "potential".
          */
-        num_unique[ERROR_NORMAL][type]++;
-        num_bytes_leaked[set][type] += size + indirect_size;
+        num_unique[ERROR_NORMAL][type] += count;
+        num_bytes_leaked[set][type] += total_bytes;
         if (type == ERROR_LEAK ||
             (type == ERROR_POSSIBLE_LEAK && options.possible_leaks) ||
             (type == ERROR_REACHABLE_LEAK && show_reachable)) {
@@ -110,6 +110,17 @@ report_leak(bool known_malloc, app_pc addr, size_t size, size_t indirect_size,
             bool early, bool reachable, bool maybe_reachable, uint shadow_state,
             packed_callstack_t *pcs, bool count_reachable, bool show_reachable);
 
+/* Reports count leaks sharing the same allocation callstack pcs and flags as a
+ * single site, totaling total_bytes (direct plus indirect).  The addr, size, and
+ * indirect_size of one representative leak are used for the printed report.
+ * report_leak() is equivalent to a count of 1.
+ */
+void
+report_leak_site(bool known_malloc, app_pc addr, size_t size, size_t indirect_size,
+                 bool early, bool reachable, bool maybe_reachable, uint shadow_state,
+                 packed_callstack_t *pcs, bool count_reachable, bool show_reachable,
+                 uint count, size_t total_bytes);
+
 void
 report_malloc(app_pc start, app_pc end, const char *routine, dr_mcontext_t *mc);
 
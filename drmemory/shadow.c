@@ -179,12 +179,17 @@ umbra_map_t *umbra_map;
 typedef struct _saved_region_t {
     app_pc start;
     size_t size;
+    /* The number of app bytes from start saved via umbra_snapshot_shadow_memory() */
+    size_t snapshot_size;
+    /* Non-NULL if the snapshot range is backed by a shared block */
+    byte *shared_block;
     bitmap_t shadow;
 } saved_region_t;
 
 /* extend size to uint boundary if the exact required size is not already aligned */
 #define SIZEOF_SAVED_BUFFER_SHADOW(size) \
-    (ALIGN_FORWARD((size), SHADOW_GRANULARITY) / SHADOW_GRANULARITY)
+    ALIGN_FORWARD(ALIGN_FORWARD((size), SHADOW_GRANULARITY) / SHADOW_GRANULARITY, \
+                  sizeof(uint))
 
 /* single allocation for saved_region_t and its shadow buffer */
 #define SIZEOF_SAVED_BUFFER(size) \
@@ -282,12 +287,14 @@ shadow_table_init(void)
     val_to_dqword[3] = SHADOW_DQWORD_UNDEFINED;
 
     memset(&umbra_map_ops, 0, sizeof(umbra_map_ops));
+    umbra_map_ops.struct_size = sizeof(umbra_map_ops);
     umbra_map_ops.flags =
         UMBRA_MAP_CREATE_SHADOW_ON_TOUCH |
         UMBRA_MAP_SHADOW_SHARED_READONLY;
     umbra_map_ops.scale = SHADOW_MAP_SCALE;
     umbra_map_ops.default_value = SHADOW_DEFAULT_VALUE;
     umbra_map_ops.default_value_size = SHADOW_DEFAULT_VALUE_SIZE;
+    umbra_map_ops.fault_batch_blocks = options.shadow_fault_batch;
 #ifndef X64
     umbra_map_ops.redzone_size = REDZONE_SIZE;
     umbra_map_ops.redzone_value = SHADOW_REDZONE_VALUE;
@@ -556,6 +563,51 @@ shadow_replace_special(app_pc addr)
     return shadow_addr;
 }
 
+#ifndef X64
+size_t
+shadow_stack_xl8_unit(void)
+{
+    /* the app range covered by one shadow table entry */
+    return get_shadow_block_size() * SHADOW_GRANULARITY;
+}
+
+void
+shadow_stack_xl8_thread_init(void)
+{
+    /* Until the first refresh, hits land in the unaddressable special block
+     * and thus go to the slowpath.  The base of 0 means only null-page
+     * references hit, and those are unaddressable anyway.
+     */
+    set_stack_xl8_slots(NULL, special_unaddressable);
+}
+
+void
+shadow_stack_xl8_refresh(app_pc sp)
+{
+    app_pc base = (app_pc) ALIGN_BACKWARD(sp, shadow_stack_xl8_unit());
+    umbra_shadow_memory_info_t info;
+    byte *shadow_addr;
+    if (base == get_stack_xl8_base())
+        return;
+    info.struct_size = sizeof(info);
+    if (umbra_get_shadow_memory(umbra_map, base, &shadow_addr, &info) != DRMF_SUCCESS)
+        return;
+    /* We must never cache a special block: the fault handler for writes to
+     * one requires that the table lookup produced the faulting address.
+     * Normal blocks are never freed (PR 580017) so caching those is safe.
+     */
+    if (TEST(UMBRA_SHADOW_MEMORY_TYPE_SHARED, info.shadow_type))
+        shadow_addr = shadow_replace_special(base);
+    else if (!TEST(UMBRA_SHADOW_MEMORY_TYPE_NORMAL, info.shadow_type))
+        return;
+    if (shadow_addr == NULL)
+        return;
+    LOG(3, "stack xl8 cache: "PFX" => "PFX"\n", base, shadow_addr);
+    STATS_INC(xl8_stack_refreshes);
+    set_stack_xl8_slots(base, shadow_addr);
+}
+#endif
+
 /* Saves the shadow values for the specified app memory region into a newly allocated
  * buffer. The caller must free the returned shadow buffer using shadow_free_buffer(),
  */
@@ -566,6 +618,7 @@ shadow_save_region(app_pc start, size_t size)
     size_t saved_buffer_size = SIZEOF_SAVED_BUFFER(size);
     saved_region_t *saved = global_alloc(saved_buffer_size, HEAPSTAT_SHADOW);
     umbra_shadow_memory_info_t shadow_info;
+    size_t shadow_size;
 
     if (MAP_4B_TO_1B) {
         ASSERT_NOT_IMPLEMENTED();
@@ -576,10 +629,22 @@ shadow_save_region(app_pc start, size_t size)
     saved->start = start;
     saved->size = size;
     saved->shadow = (bitmap_t)((byte *) saved + sizeof(saved_region_t));
+    saved->shared_block = NULL;
+    saved->snapshot_size = 0;
 
-    /* XXX i#1734: this can be optimized for better performance on large buffers */
+    /* i#1734: our bitmap layout matches the shadow layout, so whole shadow bytes
+     * are copied directly, and not at all if they are in a shared block.
+     */
+    if (ALIGNED(start, SHADOW_GRANULARITY) && size >= SHADOW_GRANULARITY) {
+        size_t snapshot_size = ALIGN_BACKWARD(size, SHADOW_GRANULARITY);
+        shadow_size = SIZEOF_SAVED_BUFFER_SHADOW(size);
+        if (umbra_snapshot_shadow_memory(umbra_map, start, snapshot_size, &shadow_size,
+                                         (byte *)saved->shadow,
+                                         &saved->shared_block) == DRMF_SUCCESS)
+            saved->snapshot_size = snapshot_size;
+    }
     umbra_shadow_memory_info_init(&shadow_info);
-    for (i = 0; i < saved->size; i++) {
+    for (i = (uint)saved->snapshot_size; i < saved->size; i++) {
         shadow_value = shadow_get_byte(&shadow_info, (byte *) start + i);
         bitmapx2_set(saved->shadow, i, shadow_value);
     }
@@ -593,9 +658,17 @@ shadow_restore_region(shadow_buffer_t *shadow_buffer)
     uint i;
     saved_region_t *saved = (saved_region_t *) shadow_buffer;
     umbra_shadow_memory_info_t shadow_info;
+    size_t shadow_size;
 
+    if (saved->snapshot_size > 0) {
+        shadow_size = SIZEOF_SAVED_BUFFER_SHADOW(saved->size);
+        if (umbra_restore_shadow_memory(umbra_map, saved->start, saved->snapshot_size,
+                                        &shadow_size, (byte *)saved->shadow,
+                                        saved->shared_block) != DRMF_SUCCESS)
+            ASSERT(false, "fail to restore shadow memory");
+    }
     umbra_shadow_memory_info_init(&shadow_info);
-    for (i = 0; i < saved->size; i++)
+    for (i = (uint)saved->snapshot_size; i < saved->size; i++)
         shadow_set_byte(&shadow_info, saved->start + i, bitmapx2_get(saved->shadow, i));
 }
 
@@ -1993,6 +2066,10 @@ void
 shadow_thread_init(void *drcontext)
 {
     shadow_registers_thread_init(drcontext);
+#if defined(TOOL_DR_MEMORY) && !defined(X64)
+    if (options.stack_xl8_cache)
+        shadow_stack_xl8_thread_init();
+#endif
 }
 
 void
@@ -2001,6 +2078,41 @@ shadow_thread_exit(void *drcontext)
     shadow_registers_thread_exit(drcontext);
 }
 
+static bool
+shadow_usage_iter(umbra_map_t *map, umbra_shadow_memory_info_t *info, void *data)
+{
+    size_t *usage = (size_t *) data;
+    /* shared blocks may also be flagged as redzone */
+    if (TEST(UMBRA_SHADOW_MEMORY_TYPE_SHARED, info->shadow_type))
+        usage[1] += info->shadow_size;
+    else
+        usage[0] += info->shadow_size;
+    return true;
+}
+
+void
+shadow_memory_usage(size_t *normal OUT, size_t *shared OUT)
+{
+    size_t usage[2] = {0, 0};
+    ASSERT(options.shadowing, "shadowing disabled");
+    if (umbra_iterate_shadow_memory(umbra_map, (void *)usage,
+                                    shadow_usage_iter) != DRMF_SUCCESS)
+        LOG(1, "%s: failed to iterate shadow memory\n", __FUNCTION__);
+    *normal = usage[0];
+    *shared = usage[1];
+}
+
+void
+shadow_fault_statistics(uint64 *faults OUT, uint64 *blocks OUT)
+{
+    ASSERT(options.shadowing, "shadowing disabled");
+    if (umbra_get_fault_statistics(umbra_map, faults, blocks) != DRMF_SUCCESS) {
+        LOG(1, "%s: failed to get shadow fault statistics\n", __FUNCTION__);
+        *faults = 0;
+        *blocks = 0;
+    }
+}
+
 void
 shadow_init(void)
 {
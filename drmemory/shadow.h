@@ -140,6 +140,19 @@ set_2bits(uint orig, uint val, uint shift);
 void
 shadow_init(void);
 
+/* Returns the shadow bytes mapped for app memory: in *normal for
+ * privately allocated blocks and in *shared for app blocks mapped to
+ * shared special blocks, which do not occupy memory of their own.
+ */
+void
+shadow_memory_usage(size_t *normal OUT, size_t *shared OUT);
+
+/* Returns the number of shadow faults that created shadow on first touch and
+ * the number of shadow blocks they created.
+ */
+void
+shadow_fault_statistics(uint64 *faults OUT, uint64 *blocks OUT);
+
 void
 shadow_exit(void);
 
@@ -205,6 +218,23 @@ shadow_replace_special(app_pc addr);
 byte *
 shadow_translation_addr(app_pc addr);
 
+#ifndef X64
+/* For -stack_xl8_cache: returns the size of the app unit whose translation is
+ * cached, which is the range covered by one shadow table entry.
+ */
+size_t
+shadow_stack_xl8_unit(void);
+
+void
+shadow_stack_xl8_thread_init(void);
+
+/* Points the current thread's translation cache at the unit containing sp,
+ * replacing a special shadow block there with a normal one.
+ */
+void
+shadow_stack_xl8_refresh(app_pc sp);
+#endif
+
 /* Returns a pointer to an always-bitlevel shadow block */
 byte *
 shadow_bitlevel_addr(void);
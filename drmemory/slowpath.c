@@ -47,7 +47,11 @@
 #endif
 #include "pattern.h"
 #include <stddef.h>
+#include <string.h> /* strcmp */
 #include "asm_utils.h"
+#ifdef BUILD_UNIT_TESTS
+# include "crypto.h"
+#endif
 
 #ifdef STATISTICS
 /* per-opcode counts */
@@ -70,6 +74,8 @@ uint num_slowpath_faults;
 
 #ifdef STATISTICS
 uint slowpath_executions;
+uint slowpath_decode_hits;
+uint slowpath_decode_misses;
 uint medpath_executions;
 uint read_slowpath;
 uint write_slowpath;
@@ -108,6 +114,8 @@ uint reg_spill_own;
 uint reg_spill_used_in_bb;
 uint reg_spill_unused_in_bb;
 uint addressable_checks_elided;
+uint dead_reg_shadow_elided;
+uint dead_eflags_shadow_elided;
 uint aflags_saved_at_top;
 uint xl8_shared;
 uint xl8_not_shared_reg_conflict;
@@ -119,6 +127,10 @@ uint xl8_not_shared_offs;
 uint xl8_not_shared_slowpaths;
 uint xl8_shared_slowpath_instrs;
 uint xl8_shared_slowpath_count;
+uint xl8_stack_instrs;
+uint xl8_stack_hits;
+uint xl8_stack_misses;
+uint xl8_stack_refreshes;
 uint slowpath_unaligned;
 uint slowpath_8_at_border;
 uint num_bbs;
@@ -450,7 +462,131 @@ opnd_uses_nonignorable_memory(opnd_t opnd)
              opnd_is_far_memory_reference(opnd)));
 }
 
-/* Called by slow_path() after initial decode.  Expected to free inst. */
+/***************************************************************************
+ * Decoded instruction cache
+ */
+
+/* Hot slowpath instrs are visited over and over, so rather than decoding
+ * and analyzing them every time we keep a small direct-mapped per-thread
+ * cache of the decoded instr and of the operand analysis that depends only
+ * on the instr.  An entry is only used if the app bytes still match and no
+ * module has been unloaded since it was filled, which covers code changes
+ * and module reloads seen by other threads; the owning thread additionally
+ * drops entries when their fragment is deleted.
+ */
+#define DECODE_CACHE_BITS 8
+#define DECODE_CACHE_SIZE (1 << DECODE_CACHE_BITS)
+#define DECODE_CACHE_IDX(pc) \
+    (((ptr_uint_t)(pc) ^ ((ptr_uint_t)(pc) >> DECODE_CACHE_BITS)) & \
+     (DECODE_CACHE_SIZE - 1))
+
+typedef struct _decode_entry_t {
+    app_pc pc; /* NULL if unused */
+    uint module_gen;
+    size_t instr_sz;
+    byte raw[MAX_INSTR_SIZE];
+    instr_t inst;
+    /* analysis that is a function of the instr alone (-check_uninitialized) */
+    bool check_definedness;
+    bool always_defined;
+    bool check_srcs_after;
+} decode_entry_t;
+
+typedef struct _decode_cache_t {
+    decode_entry_t entry[DECODE_CACHE_SIZE];
+} decode_cache_t;
+
+/* Bumped on every module unload to invalidate all threads' entries */
+static volatile uint decode_cache_module_gen;
+
+/* Returns the decoded instr at decode_pc along with its analysis.  The result
+ * is either a cache entry owned by the thread or, for instrs we do not cache,
+ * local, which the caller must free via slowpath_decode_done().
+ */
+static decode_entry_t *
+slowpath_decode(void *drcontext, app_pc pc, app_pc decode_pc, decode_entry_t *local)
+{
+    decode_entry_t *e = local;
+    app_pc next_pc;
+    /* A separate decode pc is our own copy of the instr which fragment
+     * deletion does not tell us about.
+     */
+    if (pc == decode_pc) {
+        tls_drmem_t *pt = (tls_drmem_t *) drmgr_get_tls_field(drcontext, tls_idx_drmem);
+        if (pt->decode_cache == NULL) {
+            int i;
+            pt->decode_cache = (decode_cache_t *)
+                thread_alloc(drcontext, sizeof(*pt->decode_cache), HEAPSTAT_PERBB);
+            memset(pt->decode_cache, 0, sizeof(*pt->decode_cache));
+            for (i = 0; i < DECODE_CACHE_SIZE; i++)
+                instr_init(drcontext, &pt->decode_cache->entry[i].inst);
+        }
+        e = &pt->decode_cache->entry[DECODE_CACHE_IDX(pc)];
+        if (e->pc == pc && e->module_gen == decode_cache_module_gen &&
+            memcmp(e->raw, decode_pc, e->instr_sz) == 0) {
+            STATS_INC(slowpath_decode_hits);
+            return e;
+        }
+        e->pc = NULL;
+        instr_reset(drcontext, &e->inst);
+    } else
+        instr_init(drcontext, &e->inst);
+
+    next_pc = decode(drcontext, decode_pc, &e->inst);
+    ASSERT(next_pc != NULL && instr_valid(&e->inst), "invalid instr");
+    e->instr_sz = (next_pc == NULL) ? 0 : next_pc - decode_pc;
+    if (options.check_uninitialized) {
+        e->check_definedness = instr_check_definedness(&e->inst);
+        e->always_defined = result_is_always_defined(&e->inst, false/*us*/);
+        e->check_srcs_after = instr_needs_all_srcs_and_vals(&e->inst);
+    }
+    if (e != local && next_pc != NULL && e->instr_sz <= BUFFER_SIZE_BYTES(e->raw)) {
+        memcpy(e->raw, decode_pc, e->instr_sz);
+        e->module_gen = decode_cache_module_gen;
+        e->pc = pc;
+        STATS_INC(slowpath_decode_misses);
+    }
+    return e;
+}
+
+static void
+slowpath_decode_done(void *drcontext, decode_entry_t *e, decode_entry_t *local)
+{
+    if (e == local)
+        instr_free(drcontext, &e->inst);
+}
+
+void
+slowpath_thread_exit(void *drcontext)
+{
+    tls_drmem_t *pt = (tls_drmem_t *) drmgr_get_tls_field(drcontext, tls_idx_drmem);
+    int i;
+    if (pt == NULL || pt->decode_cache == NULL)
+        return;
+    for (i = 0; i < DECODE_CACHE_SIZE; i++)
+        instr_free(drcontext, &pt->decode_cache->entry[i].inst);
+    thread_free(drcontext, pt->decode_cache, sizeof(*pt->decode_cache), HEAPSTAT_PERBB);
+    pt->decode_cache = NULL;
+}
+
+void
+slowpath_fragment_delete(void *drcontext, app_pc start, size_t size)
+{
+    tls_drmem_t *pt;
+    size_t i;
+    if (drcontext == NULL)
+        return;
+    pt = (tls_drmem_t *) drmgr_get_tls_field(drcontext, tls_idx_drmem);
+    if (pt == NULL || pt->decode_cache == NULL)
+        return;
+    for (i = 0; i < size; i++) {
+        decode_entry_t *e = &pt->decode_cache->entry[DECODE_CACHE_IDX(start + i)];
+        if (e->pc == start + i)
+            e->pc = NULL; /* instr is reset on re-use */
+    }
+}
+
+/* Called by slow_path() after initial decode.  Does not free inst. */
 bool
 slow_path_without_uninitialized(void *drcontext, dr_mcontext_t *mc, instr_t *inst,
                                 app_loc_t *loc, size_t instr_sz)
@@ -491,9 +627,7 @@ slow_path_without_uninitialized(void *drcontext, dr_mcontext_t *mc, instr_t *ins
         }
     }
 
-    instr_free(drcontext, inst);
-
-    /* call this last after freeing inst in case it does a synchronous flush */
+    /* call this last in case it does a synchronous flush */
     slow_path_xl8_sharing(loc, instr_sz, memop, mc);
 
     return true;
@@ -524,9 +658,10 @@ slow_path_without_uninitialized(void *drcontext, dr_mcontext_t *mc, instr_t *ins
 bool
 slow_path_with_mc(void *drcontext, app_pc pc, app_pc decode_pc, dr_mcontext_t *mc)
 {
-    instr_t inst;
+    instr_t *inst;
     int opc;
 #ifdef TOOL_DR_MEMORY
+    decode_entry_t local_decode, *decoded;
     opnd_t opnd;
     int i, num_srcs, num_dsts;
     uint sz;
@@ -537,6 +672,9 @@ slow_path_with_mc(void *drcontext, app_pc pc, app_pc decode_pc, dr_mcontext_t *m
     opnd_t memop = opnd_create_null();
     size_t instr_sz;
     cls_drmem_t *cpt = (cls_drmem_t *) drmgr_get_cls_field(drcontext, cls_idx_drmem);
+#endif
+#ifdef TOOL_DR_HEAPSTAT
+    instr_t local_inst;
 #endif
     app_loc_t loc;
 
@@ -556,6 +694,15 @@ slow_path_with_mc(void *drcontext, app_pc pc, app_pc decode_pc, dr_mcontext_t *m
 
     pc_to_loc(&loc, pc);
 
+#if defined(TOOL_DR_MEMORY) && !defined(X64)
+    /* Rather than calling out on fastpath misses we re-point the stack
+     * translation cache whenever we come here, which is frequent enough
+     * to track the stack as it moves between 64K units.
+     */
+    if (options.stack_xl8_cache)
+        shadow_stack_xl8_refresh((app_pc)mc->xsp);
+#endif
+
     /* Locally-spilled and whole-bb-spilled (PR 489221) registers have
      * already been restored in shared_slowpath, so we can properly
      * emulate addresses referenced.  We can't restore whole-bb-spilled
@@ -572,30 +719,33 @@ slow_path_with_mc(void *drcontext, app_pc pc, app_pc decode_pc, dr_mcontext_t *m
     }
 #endif /* TOOL_DR_MEMORY */
 
-    instr_init(drcontext, &inst);
 #ifdef TOOL_DR_MEMORY
-    instr_sz = decode(drcontext, decode_pc, &inst) - decode_pc;
+    decoded = slowpath_decode(drcontext, pc, decode_pc, &local_decode);
+    inst = &decoded->inst;
+    instr_sz = decoded->instr_sz;
 #else
-    decode(drcontext, decode_pc, &inst);
+    instr_init(drcontext, &local_inst);
+    decode(drcontext, decode_pc, &local_inst);
+    inst = &local_inst;
+    ASSERT(instr_valid(inst), "invalid instr");
 #endif
-    ASSERT(instr_valid(&inst), "invalid instr");
-    opc = instr_get_opcode(&inst);
+    opc = instr_get_opcode(inst);
 
     slowpath_update_app_loc_arch(opc, decode_pc, &loc);
 
 #ifdef STATISTICS
     STATS_INC(slowpath_count[opc]);
     {
-        uint bytes = instr_memory_reference_size(&inst);
+        uint bytes = instr_memory_reference_size(inst);
         if (bytes == 0) {
-            if (instr_num_dsts(&inst) > 0 &&
-                !opnd_is_pc(instr_get_dst(&inst, 0)) &&
-                !opnd_is_instr(instr_get_dst(&inst, 0)))
-                bytes = opnd_size_in_bytes(opnd_get_size(instr_get_dst(&inst, 0)));
-            else if (instr_num_srcs(&inst) > 0 &&
-                     !opnd_is_pc(instr_get_src(&inst, 0)) &&
-                     !opnd_is_instr(instr_get_src(&inst, 0)))
-                bytes = opnd_size_in_bytes(opnd_get_size(instr_get_src(&inst, 0)));
+            if (instr_num_dsts(inst) > 0 &&
+                !opnd_is_pc(instr_get_dst(inst, 0)) &&
+                !opnd_is_instr(instr_get_dst(inst, 0)))
+                bytes = opnd_size_in_bytes(opnd_get_size(instr_get_dst(inst, 0)));
+            else if (instr_num_srcs(inst) > 0 &&
+                     !opnd_is_pc(instr_get_src(inst, 0)) &&
+                     !opnd_is_instr(instr_get_src(inst, 0)))
+                bytes = opnd_size_in_bytes(opnd_get_size(instr_get_src(inst, 0)));
             else
                 bytes = 0;
         }
@@ -618,25 +768,28 @@ slow_path_with_mc(void *drcontext, app_pc pc, app_pc decode_pc, dr_mcontext_t *m
 
     DOLOG(3, {
         LOG(3, "\nslow_path "PFX": ", pc);
-        instr_disassemble(drcontext, &inst, LOGFILE_GET(drcontext));
-        if (instr_num_dsts(&inst) > 0 &&
-            opnd_is_memory_reference(instr_get_dst(&inst, 0))) {
+        instr_disassemble(drcontext, inst, LOGFILE_GET(drcontext));
+        if (instr_num_dsts(inst) > 0 &&
+            opnd_is_memory_reference(instr_get_dst(inst, 0))) {
             umbra_shadow_memory_info_t info;
             umbra_shadow_memory_info_init(&info);
             LOG(3, " | 0x%x",
                 shadow_get_byte(&info,
-                                opnd_compute_address(instr_get_dst(&inst, 0),
+                                opnd_compute_address(instr_get_dst(inst, 0),
                                                      mc)));
         }
         LOG(3, "\n");
     });
 
 #ifdef TOOL_DR_HEAPSTAT
-    return slow_path_for_staleness(drcontext, mc, &inst, &loc);
+    return slow_path_for_staleness(drcontext, mc, inst, &loc);
 
 #else
-    if (!options.check_uninitialized)
-        return slow_path_without_uninitialized(drcontext, mc, &inst, &loc, instr_sz);
+    if (!options.check_uninitialized) {
+        bool res = slow_path_without_uninitialized(drcontext, mc, inst, &loc, instr_sz);
+        slowpath_decode_done(drcontext, decoded, &local_decode);
+        return res;
+    }
 
     LOG(4, "shadow registers prior to instr:\n");
     DOLOG(4, { print_shadow_registers(); });
@@ -659,10 +812,10 @@ slow_path_with_mc(void *drcontext, app_pc pc, app_pc decode_pc, dr_mcontext_t *m
      * definedness to.  If there are more, we can fit them side by
      * side in our 8-dword-capacity comb->dst array.
      */
-    check_definedness = instr_check_definedness(&inst);
-    always_defined = result_is_always_defined(&inst, false/*us*/);
+    check_definedness = decoded->check_definedness;
+    always_defined = decoded->always_defined;
     pushpop = opc_is_push(opc) || opc_is_pop(opc);
-    check_srcs_after = instr_needs_all_srcs_and_vals(&inst);
+    check_srcs_after = decoded->check_srcs_after;
     if (check_srcs_after) {
         /* We need to check definedness of addressing registers, and so we do
          * our normal src loop but we do not check undefinedness or combine
@@ -670,17 +823,17 @@ slow_path_with_mc(void *drcontext, app_pc pc, app_pc decode_pc, dr_mcontext_t *m
          * check_mem_opnd() and integrate_register_shadow(), causing the 2
          * sources to be laid out side-by-side in comb->dst.
          */
-        ASSERT(instr_num_srcs(&inst) == 2, "and/or special handling error");
+        ASSERT(instr_num_srcs(inst) == 2, "and/or special handling error");
         check_definedness = false;
         IF_DEBUG(comb.opsz = 0;) /* for asserts below */
     }
 
-    shadow_combine_init(&comb, &inst, opc, OPND_SHADOW_ARRAY_LEN);
+    shadow_combine_init(&comb, inst, opc, OPND_SHADOW_ARRAY_LEN);
 
-    num_srcs = num_true_srcs(&inst, mc);
+    num_srcs = num_true_srcs(inst, mc);
 #ifdef X86
     if (opc == OP_lea)
-        num_srcs = IF_X64_ELSE(opnd_is_rel_addr(instr_get_src(&inst, 0)), false) ? 0 : 2;
+        num_srcs = IF_X64_ELSE(opnd_is_rel_addr(instr_get_src(inst, 0)), false) ? 0 : 2;
 #endif
  check_srcs:
     for (i = 0; i < num_srcs; i++) {
@@ -689,15 +842,15 @@ slow_path_with_mc(void *drcontext, app_pc pc, app_pc decode_pc, dr_mcontext_t *m
              * code below can handle REG_NULL
              */
             if (i == 0)
-                opnd = opnd_create_reg(opnd_get_base(instr_get_src(&inst, 0)));
+                opnd = opnd_create_reg(opnd_get_base(instr_get_src(inst, 0)));
             else
-                opnd = opnd_create_reg(opnd_get_index(instr_get_src(&inst, 0)));
+                opnd = opnd_create_reg(opnd_get_index(instr_get_src(inst, 0)));
         } else {
-            opnd = instr_get_src(&inst, i);
+            opnd = instr_get_src(inst, i);
         }
         if (opnd_is_memory_reference(opnd)) {
             int flags = 0;
-            opnd = adjust_memop(&inst, opnd, false, &sz, &pushpop_stackop);
+            opnd = adjust_memop(inst, opnd, false, &sz, &pushpop_stackop);
             /* do not combine srcs if checking after */
             if (check_srcs_after) {
                 ASSERT(i == 0 || sz >= comb.opsz, "check-after needs >=-size srcs");
@@ -713,7 +866,7 @@ slow_path_with_mc(void *drcontext, app_pc pc, app_pc decode_pc, dr_mcontext_t *m
             if (always_defined) {
                 LOG(2, "marking and/or/xor with 0/~0/self as defined @"PFX"\n", pc);
                 /* w/o MEMREF_USE_VALUES, handle_mem_ref() will use SHADOW_DEFINED */
-            } else if (check_definedness || always_check_definedness(&inst, i)) {
+            } else if (check_definedness || always_check_definedness(inst, i)) {
                 flags |= MEMREF_CHECK_DEFINEDNESS;
                 if (options.leave_uninit)
                     flags |= MEMREF_USE_VALUES;
@@ -747,8 +900,8 @@ slow_path_with_mc(void *drcontext, app_pc pc, app_pc decode_pc, dr_mcontext_t *m
                 if (always_defined) {
                     /* if result defined regardless, don't propagate (is
                      * equivalent to propagating SHADOW_DEFINED) or check */
-                } else if (check_definedness || always_check_definedness(&inst, i)) {
-                    check_register_defined(drcontext, reg, &loc, sz, mc, &inst);
+                } else if (check_definedness || always_check_definedness(inst, i)) {
+                    check_register_defined(drcontext, reg, &loc, sz, mc, inst);
                     if (options.leave_uninit) {
                         integrate_register_shadow(&comb, i, reg, shadow, pushpop);
                     }
@@ -771,14 +924,14 @@ slow_path_with_mc(void *drcontext, app_pc pc, app_pc decode_pc, dr_mcontext_t *m
     }
 
     /* eflags source */
-    if (TESTANY(EFLAGS_READ_ARITH, instr_get_eflags(&inst, DR_QUERY_DEFAULT))) {
+    if (TESTANY(EFLAGS_READ_ARITH, instr_get_eflags(inst, DR_QUERY_DEFAULT))) {
         uint shadow = get_shadow_eflags();
         /* for check_srcs_after we leave comb.dst where it last was */
         if (always_defined) {
             /* if result defined regardless, don't propagate (is
              * equivalent to propagating SHADOW_DEFINED) or check */
         } else if (check_definedness) {
-            check_register_defined(drcontext, REG_EFLAGS, &loc, 1, mc, &inst);
+            check_register_defined(drcontext, REG_EFLAGS, &loc, 1, mc, inst);
             if (options.leave_uninit)
                 integrate_register_shadow(&comb, 0, REG_EFLAGS, shadow, pushpop);
         } else {
@@ -797,10 +950,10 @@ slow_path_with_mc(void *drcontext, app_pc pc, app_pc decode_pc, dr_mcontext_t *m
 
     if (check_srcs_after) {
         /* turn back on for dsts */
-        check_definedness = instr_check_definedness(&inst);
-        if (check_andor_sources(drcontext, mc, &inst, &comb, decode_pc + instr_sz)) {
+        check_definedness = decoded->check_definedness;
+        if (check_andor_sources(drcontext, mc, inst, &comb, decode_pc + instr_sz)) {
             if (TESTANY(EFLAGS_WRITE_ARITH,
-                        instr_get_eflags(&inst, DR_QUERY_INCLUDE_ALL))) {
+                        instr_get_eflags(inst, DR_QUERY_INCLUDE_ALL))) {
                 /* We have to redo the eflags propagation.  map_src_to_dst() combined
                  * all the laid-out sources, some of which we made defined in
                  * check_andor_sources.
@@ -837,12 +990,12 @@ slow_path_with_mc(void *drcontext, app_pc pc, app_pc decode_pc, dr_mcontext_t *m
         }
     }
 
-    num_dsts = num_true_dsts(&inst, mc);
+    num_dsts = num_true_dsts(inst, mc);
     for (i = 0; i < num_dsts; i++) {
-        opnd = instr_get_dst(&inst, i);
+        opnd = instr_get_dst(inst, i);
         if (opnd_is_memory_reference(opnd)) {
             int flags = MEMREF_WRITE;
-            opnd = adjust_memop(&inst, opnd, true, &sz, &pushpop_stackop);
+            opnd = adjust_memop(inst, opnd, true, &sz, &pushpop_stackop);
             if (pushpop_stackop)
                 flags |= MEMREF_PUSHPOP;
             if (cpt->mem2fpmm_source != NULL && cpt->mem2fpmm_pc == pc) {
@@ -884,14 +1037,14 @@ slow_path_with_mc(void *drcontext, app_pc pc, app_pc decode_pc, dr_mcontext_t *m
         } else
             ASSERT(opnd_is_immed_int(opnd) || opnd_is_pc(opnd), "unexpected opnd");
     }
-    if (TESTANY(EFLAGS_WRITE_ARITH, instr_get_eflags(&inst, DR_QUERY_INCLUDE_ALL))) {
+    if (TESTANY(EFLAGS_WRITE_ARITH, instr_get_eflags(inst, DR_QUERY_INCLUDE_ALL))) {
         set_shadow_eflags(comb.eflags);
     }
 
     LOG(4, "shadow registers after instr:\n");
     DOLOG(4, { print_shadow_registers(); });
 
-    instr_free(drcontext, &inst);
+    slowpath_decode_done(drcontext, decoded, &local_decode);
 
     /* call this last after freeing inst in case it does a synchronous flush */
     slow_path_xl8_sharing(&loc, instr_sz, memop, mc);
@@ -1894,6 +2047,9 @@ slowpath_module_load(void *drcontext, const module_data_t *mod, bool loaded)
 void
 slowpath_module_unload(void *drcontext, const module_data_t *mod)
 {
+#ifdef TOOL_DR_MEMORY
+    ATOMIC_INC32(decode_cache_module_gen);
+#endif
 #ifdef WINDOWS
     if (_stricmp("rsaenh.dll", dr_module_preferred_name(mod)) == 0) {
         rsaenh_base = (app_pc) POINTER_MAX;
@@ -1922,8 +2078,15 @@ main(int argc, char *argv[])
 {
     void *drcontext = dr_standalone_init();
 
+    if (argc > 1 && strcmp(argv[1], "-bench") == 0) {
+        crypto_unit_benchmark();
+        return 0;
+    }
+
     slowpath_unit_tests_arch(drcontext);
 
+    crypto_unit_tests();
+
     /* add more tests here */
 
     dr_printf("success\n");
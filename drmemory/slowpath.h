@@ -98,6 +98,8 @@ extern uint64 slowpath_sz16;
 extern uint64 slowpath_szOther;
 /* FIXME: make generalized stats infrastructure */
 extern uint slowpath_executions;
+extern uint slowpath_decode_hits;
+extern uint slowpath_decode_misses;
 extern uint medpath_executions;
 extern uint read_slowpath;
 extern uint write_slowpath;
@@ -135,6 +137,8 @@ extern uint reg_spill_own;
 extern uint reg_spill_used_in_bb;
 extern uint reg_spill_unused_in_bb;
 extern uint addressable_checks_elided;
+extern uint dead_reg_shadow_elided;
+extern uint dead_eflags_shadow_elided;
 extern uint aflags_saved_at_top;
 extern uint num_faults;
 extern uint num_slowpath_faults;
@@ -148,6 +152,10 @@ extern uint xl8_not_shared_offs;
 extern uint xl8_not_shared_slowpaths;
 extern uint xl8_shared_slowpath_instrs;
 extern uint xl8_shared_slowpath_count;
+extern uint xl8_stack_instrs;
+extern uint xl8_stack_hits;
+extern uint xl8_stack_misses;
+extern uint xl8_stack_refreshes;
 extern uint slowpath_unaligned;
 extern uint slowpath_8_at_border;
 extern uint alloc_stack_count;
@@ -208,6 +216,14 @@ instrument_slowpath(void *drcontext, instrlist_t *bb, instr_t *inst, fastpath_in
 bool
 slow_path_with_mc(void *drcontext, app_pc pc, app_pc decode_pc, dr_mcontext_t *mc);
 
+#ifdef TOOL_DR_MEMORY
+void
+slowpath_thread_exit(void *drcontext);
+
+void
+slowpath_fragment_delete(void *drcontext, app_pc start, size_t size);
+#endif
+
 void
 slowpath_module_load(void *drcontext, const module_data_t *mod, bool loaded);
 
@@ -48,9 +48,20 @@
 
 /* We used to store segment bases in some TLS slots that were followed by the
  * reg spill slots, but now that DR has API support for bases we don't need them
- * anymore:
+ * anymore.  The only instru slots left are the per-thread stack translation
+ * cache for -stack_xl8_cache.
  */
-#define NUM_INSTRU_TLS_SLOTS 0
+enum {
+    INSTRU_TLS_STACK_XL8_BASE,   /* app base of the cached stack unit */
+    INSTRU_TLS_STACK_XL8_SHADOW, /* shadow address of that base */
+    INSTRU_TLS_STACK_XL8_NUM,
+};
+#if defined(TOOL_DR_MEMORY) && !defined(X64)
+# define NUM_INSTRU_TLS_SLOTS \
+    (options.stack_xl8_cache ? INSTRU_TLS_STACK_XL8_NUM : 0)
+#else
+# define NUM_INSTRU_TLS_SLOTS 0
+#endif
 
 /* drreg allocates our reg spill slots in pattern mode */
 #define NUM_TLS_SLOTS \
@@ -176,6 +187,36 @@ num_own_spill_slots(void)
     return options.num_spill_slots;
 }
 
+#if defined(TOOL_DR_MEMORY) && !defined(X64)
+opnd_t
+opnd_create_stack_xl8_slot(bool shadow)
+{
+    ASSERT(options.stack_xl8_cache, "incorrectly called");
+    return opnd_create_far_base_disp_ex
+        (seg_tls, REG_NULL, REG_NULL, 0,
+         tls_instru_base + (shadow ? INSTRU_TLS_STACK_XL8_SHADOW :
+                            INSTRU_TLS_STACK_XL8_BASE)*sizeof(ptr_uint_t), OPSZ_PTR,
+         false, true, false);
+}
+
+app_pc
+get_stack_xl8_base(void)
+{
+    ASSERT(options.stack_xl8_cache, "incorrectly called");
+    return *(app_pc *)(get_own_seg_base() + tls_instru_base +
+                       INSTRU_TLS_STACK_XL8_BASE*sizeof(ptr_uint_t));
+}
+
+void
+set_stack_xl8_slots(app_pc base, byte *shadow)
+{
+    byte *tls = get_own_seg_base() + tls_instru_base;
+    ASSERT(options.stack_xl8_cache, "incorrectly called");
+    *(app_pc *)(tls + INSTRU_TLS_STACK_XL8_BASE*sizeof(ptr_uint_t)) = base;
+    *(byte **)(tls + INSTRU_TLS_STACK_XL8_SHADOW*sizeof(ptr_uint_t)) = shadow;
+}
+#endif
+
 static opnd_t
 opnd_create_own_spill_slot(uint index)
 {
@@ -1367,6 +1408,9 @@ fastpath_top_of_bb(void *drcontext, void *tag, instrlist_t *bb, bb_info_t *bi)
         }
         inst = instrlist_first(bb);
     }
+#endif
+#if defined(TOOL_DR_MEMORY) && defined(X86)
+    fastpath_shadow_liveness(bb, bi);
 #endif
     if (inst == NULL || !whole_bb_spills_enabled() ||
         /* pattern is using drreg */
@@ -1403,6 +1447,13 @@ fastpath_pre_instrument(void *drcontext, instrlist_t *bb, instr_t *inst, bb_info
             bi->first_app_pc = pc;
         bi->last_app_pc = pc;
     }
+#ifdef TOOL_DR_MEMORY
+    if (bi->app_instr_idx < bi->num_shadow_dead)
+        bi->cur_shadow_dead = bi->shadow_dead[bi->app_instr_idx];
+    else
+        bi->cur_shadow_dead = 0;
+    bi->app_instr_idx++;
+#endif
 
     if (!whole_bb_spills_enabled())
         return;
@@ -98,6 +98,20 @@ instru_tls_exit(void);
 void
 instru_tls_thread_init(void *drcontext);
 
+#if defined(TOOL_DR_MEMORY) && !defined(X64)
+/* The -stack_xl8_cache slots: the 64K-aligned app base of the current
+ * thread's cached stack unit and the shadow address it translates to.
+ */
+opnd_t
+opnd_create_stack_xl8_slot(bool shadow);
+
+app_pc
+get_stack_xl8_base(void);
+
+void
+set_stack_xl8_slots(app_pc base, byte *shadow);
+#endif
+
 void
 instru_tls_thread_exit(void *drcontext);
 
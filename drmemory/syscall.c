@@ -30,6 +30,7 @@
 #include "syscall_os.h"
 #include "alloc.h"
 #include "perturb.h"
+#include "flush.h"
 #ifdef UNIX
 # include "sysnum_linux.h"
 #endif
@@ -461,6 +462,11 @@ event_pre_syscall(void *drcontext, int sysnum)
     if (drsys_get_mcontext(drcontext, &mc) != DRMF_SUCCESS)
         ASSERT(false, "drsys_get_mcontext failed");
 
+    /* Issue any flushes the rate limit deferred, for apps that rarely
+     * take a slowpath.
+     */
+    flush_safe_point(true/*unlink ok*/);
+
 #ifdef STATISTICS
     /* XXX: we could dynamically allocate entries and separate secondary syscalls */
     if (sysnum >= MAX_SYSNUM-1) {
@@ -559,10 +565,126 @@ event_post_syscall(void *drcontext, int sysnum)
     }
 }
 
+/***************************************************************************
+ * SYSCALL FILTERING
+ */
+
+/* Bitmap of primary system call numbers that we have determined at init time
+ * need no processing by any component.  A clear bit, or a number beyond the
+ * bitmap, means the syscall is intercepted.  The bitmap is read-only after
+ * init so the filter needs no lock.
+ */
+#define SKIP_BITMAP_SYSNUMS 2048
+static byte syscall_skip[SKIP_BITMAP_SYSNUMS / 8];
+/* Syscalls seen in the tables that need processing.  Used only at init to
+ * combine secondary syscalls sharing a primary number.
+ */
+static byte syscall_need[SKIP_BITMAP_SYSNUMS / 8];
+
+static inline bool
+sysnum_bit_test(byte *bitmap, int sysnum)
+{
+    return (sysnum >= 0 && sysnum < SKIP_BITMAP_SYSNUMS &&
+            TEST(1 << (sysnum % 8), bitmap[sysnum / 8]));
+}
+
+static inline void
+sysnum_bit_set(byte *bitmap, int sysnum)
+{
+    ASSERT(sysnum >= 0 && sysnum < SKIP_BITMAP_SYSNUMS, "sysnum out of range");
+    bitmap[sysnum / 8] |= (byte)(1 << (sysnum % 8));
+}
+
+#ifdef X86
+static bool
+filter_arg_type_cb(drsys_arg_t *arg, void *user_data)
+{
+    if (TEST(DRSYS_PARAM_RETVAL, arg->mode))
+        return true; /* keep going */
+    *(bool *)user_data = true;
+    return false; /* stop */
+}
+#endif
+
+static bool
+syscall_needs_processing(void *drcontext, drsys_sysnum_t num, drsys_syscall_t *syscall)
+{
+    bool known;
+    if (drsys_syscall_is_known(syscall, &known) != DRMF_SUCCESS || !known)
+        return true;
+    if (os_syscall_filter(num.number) ||
+        alloc_syscall_filter(drcontext, num.number) ||
+        (options.perturb && perturb_syscall_filter(num.number)) ||
+        auxlib_known_syscall(num.number))
+        return true;
+    if (options.shadowing) {
+#ifdef X86
+        /* Dr. Syscall determines some parameters dynamically (e.g., from an
+         * ioctl or fcntl request code) which a static query cannot see, so
+         * we only skip syscalls that take no parameters at all.
+         * Skipping the post-syscall marking of the return register as defined
+         * is fine here: the return register is the one holding the syscall
+         * number, which the wrappers materialize from an immediate.
+         */
+        bool has_params = false;
+        if (drsys_iterate_arg_types(syscall, filter_arg_type_cb, &has_params) !=
+            DRMF_SUCCESS || has_params)
+            return true;
+#else
+        /* The result goes to r0, which is unrelated to the syscall number in
+         * r7 and may have undefined shadow: we need the post-syscall event to
+         * mark it defined.
+         */
+        return true;
+#endif
+    }
+    return false;
+}
+
+static bool
+syscall_filter_iter_cb(drsys_sysnum_t num, drsys_syscall_t *syscall, void *user_data)
+{
+    void *drcontext = user_data;
+    if (num.number < 0 || num.number >= SKIP_BITMAP_SYSNUMS)
+        return true; /* keep going: intercepted by default */
+    if (syscall_needs_processing(drcontext, num, syscall)) {
+        sysnum_bit_set(syscall_need, num.number);
+        /* Dr. Syscall only tracks the syscalls it is told to */
+        if (drsys_filter_syscall(num) != DRMF_SUCCESS)
+            ASSERT(false, "drsys_filter_syscall should never fail");
+    } else
+        sysnum_bit_set(syscall_skip, num.number);
+    return true; /* keep going */
+}
+
+static void
+syscall_filter_init(void *drcontext)
+{
+    int i, count = 0;
+    bool filter = options.filter_syscalls;
+    /* verbose logging wants to see every syscall */
+    DOLOG(SYSCALL_VERBOSE, { filter = false; });
+    if (!filter) {
+        if (drsys_filter_all_syscalls() != DRMF_SUCCESS)
+            ASSERT(false, "drsys_filter_all_syscalls should never fail");
+        return;
+    }
+    if (drsys_iterate_syscalls(syscall_filter_iter_cb, drcontext) != DRMF_SUCCESS)
+        ASSERT(false, "drsys_iterate_syscalls failed");
+    /* A primary number is only skipped if none of its secondaries need us */
+    for (i = 0; i < BUFFER_SIZE_ELEMENTS(syscall_skip); i++)
+        syscall_skip[i] &= ~syscall_need[i];
+    for (i = 0; i < SKIP_BITMAP_SYSNUMS; i++) {
+        if (sysnum_bit_test(syscall_skip, i))
+            count++;
+    }
+    LOG(1, "not intercepting %d system calls\n", count);
+}
+
 static bool
 event_filter_syscall(void *drcontext, int sysnum)
 {
-    return true; /* intercept everything */
+    return !sysnum_bit_test(syscall_skip, sysnum);
 }
 
 static void
@@ -643,6 +765,12 @@ is_register_defined(reg_id_t reg)
     return is_shadow_register_defined(get_shadow_register(reg));
 }
 
+/* Stored alongside the symcache files.  The layouts are bitwidth-specific. */
+#define UNKNOWN_LAYOUT_FILE IF_X64_ELSE("unknown_syscalls_x64.txt", \
+                                        "unknown_syscalls_x86.txt")
+/* drsys_init() does not copy the path so it needs to persist */
+static char unknown_layout_path[MAXIMUM_PATH];
+
 void
 syscall_init(void *drcontext _IF_WINDOWS(app_pc ntdll_base))
 {
@@ -659,6 +787,13 @@ syscall_init(void *drcontext _IF_WINDOWS(app_pc ntdll_base))
 #ifdef SYSCALL_DRIVER
     ops.syscall_driver = options.syscall_driver;
 #endif
+    ops.unknown_layout_threshold = options.unknown_syscall_cache_threshold;
+    if (options.use_symcache && options.unknown_syscall_cache_threshold > 0) {
+        dr_snprintf(unknown_layout_path, BUFFER_SIZE_ELEMENTS(unknown_layout_path),
+                    "%s%c%s", options.symcache_dir, DIRSEP, UNKNOWN_LAYOUT_FILE);
+        NULL_TERMINATE_BUFFER(unknown_layout_path);
+        ops.unknown_layout_file = unknown_layout_path;
+    }
     if (options.shadowing) {
         ops.is_byte_addressable = is_byte_addressable;
         if (options.check_uninitialized) {
@@ -722,18 +857,18 @@ syscall_init(void *drcontext _IF_WINDOWS(app_pc ntdll_base))
 
     syscall_os_init(drcontext _IF_WINDOWS(ntdll_base));
 
+    /* We support additional system call handling via a separate shared library */
+    if (options.auxlib[0] != '\0')
+        syscall_load_auxlib(options.auxlib);
+
     /* We register our own filter to be independent of
      * drsys_filter_all_syscalls() for our own syscall tracking needs.
+     * The filter consults the auxlib so it must be loaded first.
      */
+    syscall_filter_init(drcontext);
     dr_register_filter_syscall_event(event_filter_syscall);
     drmgr_register_pre_syscall_event(event_pre_syscall);
     drmgr_register_post_syscall_event(event_post_syscall);
-    if (drsys_filter_all_syscalls() != DRMF_SUCCESS)
-        ASSERT(false, "drsys_filter_all_syscalls should never fail");
-
-    /* We support additional system call handling via a separate shared library */
-    if (options.auxlib[0] != '\0')
-        syscall_load_auxlib(options.auxlib);
 }
 
 void
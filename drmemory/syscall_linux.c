@@ -265,6 +265,20 @@ handle_pre_execve(void *drcontext)
 #endif
 }
 
+bool
+os_syscall_filter(int sysnum)
+{
+    switch (sysnum) {
+    case SYS_execve:
+    case SYS_clone:
+    case SYS_fork:
+    case SYS_prctl:
+        return true;
+    default:
+        return false;
+    }
+}
+
 /* for tasks unrelated to shadowing that are common to all tools */
 bool
 os_shared_pre_syscall(void *drcontext, cls_syscall_t *pt, drsys_sysnum_t sysnum,
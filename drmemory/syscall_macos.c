@@ -65,6 +65,12 @@ os_process_syscall_memarg(drsys_arg_t *arg)
     return false; /* not handled */
 }
 
+bool
+os_syscall_filter(int sysnum)
+{
+    return false; /* nothing handled yet (i#1438) */
+}
+
 /* for tasks unrelated to shadowing that are common to all tools */
 bool
 os_shared_pre_syscall(void *drcontext, cls_syscall_t *pt, drsys_sysnum_t sysnum,
@@ -52,6 +52,10 @@ syscall_os_thread_exit(void *drcontext);
 void
 syscall_os_module_load(void *drcontext, const module_data_t *info, bool loaded);
 
+/* returns whether os_shared_{pre,post}_syscall() need to see sysnum */
+bool
+os_syscall_filter(int sysnum);
+
 /* for tasks unrelated to shadowing that are common to all tools */
 bool
 os_shared_pre_syscall(void *drcontext, cls_syscall_t *pt, drsys_sysnum_t sysnum,
@@ -496,6 +496,15 @@ syscall_creates_handle(void *drcontext, drsys_sysnum_t sysnum)
  * TOP LEVEL
  */
 
+bool
+os_syscall_filter(int sysnum)
+{
+    /* Handle tracking and the many per-syscall handlers here have not been
+     * audited for filtering, so we intercept everything.
+     */
+    return true;
+}
+
 bool
 os_shared_pre_syscall(void *drcontext, cls_syscall_t *pt, drsys_sysnum_t sysnum,
                       dr_mcontext_t *mc, drsys_syscall_t *syscall)
@@ -24,7 +24,7 @@
  * XXX: add more features, such as:
  * + named constants for flags
  * + callstacks
- * + timestamps
+ * + timestamps (recorded in -binary logs but not yet printed)
  *
  * XXX i#1497: port to Linux
  * XXX i#1498: port to MacOS
@@ -91,20 +91,178 @@ typedef struct _drstrace_options_t {
     char logdir[MAXIMUM_PATH];
     char sympath[MAXIMUM_PATH]; /* The path to wintypes.pdb */
     char sysnum_file[MAXIMUM_PATH]; /* The path to the syscall number file. */
+    bool binary; /* Write raw records for drstrace_decode instead of text */
 } drstrace_options_t;
 
 static drstrace_options_t options;
 
+/****************************************************************************
+ * Binary log format
+ *
+ * With -binary, each thread appends raw records for its system calls to a
+ * private buffer, which is written to the log in one piece when it fills.
+ * The file starts with a strace_file_header_t followed by top-level records,
+ * each starting with a strace_rec_header_t:
+ * + STRACE_REC_STRING interns a name referenced by id from later records.
+ *   It is written before any record that uses its id.
+ * + STRACE_REC_CHUNK holds one flush of one thread's buffer: a sequence of
+ *   STRACE_REC_PRE and STRACE_REC_POST records.
+ * Each syscall record is followed by its args, and each arg by copies of the
+ * app memory that the printers below dereference for it.  drstrace_decode
+ * replays these through the same printers to produce the text log.
+ * All records are 8-byte aligned.
+ */
+
+#define STRACE_BINARY_MAGIC "DRSTRBIN"
+#define STRACE_BINARY_VERSION 1
+
+enum {
+    STRACE_REC_STRING,
+    STRACE_REC_CHUNK,
+    STRACE_REC_PRE,
+    STRACE_REC_POST,
+};
+
+typedef struct _strace_file_header_t {
+    char magic[8];
+    uint version;
+    uint pointer_size;
+} strace_file_header_t;
+
+typedef struct _strace_rec_header_t {
+    ushort kind;
+    ushort count; /* number of args for STRACE_REC_{PRE,POST} */
+    uint size;    /* including this header and all trailing data */
+} strace_rec_header_t;
+
+/* Followed by the NUL-terminated string */
+typedef struct _strace_string_rec_t {
+    strace_rec_header_t header;
+    uint id;
+    uint pad;
+} strace_string_rec_t;
+
+/* Followed by the thread's records */
+typedef struct _strace_chunk_rec_t {
+    strace_rec_header_t header;
+    uint64 thread_id;
+} strace_chunk_rec_t;
+
+#define STRACE_FLAG_KNOWN     0x1 /* pre: all details are known */
+#define STRACE_FLAG_SUCCEEDED 0x2 /* post */
+
+/* Followed by header.count args */
+typedef struct _strace_syscall_rec_t {
+    strace_rec_header_t header;
+    uint64 timestamp; /* dr_get_microseconds() */
+    uint sysnum;
+    uint secondary;
+    uint name_id; /* STRACE_REC_PRE only */
+    uint flags;
+    uint64 error; /* STRACE_REC_POST only */
+} strace_syscall_rec_t;
+
+/* Followed by num_captures strace_capture_t */
+typedef struct _strace_arg_rec_t {
+    int ordinal;
+    uint mode;
+    uint type;
+    uint size;
+    uint64 value;
+    uint arg_name_id;
+    uint type_name_id;
+    uint enum_name_id;
+    uint num_captures;
+} strace_arg_rec_t;
+
+/* Followed by size bytes of app memory, padded to 8 */
+typedef struct _strace_capture_t {
+    uint64 addr;
+    uint size;
+    uint pad;
+} strace_capture_t;
+
+/****************************************************************************
+ * App memory access for the printers
+ *
+ * The printers below read app memory only through these, so that the offline
+ * decoder can supply the memory captured in a binary log instead.
+ */
+
+#ifdef DRSTRACE_DECODER
+typedef struct _decode_capture_t {
+    byte *addr;
+    size_t size;
+    byte *data;
+} decode_capture_t;
+
+/* The captures for the record being decoded */
+# define DECODE_MAX_CAPTURES 64
+static decode_capture_t decode_captures[DECODE_MAX_CAPTURES];
+static uint decode_num_captures;
+
+static void *
+app_mem(void *addr, size_t size)
+{
+    uint i;
+    for (i = 0; i < decode_num_captures; i++) {
+        decode_capture_t *c = &decode_captures[i];
+        if ((byte *)addr >= c->addr && size <= c->size &&
+            (size_t)((byte *)addr - c->addr) <= c->size - size)
+            return c->data + ((byte *)addr - c->addr);
+    }
+    return NULL;
+}
+
+static bool
+read_app_mem(void *addr, size_t size, void *out)
+{
+    void *local = app_mem(addr, size);
+    if (local == NULL)
+        return false;
+    memcpy(out, local, size);
+    return true;
+}
+#else
+/* Returns a pointer through which size bytes of app memory at addr can be
+ * read directly, or NULL.
+ */
+static inline void *
+app_mem(void *addr, size_t size)
+{
+    return addr;
+}
+
+static inline bool
+read_app_mem(void *addr, size_t size, void *out)
+{
+    return dr_safe_read(addr, size, out, NULL);
+}
+#endif
+
 static void
-print_unicode_string(buf_info_t *buf, UNICODE_STRING *us)
+print_unicode_string(buf_info_t *buf, UNICODE_STRING *app_us)
 {
-    if (us == NULL)
+    UNICODE_STRING *us;
+    wchar_t *str;
+    if (app_us == NULL) {
         OUTPUT(buf, "<null>");
+        return;
+    }
+    us = (UNICODE_STRING *) app_mem(app_us, sizeof(*us));
+    if (us == NULL) {
+        OUTPUT(buf, "<not captured>");
+        return;
+    }
+    if (us->Buffer == NULL)
+        str = L"<null>";
     else {
-        OUTPUT(buf, "%d/%d \"%.*S\"", us->Length, us->MaximumLength,
-               us->Length/sizeof(wchar_t),
-               (us->Buffer == NULL) ? L"<null>" : us->Buffer);
+        str = (wchar_t *) app_mem(us->Buffer, us->Length);
+        if (str == NULL)
+            str = L"<not captured>";
     }
+    OUTPUT(buf, "%d/%d \"%.*S\"", us->Length, us->MaximumLength,
+           us->Length/sizeof(wchar_t), str);
 }
 
 void
@@ -117,7 +275,7 @@ print_simple_value(buf_info_t *buf, drsys_arg_t *arg, bool leading_zeroes)
         ptr_uint_t deref = 0;
         ASSERT(arg->size <= sizeof(deref), "too-big simple type");
         /* We assume little-endian */
-        if (dr_safe_read((void *)arg->value, arg->size, &deref, NULL))
+        if (read_app_mem((void *)arg->value, arg->size, &deref))
             OUTPUT(buf, (leading_zeroes ? " => "PFX : " => "PIFX), deref);
     }
 }
@@ -194,7 +352,7 @@ safe_read_field(buf_info_t *buf, void *addr_to_resolve, size_t addr_size,
 {
     int64 mem_value = 0;
     ASSERT(addr_size <= sizeof(mem_value), "too-big mem value to read");
-    if (!dr_safe_read(addr_to_resolve, addr_size, &mem_value, NULL)) {
+    if (!read_app_mem(addr_to_resolve, addr_size, &mem_value)) {
         OUTPUT(buf, "<field unreadable>");
         return 0;
     }
@@ -212,7 +370,11 @@ print_known_compound_type(buf_info_t *buf, drsys_param_type_t type, void *start_
         break;
     }
     case DRSYS_TYPE_OBJECT_ATTRIBUTES: {
-        OBJECT_ATTRIBUTES *oa = (OBJECT_ATTRIBUTES *) start_addr;
+        OBJECT_ATTRIBUTES *oa = (OBJECT_ATTRIBUTES *) app_mem(start_addr, sizeof(*oa));
+        if (oa == NULL) {
+            OUTPUT(buf, "<not captured>");
+            break;
+        }
         OUTPUT(buf, "len="PIFX", root="PIFX", name=",
                 oa->Length, oa->RootDirectory);
         print_unicode_string(buf, oa->ObjectName);
@@ -222,13 +384,21 @@ print_known_compound_type(buf_info_t *buf, drsys_param_type_t type, void *start_
         break;
     }
     case DRSYS_TYPE_IO_STATUS_BLOCK: {
-        IO_STATUS_BLOCK *io = (IO_STATUS_BLOCK *) start_addr;
+        IO_STATUS_BLOCK *io = (IO_STATUS_BLOCK *) app_mem(start_addr, sizeof(*io));
+        if (io == NULL) {
+            OUTPUT(buf, "<not captured>");
+            break;
+        }
         OUTPUT(buf, "status="PIFX", info="PIFX"", io->StatusPointer.Status,
                 io->Information);
         break;
     }
     case DRSYS_TYPE_LARGE_INTEGER: {
-        LARGE_INTEGER *li = (LARGE_INTEGER *) start_addr;
+        LARGE_INTEGER *li = (LARGE_INTEGER *) app_mem(start_addr, sizeof(*li));
+        if (li == NULL) {
+            OUTPUT(buf, "<not captured>");
+            break;
+        }
         OUTPUT(buf, "0x"HEX64_FORMAT_STRING, li->QuadPart);
         break;
     }
@@ -497,17 +667,247 @@ print_arg(buf_info_t *buf, drsys_arg_t *arg)
            arg->size);
 }
 
+static inline bool
+arg_is_printed(drsys_arg_t *arg)
+{
+    return ((arg->pre && !TEST(DRSYS_PARAM_RETVAL, arg->mode)) ||
+            (!arg->pre && TESTANY(DRSYS_PARAM_OUT|DRSYS_PARAM_RETVAL, arg->mode)));
+}
+
 static bool
 drsys_iter_arg_cb(drsys_arg_t *arg, void *user_data)
 {
     buf_info_t *buf = (buf_info_t *) user_data;
     ASSERT(arg->valid, "no args should be invalid");
-    if ((arg->pre && !TEST(DRSYS_PARAM_RETVAL, arg->mode)) ||
-        (!arg->pre && TESTANY(DRSYS_PARAM_OUT|DRSYS_PARAM_RETVAL, arg->mode)))
-            print_arg(buf, arg);
+    if (arg_is_printed(arg))
+        print_arg(buf, arg);
+    return true; /* keep going */
+}
+
+/****************************************************************************
+ * Binary logging
+ */
+
+#define BINBUF_SIZE (256*1024)
+/* We reserve this much before starting each record so that a record is
+ * never split across chunks.  Captures that do not fit are dropped.
+ */
+#define BINREC_MAX_SIZE (16*1024)
+#define CAPTURE_MAX_SIZE 1024
+#define STRING_CAPTURE_MAX_SIZE (4*1024)
+#define INTERN_CACHE_SIZE 64 /* power of 2 */
+#define INTERN_TABLE_BITSIZE 10
+
+typedef struct _binbuf_t {
+    /* Starts with a strace_chunk_rec_t that is filled in at flush time */
+    byte *buf;
+    size_t sofar;
+    size_t rec_limit;
+    strace_syscall_rec_t *cur;
+    thread_id_t tid;
+    /* Direct-mapped cache of string ids, to avoid binary_lock on each arg */
+    const char *intern_str[INTERN_CACHE_SIZE];
+    uint intern_id[INTERN_CACHE_SIZE];
+} binbuf_t;
+
+static int tls_idx = -1;
+/* Serializes writes to outf and updates to intern_table */
+static void *binary_lock;
+/* Maps a string's address to its id.  drsyscall's names live as long as we do. */
+static hashtable_t intern_table;
+static uint intern_next_id;
+
+static void
+binary_write_file_header(void)
+{
+    strace_file_header_t header;
+    memcpy(header.magic, STRACE_BINARY_MAGIC, sizeof(header.magic));
+    header.version = STRACE_BINARY_VERSION;
+    header.pointer_size = sizeof(void *);
+    dr_write_file(outf, &header, sizeof(header));
+}
+
+static uint
+binary_intern(binbuf_t *bb, const char *str)
+{
+    uint slot, id;
+    if (str == NULL)
+        return 0;
+    slot = (uint)(((ptr_uint_t)str >> 3) & (INTERN_CACHE_SIZE - 1));
+    if (bb->intern_str[slot] == str)
+        return bb->intern_id[slot];
+    dr_mutex_lock(binary_lock);
+    id = (uint)(ptr_uint_t) hashtable_lookup(&intern_table, (void *)str);
+    if (id == 0) {
+        static const char zeroes[8];
+        strace_string_rec_t rec;
+        size_t len = strlen(str) + 1;
+        id = ++intern_next_id;
+        hashtable_add(&intern_table, (void *)str, (void *)(ptr_uint_t)id);
+        rec.header.kind = STRACE_REC_STRING;
+        rec.header.count = 0;
+        rec.header.size = (uint) ALIGN_FORWARD(sizeof(rec) + len, 8);
+        rec.id = id;
+        rec.pad = 0;
+        /* Written while holding the lock, so it precedes any chunk using id */
+        dr_write_file(outf, &rec, sizeof(rec));
+        dr_write_file(outf, str, len);
+        dr_write_file(outf, zeroes, rec.header.size - sizeof(rec) - len);
+    }
+    dr_mutex_unlock(binary_lock);
+    bb->intern_str[slot] = str;
+    bb->intern_id[slot] = id;
+    return id;
+}
+
+static void
+binary_flush(binbuf_t *bb)
+{
+    strace_chunk_rec_t *chunk = (strace_chunk_rec_t *) bb->buf;
+    if (bb->sofar <= sizeof(*chunk))
+        return;
+    chunk->header.kind = STRACE_REC_CHUNK;
+    chunk->header.count = 0;
+    chunk->header.size = (uint) bb->sofar;
+    chunk->thread_id = bb->tid;
+    dr_mutex_lock(binary_lock);
+    dr_write_file(outf, bb->buf, bb->sofar);
+    dr_mutex_unlock(binary_lock);
+    bb->sofar = sizeof(*chunk);
+}
+
+/* Returns space for size bytes in the current record, or NULL if it is full */
+static void *
+binary_reserve(binbuf_t *bb, size_t size)
+{
+    void *res;
+    ASSERT(ALIGNED(size, 8), "records must stay aligned");
+    if (bb->sofar + size > bb->rec_limit)
+        return NULL;
+    res = bb->buf + bb->sofar;
+    bb->sofar += size;
+    return res;
+}
+
+static void
+binary_capture(binbuf_t *bb, strace_arg_rec_t *rec, void *addr, size_t size,
+               size_t max)
+{
+    strace_capture_t *cap;
+    size_t padded;
+    if (addr == NULL || size == 0)
+        return;
+    if (size > max)
+        size = max;
+    padded = sizeof(*cap) + ALIGN_FORWARD(size, 8);
+    cap = (strace_capture_t *) binary_reserve(bb, padded);
+    if (cap == NULL)
+        return;
+    if (!dr_safe_read(addr, size, cap + 1, NULL)) {
+        bb->sofar -= padded;
+        return;
+    }
+    cap->addr = (uint64)(ptr_uint_t) addr;
+    cap->size = (uint) size;
+    cap->pad = 0;
+    rec->num_captures++;
+}
+
+static void
+binary_capture_unicode_string(binbuf_t *bb, strace_arg_rec_t *rec, UNICODE_STRING *app_us)
+{
+    UNICODE_STRING us;
+    if (dr_safe_read(app_us, sizeof(us), &us, NULL))
+        binary_capture(bb, rec, us.Buffer, us.Length, STRING_CAPTURE_MAX_SIZE);
+}
+
+static bool
+binary_iter_arg_cb(drsys_arg_t *arg, void *user_data)
+{
+    binbuf_t *bb = (binbuf_t *) user_data;
+    strace_arg_rec_t *rec;
+    ASSERT(arg->valid, "no args should be invalid");
+    if (!arg_is_printed(arg))
+        return true;
+    rec = (strace_arg_rec_t *) binary_reserve(bb, sizeof(*rec));
+    if (rec == NULL)
+        return false; /* record is full */
+    bb->cur->header.count++;
+    rec->ordinal = arg->ordinal;
+    rec->mode = arg->mode;
+    rec->type = arg->type;
+    rec->size = (uint) arg->size;
+    rec->value = arg->value64;
+    rec->arg_name_id = binary_intern(bb, arg->arg_name);
+    rec->type_name_id = binary_intern(bb, arg->type_name);
+    rec->enum_name_id = binary_intern(bb, arg->enum_name);
+    rec->num_captures = 0;
+    /* Capture what print_arg() would dereference */
+    if (!TEST(DRSYS_PARAM_INLINED, arg->mode) && arg->value != 0 &&
+        !(arg->pre && !TEST(DRSYS_PARAM_IN, arg->mode))) {
+        binary_capture(bb, rec, (void *)arg->value, arg->size, CAPTURE_MAX_SIZE);
+        if (arg->type == DRSYS_TYPE_UNICODE_STRING)
+            binary_capture_unicode_string(bb, rec, (UNICODE_STRING *)arg->value);
+        else if (arg->type == DRSYS_TYPE_OBJECT_ATTRIBUTES) {
+            OBJECT_ATTRIBUTES oa;
+            if (dr_safe_read((void *)arg->value, sizeof(oa), &oa, NULL) &&
+                oa.ObjectName != NULL) {
+                binary_capture(bb, rec, oa.ObjectName, sizeof(UNICODE_STRING),
+                               CAPTURE_MAX_SIZE);
+                binary_capture_unicode_string(bb, rec, oa.ObjectName);
+            }
+        }
+    }
     return true; /* keep going */
 }
 
+static void
+binary_log_syscall(void *drcontext, drsys_syscall_t *syscall, bool pre,
+                   const char *name, uint flags, uint error)
+{
+    binbuf_t *bb = (binbuf_t *) drmgr_get_tls_field(drcontext, tls_idx);
+    drsys_sysnum_t sysnum;
+    drmf_status_t res;
+    if (BINBUF_SIZE - bb->sofar < BINREC_MAX_SIZE)
+        binary_flush(bb);
+    bb->rec_limit = bb->sofar + BINREC_MAX_SIZE;
+    bb->cur = (strace_syscall_rec_t *) binary_reserve(bb, sizeof(*bb->cur));
+    if (drsys_syscall_number(syscall, &sysnum) != DRMF_SUCCESS)
+        ASSERT(false, "drsys_syscall_number failed");
+    bb->cur->header.kind = pre ? STRACE_REC_PRE : STRACE_REC_POST;
+    bb->cur->header.count = 0;
+    bb->cur->timestamp = dr_get_microseconds();
+    bb->cur->sysnum = sysnum.number;
+    bb->cur->secondary = sysnum.secondary;
+    bb->cur->name_id = binary_intern(bb, name);
+    bb->cur->flags = flags;
+    bb->cur->error = error;
+    res = drsys_iterate_args(drcontext, binary_iter_arg_cb, bb);
+    if (res != DRMF_SUCCESS && res != DRMF_ERROR_DETAILS_UNKNOWN)
+        ASSERT(false, "drsys_iterate_args failed");
+    bb->cur->header.size = (uint)(bb->buf + bb->sofar - (byte *)bb->cur);
+}
+
+static void
+event_thread_init(void *drcontext)
+{
+    binbuf_t *bb = (binbuf_t *) dr_thread_alloc(drcontext, sizeof(*bb));
+    memset(bb, 0, sizeof(*bb));
+    bb->buf = (byte *) dr_thread_alloc(drcontext, BINBUF_SIZE);
+    bb->sofar = sizeof(strace_chunk_rec_t);
+    bb->tid = dr_get_thread_id(drcontext);
+    drmgr_set_tls_field(drcontext, tls_idx, (void *)bb);
+}
+
+static void
+event_thread_exit(void *drcontext)
+{
+    binbuf_t *bb = (binbuf_t *) drmgr_get_tls_field(drcontext, tls_idx);
+    binary_flush(bb);
+    dr_thread_free(drcontext, bb->buf, BINBUF_SIZE);
+    dr_thread_free(drcontext, bb, sizeof(*bb));
+}
+
 static bool
 event_pre_syscall(void *drcontext, int sysnum)
 {
@@ -528,6 +928,12 @@ event_pre_syscall(void *drcontext, int sysnum)
     if (drsys_syscall_is_known(syscall, &known) != DRMF_SUCCESS)
         ASSERT(false, "failed to find whether known");
 
+    if (options.binary) {
+        binary_log_syscall(drcontext, syscall, true/*pre*/, name,
+                           known ? STRACE_FLAG_KNOWN : 0, 0);
+        return true;
+    }
+
     OUTPUT(&buf, "%s%s\n", name, known ? "" : " (details not all known)");
 
     res = drsys_iterate_args(drcontext, drsys_iter_arg_cb, &buf);
@@ -556,6 +962,12 @@ event_post_syscall(void *drcontext, int sysnum)
     if (drsys_cur_syscall_result(drcontext, &success, NULL, &error) != DRMF_SUCCESS)
         ASSERT(false, "drsys_cur_syscall_result failed");
 
+    if (options.binary) {
+        binary_log_syscall(drcontext, syscall, false/*post*/, NULL,
+                           success ? STRACE_FLAG_SUCCEEDED : 0, error);
+        return;
+    }
+
     if (success)
         OUTPUT(&buf, "    succeeded =>\n");
     else
@@ -580,7 +992,7 @@ open_log_file(void)
         outf = STDERR;
     else {
         outf = drx_open_unique_appid_file(options.logdir, dr_get_process_id(),
-                                          "drstrace", "log",
+                                          "drstrace", options.binary ? "bin" : "log",
 #ifndef WINDOWS
                                           DR_FILE_CLOSE_ON_FORK |
 #endif
@@ -588,6 +1000,8 @@ open_log_file(void)
                                           buf, BUFFER_SIZE_ELEMENTS(buf));
         ASSERT(outf != INVALID_FILE, "failed to open log file");
         ALERT(1, "<drstrace log file is %s>\n", buf);
+        if (options.binary)
+            binary_write_file_header();
     }
 }
 
@@ -603,6 +1017,12 @@ event_fork(void *drcontext)
 static
 void exit_event(void)
 {
+    if (options.binary) {
+        /* Each thread's buffer was flushed by its exit event */
+        drmgr_unregister_tls_field(tls_idx);
+        hashtable_delete(&intern_table);
+        dr_mutex_destroy(binary_lock);
+    }
     if (outf != STDERR)
         dr_close_file(outf);
     if (drsys_exit() != DRMF_SUCCESS)
@@ -647,18 +1067,38 @@ options_init(client_id_t id)
                              BUFFER_SIZE_ELEMENTS(options.sysnum_file));
             USAGE_CHECK(s != NULL, "missing sysnum_file path");
             ALERT(2, "<drstrace system call number file is %s>\n", options.sysnum_file);
+        } else if (strcmp(token, "-binary") == 0) {
+            options.binary = true;
         } else {
             ALERT(0, "UNRECOGNIZED OPTION: \"%s\"\n", token);
             USAGE_CHECK(false, "invalid option");
         }
     }
+    USAGE_CHECK(!options.binary || strcmp(options.logdir, "-") != 0,
+                "-binary requires a log directory");
+}
+
+static bool
+named_consts_init(void)
+{
+    uint i = 0;
+    uint const_arrays_num = get_const_arrays_num();
+    hashtable_init(&nconsts_table, HASHTABLE_BITSIZE, HASH_STRING, false);
+    while (i < const_arrays_num) {
+        const_values_t *named_consts = const_struct_array[i];
+        bool res = hashtable_add(&nconsts_table,
+                                 (void *) named_consts[0].const_name,
+                                 (void *) named_consts);
+        if (!res)
+            return false;
+        i++;
+    }
+    return true;
 }
 
 DR_EXPORT
 void dr_init(client_id_t id)
 {
-    uint i = 0;
-    uint const_arrays_num;
     drsys_options_t ops = { sizeof(ops), 0, };
 
     dr_set_client_name("Dr. STrace", "http://drmemory.org/issues");
@@ -705,20 +1145,21 @@ void dr_init(client_id_t id)
     drmgr_register_post_syscall_event(event_post_syscall);
     if (drsys_filter_all_syscalls() != DRMF_SUCCESS)
         ASSERT(false, "drsys_filter_all_syscalls should never fail");
-    open_log_file();
-
-    const_arrays_num = get_const_arrays_num();
-    hashtable_init(&nconsts_table, HASHTABLE_BITSIZE, HASH_STRING, false);
-    while (i < const_arrays_num) {
-        const_values_t *named_consts = const_struct_array[i];
-        bool res = hashtable_add(&nconsts_table,
-                                 (void *) named_consts[0].const_name,
-                                 (void *) named_consts);
-        if (!res)
-            ASSERT(false, "drstrace failed to add to hashtable");
-        i++;
+    if (options.binary) {
+        binary_lock = dr_mutex_create();
+        hashtable_init(&intern_table, INTERN_TABLE_BITSIZE, HASH_INTPTR,
+                       false/*!strdup*/);
+        tls_idx = drmgr_register_tls_field();
+        ASSERT(tls_idx > -1, "unable to reserve TLS field");
+        drmgr_register_thread_init_event(event_thread_init);
+        drmgr_register_thread_exit_event(event_thread_exit);
+        /* Ensure every thread's exit event runs so its buffer is flushed */
+        dr_request_synchronized_exit();
     }
+    open_log_file();
 
+    if (!named_consts_init())
+        ASSERT(false, "drstrace failed to add to hashtable");
 }
 
 /****************************************************************************
@@ -738,26 +1179,12 @@ drstrace_unit_test_syscall_exit()
 bool
 drstrace_unit_test_syscall_init()
 {
-    uint const_arrays_num;
-    uint i = 0;
-
     dr_standalone_init();
 
     if (drsym_init(0) != DRSYM_SUCCESS)
         return false;
 
-    const_arrays_num = get_const_arrays_num();
-    hashtable_init(&nconsts_table, HASHTABLE_BITSIZE, HASH_STRING, false);
-    while (i < const_arrays_num) {
-        const_values_t *named_consts = const_struct_array[i];
-        bool res = hashtable_add(&nconsts_table,
-                                 (void *) named_consts[0].const_name,
-                                 (void *) named_consts);
-        if (!res)
-            return false;
-        i++;
-    }
-    return true;
+    return named_consts_init();
 }
 
 void
@@ -774,3 +1201,194 @@ drstrace_unit_test_syscall_arg_iteration(drsys_arg_t arg, void *user_data)
 
 #endif /* DRSTRACE_UNIT_TESTS */
 /***************************************************************************/
+
+/****************************************************************************
+ * Offline decoder for -binary logs
+ */
+
+#ifdef DRSTRACE_DECODER
+# define DECODE_STRING_TABLE_BITSIZE 10
+
+/* Maps string ids to the strings in the mapped log */
+static hashtable_t decode_strings;
+
+static const char *
+decode_string(uint id)
+{
+    if (id == 0)
+        return NULL;
+    return (const char *) hashtable_lookup(&decode_strings, (void *)(ptr_uint_t)id);
+}
+
+/* Prints one STRACE_REC_PRE or STRACE_REC_POST record exactly as the
+ * pre- and post-syscall events do in text mode.
+ */
+static void
+decode_syscall(strace_syscall_rec_t *rec)
+{
+    byte *pc = (byte *)(rec + 1);
+    byte *end = (byte *)rec + rec->header.size;
+    buf_info_t buf;
+    uint i, j;
+    buf.sofar = 0;
+
+    if (rec->header.kind == STRACE_REC_PRE) {
+        const char *name = decode_string(rec->name_id);
+        OUTPUT(&buf, "%s%s\n", name == NULL ? "<unknown>" : name,
+               TEST(STRACE_FLAG_KNOWN, rec->flags) ? "" : " (details not all known)");
+    } else if (TEST(STRACE_FLAG_SUCCEEDED, rec->flags))
+        OUTPUT(&buf, "    succeeded =>\n");
+    else {
+        OUTPUT(&buf, "    failed (error="IF_WINDOWS_ELSE(PIFX, "%d")") =>\n",
+               (uint) rec->error);
+    }
+
+    decode_num_captures = 0;
+    for (i = 0; i < rec->header.count && pc + sizeof(strace_arg_rec_t) <= end; i++) {
+        strace_arg_rec_t *a = (strace_arg_rec_t *) pc;
+        drsys_arg_t arg;
+        pc += sizeof(*a);
+        for (j = 0; j < a->num_captures && pc + sizeof(strace_capture_t) <= end; j++) {
+            strace_capture_t *cap = (strace_capture_t *) pc;
+            if (decode_num_captures < DECODE_MAX_CAPTURES) {
+                decode_capture_t *c = &decode_captures[decode_num_captures++];
+                c->addr = (byte *)(ptr_uint_t) cap->addr;
+                c->size = cap->size;
+                c->data = (byte *)(cap + 1);
+            }
+            pc += sizeof(*cap) + ALIGN_FORWARD(cap->size, 8);
+        }
+        memset(&arg, 0, sizeof(arg));
+        arg.pre = (rec->header.kind == STRACE_REC_PRE);
+        arg.valid = true;
+        arg.ordinal = a->ordinal;
+        arg.mode = (drsys_param_mode_t) a->mode;
+        arg.type = (drsys_param_type_t) a->type;
+        arg.size = a->size;
+        arg.value = (ptr_uint_t) a->value;
+        arg.value64 = a->value;
+        arg.arg_name = decode_string(a->arg_name_id);
+        arg.type_name = decode_string(a->type_name_id);
+        arg.enum_name = decode_string(a->enum_name_id);
+        print_arg(&buf, &arg);
+    }
+    FLUSH_BUFFER(outf, buf.buf, buf.sofar);
+}
+
+static bool
+decode_log(byte *map, size_t map_size)
+{
+    strace_file_header_t *header = (strace_file_header_t *) map;
+    byte *pc = map + sizeof(*header);
+    byte *end = map + map_size;
+    if (map_size < sizeof(*header) ||
+        memcmp(header->magic, STRACE_BINARY_MAGIC, sizeof(header->magic)) != 0) {
+        ALERT(0, "not a drstrace binary log\n");
+        return false;
+    }
+    if (header->version != STRACE_BINARY_VERSION ||
+        header->pointer_size != sizeof(void *)) {
+        ALERT(0, "unsupported log version %d or pointer size %d\n",
+              header->version, header->pointer_size);
+        return false;
+    }
+    while (pc + sizeof(strace_rec_header_t) <= end) {
+        strace_rec_header_t *rec = (strace_rec_header_t *) pc;
+        if (rec->size < sizeof(*rec) || rec->size > (size_t)(end - pc)) {
+            ALERT(0, "log is truncated\n");
+            return false;
+        }
+        if (rec->kind == STRACE_REC_STRING) {
+            strace_string_rec_t *str = (strace_string_rec_t *) rec;
+            hashtable_add(&decode_strings, (void *)(ptr_uint_t) str->id,
+                          (void *)(str + 1));
+        } else if (rec->kind == STRACE_REC_CHUNK) {
+            byte *sub = pc + sizeof(strace_chunk_rec_t);
+            while (sub + sizeof(strace_syscall_rec_t) <= pc + rec->size) {
+                strace_syscall_rec_t *sys = (strace_syscall_rec_t *) sub;
+                if (sys->header.size < sizeof(*sys) ||
+                    sys->header.size > (size_t)(pc + rec->size - sub))
+                    break;
+                decode_syscall(sys);
+                sub += sys->header.size;
+            }
+        }
+        pc += rec->size;
+    }
+    return true;
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char *logname = NULL;
+    const char *outname = NULL;
+    file_t f;
+    uint64 file_size;
+    size_t map_size;
+    byte *map;
+    bool ok;
+    int i;
+
+    dr_standalone_init();
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-symcache_path") == 0 && i + 1 < argc) {
+            dr_snprintf(options.sympath, BUFFER_SIZE_ELEMENTS(options.sympath),
+                        "%s", argv[++i]);
+            NULL_TERMINATE_BUFFER(options.sympath);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            outname = argv[++i];
+        else if (logname == NULL)
+            logname = argv[i];
+        else {
+            logname = NULL;
+            break;
+        }
+    }
+    if (logname == NULL) {
+        dr_fprintf(STDERR, "usage: drstrace_decode [-symcache_path <path>] "
+                   "[-o <outfile>] <drstrace .bin log>\n");
+        return 1;
+    }
+
+    f = dr_open_file(logname, DR_FILE_READ);
+    if (f == INVALID_FILE || !dr_file_size(f, &file_size)) {
+        ALERT(0, "unable to open %s\n", logname);
+        return 1;
+    }
+    map_size = (size_t) file_size;
+    map = (byte *) dr_map_file(f, &map_size, 0, NULL, DR_MEMPROT_READ, 0);
+    if (map == NULL || map_size < file_size) {
+        ALERT(0, "unable to map %s\n", logname);
+        return 1;
+    }
+    if (outname == NULL)
+        outf = STDOUT;
+    else {
+        outf = dr_open_file(outname, DR_FILE_WRITE_OVERWRITE);
+        if (outf == INVALID_FILE) {
+            ALERT(0, "unable to open %s\n", outname);
+            return 1;
+        }
+    }
+
+    if (drsym_init(0) != DRSYM_SUCCESS || !named_consts_init()) {
+        ALERT(0, "failed to initialize\n");
+        return 1;
+    }
+    hashtable_init(&decode_strings, DECODE_STRING_TABLE_BITSIZE, HASH_INTPTR,
+                   false/*!strdup*/);
+
+    ok = decode_log(map, (size_t) file_size);
+
+    hashtable_delete(&decode_strings);
+    hashtable_delete(&nconsts_table);
+    drsym_exit();
+    if (outf != STDOUT)
+        dr_close_file(outf);
+    dr_unmap_file(map, map_size);
+    dr_close_file(f);
+    return ok ? 0 : 1;
+}
+#endif /* DRSTRACE_DECODER */
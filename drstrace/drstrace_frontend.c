@@ -122,6 +122,10 @@ print_usage(void)
     fprintf(stderr, "                a local directory will be used.\n");
     fprintf(stderr, "-[no_]load_symbols  Enables or disables loading of symbols over\n");
     fprintf(stderr, "                the network.  This option is enabled by default.\n");
+    fprintf(stderr, "-binary         Write raw per-thread records to a .bin file\n");
+    fprintf(stderr, "                instead of text, which is much faster for\n");
+    fprintf(stderr, "                syscall-heavy apps.  Use drstrace_decode to\n");
+    fprintf(stderr, "                convert it to the usual text output.\n");
     fprintf(stderr, "-no_follow_children   Do not trace child processes (overrides\n");
     fprintf(stderr, "                the default, which is to trace all children).\n");
     fprintf(stderr, "-version        Print version number.\n");
@@ -0,0 +1,96 @@
+# **********************************************************
+# Copyright (c) 2026 Google, Inc.  All rights reserved.
+# **********************************************************
+
+# Dr. Memory: the memory debugger
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation;
+# version 2.1 of the License, and no later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+# Library General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+# Runs drstrace on an app in text mode and in -binary mode, decodes the
+# binary log with drstrace_decode, and compares the two.
+#
+# arguments:
+# * drstrace = path to the drstrace frontend
+# * decode = path to drstrace_decode
+# * dr_dir = DynamoRIO root to pass to -dr
+# * app = path to the app to trace
+# * outdir = scratch directory for the logs
+#
+# Argument values (pointers, handles, etc.) legitimately differ between two
+# runs, so we compare the sequence of system call names and of succeeded/failed
+# results, which for a single-threaded app must match.
+
+foreach (mode text binary)
+  set(dir "${outdir}/${mode}")
+  file(REMOVE_RECURSE "${dir}")
+  file(MAKE_DIRECTORY "${dir}")
+  if ("${mode}" STREQUAL "binary")
+    set(extra_ops -binary)
+  else ()
+    set(extra_ops "")
+  endif ()
+  execute_process(COMMAND ${drstrace} -dr ${dr_dir} -logdir ${dir} ${extra_ops}
+    -- ${app}
+    RESULT_VARIABLE cmd_result
+    OUTPUT_VARIABLE cmd_out
+    ERROR_VARIABLE cmd_err)
+  if (cmd_result)
+    message(FATAL_ERROR "*** ${mode} run failed (${cmd_result}):\n${cmd_out}${cmd_err}")
+  endif ()
+endforeach ()
+
+file(GLOB text_logs "${outdir}/text/drstrace.*.log")
+file(GLOB bin_logs "${outdir}/binary/drstrace.*.bin")
+list(LENGTH text_logs num_text)
+list(LENGTH bin_logs num_bin)
+if (NOT num_text EQUAL 1 OR NOT num_bin EQUAL 1)
+  message(FATAL_ERROR "*** expected one log per mode: ${text_logs} ${bin_logs}")
+endif ()
+
+set(decoded "${outdir}/binary/decoded.log")
+execute_process(COMMAND ${decode} -o ${decoded} ${bin_logs}
+  RESULT_VARIABLE cmd_result
+  OUTPUT_VARIABLE cmd_out
+  ERROR_VARIABLE cmd_err)
+if (cmd_result)
+  message(FATAL_ERROR "*** drstrace_decode failed (${cmd_result}):\n${cmd_out}${cmd_err}")
+endif ()
+
+# Sets ${out} in the caller to the syscall name and result lines of ${file}.
+function (syscall_lines out file)
+  file(STRINGS "${file}" lines)
+  set(res "")
+  foreach (line ${lines})
+    if ("${line}" MATCHES "^[A-Za-z_]" OR
+        "${line}" MATCHES "^    (succeeded|failed)")
+      # Strip the error code, which is not part of the comparison above
+      string(REGEX REPLACE "\\(error=.*" "" line "${line}")
+      set(res "${res}${line}\n")
+    endif ()
+  endforeach ()
+  set(${out} "${res}" PARENT_SCOPE)
+endfunction (syscall_lines)
+
+syscall_lines(text_lines ${text_logs})
+syscall_lines(decoded_lines ${decoded})
+if ("${text_lines}" STREQUAL "")
+  message(FATAL_ERROR "*** no system calls found in ${text_logs}")
+endif ()
+if (NOT "${text_lines}" STREQUAL "${decoded_lines}")
+  file(WRITE "${outdir}/text.calls" "${text_lines}")
+  file(WRITE "${outdir}/decoded.calls" "${decoded_lines}")
+  message(FATAL_ERROR "*** decoded -binary log does not match the text log: "
+    "compare ${outdir}/text.calls and ${outdir}/decoded.calls")
+endif ()
@@ -381,6 +381,397 @@ is_register_defined(reg_id_t reg)
         return (*drsys_ops.is_register_defined)(reg);
 }
 
+/* Unknown syscall layout caching (drsys_ops.unknown_layout_threshold).
+ * Comparing memory across every unknown syscall is expensive, and hot unknown
+ * ioctls pay that cost on each invocation.  Once we have seen the same written
+ * ranges enough times in a row we stop comparing and report the cached ranges.
+ * Entries are keyed by the primary number plus the raw secondary code, as an
+ * unknown ioctl request code maps to BASE_ENTRY_INDEX in pt->sysnum.
+ */
+typedef struct _unknown_layout_t {
+    drsys_sysnum_t num;
+    uint observations;
+    bool stable;
+    uint num_writes;
+    unknown_write_t writes[UNKNOWN_LAYOUT_MAX_WRITES];
+} unknown_layout_t;
+
+#define UNKNOWN_LAYOUT_TABLE_HASH_BITS 6
+static hashtable_t unknown_layout_table;
+/* Protects unknown_layout_table, non-stable entries, and additions to
+ * unknown_layout_stable.
+ */
+static void *unknown_layout_lock;
+
+/* Stable entries are immutable and are never removed until exit, so we publish
+ * them in an insert-only open-addressed array that pre-syscall reads without the
+ * lock.  Slots only ever go from NULL to an entry.  We keep one slot empty so
+ * that probes always terminate; stable entries beyond that simply keep taking
+ * the comparison path.
+ */
+#define UNKNOWN_LAYOUT_STABLE_BITS 8
+#define UNKNOWN_LAYOUT_STABLE_SIZE (1 << UNKNOWN_LAYOUT_STABLE_BITS)
+#define UNKNOWN_LAYOUT_STABLE_MASK (UNKNOWN_LAYOUT_STABLE_SIZE - 1)
+static unknown_layout_t * volatile unknown_layout_stable[UNKNOWN_LAYOUT_STABLE_SIZE];
+static volatile int unknown_layout_num_stable;
+
+#define UNKNOWN_LAYOUT_FILE_HEADER "DrSyscall Unknown Layout File"
+#define UNKNOWN_LAYOUT_FILE_VERSION 1
+
+static bool
+unknown_layout_enabled(void)
+{
+    return (drsys_ops.analyze_unknown_syscalls && drsys_ops.unknown_layout_threshold > 0);
+}
+
+static drsys_sysnum_t
+unknown_layout_key(cls_syscall_t *cpt)
+{
+    drsys_sysnum_t key = cpt->sysnum;
+    if (key.secondary == BASE_ENTRY_INDEX)
+        key.secondary = cpt->secondary_code;
+    return key;
+}
+
+static void
+unknown_layout_free(void *p)
+{
+    global_free(p, sizeof(unknown_layout_t), HEAPSTAT_MISC);
+}
+
+/* Caller must hold unknown_layout_lock */
+static unknown_layout_t *
+unknown_layout_create(drsys_sysnum_t key)
+{
+    unknown_layout_t *layout = (unknown_layout_t *)
+        global_alloc(sizeof(*layout), HEAPSTAT_MISC);
+    memset(layout, 0, sizeof(*layout));
+    layout->num = key;
+    hashtable_add(&unknown_layout_table, (void *) &layout->num, (void *) layout);
+    return layout;
+}
+
+/* Caller must hold unknown_layout_lock.  Marks layout stable and makes it
+ * visible to unknown_layout_lookup().
+ */
+static void
+unknown_layout_publish(unknown_layout_t *layout)
+{
+    uint idx;
+    layout->stable = true;
+    if (unknown_layout_num_stable >= UNKNOWN_LAYOUT_STABLE_SIZE - 1) {
+        LOG(SYSCALL_VERBOSE, "unknown-syscall #"SYSNUM_FMT"."SYSNUM_FMT
+            ": too many stable layouts to publish\n", layout->num.number,
+            layout->num.secondary);
+        return;
+    }
+    /* The atomic add is a full barrier, ordering the writes to *layout before
+     * the slot store below that lock-free readers observe.
+     */
+    dr_atomic_add32_return_sum(&unknown_layout_num_stable, 1);
+    for (idx = sysnum_hash(&layout->num) & UNKNOWN_LAYOUT_STABLE_MASK;
+         unknown_layout_stable[idx] != NULL;
+         idx = (idx + 1) & UNKNOWN_LAYOUT_STABLE_MASK)
+        ; /* nothing */
+    unknown_layout_stable[idx] = layout;
+}
+
+/* Returns the stable layout for the current syscall, or NULL.  This is called
+ * on every unknown syscall so it does not take unknown_layout_lock.
+ */
+static unknown_layout_t *
+unknown_layout_lookup(cls_syscall_t *cpt)
+{
+    unknown_layout_t *layout;
+    drsys_sysnum_t key;
+    uint idx;
+    if (!unknown_layout_enabled())
+        return NULL;
+    key = unknown_layout_key(cpt);
+    for (idx = sysnum_hash(&key) & UNKNOWN_LAYOUT_STABLE_MASK;
+         (layout = unknown_layout_stable[idx]) != NULL;
+         idx = (idx + 1) & UNKNOWN_LAYOUT_STABLE_MASK) {
+        if (drsys_sysnums_equal(&layout->num, &key))
+            return layout;
+    }
+    return NULL;
+}
+
+/* Records a write found by handle_post_unknown_syscall().  Writes are found in
+ * increasing address order per parameter so we only need to merge with the last
+ * range.
+ */
+static void
+unknown_layout_record_write(cls_syscall_t *cpt, int ordinal, byte *start, size_t size)
+{
+    unknown_write_t *last;
+    uint offs;
+    if (!unknown_layout_enabled() || cpt->unknown_overflow)
+        return;
+    ASSERT(start >= cpt->sysarg_ptr[ordinal], "write outside of param");
+    offs = (uint)(start - cpt->sysarg_ptr[ordinal]);
+    if (cpt->unknown_num_writes > 0) {
+        last = &cpt->unknown_writes[cpt->unknown_num_writes - 1];
+        if (last->ordinal == (uint)ordinal && offs <= last->offs + last->size) {
+            if (offs + size > last->offs + last->size)
+                last->size = offs + (uint)size - last->offs;
+            return;
+        }
+    }
+    if (cpt->unknown_num_writes >= UNKNOWN_LAYOUT_MAX_WRITES) {
+        cpt->unknown_overflow = true;
+        return;
+    }
+    last = &cpt->unknown_writes[cpt->unknown_num_writes++];
+    last->ordinal = ordinal;
+    last->offs = offs;
+    last->size = (uint)size;
+}
+
+/* Compares the writes recorded for this invocation with the table entry and
+ * marks the entry stable once it has been consistent for long enough.
+ */
+static void
+unknown_layout_observe(cls_syscall_t *cpt)
+{
+    unknown_layout_t *layout;
+    drsys_sysnum_t key = unknown_layout_key(cpt);
+    dr_mutex_lock(unknown_layout_lock);
+    layout = (unknown_layout_t *) hashtable_lookup(&unknown_layout_table, &key);
+    if (layout == NULL)
+        layout = unknown_layout_create(key);
+    if (!layout->stable) {
+        if (cpt->unknown_overflow) {
+            layout->observations = 0;
+            layout->num_writes = 0;
+        } else if (layout->observations > 0 &&
+                   layout->num_writes == cpt->unknown_num_writes &&
+                   memcmp(layout->writes, cpt->unknown_writes,
+                          cpt->unknown_num_writes * sizeof(cpt->unknown_writes[0]))
+                   == 0) {
+            layout->observations++;
+        } else {
+            layout->observations = 1;
+            layout->num_writes = cpt->unknown_num_writes;
+            memcpy(layout->writes, cpt->unknown_writes,
+                   cpt->unknown_num_writes * sizeof(cpt->unknown_writes[0]));
+        }
+        if (layout->observations >= drsys_ops.unknown_layout_threshold) {
+            LOG(SYSCALL_VERBOSE, "unknown-syscall #"SYSNUM_FMT"."SYSNUM_FMT
+                ": caching layout with %d writes\n", key.number, key.secondary,
+                layout->num_writes);
+            unknown_layout_publish(layout);
+        }
+    }
+    dr_mutex_unlock(unknown_layout_lock);
+}
+
+/* Parses one entry line of the file written by unknown_layout_write_file().
+ * Caller must hold unknown_layout_lock.  Stops on the first malformed line.
+ */
+static bool
+unknown_layout_parse_line(const char *line)
+{
+    drsys_sysnum_t key;
+    unknown_layout_t *layout;
+    const char *s;
+    uint i;
+    if (dr_sscanf(line, "%d.%d=", &key.number, &key.secondary) != 2)
+        return false;
+    if (hashtable_lookup(&unknown_layout_table, &key) != NULL)
+        return true;
+    s = strchr(line, '=');
+    if (s == NULL)
+        return false;
+    layout = unknown_layout_create(key);
+    for (i = 0; s[1] != '\0'; i++) {
+        unknown_write_t *w = &layout->writes[i];
+        if (i >= UNKNOWN_LAYOUT_MAX_WRITES ||
+            dr_sscanf(s + 1, "%u:%u:%u", &w->ordinal, &w->offs, &w->size) != 3 ||
+            w->ordinal >= SYSCALL_NUM_ARG_TRACK || w->size == 0 ||
+            w->offs + w->size > SYSCALL_ARG_TRACK_MAX_SZ) {
+            /* leave it unstable so it is re-learned */
+            return true;
+        }
+        s = strchr(s + 1, ',');
+        if (s == NULL) {
+            i++;
+            break;
+        }
+    }
+    layout->num_writes = i;
+    layout->observations = drsys_ops.unknown_layout_threshold;
+    unknown_layout_publish(layout);
+    return true;
+}
+
+/* Copies the line at *line into buf as a NUL-terminated string, without its
+ * line ending, and advances *line past it.  The file mapping is not
+ * NUL-terminated so we must not search past end.
+ */
+static bool
+unknown_layout_next_line(const char **line, const char *end, char *buf, size_t bufsz)
+{
+    const char *eol;
+    size_t len;
+    if (*line >= end)
+        return false;
+    eol = (const char *) memchr(*line, '\n', end - *line);
+    if (eol == NULL)
+        eol = end;
+    len = eol - *line;
+    if (len > 0 && (*line)[len - 1] == '\r')
+        len--;
+    if (len >= bufsz)
+        return false;
+    memcpy(buf, *line, len);
+    buf[len] = '\0';
+    *line = (eol == end) ? end : eol + 1;
+    return true;
+}
+
+/* Parses the file written by unknown_layout_write_file().  Each entry is a line
+ * "number.secondary=ordinal:offset:size,...", with an empty list for syscalls
+ * that write nothing.
+ */
+static void
+unknown_layout_read_file(void)
+{
+    file_t f;
+    void *map = NULL;
+    uint64 map_size;
+    size_t actual_size;
+    const char *line, *end;
+    /* Room for the maximum number of writes with 10-digit fields */
+    char buf[32 + UNKNOWN_LAYOUT_MAX_WRITES * 34];
+    int version;
+    if (drsys_ops.unknown_layout_file == NULL)
+        return;
+    f = dr_open_file(drsys_ops.unknown_layout_file, DR_FILE_READ);
+    if (f == INVALID_FILE)
+        return;
+    if (dr_file_size(f, &map_size) && map_size > 0) {
+        actual_size = (size_t)map_size;
+        map = dr_map_file(f, &actual_size, 0, NULL, DR_MEMPROT_READ, 0);
+    }
+    if (map == NULL || actual_size < map_size)
+        goto unknown_layout_read_file_done;
+    line = (const char *) map;
+    end = line + (size_t)map_size;
+    if (!unknown_layout_next_line(&line, end, buf, BUFFER_SIZE_ELEMENTS(buf)) ||
+        strcmp(buf, UNKNOWN_LAYOUT_FILE_HEADER) != 0 ||
+        !unknown_layout_next_line(&line, end, buf, BUFFER_SIZE_ELEMENTS(buf)) ||
+        dr_sscanf(buf, "%d", &version) != 1 ||
+        version != UNKNOWN_LAYOUT_FILE_VERSION)
+        goto unknown_layout_read_file_done;
+    dr_mutex_lock(unknown_layout_lock);
+    while (unknown_layout_next_line(&line, end, buf, BUFFER_SIZE_ELEMENTS(buf))) {
+        if (buf[0] != '\0' && !unknown_layout_parse_line(buf))
+            break;
+    }
+    dr_mutex_unlock(unknown_layout_lock);
+    LOG(1, "loaded cached unknown syscall layouts from %s\n",
+        drsys_ops.unknown_layout_file);
+ unknown_layout_read_file_done:
+    if (map != NULL)
+        dr_unmap_file(map, actual_size);
+    dr_close_file(f);
+}
+
+static void
+unknown_layout_write_file(void)
+{
+    file_t f;
+    uint i, j;
+    if (drsys_ops.unknown_layout_file == NULL)
+        return;
+    f = dr_open_file(drsys_ops.unknown_layout_file, DR_FILE_WRITE_OVERWRITE);
+    if (f == INVALID_FILE) {
+        LOG(1, "WARNING: unable to write %s\n", drsys_ops.unknown_layout_file);
+        return;
+    }
+    dr_fprintf(f, "%s\n%d\n", UNKNOWN_LAYOUT_FILE_HEADER, UNKNOWN_LAYOUT_FILE_VERSION);
+    dr_mutex_lock(unknown_layout_lock);
+    for (i = 0; i < HASHTABLE_SIZE(unknown_layout_table.table_bits); i++) {
+        hash_entry_t *he;
+        for (he = unknown_layout_table.table[i]; he != NULL; he = he->next) {
+            unknown_layout_t *layout = (unknown_layout_t *) he->payload;
+            if (!layout->stable)
+                continue;
+            dr_fprintf(f, "%d.%d=", layout->num.number, layout->num.secondary);
+            for (j = 0; j < layout->num_writes; j++) {
+                dr_fprintf(f, "%s%u:%u:%u", j == 0 ? "" : ",",
+                           layout->writes[j].ordinal, layout->writes[j].offs,
+                           layout->writes[j].size);
+            }
+            dr_fprintf(f, "\n");
+        }
+    }
+    dr_mutex_unlock(unknown_layout_lock);
+    dr_close_file(f);
+}
+
+static void
+unknown_layout_init(void)
+{
+    if (!unknown_layout_enabled())
+        return;
+    unknown_layout_lock = dr_mutex_create();
+    hashtable_init_ex(&unknown_layout_table, UNKNOWN_LAYOUT_TABLE_HASH_BITS,
+                      HASH_INTPTR, false/*!strdup*/, false/*!synch*/,
+                      unknown_layout_free, sysnum_hash, sysnum_cmp);
+    unknown_layout_read_file();
+}
+
+static void
+unknown_layout_exit(void)
+{
+    if (!unknown_layout_enabled())
+        return;
+    unknown_layout_write_file();
+    memset((void *)unknown_layout_stable, 0, sizeof(unknown_layout_stable));
+    unknown_layout_num_stable = 0;
+    hashtable_delete(&unknown_layout_table);
+    dr_mutex_destroy(unknown_layout_lock);
+}
+
+/* Called in pre-syscall in place of the memory snapshot when the layout is cached */
+static void
+handle_pre_unknown_syscall_cached(void *drcontext, cls_syscall_t *cpt,
+                                  unknown_layout_t *layout)
+{
+    uint i;
+    for (i = 0; i < SYSCALL_NUM_ARG_TRACK; i++) {
+        cpt->sysarg_ptr[i] = NULL;
+        cpt->sysarg_sz[i] = 0; /* nothing to compare or restore */
+    }
+    for (i = 0; i < layout->num_writes; i++) {
+        unknown_write_t *w = &layout->writes[i];
+        cpt->sysarg_ptr[w->ordinal] = (app_pc) dr_syscall_get_param(drcontext,
+                                                                    w->ordinal);
+    }
+}
+
+static void
+handle_post_unknown_syscall_cached(cls_syscall_t *cpt, sysarg_iter_info_t *ii,
+                                   unknown_layout_t *layout)
+{
+    uint i;
+    if (!os_syscall_succeeded(cpt->sysnum, cpt->sysinfo, cpt))
+        return;
+    for (i = 0; i < layout->num_writes; i++) {
+        unknown_write_t *w = &layout->writes[i];
+        byte *start = cpt->sysarg_ptr[w->ordinal] + w->offs;
+        /* The param may not be a pointer this time (e.g., NULL is passed) */
+        if (cpt->sysarg_ptr[w->ordinal] == NULL || !is_byte_addressable(start) ||
+            !is_byte_addressable(start + w->size - 1))
+            continue;
+        if (!report_memarg_type(ii, w->ordinal, SYSARG_WRITE, start, w->size, NULL,
+                                DRSYS_TYPE_UNKNOWN, NULL))
+            break;
+    }
+}
+
 /* For syscall we do not have specific parameter info for, we do a
  * memory comparison to find what has been written.
  * We will not catch passing undefined values in that are read, of course.
@@ -398,6 +789,11 @@ handle_pre_unknown_syscall(void *drcontext, cls_syscall_t *cpt,
 
     if (!drsys_ops.analyze_unknown_syscalls)
         return;
+    if (cpt->unknown_layout != NULL) {
+        handle_pre_unknown_syscall_cached(drcontext, cpt,
+                                          (unknown_layout_t *) cpt->unknown_layout);
+        return;
+    }
     LOG(SYSCALL_VERBOSE, "unknown system call #"SYSNUM_FMT"."SYSNUM_FMT" %s\n",
         sysnum.number, sysnum.secondary, sysinfo == NULL ? "" : sysinfo->name);
     /* PR 484069: reduce global logfile size */
@@ -511,8 +907,27 @@ handle_post_unknown_syscall(void *drcontext, cls_syscall_t *cpt,
     int i, j;
     byte *w_at = NULL;
     byte post_val[SYSCALL_ARG_TRACK_MAX_SZ];
+    bool record;
     if (!drsys_ops.analyze_unknown_syscalls)
         return;
+    if (cpt->unknown_layout != NULL) {
+        if (ii != NULL) {
+            handle_post_unknown_syscall_cached(cpt, ii,
+                                               (unknown_layout_t *) cpt->unknown_layout);
+        }
+        return;
+    }
+    if (ii == NULL) {
+        /* Only learn from successful calls: failures often write nothing */
+        if (cpt->unknown_recorded && unknown_layout_enabled() &&
+            os_syscall_succeeded(cpt->sysnum, cpt->sysinfo, cpt))
+            unknown_layout_observe(cpt);
+        record = false;
+    } else {
+        /* Multiple clients may iterate: we only need to record once */
+        record = !cpt->unknown_recorded;
+        cpt->unknown_recorded = true;
+    }
     /* we analyze params even if syscall failed, since in some cases
      * some params are still written (xref i#486, i#358)
      */
@@ -552,9 +967,15 @@ handle_post_unknown_syscall(void *drcontext, cls_syscall_t *cpt,
                                 report_memarg_type(ii, i, SYSARG_WRITE,
                                                    (byte *)ALIGN_BACKWARD(pc, 4), 4, NULL,
                                                    DRSYS_TYPE_UNKNOWN, NULL);
+                                if (record) {
+                                    unknown_layout_record_write
+                                        (cpt, i, (byte *)ALIGN_BACKWARD(pc, 4), 4);
+                                }
                             } else if (ii != NULL) {
                                 report_memarg_type(ii, i, SYSARG_WRITE, pc, 1, NULL,
                                                    DRSYS_TYPE_UNKNOWN, NULL);
+                                if (record)
+                                    unknown_layout_record_write(cpt, i, pc, 1);
                             }
                         } else if (ii == NULL /* => restore */) {
                             if (post_val[j] == UNKNOWN_SYSVAL_SENTINEL &&
@@ -1616,6 +2037,7 @@ get_sysinfo(void *drcontext, cls_syscall_t *pt, int initial_num,
     ASSERT(pt->pre, "not support for post: need pt->sysarg there");
     sysnum->number = initial_num;
     sysnum->secondary = 0;
+    pt->secondary_code = 0;
     sysinfo = syscall_lookup(*sysnum, false/*don't resolve 2ndary yet*/);
     if (sysinfo != NULL) {
         if (TEST(SYSINFO_SECONDARY_TABLE, sysinfo->flags)) {
@@ -1631,6 +2053,7 @@ get_sysinfo(void *drcontext, cls_syscall_t *pt, int initial_num,
              */
             code = (uint) dr_syscall_get_param(drcontext, sysinfo->arg[0].param);
             sysnum->secondary = code;
+            pt->secondary_code = code;
             /* get a new sysinfo */
             sysinfo = syscall_lookup(*sysnum, true/*resolve 2ndary*/);
             if (sysinfo == NULL) {
@@ -1913,6 +2336,12 @@ drsys_event_pre_syscall(void *drcontext, int initial_num)
     pt->sysinfo = get_sysinfo(drcontext, pt, initial_num, &pt->sysnum);
     pt->known = (pt->sysinfo != NULL &&
                  TEST(SYSINFO_ALL_PARAMS_KNOWN, pt->sysinfo->flags));
+    if (!pt->known) {
+        pt->unknown_layout = unknown_layout_lookup(pt);
+        pt->unknown_recorded = false;
+        pt->unknown_overflow = false;
+        pt->unknown_num_writes = 0;
+    }
 
     /* Save params for post-syscall access.
      * We are reading beyond the # of args of some syscalls and we can
@@ -2210,6 +2639,8 @@ drsys_init(client_id_t client_id, drsys_options_t *ops)
     if (res != DRMF_SUCCESS && res != DRMF_WARNING_UNSUPPORTED_KERNEL)
         return res;
 
+    unknown_layout_init();
+
     /* We used to handle all the gory details of Windows pre- and
      * post-syscall hooking ourselves, including system call parameter
      * bases varying by syscall type, and post-syscall hook complexity.
@@ -2272,6 +2703,8 @@ drsys_exit(void)
 
     hashtable_delete(&filtered_table);
 
+    unknown_layout_exit();
+
     drsyscall_os_exit();
 
     dr_recurlock_destroy(systable_lock);
@@ -447,6 +447,24 @@ typedef struct _drsys_options_t {
     const char *sysnum_file;
     /** Whether to use internal syscall tables if they match the underlying kernel. */
     bool skip_internal_tables;
+
+    /**
+     * If analyze_unknown_syscalls is on and this parameter is non-zero, once
+     * the same set of written parameter bytes has been observed this many
+     * consecutive times for a successful unknown system call (keyed by system
+     * call number and secondary code, such as an ioctl request code), that
+     * layout is cached and subsequent invocations report those writes directly
+     * without performing any pre- and post-syscall memory comparison.
+     * Writes by failed system calls are not reported once a layout is cached.
+     */
+    uint unknown_layout_threshold;
+    /**
+     * If unknown_layout_threshold is non-zero and this parameter is non-NULL, it
+     * points at the path to a file from which cached unknown system call layouts
+     * are loaded at initialization and to which they are written at exit, allowing
+     * the cache to be shared across runs.
+     */
+    const char *unknown_layout_file;
 } drsys_options_t;
 
 /** The current version of the file specified by drsys_options_t.sysnum_file. */
@@ -272,6 +272,19 @@ enum {
 
 #define SYSCALL_ARG_TRACK_MAX_SZ 2048
 
+/* Max number of distinct written ranges we cache for an unknown syscall
+ * (drsys_options_t.unknown_layout_threshold).  Layouts with more ranges
+ * are never cached.
+ */
+#define UNKNOWN_LAYOUT_MAX_WRITES 16
+
+/* A range written by an unknown syscall, relative to the start of its parameter */
+typedef struct _unknown_write_t {
+    uint ordinal;
+    uint offs;
+    uint size;
+} unknown_write_t;
+
 typedef struct _syscall_info_t {
     /* System call number: filled in dynamically, allowing us to use the static
      * fields to indicate underlying version reliance.  We read the static
@@ -336,6 +349,14 @@ typedef struct _cls_syscall_t {
     size_t sysarg_val_bytes[SYSCALL_NUM_ARG_TRACK];
     byte *sysarg_val[SYSCALL_NUM_ARG_TRACK];
 
+    /* for caching the inferred layout of unknown syscalls */
+    uint secondary_code; /* raw code even when it has no secondary table entry */
+    void *unknown_layout; /* stable cached layout used for this syscall, if any */
+    bool unknown_recorded;
+    bool unknown_overflow;
+    uint unknown_num_writes;
+    unknown_write_t unknown_writes[UNKNOWN_LAYOUT_MAX_WRITES];
+
     /* for a writable info struct so we can set the sysnum */
     syscall_info_t unknown_info;
 } cls_syscall_t;
@@ -0,0 +1,571 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/* Dr. Memory: the memory debugger
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License, and no later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/***************************************************************************
+ * drworkpool.c: work pool of client threads
+ */
+
+#include "dr_api.h"
+#include "drworkpool.h"
+#include "drmemory_framework.h"
+#include "../framework/drmf.h"
+#include "utils.h"
+#include <string.h>
+
+/* General comments:
+ * - Each thread owns a bounded deque.  The owner takes the newest item and
+ *   other threads steal the oldest.  Submissions from outside the pool are
+ *   spread round-robin.
+ * - The deques are protected by short critical sections rather than being
+ *   lock-free: the items are coarse (a leak scan, a report, a symbol file)
+ *   so contention is negligible.
+ * - We use ticket locks built on atomic adds rather than dr_mutex_t: in a
+ *   forked child, a lock held by a parent thread that does not exist in the
+ *   child can simply be reset.
+ * - An item is counted in pool->queued while in a deque and in pool->active
+ *   while running.  When an item is taken, active is incremented before
+ *   queued is decremented so that the two are never both transiently zero.
+ */
+
+#define DEFAULT_QUEUE_CAPACITY 256
+
+typedef struct _ticket_lock_t {
+    volatile int next;
+    volatile int serving;
+} ticket_lock_t;
+
+typedef struct _work_item_t {
+    drworkpool_func_t func;
+    drworkpool_func_t cancel_func;
+    void *arg;
+} work_item_t;
+
+typedef struct _worker_t {
+    drworkpool_t *pool;
+    uint index;
+    ticket_lock_t lock; /* protects the fields below it */
+    work_item_t *items; /* ring of pool->capacity entries */
+    uint oldest;        /* ring index of the oldest item */
+    uint count;
+    thread_id_t tid;
+    void *wake;         /* signaled when there may be work for an idle thread */
+    volatile int idle;
+} worker_t;
+
+struct _drworkpool_t {
+    uint num_threads;
+    uint capacity;
+    worker_t *workers;
+    volatile int queued;
+    volatile int active;
+    volatile int next_worker;
+    volatile int live_threads;
+    volatile bool exiting;
+    void *done_event;   /* signaled when queued and active reach zero */
+    void *exited_event; /* signaled when live_threads reaches zero */
+    drworkpool_t *next;
+};
+
+static int drworkpool_init_count;
+
+/* For cancellation at exit and for re-creating threads after a fork */
+static drworkpool_t *pool_list;
+static ticket_lock_t pool_list_lock;
+
+#ifdef UNIX
+static void
+workpool_fork_init(void *drcontext);
+#endif
+
+/***************************************************************************
+ * Locks
+ */
+
+static void
+tlock_acquire(ticket_lock_t *lock)
+{
+    int ticket = dr_atomic_add32_return_sum(&lock->next, 1) - 1;
+    /* The atomic read also serves as the acquire barrier */
+    while (dr_atomic_add32_return_sum(&lock->serving, 0) != ticket)
+        dr_thread_yield();
+}
+
+static void
+tlock_release(ticket_lock_t *lock)
+{
+    dr_atomic_add32_return_sum(&lock->serving, 1);
+}
+
+static void
+tlock_reset(ticket_lock_t *lock)
+{
+    lock->next = 0;
+    lock->serving = 0;
+}
+
+/***************************************************************************
+ * Deques
+ */
+
+static bool
+deque_push(worker_t *w, work_item_t *item)
+{
+    drworkpool_t *pool = w->pool;
+    bool res = false;
+    tlock_acquire(&w->lock);
+    /* Checked under the lock so nothing is added after cancel_queued() */
+    if (!pool->exiting && w->count < pool->capacity) {
+        w->items[(w->oldest + w->count) % pool->capacity] = *item;
+        w->count++;
+        res = true;
+    }
+    tlock_release(&w->lock);
+    return res;
+}
+
+static void
+item_taken(drworkpool_t *pool)
+{
+    dr_atomic_add32_return_sum(&pool->active, 1);
+    dr_atomic_add32_return_sum(&pool->queued, -1);
+}
+
+static bool
+deque_pop_newest(worker_t *w, OUT work_item_t *item)
+{
+    bool res = false;
+    tlock_acquire(&w->lock);
+    if (w->count > 0) {
+        w->count--;
+        *item = w->items[(w->oldest + w->count) % w->pool->capacity];
+        item_taken(w->pool);
+        res = true;
+    }
+    tlock_release(&w->lock);
+    return res;
+}
+
+static bool
+deque_steal_oldest(worker_t *w, OUT work_item_t *item)
+{
+    bool res = false;
+    tlock_acquire(&w->lock);
+    if (w->count > 0) {
+        *item = w->items[w->oldest];
+        w->oldest = (w->oldest + 1) % w->pool->capacity;
+        w->count--;
+        item_taken(w->pool);
+        res = true;
+    }
+    tlock_release(&w->lock);
+    return res;
+}
+
+/* Cancels every item in w's deque.  Caller must hold w->lock. */
+static void
+cancel_queued(worker_t *w)
+{
+    drworkpool_t *pool = w->pool;
+    while (w->count > 0) {
+        work_item_t *item = &w->items[w->oldest];
+        if (item->cancel_func != NULL)
+            (*item->cancel_func)(item->arg);
+        w->oldest = (w->oldest + 1) % pool->capacity;
+        w->count--;
+        dr_atomic_add32_return_sum(&pool->queued, -1);
+    }
+}
+
+/***************************************************************************
+ * Threads
+ */
+
+static worker_t *
+current_worker(drworkpool_t *pool)
+{
+    thread_id_t tid = dr_get_thread_id(dr_get_current_drcontext());
+    uint i;
+    for (i = 0; i < pool->num_threads; i++) {
+        if (pool->workers[i].tid == tid)
+            return &pool->workers[i];
+    }
+    return NULL;
+}
+
+static bool
+find_work(drworkpool_t *pool, worker_t *w, OUT work_item_t *item)
+{
+    uint i;
+    if (deque_pop_newest(w, item))
+        return true;
+    for (i = 1; i < pool->num_threads; i++) {
+        if (deque_steal_oldest(&pool->workers[(w->index + i) % pool->num_threads],
+                               item))
+            return true;
+    }
+    return false;
+}
+
+/* Wakes target if it is idle, or else some other idle thread to steal the
+ * new item.  If none is idle, the busy threads look for work before idling.
+ */
+static void
+wake_for(drworkpool_t *pool, worker_t *target)
+{
+    uint i;
+    if (target->idle) {
+        dr_event_signal(target->wake);
+        return;
+    }
+    for (i = 0; i < pool->num_threads; i++) {
+        if (pool->workers[i].idle) {
+            dr_event_signal(pool->workers[i].wake);
+            return;
+        }
+    }
+}
+
+static void
+worker_thread(void *arg)
+{
+    worker_t *w = (worker_t *) arg;
+    drworkpool_t *pool = w->pool;
+    work_item_t item;
+    w->tid = dr_get_thread_id(dr_get_current_drcontext());
+    LOG(2, "drworkpool: thread %d of pool "PFX" is "TIDFMT"\n", w->index, pool, w->tid);
+    while (!pool->exiting) {
+        if (find_work(pool, w, &item)) {
+            (*item.func)(item.arg);
+            if (dr_atomic_add32_return_sum(&pool->active, -1) == 0 && pool->queued == 0)
+                dr_event_signal(pool->done_event);
+            continue;
+        }
+        /* We announce that we are idle, then reset, then re-check, so that a
+         * submitter either sees us idle and signals after our reset or has
+         * already raised queued before our check.
+         */
+        dr_atomic_add32_return_sum(&w->idle, 1);
+        dr_event_reset(w->wake);
+        if (pool->queued == 0 && !pool->exiting)
+            dr_event_wait(w->wake);
+        dr_atomic_add32_return_sum(&w->idle, -1);
+    }
+    w->tid = INVALID_THREAD_ID;
+    if (dr_atomic_add32_return_sum(&pool->live_threads, -1) == 0)
+        dr_event_signal(pool->exited_event);
+}
+
+static drmf_status_t
+start_threads(drworkpool_t *pool)
+{
+    uint i;
+    pool->live_threads = pool->num_threads;
+    for (i = 0; i < pool->num_threads; i++) {
+        if (!dr_create_client_thread(worker_thread, &pool->workers[i])) {
+            /* the threads already running will exit on destroy */
+            dr_atomic_add32_return_sum(&pool->live_threads,
+                                       -(int)(pool->num_threads - i));
+            return DRMF_ERROR;
+        }
+    }
+    return DRMF_SUCCESS;
+}
+
+/* Cancels all queued items and stops the pool's threads from taking more.
+ * others_suspended says that every other thread is suspended, as at process
+ * exit.  One of them may then hold a deque lock that will never be released,
+ * so we do not take the locks: nothing else is running.  A thread suspended
+ * in the middle of taking an item leaves that item neither run nor canceled.
+ */
+static void
+pool_stop(drworkpool_t *pool, bool others_suspended)
+{
+    uint i;
+    pool->exiting = true;
+    for (i = 0; i < pool->num_threads; i++) {
+        worker_t *w = &pool->workers[i];
+        if (others_suspended)
+            cancel_queued(w);
+        else {
+            tlock_acquire(&w->lock);
+            cancel_queued(w);
+            tlock_release(&w->lock);
+        }
+        dr_event_signal(w->wake);
+    }
+}
+
+static void
+pool_free(drworkpool_t *pool)
+{
+    uint i;
+    for (i = 0; i < pool->num_threads; i++) {
+        worker_t *w = &pool->workers[i];
+        global_free(w->items, pool->capacity * sizeof(*w->items), HEAPSTAT_MISC);
+        dr_event_destroy(w->wake);
+    }
+    global_free(pool->workers, pool->num_threads * sizeof(*pool->workers),
+                HEAPSTAT_MISC);
+    dr_event_destroy(pool->done_event);
+    dr_event_destroy(pool->exited_event);
+    global_free(pool, sizeof(*pool), HEAPSTAT_MISC);
+}
+
+static void
+pool_list_remove(drworkpool_t *pool)
+{
+    drworkpool_t *prev = NULL, *cur;
+    tlock_acquire(&pool_list_lock);
+    for (cur = pool_list; cur != NULL; prev = cur, cur = cur->next) {
+        if (cur == pool) {
+            if (prev == NULL)
+                pool_list = cur->next;
+            else
+                prev->next = cur->next;
+            break;
+        }
+    }
+    tlock_release(&pool_list_lock);
+}
+
+#ifdef UNIX
+static void
+workpool_fork_init(void *drcontext)
+{
+    drworkpool_t *pool;
+    uint i;
+    /* Only the forking thread exists in the child.  Locks held by other
+     * threads will never be released and the pool threads are gone.  The
+     * queued items are the parent's to run, so the child cancels its copies.
+     */
+    tlock_reset(&pool_list_lock);
+    for (pool = pool_list; pool != NULL; pool = pool->next) {
+        for (i = 0; i < pool->num_threads; i++) {
+            worker_t *w = &pool->workers[i];
+            tlock_reset(&w->lock);
+            cancel_queued(w);
+            w->tid = INVALID_THREAD_ID;
+            w->idle = 0;
+            dr_event_reset(w->wake);
+        }
+        pool->queued = 0;
+        pool->active = 0;
+        dr_event_reset(pool->done_event);
+        dr_event_reset(pool->exited_event);
+        if (pool->exiting)
+            pool->live_threads = 0;
+        else if (start_threads(pool) != DRMF_SUCCESS)
+            LOG(1, "drworkpool: failed to re-create threads after fork\n");
+    }
+}
+#endif
+
+/***************************************************************************
+ * Interface
+ */
+
+DR_EXPORT
+drmf_status_t
+drworkpool_init(client_id_t client_id)
+{
+    drmf_status_t res;
+    /* handle multiple sets of init/exit calls */
+    int count = dr_atomic_add32_return_sum(&drworkpool_init_count, 1);
+    if (count > 1)
+        return DRMF_WARNING_ALREADY_INITIALIZED;
+
+    res = drmf_check_version(client_id);
+    if (res != DRMF_SUCCESS)
+        return res;
+
+#ifdef UNIX
+    dr_register_fork_init_event(workpool_fork_init);
+#endif
+    return DRMF_SUCCESS;
+}
+
+DR_EXPORT
+drmf_status_t
+drworkpool_exit(void)
+{
+    drworkpool_t *pool, *next;
+    /* handle multiple sets of init/exit calls */
+    int count = dr_atomic_add32_return_sum(&drworkpool_init_count, -1);
+    if (count > 0)
+        return DRMF_SUCCESS;
+    if (count < 0)
+        return DRMF_ERROR;
+
+#ifdef UNIX
+    dr_unregister_fork_init_event(workpool_fork_init);
+#endif
+    /* All other threads, pool threads included, are suspended, so we neither
+     * wait for them nor worry about them touching what we free.  We take no
+     * locks, as a suspended thread may hold one.
+     */
+    for (pool = pool_list; pool != NULL; pool = next) {
+        next = pool->next;
+        LOG(1, "drworkpool: pool "PFX" not destroyed before exit\n", pool);
+        pool_stop(pool, true/*others suspended*/);
+        pool_free(pool);
+    }
+    pool_list = NULL;
+    return DRMF_SUCCESS;
+}
+
+DR_EXPORT
+drmf_status_t
+drworkpool_create(OUT drworkpool_t **pool_out, drworkpool_options_t *ops)
+{
+    drworkpool_t *pool;
+    drmf_status_t res;
+    uint i;
+    if (pool_out == NULL || ops == NULL || ops->num_threads == 0)
+        return DRMF_ERROR_INVALID_PARAMETER;
+    if (ops->struct_size != sizeof(*ops))
+        return DRMF_ERROR_INVALID_SIZE;
+    if (drworkpool_init_count <= 0)
+        return DRMF_ERROR_NOT_INITIALIZED;
+
+    pool = (drworkpool_t *) global_alloc(sizeof(*pool), HEAPSTAT_MISC);
+    memset(pool, 0, sizeof(*pool));
+    pool->num_threads = ops->num_threads;
+    pool->capacity = (ops->queue_capacity == 0) ? DEFAULT_QUEUE_CAPACITY :
+        ops->queue_capacity;
+    pool->workers = (worker_t *)
+        global_alloc(pool->num_threads * sizeof(*pool->workers), HEAPSTAT_MISC);
+    memset(pool->workers, 0, pool->num_threads * sizeof(*pool->workers));
+    for (i = 0; i < pool->num_threads; i++) {
+        worker_t *w = &pool->workers[i];
+        w->pool = pool;
+        w->index = i;
+        w->items = (work_item_t *)
+            global_alloc(pool->capacity * sizeof(*w->items), HEAPSTAT_MISC);
+        w->tid = INVALID_THREAD_ID;
+        w->wake = dr_event_create();
+    }
+    pool->done_event = dr_event_create();
+    pool->exited_event = dr_event_create();
+
+    res = start_threads(pool);
+    if (res != DRMF_SUCCESS) {
+        pool_stop(pool, false/*!others suspended*/);
+        while (pool->live_threads > 0)
+            dr_event_wait(pool->exited_event);
+        pool_free(pool);
+        return res;
+    }
+
+    tlock_acquire(&pool_list_lock);
+    pool->next = pool_list;
+    pool_list = pool;
+    tlock_release(&pool_list_lock);
+
+    LOG(1, "drworkpool: created pool "PFX" with %d threads\n", pool, pool->num_threads);
+    *pool_out = pool;
+    return DRMF_SUCCESS;
+}
+
+DR_EXPORT
+drmf_status_t
+drworkpool_destroy(drworkpool_t *pool)
+{
+    if (pool == NULL)
+        return DRMF_ERROR_INVALID_PARAMETER;
+    if (current_worker(pool) != NULL)
+        return DRMF_ERROR_INVALID_CALL;
+    pool_list_remove(pool);
+    pool_stop(pool, false/*!others suspended*/);
+    while (pool->live_threads > 0)
+        dr_event_wait(pool->exited_event);
+    pool_free(pool);
+    return DRMF_SUCCESS;
+}
+
+DR_EXPORT
+drmf_status_t
+drworkpool_submit(drworkpool_t *pool, drworkpool_func_t func,
+                  drworkpool_func_t cancel_func, void *arg)
+{
+    work_item_t item;
+    worker_t *self, *target = NULL;
+    uint start, i;
+    if (pool == NULL || func == NULL)
+        return DRMF_ERROR_INVALID_PARAMETER;
+    if (pool->exiting)
+        return DRMF_ERROR_INVALID_CALL;
+    item.func = func;
+    item.cancel_func = cancel_func;
+    item.arg = arg;
+    self = current_worker(pool);
+    if (self != NULL)
+        start = self->index;
+    else {
+        start = (uint) dr_atomic_add32_return_sum(&pool->next_worker, 1) %
+            pool->num_threads;
+    }
+    /* Raised before the push so that a thief never drives it negative */
+    dr_atomic_add32_return_sum(&pool->queued, 1);
+    for (i = 0; i < pool->num_threads; i++) {
+        worker_t *w = &pool->workers[(start + i) % pool->num_threads];
+        if (deque_push(w, &item)) {
+            target = w;
+            break;
+        }
+    }
+    if (target == NULL) {
+        dr_atomic_add32_return_sum(&pool->queued, -1);
+        return pool->exiting ? DRMF_ERROR_INVALID_CALL : DRMF_ERROR_NOMEM;
+    }
+    if (target != self)
+        wake_for(pool, target);
+    return DRMF_SUCCESS;
+}
+
+DR_EXPORT
+drmf_status_t
+drworkpool_wait(drworkpool_t *pool)
+{
+    if (pool == NULL)
+        return DRMF_ERROR_INVALID_PARAMETER;
+    if (current_worker(pool) != NULL)
+        return DRMF_ERROR_INVALID_CALL;
+    while (true) {
+        dr_event_reset(pool->done_event);
+        /* An item moves from queued to active, so check queued first */
+        if (pool->queued == 0 && pool->active == 0)
+            break;
+        dr_event_wait(pool->done_event);
+    }
+    /* Pass the wakeup on to any other waiter */
+    dr_event_signal(pool->done_event);
+    return DRMF_SUCCESS;
+}
+
+DR_EXPORT
+drmf_status_t
+drworkpool_is_pool_thread(drworkpool_t *pool, OUT bool *is_pool)
+{
+    if (pool == NULL || is_pool == NULL)
+        return DRMF_ERROR_INVALID_PARAMETER;
+    *is_pool = (current_worker(pool) != NULL);
+    return DRMF_SUCCESS;
+}
@@ -0,0 +1,186 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/* Dr. Memory: the memory debugger
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License, and no later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _DRWORKPOOL_H_
+#define _DRWORKPOOL_H_ 1
+
+/* Dr. WorkPool: Tool Thread Work Pool Extension */
+
+/* Framework-shared header */
+#include "drmemory_framework.h"
+
+/**
+ * @file drworkpool.h
+ * @brief Header for Dr. WorkPool: Tool Thread Work Pool Extension
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \addtogroup drworkpool Dr. WorkPool: Tool Thread Work Pool Extension
+ */
+/*@{*/ /* begin doxygen group */
+
+/** Opaque handle for a work pool. */
+typedef struct _drworkpool_t drworkpool_t;
+
+/**
+ * Type of a work item callback, invoked on a pool thread with the \p arg
+ * that was passed to drworkpool_submit().
+ */
+typedef void (*drworkpool_func_t)(void *arg);
+
+/** Parameters for drworkpool_create(). */
+typedef struct _drworkpool_options_t {
+    /** For compatibility.  Set to sizeof(drworkpool_options_t). */
+    size_t struct_size;
+    /** The number of client threads to create.  Must be at least 1. */
+    uint num_threads;
+    /**
+     * The maximum number of queued (not yet running) items per thread.
+     * Once every thread's queue is full, drworkpool_submit() fails with
+     * #DRMF_ERROR_NOMEM.  0 selects a default of 256.
+     */
+    uint queue_capacity;
+} drworkpool_options_t;
+
+DR_EXPORT
+/**
+ * Initializes drworkpool.  Can be called multiple times (by separate
+ * components, normally) but each call must be paired with a corresponding
+ * call to drworkpool_exit().
+ *
+ * @param[in]  client_id  The id of the client using drworkpool, as passed
+ *   to dr_init().
+ *
+ * \return success code.
+ */
+drmf_status_t
+drworkpool_init(client_id_t client_id);
+
+DR_EXPORT
+/**
+ * Cleans up drworkpool.  Must be called from the process exit event.  By
+ * then DynamoRIO has suspended all client threads, so pools that were not
+ * destroyed have their queued items cancelled (see drworkpool_submit()) and
+ * are freed without waiting for items that were in progress.
+ *
+ * \return success code.
+ */
+drmf_status_t
+drworkpool_exit(void);
+
+DR_EXPORT
+/**
+ * Creates a pool of client threads, each with its own queue of work items.
+ * An idle thread takes work from the other threads' queues, so a slow item
+ * does not hold up the items queued behind it.
+ *
+ * On UNIX, in a forked child the pool's threads are re-created and the
+ * items that were queued in the parent are cancelled in the child, as the
+ * parent still owns them.
+ *
+ * @param[out] pool  The new pool.
+ * @param[in]  ops   The pool parameters.
+ *
+ * \return success code.
+ */
+drmf_status_t
+drworkpool_create(OUT drworkpool_t **pool, drworkpool_options_t *ops);
+
+DR_EXPORT
+/**
+ * Cancels all queued items, waits for the items in progress to finish,
+ * and then terminates the pool's threads and frees the pool.  Must not be
+ * called from the process exit event (see drworkpool_exit()) or from a
+ * work item.
+ *
+ * @param[in]  pool  The pool to destroy.
+ *
+ * \return success code.
+ */
+drmf_status_t
+drworkpool_destroy(drworkpool_t *pool);
+
+DR_EXPORT
+/**
+ * Queues \p func to be called with \p arg on one of the pool's threads.
+ * Items submitted from a pool thread go to that thread's own queue and are
+ * preferentially run by it, newest first, which keeps related work
+ * together.  Other threads take the oldest items.  No ordering is
+ * guaranteed between items.
+ *
+ * If the item is never run because the pool is destroyed, or because it was
+ * queued in the parent of a forked child, \p cancel_func (if non-NULL) is
+ * called with \p arg instead, so that the item's resources can be freed.
+ * \p cancel_func may be called on any thread, while the pool's internal
+ * state is locked: it must not call back into drworkpool.
+ *
+ * @param[in]  pool         The pool.
+ * @param[in]  func         The work callback.
+ * @param[in]  cancel_func  The optional cancellation callback.
+ * @param[in]  arg          The argument to pass to either callback.
+ *
+ * Apart from submissions by the pool's own work items, this must not be
+ * called concurrently with drworkpool_destroy().
+ *
+ * \return success code.  Returns #DRMF_ERROR_NOMEM if all of the queues are
+ * full, in which case the caller may run the work itself or retry later,
+ * and #DRMF_ERROR_INVALID_CALL if the pool is being destroyed.
+ */
+drmf_status_t
+drworkpool_submit(drworkpool_t *pool, drworkpool_func_t func,
+                  drworkpool_func_t cancel_func, void *arg);
+
+DR_EXPORT
+/**
+ * Waits until every item submitted to \p pool has finished, including any
+ * submitted by the items themselves while waiting.  Must not be called
+ * from a work item.
+ *
+ * @param[in]  pool  The pool.
+ *
+ * \return success code.
+ */
+drmf_status_t
+drworkpool_wait(drworkpool_t *pool);
+
+DR_EXPORT
+/**
+ * Queries whether the current thread is one of \p pool's threads.
+ *
+ * @param[in]  pool     The pool.
+ * @param[out] is_pool  Whether the current thread belongs to \p pool.
+ *
+ * \return success code.
+ */
+drmf_status_t
+drworkpool_is_pool_thread(drworkpool_t *pool, OUT bool *is_pool);
+
+/*@}*/ /* end doxygen group */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DRWORKPOOL_H_ */
@@ -0,0 +1,365 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/* Dr. Memory: the memory debugger
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License, and no later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Overhead benchmark kernels, driven by runbench.cmake.
+ * Usage: bench <kernel> [scale]
+ * Each kernel is timed on its own, excluding process startup and exit, and
+ * reports "kernel_ms: <N>" plus a checksum that keeps the work observable.
+ * The kernels are meant to be error-free so that reporting costs do not
+ * skew the measurements.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef UNIX
+# include <pthread.h>
+# include <time.h>
+#else
+# include <windows.h>
+# include <process.h>
+#endif
+#ifdef X86
+# include <emmintrin.h>
+#endif
+
+#define NUM_THREADS 4
+
+static unsigned int rand_state = 12345;
+
+static unsigned int
+next_rand(void)
+{
+    /* simple LCG so results are repeatable across runs and platforms */
+    rand_state = rand_state * 1103515245 + 12345;
+    return (rand_state >> 16) & 0x7fff;
+}
+
+static double
+now_ms(void)
+{
+#ifdef UNIX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+#else
+    LARGE_INTEGER count, freq;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+    return (double)count.QuadPart * 1000.0 / (double)freq.QuadPart;
+#endif
+}
+
+/***************************************************************************
+ * Kernels
+ */
+
+/* Allocation churn: a live set of random-sized objects replaced at random */
+static unsigned int
+kernel_alloc(int scale)
+{
+#define LIVE_OBJS 4096
+    static char *live[LIVE_OBJS];
+    unsigned int sum = 0;
+    int i;
+    for (i = 0; i < 2000000 * scale; i++) {
+        int idx = next_rand() % LIVE_OBJS;
+        size_t sz = 8 + next_rand() % 512;
+        if (live[idx] != NULL) {
+            sum += (unsigned char) live[idx][0];
+            free(live[idx]);
+        }
+        live[idx] = (char *) malloc(sz);
+        live[idx][0] = (char) sz;
+        live[idx][sz - 1] = (char) i;
+    }
+    for (i = 0; i < LIVE_OBJS; i++)
+        free(live[i]);
+    memset(live, 0, sizeof(live));
+    return sum;
+#undef LIVE_OBJS
+}
+
+/* String processing: the libc routines Dr. Memory replaces */
+static unsigned int
+kernel_string(int scale)
+{
+    char src[256], dst[512];
+    unsigned int sum = 0;
+    int i, j;
+    for (i = 0; i < (int) sizeof(src) - 1; i++)
+        src[i] = 'a' + (i % 26);
+    src[sizeof(src) - 1] = '\0';
+    for (i = 0; i < 600000 * scale; i++) {
+        int len = 16 + next_rand() % 200;
+        char *p;
+        memcpy(dst, src, len);
+        dst[len] = '\0';
+        strcat(dst, "-suffix");
+        sum += (unsigned int) strlen(dst);
+        p = strchr(dst, 'q');
+        if (p != NULL)
+            sum += (unsigned int)(p - dst);
+        sum += (strcmp(dst, src) < 0) ? 1 : 0;
+        for (j = 0; dst[j] != '\0'; j++)
+            sum += (unsigned char) dst[j];
+    }
+    return sum;
+}
+
+/* Floating-point vector math */
+static unsigned int
+kernel_simd(int scale)
+{
+#define VEC_LEN 4096
+    float *a = (float *) malloc(VEC_LEN * sizeof(float));
+    float *b = (float *) malloc(VEC_LEN * sizeof(float));
+    float total = 0.f;
+    int i, iter;
+    for (i = 0; i < VEC_LEN; i++) {
+        a[i] = (float)(i % 17) * 0.5f;
+        b[i] = (float)(i % 13) * 0.25f;
+    }
+    for (iter = 0; iter < 60000 * scale; iter++) {
+#ifdef X86
+        __m128 acc = _mm_setzero_ps();
+        float lanes[4];
+        for (i = 0; i < VEC_LEN; i += 4) {
+            __m128 va = _mm_loadu_ps(&a[i]);
+            __m128 vb = _mm_loadu_ps(&b[i]);
+            acc = _mm_add_ps(acc, _mm_mul_ps(va, vb));
+            /* saxpy back into b to keep a loop-carried store */
+            _mm_storeu_ps(&b[i], _mm_add_ps(vb, _mm_mul_ps(va, _mm_set1_ps(1e-6f))));
+        }
+        _mm_storeu_ps(lanes, acc);
+        total += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#else
+        float acc = 0.f;
+        for (i = 0; i < VEC_LEN; i++) {
+            acc += a[i] * b[i];
+            b[i] += a[i] * 1e-6f;
+        }
+        total += acc;
+#endif
+    }
+    free(a);
+    free(b);
+    return (unsigned int) total;
+#undef VEC_LEN
+}
+
+/* Pointer chasing through a shuffled heap list */
+typedef struct _node_t {
+    struct _node_t *next;
+    size_t payload;
+} node_t;
+
+static unsigned int
+kernel_pointer(int scale)
+{
+#define NUM_NODES 65536
+    node_t **nodes = (node_t **) malloc(NUM_NODES * sizeof(*nodes));
+    node_t *cur;
+    unsigned int sum = 0;
+    int i, iter;
+    for (i = 0; i < NUM_NODES; i++) {
+        nodes[i] = (node_t *) malloc(sizeof(node_t));
+        nodes[i]->payload = i;
+    }
+    for (i = NUM_NODES - 1; i > 0; i--) {
+        int j = (next_rand() * 32768 + next_rand()) % (i + 1);
+        node_t *tmp = nodes[i];
+        nodes[i] = nodes[j];
+        nodes[j] = tmp;
+    }
+    for (i = 0; i < NUM_NODES; i++)
+        nodes[i]->next = nodes[(i + 1) % NUM_NODES];
+    for (iter = 0; iter < 80 * scale; iter++) {
+        cur = nodes[0];
+        for (i = 0; i < NUM_NODES; i++) {
+            sum += (unsigned int) cur->payload;
+            cur = cur->next;
+        }
+    }
+    for (i = 0; i < NUM_NODES; i++)
+        free(nodes[i]);
+    free(nodes);
+    return sum;
+#undef NUM_NODES
+}
+
+/* Syscall-heavy I/O: small unbuffered writes and reads of a temp file */
+static unsigned int
+kernel_syscall(int scale)
+{
+    FILE *f = tmpfile();
+    char buf[128];
+    unsigned int sum = 0;
+    int i;
+    if (f == NULL) {
+        fprintf(stderr, "tmpfile failed\n");
+        exit(1);
+    }
+    setvbuf(f, NULL, _IONBF, 0);
+    memset(buf, 'x', sizeof(buf));
+    for (i = 0; i < 80000 * scale; i++) {
+        buf[0] = (char) i;
+        fwrite(buf, 1, sizeof(buf), f);
+        if (i % 64 == 63) {
+            /* read back the batch and then overwrite it with the next one */
+            int j;
+            rewind(f);
+            for (j = 0; j < 64 && fread(buf, 1, sizeof(buf), f) == sizeof(buf); j++)
+                sum += (unsigned char) buf[0];
+            rewind(f);
+        }
+    }
+    fclose(f);
+    return sum;
+}
+
+/* Multithreaded allocation: contention on the allocator and its tracking */
+static int thread_scale;
+
+#ifdef UNIX
+static void *
+#else
+static unsigned int __stdcall
+#endif
+thread_alloc_func(void *arg)
+{
+    unsigned int *result = (unsigned int *) arg;
+    unsigned int state = (unsigned int)(size_t) result;
+    char *objs[256];
+    unsigned int sum = 0;
+    int i;
+    memset(objs, 0, sizeof(objs));
+    for (i = 0; i < 800000 * thread_scale; i++) {
+        int idx;
+        state = state * 1103515245 + 12345;
+        idx = (state >> 16) % 256;
+        free(objs[idx]);
+        objs[idx] = (char *) malloc(16 + (state >> 8) % 256);
+        objs[idx][0] = (char) i;
+        sum += (unsigned char) objs[idx][0];
+    }
+    for (i = 0; i < 256; i++)
+        free(objs[i]);
+    *result = sum;
+    return 0;
+}
+
+static unsigned int
+kernel_threads(int scale)
+{
+    unsigned int results[NUM_THREADS];
+    unsigned int sum = 0;
+    int i;
+#ifdef UNIX
+    pthread_t thread[NUM_THREADS];
+#else
+    HANDLE thread[NUM_THREADS];
+#endif
+    thread_scale = scale;
+    for (i = 0; i < NUM_THREADS; i++) {
+#ifdef UNIX
+        pthread_create(&thread[i], NULL, thread_alloc_func, &results[i]);
+#else
+        thread[i] = (HANDLE) _beginthreadex(NULL, 0, thread_alloc_func, &results[i],
+                                            0, NULL);
+#endif
+    }
+    for (i = 0; i < NUM_THREADS; i++) {
+#ifdef UNIX
+        pthread_join(thread[i], NULL);
+#else
+        WaitForSingleObject(thread[i], INFINITE);
+        CloseHandle(thread[i]);
+#endif
+        sum += results[i];
+    }
+    return sum;
+}
+
+/* Deep recursion: stack frame allocation and teardown */
+static unsigned int
+recurse(int depth)
+{
+    volatile char frame[64];
+    frame[0] = (char) depth;
+    frame[63] = (char)(depth >> 8);
+    if (depth == 0)
+        return frame[0];
+    return recurse(depth - 1) + frame[63];
+}
+
+static unsigned int
+kernel_recursion(int scale)
+{
+    unsigned int sum = 0;
+    int i;
+    for (i = 0; i < 20000 * scale; i++)
+        sum += recurse(1000 + i % 64);
+    return sum;
+}
+
+static const struct {
+    const char *name;
+    unsigned int (*func)(int scale);
+} kernels[] = {
+    { "alloc",     kernel_alloc },
+    { "string",    kernel_string },
+    { "simd",      kernel_simd },
+    { "pointer",   kernel_pointer },
+    { "syscall",   kernel_syscall },
+    { "threads",   kernel_threads },
+    { "recursion", kernel_recursion },
+};
+#define NUM_KERNELS (sizeof(kernels)/sizeof(kernels[0]))
+
+int
+main(int argc, char **argv)
+{
+    int i, scale = 1;
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <kernel> [scale]\nkernels:", argv[0]);
+        for (i = 0; i < (int) NUM_KERNELS; i++)
+            fprintf(stderr, " %s", kernels[i].name);
+        fprintf(stderr, "\n");
+        return 1;
+    }
+    if (argc > 2)
+        scale = atoi(argv[2]);
+    if (scale <= 0)
+        scale = 1;
+    for (i = 0; i < (int) NUM_KERNELS; i++) {
+        if (strcmp(argv[1], kernels[i].name) == 0) {
+            double start = now_ms();
+            unsigned int checksum = (*kernels[i].func)(scale);
+            double end = now_ms();
+            printf("checksum: %u\n", checksum);
+            printf("kernel_ms: %d\n", (int)(end - start + 0.5));
+            return 0;
+        }
+    }
+    fprintf(stderr, "unknown kernel %s\n", argv[1]);
+    return 1;
+}
@@ -0,0 +1,146 @@
+# **********************************************************
+# Copyright (c) 2026 Google, Inc.  All rights reserved.
+# **********************************************************
+
+# Dr. Memory: the memory debugger
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation;
+# version 2.1 of the License, and no later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+# Library General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+# Runs each benchmark kernel natively and under each configuration and
+# writes a slowdown table.
+#
+# arguments:
+# * drmem_cmd = tool launch command, with @ separating args
+# * bench = path to the bench executable
+# * outfile = path of the CSV file to write
+# * kernels = optional @-separated list of kernels to run (default: all)
+# * configs = optional @-separated list of name=options entries, with
+#   spaces separating options (default: the list below)
+# * scale = optional kernel work multiplier (default: 1)
+# * reps = optional number of runs per measurement, of which the fastest
+#   is used (default: 3)
+# * timeout = optional per-run timeout in seconds (default: 600)
+#
+# The CSV has one row per kernel and configuration with the columns
+#   kernel,config,options,native_ms,tool_ms,slowdown
+# followed by a "mean" row per configuration.  Times are the kernels' own
+# measurements and so exclude tool startup and exit costs (symbol loading,
+# the leak scan, etc.).  The per-feature cost is the difference between
+# configurations: e.g., full vs no_uninit is the cost of definedness
+# checking, full vs wrap is -replace_malloc vs wrapping, and no_elide vs full
+# is the savings from skipping dead shadow register and eflags writes.
+
+if (NOT DEFINED kernels OR "${kernels}" STREQUAL "")
+  set(kernels alloc string simd pointer syscall threads recursion)
+endif ()
+if (NOT DEFINED configs OR "${configs}" STREQUAL "")
+  set(configs
+    "full="
+    "wrap=-no_replace_malloc"
+    "no_uninit=-no_check_uninitialized"
+    "no_elide=-no_elide_dead_shadow"
+    "leaks_only=-leaks_only"
+    "light=-light"
+    "pattern=-unaddr_only")
+endif ()
+if (NOT DEFINED scale OR "${scale}" STREQUAL "")
+  set(scale 1)
+endif ()
+if (NOT DEFINED reps OR "${reps}" STREQUAL "")
+  set(reps 3)
+endif ()
+if (NOT DEFINED timeout OR "${timeout}" STREQUAL "")
+  set(timeout 600)
+endif ()
+# lists are passed with @ separators to survive add_custom_target
+foreach (var drmem_cmd kernels configs)
+  string(REGEX REPLACE "@" ";" ${var} "${${var}}")
+endforeach ()
+
+# Sets ${out_ms} in the caller to the fastest of ${reps} runs of ${ARGN},
+# or to "error" if any run fails.
+function (time_kernel out_ms)
+  set(best "")
+  foreach (rep RANGE 1 ${reps})
+    execute_process(COMMAND ${ARGN}
+      RESULT_VARIABLE cmd_result
+      OUTPUT_VARIABLE cmd_out
+      ERROR_VARIABLE cmd_err
+      TIMEOUT ${timeout})
+    string(REGEX MATCH "kernel_ms: ([0-9]+)" ms_line "${cmd_out}")
+    if (NOT "${cmd_result}" STREQUAL "0" OR "${ms_line}" STREQUAL "")
+      message("*** failed: ${ARGN}\n${cmd_out}${cmd_err}")
+      set(${out_ms} "error" PARENT_SCOPE)
+      return()
+    endif ()
+    string(REGEX REPLACE "kernel_ms: ([0-9]+)" "\\1" ms "${ms_line}")
+    if ("${best}" STREQUAL "" OR ms LESS best)
+      set(best ${ms})
+    endif ()
+  endforeach ()
+  set(${out_ms} ${best} PARENT_SCOPE)
+endfunction (time_kernel)
+
+# Sets ${out} in the caller to ${x100}/100 formatted with two decimals.
+function (format_hundredths out x100)
+  math(EXPR whole "${x100} / 100")
+  math(EXPR frac "${x100} % 100")
+  if (frac LESS 10)
+    set(frac "0${frac}")
+  endif ()
+  set(${out} "${whole}.${frac}" PARENT_SCOPE)
+endfunction (format_hundredths)
+
+file(WRITE "${outfile}" "kernel,config,options,native_ms,tool_ms,slowdown\n")
+
+foreach (kernel ${kernels})
+  time_kernel(native_ms ${bench} ${kernel} ${scale})
+  set(native_${kernel} ${native_ms})
+  message("${kernel}: native ${native_ms} ms")
+endforeach ()
+
+foreach (config ${configs})
+  string(REGEX REPLACE "=.*" "" name "${config}")
+  string(REGEX REPLACE "^[^=]*=" "" ops "${config}")
+  set(ops_list ${ops})
+  separate_arguments(ops_list)
+  set(sum_x100 0)
+  set(count 0)
+  foreach (kernel ${kernels})
+    time_kernel(tool_ms ${drmem_cmd} ${ops_list} -- ${bench} ${kernel} ${scale})
+    set(native_ms ${native_${kernel}})
+    if ("${tool_ms}" STREQUAL "error" OR "${native_ms}" STREQUAL "error")
+      set(slowdown "error")
+    else ()
+      if (native_ms LESS 1)
+        set(native_ms 1)
+      endif ()
+      math(EXPR x100 "${tool_ms} * 100 / ${native_ms}")
+      format_hundredths(slowdown ${x100})
+      math(EXPR sum_x100 "${sum_x100} + ${x100}")
+      math(EXPR count "${count} + 1")
+    endif ()
+    message("${kernel}: ${name} ${tool_ms} ms, ${slowdown}x")
+    file(APPEND "${outfile}"
+      "${kernel},${name},${ops},${native_${kernel}},${tool_ms},${slowdown}\n")
+  endforeach ()
+  if (count GREATER 0)
+    math(EXPR mean_x100 "${sum_x100} / ${count}")
+    format_hundredths(mean ${mean_x100})
+    file(APPEND "${outfile}" "mean,${name},${ops},,,${mean}\n")
+  endif ()
+endforeach ()
+
+message("Results written to ${outfile}")
@@ -0,0 +1,88 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/* Dr. Memory: the memory debugger
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License, and no later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Tests that calloc zeroes memory reused from dirty freed chunks, even where
+ * the allocator skips zeroing for memory it knows the OS zeroed.  Run with
+ * -delay_frees 0 so frees are reused right away.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DIRTY 0xa5
+#define ROUNDS 8
+
+static size_t sizes[] = { 24, 200, 4000, 60000, 300000 };
+#define NUM_SIZES (sizeof(sizes)/sizeof(sizes[0]))
+
+static int
+count_nonzero(unsigned char *p, size_t size)
+{
+    size_t i;
+    int bad = 0;
+    for (i = 0; i < size; i++) {
+        if (p[i] != 0)
+            bad++;
+    }
+    return bad;
+}
+
+int
+main()
+{
+    unsigned char *p, *q;
+    size_t i;
+    int round, bad = 0;
+
+    for (round = 0; round < ROUNDS; round++) {
+        for (i = 0; i < NUM_SIZES; i++) {
+            /* Same size: the freed chunk itself is reused */
+            p = (unsigned char *) malloc(sizes[i]);
+            memset(p, DIRTY, sizes[i]);
+            free(p);
+            p = (unsigned char *) calloc(1, sizes[i]);
+            bad += count_nonzero(p, sizes[i]);
+            memset(p, DIRTY, sizes[i]);
+            free(p);
+            /* Smaller: a piece split off a dirty freed chunk */
+            p = (unsigned char *) calloc(2, sizes[i] / 4);
+            bad += count_nonzero(p, sizes[i] / 2);
+            free(p);
+        }
+    }
+
+    /* A realloc that grew into the arena tail and was then freed leaves
+     * dirty memory past where the chunk was first carved.
+     */
+    p = (unsigned char *) malloc(100);
+    q = (unsigned char *) realloc(p, 20000);
+    memset(q, DIRTY, 20000);
+    free(q);
+    p = (unsigned char *) calloc(20000, 1);
+    bad += count_nonzero(p, 20000);
+    free(p);
+
+    if (bad > 0)
+        printf("calloc returned %d dirty bytes\n", bad);
+    else
+        printf("calloc memory all zero\n");
+    return 0;
+}
@@ -0,0 +1,87 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/* Dr. Memory: the memory debugger
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License, and no later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Tests -elide_dead_shadow: uninitialized values written to registers and
+ * eflags that are overwritten before being read must not be reported, while
+ * the same values when they are read must be.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NOINLINE __attribute__((noinline))
+
+/* eax's and the add's eflags' uninitialized shadow is dead */
+static NOINLINE int
+dead_reg_and_eflags(int *uninit)
+{
+    int res;
+    __asm__ __volatile__("mov (%1), %%eax\n\t"
+                         "add $1, %%eax\n\t"
+                         "mov $5, %%eax\n\t"
+                         "test %%eax, %%eax\n\t"
+                         "mov %%eax, %0"
+                         : "=r"(res) : "r"(uninit) : "eax", "cc");
+    return res;
+}
+
+/* eax's uninitialized shadow reaches the result */
+static NOINLINE int
+live_reg(int *uninit)
+{
+    int res;
+    __asm__ __volatile__("mov (%1), %%eax\n\t"
+                         "add $1, %%eax\n\t"
+                         "mov %%eax, %0"
+                         : "=r"(res) : "r"(uninit) : "eax", "cc");
+    return res;
+}
+
+/* The add's uninitialized eflags reach the result */
+static NOINLINE int
+live_eflags(int *uninit)
+{
+    int res;
+    __asm__ __volatile__("xor %k0, %k0\n\t"
+                         "mov (%1), %%eax\n\t"
+                         "add $1, %%eax\n\t"
+                         "setz %b0"
+                         : "=&q"(res) : "r"(uninit) : "eax", "cc");
+    return res;
+}
+
+int
+main()
+{
+    int *uninit = (int *) malloc(sizeof(int));
+    int i, count = 0;
+
+    for (i = 0; i < 10; i++) {
+        if (dead_reg_and_eflags(uninit) == 5) /* no error */
+            count++;
+    }
+    if (live_reg(uninit) == 0) /* error: uninitialized */
+        count++;
+    if (live_eflags(uninit) == 0) /* error: uninitialized */
+        count++;
+    printf("count %s\n", count >= 10 ? "ok" : "wrong");
+    free(uninit);
+    return 0;
+}
@@ -0,0 +1,89 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/* Dr. Memory: the memory debugger
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License, and no later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Tests that the slowpath's per-thread decode cache notices code that is
+ * rewritten in place: the same pc first holds a 4-byte load and then a
+ * 2-byte load, and each must be reported with its own size.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define NOINLINE __attribute__((noinline))
+#define ITERS 10
+#define BUF_SIZE 16
+
+typedef int (*load_func_t)(char *);
+
+#ifdef __x86_64__
+/* mov eax, [rdi]; ret */
+static const unsigned char load4[] = { 0x8b, 0x07, 0xc3 };
+/* movzx eax, word [rdi]; ret */
+static const unsigned char load2[] = { 0x0f, 0xb7, 0x07, 0xc3 };
+#else
+/* mov ecx, [esp+4]; mov eax, [ecx]; ret */
+static const unsigned char load4[] = { 0x8b, 0x4c, 0x24, 0x04, 0x8b, 0x01, 0xc3 };
+/* mov ecx, [esp+4]; movzx eax, word [ecx]; ret */
+static const unsigned char load2[] = { 0x8b, 0x4c, 0x24, 0x04, 0x0f, 0xb7, 0x01, 0xc3 };
+#endif
+
+static NOINLINE int
+call_load4(load_func_t func, char *buf)
+{
+    return func(buf + BUF_SIZE); /* error: unaddressable 4 bytes */
+}
+
+static NOINLINE int
+call_load2(load_func_t func, char *buf)
+{
+    return func(buf + BUF_SIZE); /* error: unaddressable 2 bytes */
+}
+
+int
+main()
+{
+    char *buf = (char *) malloc(BUF_SIZE);
+    unsigned char *code = (unsigned char *)
+        mmap(0, 4096, PROT_READ|PROT_WRITE|PROT_EXEC, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    int i, sum = 0;
+
+    if (code == (unsigned char *) MAP_FAILED) {
+        printf("mmap failed\n");
+        return 1;
+    }
+    memset(buf, 0, BUF_SIZE);
+
+    /* Each call past the first goes back to the slowpath at the same pc */
+    memcpy(code, load4, sizeof(load4));
+    for (i = 0; i < ITERS; i++)
+        sum += call_load4((load_func_t) code, buf);
+
+    /* A stale decoding would report the 2-byte load as reading 4 bytes */
+    memcpy(code, load2, sizeof(load2));
+    for (i = 0; i < ITERS; i++)
+        sum += call_load2((load_func_t) code, buf);
+
+    munmap(code, 4096);
+    free(buf);
+    printf("done\n");
+    return (sum == -1) ? 1 : 0;
+}
@@ -0,0 +1,61 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/* Dr. Memory: the memory debugger
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License, and no later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Causes runtime code cache flushes that -flush_min_interval batches: with
+ * -share_xl8, several references in one loop that share a translation each
+ * abandon sharing once they straddle enough 64K shadow blocks; in pattern
+ * mode, 2-byte reads of the pattern value switch checks to 4 bytes.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BUF_SIZE (1024*1024)
+#define STRIDE 8
+#define PATTERN_READS 64
+
+int
+main()
+{
+    unsigned char *buf = (unsigned char *) malloc(BUF_SIZE);
+    unsigned short *pat = (unsigned short *) malloc(PATTERN_READS * sizeof(*pat));
+    unsigned char *p;
+    unsigned int sum = 0;
+    int i;
+
+    memset(buf, 1, BUF_SIZE);
+    /* References 512 bytes apart from one base register are translated
+     * together, and cross into different 64K blocks near each boundary.
+     */
+    for (p = buf; p + 2048 < buf + BUF_SIZE; p += STRIDE)
+        sum += p[0] + p[512] + p[1024] + p[1536] + p[2047];
+
+    /* The -pattern value, so each 2-byte check of these reads faults */
+    for (i = 0; i < PATTERN_READS; i++)
+        pat[i] = 0xf1fd;
+    for (i = 0; i < PATTERN_READS; i++)
+        sum += pat[i];
+
+    printf("sum %u\n", sum);
+    free(pat);
+    free(buf);
+    return 0;
+}
@@ -0,0 +1,78 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/* Dr. Memory: the memory debugger
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License, and no later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Test app for drltrace: loads drltrace_lib, calls each of its exports, and
+ * unloads it, twice, so the exports are wrapped again after the reload.
+ */
+
+#include <stdio.h>
+#ifdef WINDOWS
+# include <windows.h>
+#else
+# include <dlfcn.h>
+#endif
+
+#define LOADS 2
+
+typedef int (*lib_func_t)(int, int);
+
+int
+main(int argc, char **argv)
+{
+    int i, sum = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: <library-path>\n");
+        return 1;
+    }
+    for (i = 0; i < LOADS; i++) {
+        lib_func_t first, second;
+#ifdef WINDOWS
+        HMODULE lib = LoadLibrary(argv[1]);
+#else
+        void *lib = dlopen(argv[1], RTLD_NOW);
+#endif
+        if (lib == NULL) {
+            fprintf(stderr, "error loading library %s\n", argv[1]);
+            return 1;
+        }
+#ifdef WINDOWS
+        first = (lib_func_t) GetProcAddress(lib, "drltrace_lib_first");
+        second = (lib_func_t) GetProcAddress(lib, "drltrace_lib_second");
+#else
+        first = (lib_func_t) dlsym(lib, "drltrace_lib_first");
+        second = (lib_func_t) dlsym(lib, "drltrace_lib_second");
+#endif
+        if (first == NULL || second == NULL) {
+            fprintf(stderr, "error finding exports\n");
+            return 1;
+        }
+        sum += first(0x11, 0x12);
+        sum += second(0x21, 0x22);
+#ifdef WINDOWS
+        FreeLibrary(lib);
+#else
+        dlclose(lib);
+#endif
+    }
+    fprintf(stderr, "done %d\n", sum);
+    return 0;
+}
@@ -0,0 +1,44 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/* Dr. Memory: the memory debugger
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License, and no later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Library for drltrace_app: two exports with distinct arguments, so a trace
+ * shows whether each call is reported under its own name.
+ */
+
+#ifdef WINDOWS
+# define LIB_EXPORT __declspec(dllexport)
+#else
+# define LIB_EXPORT __attribute__ ((visibility ("default")))
+#endif
+
+LIB_EXPORT
+int
+drltrace_lib_first(int a, int b)
+{
+    return a + b;
+}
+
+LIB_EXPORT
+int
+drltrace_lib_second(int a, int b)
+{
+    return a * b;
+}
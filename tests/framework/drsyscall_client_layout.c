@@ -0,0 +1,118 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/* Dr. Memory: the memory debugger
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License, and no later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Tests that Dr. Syscall's cached unknown syscall layouts
+ * (drsys_options_t.unknown_layout_file) survive a write and read back.
+ */
+
+#include "dr_api.h"
+#include "drmgr.h"
+#include "drsyscall.h"
+#include <string.h>
+
+#undef ASSERT /* we don't want msgbox */
+#define ASSERT(cond, msg) \
+    ((void)((!(cond)) ? \
+     (dr_fprintf(STDERR, "ASSERT FAILURE: %s:%d: %s (%s)", \
+                 __FILE__,  __LINE__, #cond, msg), \
+      dr_abort(), 0) : 0))
+
+/* Must match drsyscall.c */
+#define LAYOUT_FILE_HEADER "DrSyscall Unknown Layout File\n1\n"
+
+/* High enough that nothing observed during the run becomes stable, so every
+ * entry written at exit must have come from the file we wrote at init.
+ */
+#define LAYOUT_THRESHOLD 1000000
+
+static const char *layout_path;
+
+/* The last entry has no newline and the file is padded to a page multiple,
+ * so parsing must stop at the end of the mapping.
+ */
+static const char *const layout_entries =
+    "9001.0=0:0:8,1:4:16\n"
+    "9002.305419896=\n"
+    /* invalid: size 0, so it should be re-learned rather than cached */
+    "9003.0=0:0:0\n";
+static const char *const layout_last = "9004.7=2:8:4";
+
+static void
+write_layout_file(void)
+{
+    file_t f = dr_open_file(layout_path, DR_FILE_WRITE_OVERWRITE);
+    size_t sofar = 0, pad, page = dr_page_size();
+    ASSERT(f != INVALID_FILE, "failed to create layout file");
+    sofar += dr_write_file(f, LAYOUT_FILE_HEADER, strlen(LAYOUT_FILE_HEADER));
+    sofar += dr_write_file(f, layout_entries, strlen(layout_entries));
+    /* blank lines are skipped */
+    for (pad = page - (sofar + strlen(layout_last)) % page; pad > 0; pad--)
+        sofar += dr_write_file(f, "\n", 1);
+    sofar += dr_write_file(f, layout_last, strlen(layout_last));
+    ASSERT(sofar % page == 0, "layout file not padded");
+    dr_close_file(f);
+}
+
+static void
+check_layout_file(void)
+{
+    static char buf[8192];
+    ssize_t len;
+    file_t f = dr_open_file(layout_path, DR_FILE_READ);
+    ASSERT(f != INVALID_FILE, "layout file not written at exit");
+    len = dr_read_file(f, buf, sizeof(buf) - 1);
+    dr_close_file(f);
+    ASSERT(len > 0, "failed to read layout file");
+    buf[len] = '\0';
+    ASSERT(strncmp(buf, LAYOUT_FILE_HEADER, strlen(LAYOUT_FILE_HEADER)) == 0,
+           "bad header");
+    ASSERT(strstr(buf, "\n9001.0=0:0:8,1:4:16\n") != NULL, "lost multi-write entry");
+    ASSERT(strstr(buf, "\n9002.305419896=\n") != NULL, "lost empty entry");
+    ASSERT(strstr(buf, "\n9004.7=2:8:4\n") != NULL, "lost unterminated last entry");
+    ASSERT(strstr(buf, "9003.") == NULL, "invalid entry was cached");
+}
+
+static void
+exit_event(void)
+{
+    /* drsys_exit() writes out the stable layouts */
+    if (drsys_exit() != DRMF_SUCCESS)
+        ASSERT(false, "drsys failed to exit");
+    check_layout_file();
+    dr_fprintf(STDERR, "TEST PASSED\n");
+    drmgr_exit();
+}
+
+DR_EXPORT void
+dr_client_main(client_id_t id, int argc, const char *argv[])
+{
+    drsys_options_t ops = { sizeof(ops), 0, };
+    ASSERT(argc > 1, "takes the layout file path");
+    layout_path = argv[1];
+    write_layout_file();
+    ops.analyze_unknown_syscalls = true;
+    ops.unknown_layout_threshold = LAYOUT_THRESHOLD;
+    ops.unknown_layout_file = layout_path;
+    drmgr_init();
+    if (drsys_init(id, &ops) != DRMF_SUCCESS)
+        ASSERT(false, "drsys failed to init");
+    dr_register_exit_event(exit_event);
+}
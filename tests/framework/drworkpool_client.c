@@ -0,0 +1,214 @@
+/* **************************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **************************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Tests drworkpool: nested submission, full queues, waiting, and cancellation */
+
+#include "dr_api.h"
+#include "drworkpool.h"
+#include <string.h>
+
+#define NUM_ITEMS 200
+#define NUM_CANCELABLE 5
+
+static drworkpool_t *pool;
+static drworkpool_t *serial_pool;
+static drworkpool_t *idle_pool;
+static drworkpool_t *busy_pool;
+static volatile int items_run;
+static volatile int cancels;
+static volatile bool wrong_thread;
+static bool tested;
+static void *started;
+static void *release;
+
+static void
+check_pool_thread(drworkpool_t *p, bool expect)
+{
+    bool is_pool;
+    if (drworkpool_is_pool_thread(p, &is_pool) != DRMF_SUCCESS || is_pool != expect)
+        wrong_thread = true;
+}
+
+static void
+child_item(void *arg)
+{
+    check_pool_thread(pool, true);
+    dr_atomic_add32_return_sum(&items_run, 1);
+}
+
+static void
+parent_item(void *arg)
+{
+    check_pool_thread(pool, true);
+    dr_atomic_add32_return_sum(&items_run, 1);
+    if ((ptr_uint_t)arg % 2 == 0) {
+        /* our own queue may be full, in which case we do the work inline */
+        if (drworkpool_submit(pool, child_item, NULL, NULL) != DRMF_SUCCESS)
+            child_item(NULL);
+    }
+}
+
+static void
+blocker_item(void *arg)
+{
+    dr_event_signal(started);
+    dr_event_wait(release);
+}
+
+static void
+cancelable_item(void *arg)
+{
+    DR_ASSERT_MSG(false, "item should have been cancelled");
+}
+
+static void
+cancel_item(void *arg)
+{
+    dr_atomic_add32_return_sum(&cancels, 1);
+    dr_event_signal(release);
+}
+
+static void
+spin_item(void *arg)
+{
+    /* Keeps the pool threads in the deque code until they are suspended at
+     * exit, where drworkpool_exit() must not wait for a lock they hold.
+     */
+    drworkpool_submit(busy_pool, spin_item, NULL, NULL);
+}
+
+static void
+test_pool(void)
+{
+    drworkpool_options_t ops;
+    ptr_uint_t i;
+    memset(&ops, 0, sizeof(ops));
+    ops.struct_size = sizeof(ops);
+    ops.num_threads = 4;
+    /* small enough that submissions hit full queues */
+    ops.queue_capacity = 8;
+    if (drworkpool_create(&pool, &ops) != DRMF_SUCCESS)
+        DR_ASSERT_MSG(false, "failed to create pool");
+    check_pool_thread(pool, false);
+    for (i = 0; i < NUM_ITEMS; i++) {
+        drmf_status_t res;
+        while ((res = drworkpool_submit(pool, parent_item, NULL, (void *)i)) ==
+               DRMF_ERROR_NOMEM)
+            dr_thread_yield();
+        DR_ASSERT(res == DRMF_SUCCESS);
+    }
+    if (drworkpool_wait(pool) != DRMF_SUCCESS)
+        DR_ASSERT(false);
+    DR_ASSERT_MSG(items_run == NUM_ITEMS + NUM_ITEMS / 2, "items were lost");
+    if (drworkpool_destroy(pool) != DRMF_SUCCESS)
+        DR_ASSERT(false);
+}
+
+static void
+test_cancel(void)
+{
+    drworkpool_options_t ops;
+    int i;
+    memset(&ops, 0, sizeof(ops));
+    ops.struct_size = sizeof(ops);
+    ops.num_threads = 1;
+    if (drworkpool_create(&serial_pool, &ops) != DRMF_SUCCESS)
+        DR_ASSERT_MSG(false, "failed to create pool");
+    started = dr_event_create();
+    release = dr_event_create();
+    if (drworkpool_submit(serial_pool, blocker_item, NULL, NULL) != DRMF_SUCCESS)
+        DR_ASSERT(false);
+    dr_event_wait(started);
+    /* the only thread is blocked, so these stay queued */
+    for (i = 0; i < NUM_CANCELABLE; i++) {
+        if (drworkpool_submit(serial_pool, cancelable_item, cancel_item, NULL) !=
+            DRMF_SUCCESS)
+            DR_ASSERT(false);
+    }
+    /* cancellation releases the blocker, which destroy then waits for */
+    if (drworkpool_destroy(serial_pool) != DRMF_SUCCESS)
+        DR_ASSERT(false);
+    DR_ASSERT_MSG(cancels == NUM_CANCELABLE, "items were not cancelled");
+    dr_event_destroy(started);
+    dr_event_destroy(release);
+
+    /* left for drworkpool_exit() to clean up */
+    if (drworkpool_create(&idle_pool, &ops) != DRMF_SUCCESS)
+        DR_ASSERT_MSG(false, "failed to create pool");
+    ops.num_threads = 2;
+    if (drworkpool_create(&busy_pool, &ops) != DRMF_SUCCESS)
+        DR_ASSERT_MSG(false, "failed to create pool");
+    for (i = 0; i < 2; i++) {
+        if (drworkpool_submit(busy_pool, spin_item, NULL, NULL) != DRMF_SUCCESS)
+            DR_ASSERT(false);
+    }
+}
+
+static bool
+event_filter_syscall(void *drcontext, int sysnum)
+{
+    return !tested;
+}
+
+static bool
+event_pre_syscall(void *drcontext, int sysnum)
+{
+    /* Client threads do not run until the app does, so we test here rather
+     * than in dr_client_main().
+     */
+    if (!tested) {
+        tested = true;
+        test_pool();
+        test_cancel();
+    }
+    return true;
+}
+
+static void
+exit_event(void)
+{
+    DR_ASSERT_MSG(tested, "no syscall was seen");
+    DR_ASSERT_MSG(!wrong_thread, "pool thread query is wrong");
+    if (drworkpool_exit() != DRMF_SUCCESS)
+        DR_ASSERT(false);
+    dr_fprintf(STDOUT, "TEST PASSED\n");
+}
+
+DR_EXPORT void
+dr_client_main(client_id_t id, int argc, const char *argv[])
+{
+    if (drworkpool_init(id) != DRMF_SUCCESS)
+        DR_ASSERT_MSG(false, "fail to init drworkpool");
+    dr_register_filter_syscall_event(event_filter_syscall);
+    dr_register_pre_syscall_event(event_pre_syscall);
+    dr_register_exit_event(exit_event);
+}
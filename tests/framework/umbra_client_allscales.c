@@ -44,6 +44,186 @@
     (dr_fprintf(STDERR,  "ASSERT FAILURE: %s:%d: %s (%s)\n",    \
                 __FILE__, __LINE__, #cond, msg), dr_abort(), 0)))
 
+#ifdef X64
+/* Enough app memory to cover whole shadow blocks at every scale. */
+# define TEST_APP_SIZE (4*1024*1024)
+/* Keeps the set range off block boundaries and its shadow 8-byte aligned. */
+# define TEST_APP_OFFS 64
+
+/* Sets and scans multi-byte shadow values, which only x64 supports. */
+static void
+test_value_sizes(umbra_map_t *umbra_map, int scale_val, bool is_scale_down)
+{
+    static const size_t value_sizes[] = {1, 2, 4, 8};
+    static const ptr_uint_t value_all = 0x8877665544332211;
+    byte *app_base = dr_raw_mem_alloc(TEST_APP_SIZE,
+                                      DR_MEMPROT_READ | DR_MEMPROT_WRITE, NULL);
+    app_pc set_base = app_base + TEST_APP_OFFS;
+    size_t set_size = TEST_APP_SIZE - 2*TEST_APP_OFFS;
+    size_t expect_size = is_scale_down ? set_size / scale_val : set_size * scale_val;
+    uint i;
+    CHECK(app_base != NULL, "failed to allocate app memory");
+    for (i = 0; i < sizeof(value_sizes)/sizeof(value_sizes[0]); i++) {
+        size_t value_size = value_sizes[i], shadow_size, j;
+        ptr_uint_t value = (value_size == sizeof(value_all)) ? value_all :
+            value_all & (((ptr_uint_t)1 << (value_size * 8)) - 1);
+        app_pc found_pc;
+        bool found;
+        byte buf[256];
+        if (umbra_shadow_set_range(umbra_map, set_base, set_size, &shadow_size,
+                                   value, value_size) != DRMF_SUCCESS)
+            CHECK(false, "failed to set multi-byte shadow range");
+        CHECK(shadow_size == expect_size, "wrong shadow size set");
+        /* both a partial block and a whole (possibly shared) block */
+        for (j = 0; j < 2; j++) {
+            app_pc pc = (j == 0) ? set_base : app_base + TEST_APP_SIZE/2;
+            uint k;
+            shadow_size = sizeof(buf);
+            if (umbra_read_shadow_memory(umbra_map, pc, 64, &shadow_size,
+                                         buf) != DRMF_SUCCESS)
+                CHECK(false, "failed to read shadow memory");
+            for (k = 0; k < shadow_size; k += value_size) {
+                ptr_uint_t elem = 0;
+                memcpy(&elem, buf + k, value_size);
+                CHECK(elem == value, "wrong multi-byte shadow value");
+            }
+        }
+        found_pc = app_base;
+        if (umbra_value_in_shadow_memory(umbra_map, &found_pc, TEST_APP_SIZE,
+                                         value, value_size, &found) != DRMF_SUCCESS)
+            CHECK(false, "failed to scan shadow memory");
+        CHECK(found && found_pc == set_base, "multi-byte value not found");
+        found_pc = set_base;
+        if (umbra_value_in_shadow_memory(umbra_map, &found_pc, set_size,
+                                         value ^ 1, value_size,
+                                         &found) != DRMF_SUCCESS)
+            CHECK(false, "failed to scan shadow memory");
+        CHECK(!found, "unexpected multi-byte value found");
+        if (umbra_shadow_set_range(umbra_map, app_base, TEST_APP_SIZE, &shadow_size,
+                                   0, 1) != DRMF_SUCCESS)
+            CHECK(false, "failed to reset shadow range");
+    }
+    dr_raw_mem_free(app_base, TEST_APP_SIZE);
+}
+
+typedef struct _uniform_iter_t {
+    app_pc blk1, blk2;
+    uint blk1_shared, blk2_shared;
+} uniform_iter_t;
+
+static bool
+count_shared_blocks(umbra_map_t *map, umbra_shadow_memory_info_t *info,
+                    void *user_data)
+{
+    uniform_iter_t *iter = (uniform_iter_t *) user_data;
+    if (info->shadow_type == UMBRA_SHADOW_MEMORY_TYPE_SHARED) {
+        if (info->app_base == iter->blk1)
+            iter->blk1_shared++;
+        else if (info->app_base == iter->blk2)
+            iter->blk2_shared++;
+    }
+    return true;
+}
+
+static umbra_shadow_memory_type_t
+shadow_block_info(umbra_map_t *umbra_map, app_pc pc, byte **shared_base OUT)
+{
+    umbra_shadow_memory_info_t info;
+    byte *shadow_addr;
+    info.struct_size = sizeof(info);
+    if (umbra_get_shadow_memory(umbra_map, pc, &shadow_addr, &info) != DRMF_SUCCESS)
+        CHECK(false, "failed to get shadow memory info");
+    if (shared_base != NULL)
+        *shared_base = info.shadow_base;
+    return info.shadow_type;
+}
+
+/* Tests that whole blocks set to one value share a read-only block, that
+ * scans see their value without giving them memory, and that writing to one
+ * gives just that block private memory holding the value.
+ */
+static void
+test_uniform_blocks(umbra_map_t *umbra_map, int scale_val, bool is_scale_down)
+{
+    byte *app_base = dr_raw_mem_alloc(TEST_APP_SIZE,
+                                      DR_MEMPROT_READ | DR_MEMPROT_WRITE, NULL);
+    size_t app_blk_size, shadow_size, written, i;
+    byte *shared, *shared2, *shadow_addr;
+    umbra_shadow_memory_info_t info;
+    uniform_iter_t iter = {0,};
+    byte buf[256];
+    app_pc found_pc;
+    bool found;
+    CHECK(app_base != NULL, "failed to allocate app memory");
+    info.struct_size = sizeof(info);
+    if (umbra_get_shadow_memory(umbra_map, app_base, &shadow_addr,
+                                &info) != DRMF_SUCCESS)
+        CHECK(false, "failed to get shadow memory info");
+    app_blk_size = info.app_size;
+    iter.blk1 = (app_pc) ALIGN_FORWARD(app_base, app_blk_size);
+    iter.blk2 = iter.blk1 + app_blk_size;
+    CHECK(iter.blk2 + app_blk_size <= app_base + TEST_APP_SIZE,
+          "app memory too small for two shadow blocks");
+
+    /* sharing */
+    if (umbra_shadow_set_range(umbra_map, iter.blk1, 2*app_blk_size, &shadow_size,
+                               0x5a, 1) != DRMF_SUCCESS)
+        CHECK(false, "failed to set shadow range");
+    CHECK(shadow_block_info(umbra_map, iter.blk1, &shared) ==
+          UMBRA_SHADOW_MEMORY_TYPE_SHARED, "whole block not shared");
+    CHECK(shadow_block_info(umbra_map, iter.blk2, &shared2) ==
+          UMBRA_SHADOW_MEMORY_TYPE_SHARED && shared2 == shared,
+          "blocks with one value do not share");
+    CHECK(shared[0] == 0x5a && shared[shadow_size/2 - 1] == 0x5a,
+          "wrong shared block value");
+
+    /* scans, including a wider value made of the same bytes */
+    found_pc = iter.blk1;
+    if (umbra_value_in_shadow_memory(umbra_map, &found_pc, 2*app_blk_size,
+                                     0x5a5a, 2, &found) != DRMF_SUCCESS)
+        CHECK(false, "failed to scan shadow memory");
+    CHECK(found && found_pc == iter.blk1, "wider value not found in shared block");
+    found_pc = iter.blk1;
+    if (umbra_value_in_shadow_memory(umbra_map, &found_pc, 2*app_blk_size,
+                                     0x5a5b, 2, &found) != DRMF_SUCCESS)
+        CHECK(false, "failed to scan shadow memory");
+    CHECK(!found, "unexpected value found in shared block");
+    CHECK(shadow_block_info(umbra_map, iter.blk1, NULL) ==
+          UMBRA_SHADOW_MEMORY_TYPE_SHARED, "scan privatized the block");
+
+    /* copy-on-write */
+    memset(buf, 0x11, sizeof(buf));
+    written = sizeof(buf);
+    if (umbra_write_shadow_memory(umbra_map, iter.blk1, is_scale_down ? scale_val : 1,
+                                  &written, buf) != DRMF_SUCCESS)
+        CHECK(false, "failed to write shadow memory");
+    CHECK(shadow_block_info(umbra_map, iter.blk1, NULL) ==
+          UMBRA_SHADOW_MEMORY_TYPE_NORMAL, "write did not privatize the block");
+    CHECK(shadow_block_info(umbra_map, iter.blk2, &shared2) ==
+          UMBRA_SHADOW_MEMORY_TYPE_SHARED && shared2 == shared,
+          "write privatized a neighboring block");
+    shadow_size = sizeof(buf);
+    if (umbra_read_shadow_memory(umbra_map, iter.blk1, 64, &shadow_size,
+                                 buf) != DRMF_SUCCESS)
+        CHECK(false, "failed to read shadow memory");
+    for (i = 0; i < shadow_size; i++)
+        CHECK(buf[i] == (i < written ? 0x11 : 0x5a), "privatized block lost value");
+    CHECK(shared[0] == 0x5a, "write reached the shared block");
+
+    /* iteration */
+    if (umbra_iterate_shadow_memory(umbra_map, &iter,
+                                    count_shared_blocks) != DRMF_SUCCESS)
+        CHECK(false, "failed to iterate shadow memory");
+    CHECK(iter.blk1_shared == 0 && iter.blk2_shared == 1,
+          "iteration misreports shared blocks");
+
+    if (umbra_shadow_set_range(umbra_map, app_base, TEST_APP_SIZE, &shadow_size,
+                               0, 1) != DRMF_SUCCESS)
+        CHECK(false, "failed to reset shadow range");
+    dr_raw_mem_free(app_base, TEST_APP_SIZE);
+}
+#endif
+
 static void
 test_umbra_mapping(client_id_t id, umbra_map_scale_t scale, const char *label,
                    int scale_val, bool is_scale_down)
@@ -67,6 +247,10 @@ test_umbra_mapping(client_id_t id, umbra_map_scale_t scale, const char *label,
             CHECK(false, "failed to get granularity info umbra");
     CHECK(scale_val == scale_val_out, "incorrect scale");
     CHECK(is_scale_down == is_scale_down_out, "incorrect scale granularity");
+#ifdef X64
+    test_value_sizes(umbra_map, scale_val, is_scale_down);
+    test_uniform_blocks(umbra_map, scale_val, is_scale_down);
+#endif
     if (umbra_destroy_mapping(umbra_map) != DRMF_SUCCESS)
         CHECK(false, "failed to destroy shadow memory mapping");
     umbra_exit();
@@ -130,6 +130,24 @@ int main()
     free(p);
 #endif
 
+    /* Repeated requests of common alignment classes should be able to re-use
+     * chunks that are already aligned.
+     */
+    for (i = 0; i < 64; i++) {
+        size_t align = (size_t)16 << (i % 4 == 3 ? 8 : i % 4); /* 16,32,64,4096 */
+        void *q = NULL;
+        res = posix_memalign(&p, align, 100 + i);
+        assert(res == 0 && p != NULL);
+        assert(ALIGNED(p, align));
+        res = posix_memalign(&q, align, 100 + i);
+        assert(res == 0 && q != NULL);
+        assert(ALIGNED(q, align));
+        ((char *)p)[0] = ((char *)p)[99 + i] = 0;
+        ((char *)q)[0] = ((char *)q)[99 + i] = 0;
+        free(p);
+        free(q);
+    }
+
     printf("success\n");
     return 0;
 }
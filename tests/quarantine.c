@@ -0,0 +1,65 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/* Dr. Memory: the memory debugger
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License, and no later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Tests that -quarantine_rss_limit evicts delayed frees under memory pressure.
+ * Run with a limit below the process's resident size, so the quarantine keeps
+ * shrinking until freed memory is handed back out.  The frees here total less
+ * than -delay_frees_maxsz, so w/o eviction none would be reused.
+ */
+#ifdef WINDOWS
+# include <windows.h>
+# define SLEEP_MS(ms) Sleep(ms)
+#else
+# include <unistd.h>
+# define SLEEP_MS(ms) usleep((ms) * 1000)
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHUNK_SIZE (32*1024)
+#define SLEEP_PER_ATTEMPT 50
+/* Well beyond the time the quarantine takes to shrink to its floor */
+#define MAX_ATTEMPTS 400
+
+int
+main()
+{
+    static char *freed[MAX_ATTEMPTS];
+    int i, j;
+    int evicted = 0;
+    char *p = (char *) malloc(CHUNK_SIZE);
+    for (i = 0; i < MAX_ATTEMPTS && !evicted; i++) {
+        char *q;
+        p[0] = 1;
+        free(p);
+        freed[i] = p;
+        q = (char *) malloc(CHUNK_SIZE);
+        for (j = 0; j <= i; j++) {
+            if (q == freed[j])
+                evicted = 1;
+        }
+        p = q;
+        SLEEP_MS(SLEEP_PER_ATTEMPT);
+    }
+    free(p);
+    printf("%s\n", evicted ? "delayed frees were evicted" : "no eviction");
+    return 0;
+}
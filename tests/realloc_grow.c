@@ -0,0 +1,84 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/* Dr. Memory: the memory debugger
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License, and no later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Tests growing reallocs.  By default they move, so a stale pointer to the
+ * old region is reported; with -realloc_in_place they grow into the free
+ * memory that follows.  Either way, the contents must be kept and the new
+ * tail must be uninitialized and bounded by a redzone.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Sizes no startup free is likely to have left in the free list */
+#define OLD_SIZE 2800
+#define NEW_SIZE 4200
+#define FREED_SIZE 5000
+
+static int
+check_grown(char *old, char *grown, char fill)
+{
+    int i, bad = 0;
+    printf("%s\n", (grown == old) ? "grew in place" : "moved");
+    for (i = 0; i < OLD_SIZE; i++) {
+        if (grown[i] != fill)
+            bad++;
+    }
+    if (bad > 0)
+        printf("%d bytes lost\n", bad);
+    if (grown[NEW_SIZE - 1] == 0) /* error: uninitialized */
+        bad++;
+    bad += grown[NEW_SIZE]; /* error: unaddressable */
+    return bad;
+}
+
+int
+main()
+{
+    char *p, *q, *next, *after;
+    int res = 0;
+    char c;
+
+    printf("start\n"); /* set up stdout's buffer first */
+
+    /* The last chunk carved from its arena grows into the uncarved tail */
+    p = (char *) malloc(OLD_SIZE);
+    memset(p, 'a', OLD_SIZE);
+    q = (char *) realloc(p, NEW_SIZE);
+    res += check_grown(p, q, 'a');
+    c = p[0]; /* error: freed unless grown in place */
+    free(q);
+
+    /* A chunk followed by a free chunk absorbs the front of it */
+    p = (char *) malloc(OLD_SIZE);
+    next = (char *) malloc(FREED_SIZE);
+    after = (char *) malloc(OLD_SIZE);
+    memset(next, 'b', FREED_SIZE); /* stale contents must not read as defined */
+    free(next);
+    memset(p, 'c', OLD_SIZE);
+    q = (char *) realloc(p, NEW_SIZE);
+    res += check_grown(p, q, 'c');
+    free(after);
+    free(q);
+
+    printf("done\n");
+    return (res == -1) ? 1 : 0;
+}
@@ -0,0 +1,104 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/* Dr. Memory: the memory debugger
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License, and no later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Tests -redzone_adaptive sizing and per-callstack quieting.  Run with
+ * -redzone_adaptive_quiet below QUIET_ALLOCS.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef WINDOWS
+# define NOINLINE __declspec(noinline)
+#else
+# define NOINLINE __attribute__((noinline))
+#endif
+
+#define BIG_SIZE 4096
+/* Past any fixed redzone, but within BIG_SIZE/-redzone_adaptive_scale */
+#define FAR_OVERFLOW 128
+#define QUIET_ALLOCS 64
+
+/* Each of these is a distinct allocation callstack */
+static NOINLINE char *
+alloc_noisy(size_t size)
+{
+    return (char *) malloc(size);
+}
+
+static NOINLINE char *
+alloc_quiet(size_t size)
+{
+    return (char *) malloc(size);
+}
+
+int
+main()
+{
+    char *tiny, *tiny2, *big, *neighbor;
+    char *keep[QUIET_ALLOCS];
+    int i;
+    char c;
+
+    /* Tiny mallocs get the minimum redzone, which still catches an off-by-one */
+    tiny = (char *) malloc(8);
+    tiny2 = (char *) malloc(8);
+    printf("tiny spacing %d\n", (int)(tiny2 - tiny));
+    c = tiny[8]; /* error: unaddressable */
+    free(tiny2);
+    free(tiny);
+
+    /* Large mallocs are padded well beyond the minimum redzone */
+    big = (char *) malloc(BIG_SIZE);
+    neighbor = (char *) malloc(BIG_SIZE);
+    c = big[BIG_SIZE + FAR_OVERFLOW]; /* error: unaddressable */
+    free(neighbor);
+    free(big);
+    printf("sizing\n");
+
+    /* A callstack with a redzone error keeps its padding */
+    big = alloc_noisy(BIG_SIZE);
+    c = big[BIG_SIZE + FAR_OVERFLOW]; /* error: unaddressable */
+    free(big);
+    for (i = 0; i < QUIET_ALLOCS; i++)
+        keep[i] = alloc_noisy(16);
+    big = alloc_noisy(BIG_SIZE);
+    neighbor = (char *) malloc(BIG_SIZE);
+    c = big[BIG_SIZE + FAR_OVERFLOW]; /* error: unaddressable */
+    free(neighbor);
+    free(big);
+    for (i = 0; i < QUIET_ALLOCS; i++)
+        free(keep[i]);
+
+    /* An error-free callstack loses its padding, so this reads the neighbor */
+    for (i = 0; i < QUIET_ALLOCS; i++)
+        keep[i] = alloc_quiet(16);
+    big = alloc_quiet(BIG_SIZE);
+    neighbor = (char *) malloc(BIG_SIZE);
+    neighbor[FAR_OVERFLOW] = 0;
+    c = big[BIG_SIZE + FAR_OVERFLOW]; /* no error */
+    free(neighbor);
+    free(big);
+    for (i = 0; i < QUIET_ALLOCS; i++)
+        free(keep[i]);
+    printf("quieting\n");
+
+    return 0;
+}
@@ -40,6 +40,11 @@
 #     exit code must match the value passed in order for the test to pass.
 # * path_append = string to add to PATH before running cmd
 # * timeout = timeout value for the test
+# * covmerge = if set, path to covmerge, which is run with -summary on the
+#     -coverage_bitmap file named in the output: it must parse and report
+#     covered bytes
+# * logmatch = if set, a regex that the global log in the same directory as
+#     the results file must match (e.g., for -statistics counters)
 #
 # these allow for parameterization for more portable tests (PR 544430)
 # env vars will override; else passed-in default settings will be used:
@@ -531,6 +536,28 @@ foreach (line ${lines})
   endif ()
 endforeach (line)
 
+##################################################
+# check coverage bitmap file
+
+if (DEFINED covmerge AND NOT "${covmerge}" STREQUAL "")
+  string(REGEX MATCH "Code coverage bitmap data: ([^\r\n]+)" covline "${cmd_err}")
+  if ("${covline}" STREQUAL "")
+    message(FATAL_ERROR "*** no coverage bitmap file in output:\n${cmd_err}")
+  endif ()
+  set(covfile "${CMAKE_MATCH_1}")
+  execute_process(COMMAND ${covmerge} -summary ${covfile}
+    RESULT_VARIABLE covmerge_result
+    ERROR_VARIABLE covmerge_err
+    OUTPUT_VARIABLE covmerge_out)
+  if (covmerge_result)
+    message(FATAL_ERROR
+      "*** covmerge -summary ${covfile} failed (${covmerge_result}): ${covmerge_err}***\n")
+  endif ()
+  if (NOT "${covmerge_out}" MATCHES "(^|\n) *[1-9][0-9]* bytes covered")
+    message(FATAL_ERROR "*** no covered blocks in ${covfile}:\n${covmerge_out}")
+  endif ()
+endif ()
+
 ##################################################
 # check results file
 # XXX i#1688: Disable leak tests for Dr. Heapstat until the offline
@@ -604,6 +631,19 @@ if (resmatch AND NOT TOOL_DR_HEAPSTAT)
     endif ()
   endforeach (resfile)
 
+  if (DEFINED logmatch AND NOT "${logmatch}" STREQUAL "")
+    get_filename_component(logdir "${resfile_using}" PATH)
+    file(GLOB globallogs "${logdir}/global.*.log")
+    if ("${globallogs}" STREQUAL "")
+      message(FATAL_ERROR "*** no global log in ${logdir}")
+    endif ()
+    list(GET globallogs 0 globallog)
+    file(READ "${globallog}" globallog_contents)
+    if (NOT "${globallog_contents}" MATCHES "${logmatch}")
+      message(FATAL_ERROR "*** ${globallog} failed to match \"${logmatch}\"")
+    endif ()
+  endif ()
+
   # remove absolute addresses (from PR 535568)
   string(REGEX REPLACE " *0x[0-9a-f]+-0x[0-9a-f]+" "" results "${results}")
   string(REGEX REPLACE " *0x[0-9a-f]+" "" results "${results}")
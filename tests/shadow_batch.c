@@ -0,0 +1,77 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/* Dr. Memory: the memory debugger
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License, and no later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* Tests shadow created for adjacent blocks by a single on-touch shadow fault
+ * (-shadow_fault_batch): every block of a large new region must end up with
+ * the shadow state of its own accesses, whichever fault created it.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#define BLOCK_SIZE (64*1024) /* app bytes per shadow block */
+#define NUM_BLOCKS 64
+#define REGION_SIZE (NUM_BLOCKS*BLOCK_SIZE)
+
+int
+main()
+{
+    char *heap, *map;
+    int i, sum = 0;
+
+    /* Touch the first byte of each block in order, so one fault can create
+     * shadow for the blocks that follow before they are touched.
+     */
+    heap = (char *) malloc(REGION_SIZE);
+    for (i = 0; i < NUM_BLOCKS; i++)
+        heap[i*BLOCK_SIZE] = (char) i;
+    for (i = 0; i < NUM_BLOCKS; i++) {
+        if (heap[i*BLOCK_SIZE] != (char) i) /* no error */
+            printf("wrong value in block %d\n", i);
+    }
+    if (heap[(NUM_BLOCKS-1)*BLOCK_SIZE + 1] == 0) /* error: uninitialized */
+        sum++;
+    if (heap[REGION_SIZE/2 + 1] == 0) /* error: uninitialized */
+        sum++;
+    sum += heap[REGION_SIZE]; /* error: unaddressable */
+    free(heap);
+    printf("heap blocks\n");
+
+    /* Touch a fresh mapping backward, so batches stop at blocks that already
+     * have shadow, and then forward across the gaps between them.
+     */
+    map = (char *) mmap(0, REGION_SIZE, PROT_READ|PROT_WRITE,
+                        MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (map == (char *) MAP_FAILED) {
+        printf("mmap failed\n");
+        return 1;
+    }
+    for (i = NUM_BLOCKS - 1; i >= 0; i -= 4)
+        map[i*BLOCK_SIZE] = (char) i;
+    for (i = 0; i < REGION_SIZE; i += BLOCK_SIZE/2)
+        map[i + 1] = 1;
+    for (i = 0; i < REGION_SIZE; i += BLOCK_SIZE/2)
+        sum += map[i] + map[i + 2]; /* no error: mmap memory is defined */
+    munmap(map, REGION_SIZE);
+    printf("mapped blocks\n");
+
+    return (sum == -1) ? 1 : 0;
+}
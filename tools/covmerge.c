@@ -0,0 +1,377 @@
+/* **********************************************************
+ * Copyright (c) 2026 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/* Dr. Memory: the memory debugger
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License, and no later version.
+
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Library General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/* covmerge: combines -coverage_bitmap files from any number of processes
+ * and runs into one file of the same format, and optionally lists the
+ * covered code ranges.  Modules are matched by path and size.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "covformat.h"
+
+#define CHUNK_BITMAP_BYTES (COVFILE_CHUNK_SIZE / 8)
+#define MODULE_TABLE_SIZE 1024
+
+typedef unsigned int uint32;
+typedef unsigned long long uint64;
+
+typedef struct _module_t {
+    char *path;
+    uint64 size;
+    uint32 num_chunks;
+    unsigned char **chunks;
+    struct _module_t *next; /* hash chain */
+} module_t;
+
+static module_t *module_table[MODULE_TABLE_SIZE];
+static uint32 num_modules;
+
+static const char *usage_str =
+    "Usage: %s [-o <merged.cov>] [-text <ranges.txt>|-] [-summary] <file.cov>...\n"
+    "  -o       = write the merged coverage to this file\n"
+    "  -text    = list each module's covered ranges as module offsets\n"
+    "             to this file, or to stdout if -\n"
+    "  -summary = print the number of covered bytes per module\n";
+
+static void *
+xmalloc(size_t size)
+{
+    void *p = malloc(size);
+    if (p == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+static uint32
+hash_module(const char *path, uint64 size)
+{
+    uint32 hash = 2166136261u;
+    for (; *path != '\0'; path++)
+        hash = (hash ^ (unsigned char) *path) * 16777619u;
+    hash ^= (uint32) size;
+    return hash % MODULE_TABLE_SIZE;
+}
+
+static module_t *
+lookup_or_add_module(const char *path, uint64 size)
+{
+    uint32 idx = hash_module(path, size);
+    module_t *mod;
+    for (mod = module_table[idx]; mod != NULL; mod = mod->next) {
+        if (mod->size == size && strcmp(mod->path, path) == 0)
+            return mod;
+    }
+    mod = (module_t *) xmalloc(sizeof(*mod));
+    mod->path = (char *) xmalloc(strlen(path) + 1);
+    strcpy(mod->path, path);
+    mod->size = size;
+    mod->num_chunks = (uint32)((size + COVFILE_CHUNK_SIZE - 1) / COVFILE_CHUNK_SIZE);
+    mod->chunks = (unsigned char **) calloc(mod->num_chunks, sizeof(*mod->chunks));
+    if (mod->chunks == NULL && mod->num_chunks > 0) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    mod->next = module_table[idx];
+    module_table[idx] = mod;
+    num_modules++;
+    return mod;
+}
+
+static int
+read_exact(FILE *f, void *buf, size_t size)
+{
+    return fread(buf, 1, size, f) == size;
+}
+
+/* Returns 0 on a fatal error.  A truncated file is only warned about as it
+ * is expected from a killed process.
+ */
+static int
+merge_file(const char *fname)
+{
+    FILE *f = fopen(fname, "rb");
+    char magic[COVFILE_MAGIC_LEN];
+    uint32 header[2];
+    module_t **ids = NULL;
+    uint32 ids_size = 0;
+    unsigned char bitmap[CHUNK_BITMAP_BYTES];
+    char path[4096];
+    int tag, ok = 1, truncated = 0;
+    if (f == NULL) {
+        fprintf(stderr, "Unable to open %s\n", fname);
+        return 0;
+    }
+    if (!read_exact(f, magic, sizeof(magic)) ||
+        memcmp(magic, COVFILE_MAGIC, COVFILE_MAGIC_LEN) != 0 ||
+        !read_exact(f, header, sizeof(header))) {
+        fprintf(stderr, "%s is not a coverage file\n", fname);
+        fclose(f);
+        return 0;
+    }
+    if (header[0] != COVFILE_BOM || header[1] != COVFILE_CHUNK_SIZE) {
+        fprintf(stderr, "%s was written with a different byte order or chunk size\n",
+                fname);
+        fclose(f);
+        return 0;
+    }
+    while ((tag = fgetc(f)) != EOF) {
+        if (tag == COVREC_MODULE) {
+            uint32 id, len;
+            uint64 size;
+            if (!read_exact(f, &id, sizeof(id)) || !read_exact(f, &size, sizeof(size)) ||
+                !read_exact(f, &len, sizeof(len))) {
+                truncated = 1;
+                break;
+            }
+            if (len >= sizeof(path)) {
+                fprintf(stderr, "%s: module path too long\n", fname);
+                ok = 0;
+                break;
+            }
+            if (!read_exact(f, path, len)) {
+                truncated = 1;
+                break;
+            }
+            path[len] = '\0';
+            if (id >= ids_size) {
+                uint32 new_size = (id + 1) * 2;
+                module_t **grown = (module_t **) realloc(ids, new_size * sizeof(*ids));
+                if (grown == NULL) {
+                    fprintf(stderr, "Out of memory\n");
+                    exit(1);
+                }
+                memset(grown + ids_size, 0, (new_size - ids_size) * sizeof(*ids));
+                ids = grown;
+                ids_size = new_size;
+            }
+            ids[id] = lookup_or_add_module(path, size);
+        } else if (tag == COVREC_CHUNK) {
+            uint32 id, chunk, i;
+            module_t *mod;
+            if (!read_exact(f, &id, sizeof(id)) || !read_exact(f, &chunk, sizeof(chunk)) ||
+                !read_exact(f, bitmap, sizeof(bitmap))) {
+                truncated = 1;
+                break;
+            }
+            if (id >= ids_size || ids[id] == NULL || chunk >= ids[id]->num_chunks) {
+                fprintf(stderr, "%s: invalid chunk record\n", fname);
+                ok = 0;
+                break;
+            }
+            mod = ids[id];
+            if (mod->chunks[chunk] == NULL) {
+                mod->chunks[chunk] = (unsigned char *) xmalloc(CHUNK_BITMAP_BYTES);
+                memcpy(mod->chunks[chunk], bitmap, CHUNK_BITMAP_BYTES);
+            } else {
+                for (i = 0; i < CHUNK_BITMAP_BYTES; i++)
+                    mod->chunks[chunk][i] |= bitmap[i];
+            }
+        } else if (tag == COVREC_DUMP) {
+            uint64 timestamp;
+            if (!read_exact(f, &timestamp, sizeof(timestamp))) {
+                truncated = 1;
+                break;
+            }
+        } else {
+            fprintf(stderr, "%s: unknown record type 0x%x\n", fname, tag);
+            ok = 0;
+            break;
+        }
+    }
+    if (ferror(f)) {
+        fprintf(stderr, "Error reading %s\n", fname);
+        ok = 0;
+    } else if (truncated)
+        fprintf(stderr, "Warning: %s is truncated: using its complete records\n", fname);
+    free(ids);
+    fclose(f);
+    return ok;
+}
+
+static int
+compare_modules(const void *a, const void *b)
+{
+    const module_t *ma = *(const module_t **) a;
+    const module_t *mb = *(const module_t **) b;
+    int res = strcmp(ma->path, mb->path);
+    if (res != 0)
+        return res;
+    return (ma->size < mb->size) ? -1 : ((ma->size > mb->size) ? 1 : 0);
+}
+
+/* Returns the modules sorted by path so output is stable across runs */
+static module_t **
+sorted_modules(void)
+{
+    module_t **list = (module_t **) xmalloc((num_modules + 1) * sizeof(*list));
+    module_t *mod;
+    uint32 i, count = 0;
+    for (i = 0; i < MODULE_TABLE_SIZE; i++) {
+        for (mod = module_table[i]; mod != NULL; mod = mod->next)
+            list[count++] = mod;
+    }
+    qsort(list, count, sizeof(*list), compare_modules);
+    return list;
+}
+
+static int
+offset_covered(module_t *mod, uint64 offs)
+{
+    unsigned char *bitmap = mod->chunks[offs / COVFILE_CHUNK_SIZE];
+    uint32 bit = (uint32)(offs % COVFILE_CHUNK_SIZE);
+    return bitmap != NULL && (bitmap[bit / 8] & (1 << (bit % 8))) != 0;
+}
+
+static uint64
+covered_bytes(module_t *mod)
+{
+    uint64 count = 0;
+    uint32 chunk, i;
+    for (chunk = 0; chunk < mod->num_chunks; chunk++) {
+        if (mod->chunks[chunk] == NULL)
+            continue;
+        for (i = 0; i < CHUNK_BITMAP_BYTES; i++) {
+            unsigned char b = mod->chunks[chunk][i];
+            for (; b != 0; b &= (unsigned char)(b - 1))
+                count++;
+        }
+    }
+    return count;
+}
+
+static int
+write_merged(const char *fname, module_t **list)
+{
+    FILE *f = fopen(fname, "wb");
+    uint32 header[2] = {COVFILE_BOM, COVFILE_CHUNK_SIZE};
+    uint32 i, chunk;
+    uint64 now = (uint64) time(NULL) * 1000;
+    if (f == NULL) {
+        fprintf(stderr, "Unable to open %s\n", fname);
+        return 0;
+    }
+    fwrite(COVFILE_MAGIC, 1, COVFILE_MAGIC_LEN, f);
+    fwrite(header, sizeof(header), 1, f);
+    for (i = 0; i < num_modules; i++) {
+        module_t *mod = list[i];
+        uint32 len = (uint32) strlen(mod->path);
+        fputc(COVREC_MODULE, f);
+        fwrite(&i, sizeof(i), 1, f);
+        fwrite(&mod->size, sizeof(mod->size), 1, f);
+        fwrite(&len, sizeof(len), 1, f);
+        fwrite(mod->path, 1, len, f);
+        for (chunk = 0; chunk < mod->num_chunks; chunk++) {
+            if (mod->chunks[chunk] == NULL)
+                continue;
+            fputc(COVREC_CHUNK, f);
+            fwrite(&i, sizeof(i), 1, f);
+            fwrite(&chunk, sizeof(chunk), 1, f);
+            fwrite(mod->chunks[chunk], 1, CHUNK_BITMAP_BYTES, f);
+        }
+    }
+    fputc(COVREC_DUMP, f);
+    fwrite(&now, sizeof(now), 1, f);
+    if (fclose(f) != 0) {
+        fprintf(stderr, "Failed to write %s\n", fname);
+        return 0;
+    }
+    return 1;
+}
+
+static void
+write_ranges(FILE *f, module_t **list)
+{
+    uint32 i;
+    for (i = 0; i < num_modules; i++) {
+        module_t *mod = list[i];
+        uint64 offs = 0, start;
+        fprintf(f, "module: %s\n", mod->path);
+        while (offs < mod->size) {
+            /* skip whole empty chunks */
+            if (offs % COVFILE_CHUNK_SIZE == 0 &&
+                mod->chunks[offs / COVFILE_CHUNK_SIZE] == NULL) {
+                offs += COVFILE_CHUNK_SIZE;
+                continue;
+            }
+            if (!offset_covered(mod, offs)) {
+                offs++;
+                continue;
+            }
+            start = offs;
+            while (offs < mod->size && offset_covered(mod, offs))
+                offs++;
+            fprintf(f, "  +0x%llx-0x%llx\n", start, offs);
+        }
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char *outfile = NULL, *textfile = NULL;
+    int summary = 0, num_inputs = 0, i;
+    module_t **list;
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            outfile = argv[++i];
+        else if (strcmp(argv[i], "-text") == 0 && i + 1 < argc)
+            textfile = argv[++i];
+        else if (strcmp(argv[i], "-summary") == 0)
+            summary = 1;
+        else if (argv[i][0] == '-') {
+            fprintf(stderr, usage_str, argv[0]);
+            return 1;
+        } else {
+            if (!merge_file(argv[i]))
+                return 1;
+            num_inputs++;
+        }
+    }
+    if (num_inputs == 0 || (outfile == NULL && textfile == NULL && !summary)) {
+        fprintf(stderr, usage_str, argv[0]);
+        return 1;
+    }
+    list = sorted_modules();
+    if (outfile != NULL && !write_merged(outfile, list))
+        return 1;
+    if (textfile != NULL) {
+        FILE *f = (strcmp(textfile, "-") == 0) ? stdout : fopen(textfile, "w");
+        if (f == NULL) {
+            fprintf(stderr, "Unable to open %s\n", textfile);
+            return 1;
+        }
+        write_ranges(f, list);
+        if (f != stdout)
+            fclose(f);
+    }
+    if (summary) {
+        for (i = 0; i < (int) num_modules; i++) {
+            printf("%10llu bytes covered of %10llu: %s\n", covered_bytes(list[i]),
+                   list[i]->size, list[i]->path);
+        }
+    }
+    return 0;
+}
@@ -136,6 +136,9 @@ umbra_map_create(umbra_map_t **map_out, umbra_map_options_t *ops, uint idx)
     memset(map, 0, sizeof(*map));
     map->magic = UMBRA_MAP_MAGIC;
     map->options = *ops;
+    /* fields added after the original struct */
+    if (ops->struct_size < sizeof(*ops))
+        map->options.fault_batch_blocks = 0;
     map->index = idx;
     if (ops->app_memory_create_cb != NULL ||
 #ifdef UNIX
@@ -532,6 +535,121 @@ umbra_write_shadow_memory(IN  umbra_map_t *map,
                                           shadow_size, buffer);
 }
 
+/* Returns whether [app_addr, app_addr+app_size) lies within the single shadow
+ * block described by info.
+ */
+static bool
+umbra_range_in_block(umbra_shadow_memory_info_t *info, app_pc app_addr, size_t app_size)
+{
+    /* closed ends to avoid overflow at the top of the address space */
+    return (app_addr >= info->app_base &&
+            app_addr + (app_size - 1) <= info->app_base + (info->app_size - 1));
+}
+
+DR_EXPORT
+drmf_status_t
+umbra_snapshot_shadow_memory(IN    umbra_map_t *map,
+                             IN    app_pc  app_addr,
+                             IN    size_t  app_size,
+                             INOUT size_t *shadow_size,
+                             OUT   byte   *buffer,
+                             OUT   byte  **shared_block)
+{
+    umbra_shadow_memory_info_t info;
+    byte *shadow_addr;
+    size_t size;
+    if (map == NULL || map->magic != UMBRA_MAP_MAGIC) {
+        ASSERT(false, "invalid umbra_map");
+        return DRMF_ERROR_INVALID_PARAMETER;
+    }
+    if (buffer == NULL || shadow_size == NULL || shared_block == NULL)
+        return DRMF_ERROR_INVALID_PARAMETER;
+    *shared_block = NULL;
+    if (app_size == 0) {
+        *shadow_size = 0;
+        return DRMF_SUCCESS;
+    }
+    if (POINTER_OVERFLOW_ON_ADD(app_addr, app_size-1)) /* just hitting top is ok */
+        return DRMF_ERROR_INVALID_SIZE;
+    size = umbra_map_scale_app_to_shadow(map, app_size);
+    if (*shadow_size < size) {
+        *shadow_size = 0;
+        return DRMF_ERROR_INVALID_SIZE;
+    }
+    umbra_shadow_memory_info_init(&info);
+    if (umbra_get_shadow_memory_arch(map, app_addr, &shadow_addr,
+                                     &info) == DRMF_SUCCESS &&
+        umbra_range_in_block(&info, app_addr, app_size)) {
+        if (TEST(UMBRA_SHADOW_MEMORY_TYPE_SHARED, info.shadow_type)) {
+            /* The block is uniform and immutable: no need to copy anything */
+            *shared_block = info.shadow_base;
+            *shadow_size = 0;
+            return DRMF_SUCCESS;
+        }
+        if (TEST(UMBRA_SHADOW_MEMORY_TYPE_NORMAL, info.shadow_type)) {
+            memcpy(buffer, shadow_addr, size);
+            *shadow_size = size;
+            return DRMF_SUCCESS;
+        }
+    }
+    /* Spans blocks or needs shadow allocation: use the general path */
+    return umbra_read_shadow_memory_arch(map, app_addr, app_size, shadow_size, buffer);
+}
+
+DR_EXPORT
+drmf_status_t
+umbra_restore_shadow_memory(IN    umbra_map_t *map,
+                            IN    app_pc  app_addr,
+                            IN    size_t  app_size,
+                            INOUT size_t *shadow_size,
+                            IN    byte   *buffer,
+                            IN    byte   *shared_block)
+{
+    umbra_shadow_memory_info_t info;
+    byte *shadow_addr;
+    size_t size;
+    bool in_block;
+    if (map == NULL || map->magic != UMBRA_MAP_MAGIC) {
+        ASSERT(false, "invalid umbra_map");
+        return DRMF_ERROR_INVALID_PARAMETER;
+    }
+    if (shadow_size == NULL || (buffer == NULL && shared_block == NULL))
+        return DRMF_ERROR_INVALID_PARAMETER;
+    if (app_size == 0) {
+        *shadow_size = 0;
+        return DRMF_SUCCESS;
+    }
+    if (POINTER_OVERFLOW_ON_ADD(app_addr, app_size-1)) /* just hitting top is ok */
+        return DRMF_ERROR_INVALID_SIZE;
+    size = umbra_map_scale_app_to_shadow(map, app_size);
+    umbra_shadow_memory_info_init(&info);
+    in_block = (umbra_get_shadow_memory_arch(map, app_addr, &shadow_addr,
+                                             &info) == DRMF_SUCCESS &&
+                umbra_range_in_block(&info, app_addr, app_size));
+    if (shared_block != NULL) {
+        if (in_block && TEST(UMBRA_SHADOW_MEMORY_TYPE_SHARED, info.shadow_type) &&
+            info.shadow_base == shared_block) {
+            /* Still backed by the same shared block: nothing changed */
+            *shadow_size = size;
+            return DRMF_SUCCESS;
+        }
+        /* The snapshot fit in one uniform block so any offset in it is a
+         * valid source.
+         */
+        buffer = shared_block;
+    } else if (*shadow_size < size) {
+        *shadow_size = 0;
+        return DRMF_ERROR_INVALID_SIZE;
+    }
+    if (in_block && TEST(UMBRA_SHADOW_MEMORY_TYPE_NORMAL, info.shadow_type)) {
+        memcpy(shadow_addr, buffer, size);
+        *shadow_size = size;
+        return DRMF_SUCCESS;
+    }
+    *shadow_size = size;
+    return umbra_write_shadow_memory_arch(map, app_addr, app_size, shadow_size, buffer);
+}
+
 DR_EXPORT
 drmf_status_t
 umbra_shadow_set_range(IN   umbra_map_t *map,
@@ -618,6 +736,25 @@ umbra_get_shadow_block_size(IN  umbra_map_t *map,
     return DRMF_SUCCESS;
 }
 
+DR_EXPORT
+drmf_status_t
+umbra_get_fault_statistics(IN  umbra_map_t *map,
+                           OUT uint64 *num_faults,
+                           OUT uint64 *num_blocks)
+{
+    if (map == NULL || map->magic != UMBRA_MAP_MAGIC) {
+        ASSERT(false, "invalid umbra_map");
+        return DRMF_ERROR_INVALID_PARAMETER;
+    }
+    if (num_faults == NULL || num_blocks == NULL)
+        return DRMF_ERROR_INVALID_PARAMETER;
+    umbra_map_lock(map);
+    *num_faults = map->num_faults;
+    *num_blocks = map->num_fault_blocks;
+    umbra_map_unlock(map);
+    return DRMF_SUCCESS;
+}
+
 drmf_status_t
 umbra_iterate_app_memory(IN  umbra_map_t *map,
                          IN  void *user_data,
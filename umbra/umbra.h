@@ -259,6 +259,16 @@ typedef struct _umbra_map_options_t {
     /** Application memory re-map callback. */
     app_memory_mremap_cb_t app_memory_mremap_cb;
 #endif
+
+    /**
+     * With #UMBRA_MAP_CREATE_SHADOW_ON_TOUCH, the maximum number of
+     * application blocks given shadow memory by one shadow fault: the
+     * faulting block plus the following blocks of the same application
+     * mapping that have no shadow yet, created with a single allocation.
+     * 0 or 1 creates only the faulting block.  Only honored on x64 UNIX,
+     * and only read if \p struct_size includes this field.
+     */
+    uint fault_batch_blocks;
 } umbra_map_options_t;
 
 /***************************************************************************
@@ -296,6 +306,24 @@ drmf_status_t
 umbra_create_mapping(IN  umbra_map_options_t *ops,
                      OUT umbra_map_t **map_out);
 
+DR_EXPORT
+/**
+ * Returns in \p num_faults the number of shadow faults \p map has handled
+ * to create shadow memory on touch (see #UMBRA_MAP_CREATE_SHADOW_ON_TOUCH),
+ * and in \p num_blocks the number of shadow blocks those faults created.
+ * The ratio shows the effect of \p fault_batch_blocks in
+ * #umbra_map_options_t.  Both are 0 for the 32-bit implementation, which
+ * does not create shadow memory on faults.
+ *
+ * @param[in]  map         The mapping object to use.
+ * @param[out] num_faults  The number of shadow faults handled.
+ * @param[out] num_blocks  The number of shadow blocks created by them.
+ */
+drmf_status_t
+umbra_get_fault_statistics(IN  umbra_map_t *map,
+                           OUT uint64 *num_faults,
+                           OUT uint64 *num_blocks);
+
 DR_EXPORT
 /**
  * Destroy a shadow memory mapping \p map created by umbra_create_mapping.
@@ -313,7 +341,7 @@ DR_EXPORT
  * @param[in] app_size    Application memory size.
  * @param[in] value       The initial value in shadow memory.
  * @param[in] value_size  The initial value size, could be 1, 2, 4, or 8 (x64).
- *                        Only 1 is supported now.
+ *                        Only 1 is supported on 32-bit.
  *
  * \return success code.  If \p app_addr is not a valid application address
  * and the shadow mapping implementation does not support shadow memory
@@ -446,6 +474,66 @@ umbra_write_shadow_memory(IN  umbra_map_t *map,
                           INOUT size_t *shadow_size,
                           IN  byte   *buffer);
 
+DR_EXPORT
+/**
+ * Save a snapshot of the shadow memory for application memory at \p app_addr
+ * into \p buffer, for later restoration via umbra_restore_shadow_memory().
+ * This is intended for repeatedly saving and restoring the same region, such as
+ * a fuzzing iteration's buffers and stack frame.  When the range lies within a
+ * single shadow block the shadow bytes are copied directly with no further
+ * lookups.  When that block is a special shared shadow block, nothing is copied:
+ * \p shared_block is set to the base of that block and \p shadow_size is set
+ * to 0.  Otherwise, \p shared_block is set to NULL.
+ *
+ * @param[in]     map           The mapping object to use.
+ * @param[in]     app_addr      Application memory address.
+ * @param[in]     app_size      Application memory size.
+ * @param[in,out] shadow_size   The max buffer size.
+ *                              Return the number of bytes actually saved.
+ * @param[out]    buffer        The buffer to hold the saved value.
+ * @param[out]    shared_block  Returns the shared block backing the whole range,
+ *                              if any.
+ *
+ * \return success code.  If \p app_addr is not a valid application address
+ * and the shadow mapping implementation does not support shadow memory
+ * for invalid addresses, returns DRMF_ERROR_INVALID_ADDRESS.
+ */
+drmf_status_t
+umbra_snapshot_shadow_memory(IN    umbra_map_t *map,
+                             IN    app_pc  app_addr,
+                             IN    size_t  app_size,
+                             INOUT size_t *shadow_size,
+                             OUT   byte   *buffer,
+                             OUT   byte  **shared_block);
+
+DR_EXPORT
+/**
+ * Restore the shadow memory for application memory at \p app_addr from a
+ * snapshot taken by umbra_snapshot_shadow_memory().  If the snapshot was of
+ * a special shared shadow block and the range is still backed by that same
+ * block, no work is done.
+ *
+ * @param[in]     map           The mapping object to use.
+ * @param[in]     app_addr      Application memory address.
+ * @param[in]     app_size      Application memory size.
+ * @param[in,out] shadow_size   The buffer size.
+ *                              Return the number of bytes actually written.
+ * @param[in]     buffer        The buffer passed to umbra_snapshot_shadow_memory().
+ * @param[in]     shared_block  The \p shared_block value returned by
+ *                              umbra_snapshot_shadow_memory().
+ *
+ * \return success code.  If \p app_addr is not a valid application address
+ * and the shadow mapping implementation does not support shadow memory
+ * for invalid addresses, returns DRMF_ERROR_INVALID_ADDRESS.
+ */
+drmf_status_t
+umbra_restore_shadow_memory(IN    umbra_map_t *map,
+                            IN    app_pc  app_addr,
+                            IN    size_t  app_size,
+                            INOUT size_t *shadow_size,
+                            IN    byte   *buffer,
+                            IN    byte   *shared_block);
+
 DR_EXPORT
 /**
  * Set a range of shadow memory for application memory at \p app_addr.
@@ -456,7 +544,15 @@ DR_EXPORT
  * @param[out] shadow_size   The number of bytes actually written.
  * @param[in]  value         The value to be set in shadow memory.
  * @param[in]  value_size    The value size for \p value, could be 1, 2, 4,
- *                           or 8 (x64). Only 1 is supported now.
+ *                           or 8 (x64). Only 1 is supported on 32-bit.
+ *                           Values are laid out from the shadow of
+ *                           \p app_addr, whose shadow size must be a
+ *                           multiple of \p value_size.
+ *
+ * \note: On x64 with #UMBRA_MAP_CREATE_SHADOW_ON_TOUCH and
+ * #UMBRA_MAP_SHADOW_SHARED_READONLY, each whole shadow block in the range is
+ * pointed at a shared read-only block holding \p value instead of being
+ * written, and is given private memory again on its first app access.
  *
  * \return success code.  If \p app_addr is not a valid application address
  * and the shadow mapping implementation does not support shadow memory
@@ -505,7 +601,9 @@ DR_EXPORT
  * @param[in]     app_size    Application memory size.
  * @param[in]     value       The value to be set in shadow memory.
  * @param[in]     value_size  The value size for \p value, could be 1, 2, 4,
- *                            or 8 (x64). Only 1 is supported now.
+ *                            or 8 (x64). Only 1 is supported on 32-bit.
+ *                            Values are matched at multiples of
+ *                            \p value_size from the shadow of \p app_addr.
  * @param[out]    found       Return true if \p value found in the range.
  *
  * \return success code.  If \p app_addr is not a valid application address
@@ -687,8 +785,9 @@ DR_EXPORT
  * \note: Umbra only creates special shared shadow memory if necessary.
  * This routine forces Umbra create one even Umbra may not use it.
  *
- * \note: Umbra does not use special shared shadow block in current x64
- * implementation and always returns DRMF_ERROR_FEATURE_NOT_AVAILABLE.
+ * \note: In the x64 implementation, shared blocks require
+ * #UMBRA_MAP_CREATE_SHADOW_ON_TOUCH and DRMF_ERROR_FEATURE_NOT_AVAILABLE is
+ * returned without it.
  */
 drmf_status_t
 umbra_create_shared_shadow_block(IN  umbra_map_t *map,
@@ -707,8 +806,6 @@ DR_EXPORT
  * @param[out] block       The pointer pointing to the base of the shadow block.
  *                         Returns NULL if Umbra fails to find one.
  *
- * \note: Umbra does not use special shared shadow block in current x64
- * implementation and always returns DRMF_ERROR_FEATURE_NOT_AVAILABLE.
  */
 drmf_status_t
 umbra_get_shared_shadow_block(IN  umbra_map_t *map,
@@ -290,6 +290,12 @@ static ptr_uint_t segment_base(uint num_seg_bits, app_pc pc)
     ((ptr_uint_t)(((addr) - (base)) / (ptr_uint_t)(map)->shadow_block_size) & \
      (ptr_uint_t)(BIT_PER_BYTE - 1))
 
+/* Each uniform table leaf is one allocation unit of bytes, one per block */
+#define UNIFORM_LEAF_BLOCKS ALLOC_UNIT_SIZE
+#define UNIFORM_NUM_LEAVES(map, base, end) \
+    (ALIGN_FORWARD(((end) - (base)) / (map)->shadow_block_size, \
+                   UNIFORM_LEAF_BLOCKS) / UNIFORM_LEAF_BLOCKS)
+
 typedef struct _app_segment_t {
     /* app segment range */
     app_pc app_base;
@@ -303,6 +309,12 @@ typedef struct _app_segment_t {
      * bitmap to track if shadow memory is allocated.
      */
     byte  *shadow_bitmap[MAX_NUM_MAPS];
+    /* Uniform shadow blocks: one byte per shadow block holding 1 plus the
+     * index of its map->uniform_blocks entry, or 0.  The bytes are split into
+     * leaves of UNIFORM_LEAF_BLOCKS allocated on first use, so that lookups
+     * need no lock.
+     */
+    byte * volatile *shadow_uniform[MAX_NUM_MAPS];
     /* for shadow's shadow */
     byte  *reserve_base[MAX_NUM_MAPS];
     byte  *reserve_end[MAX_NUM_MAPS];
@@ -473,6 +485,10 @@ umbra_add_shadow_segment(umbra_map_t *map, app_segment_t *seg)
     size = size / map->shadow_block_size / BIT_PER_BYTE;
     seg->shadow_bitmap[seg_map_idx] = global_alloc(size, HEAPSTAT_SHADOW);
     memset(seg->shadow_bitmap[seg_map_idx], 0, size);
+    size = UNIFORM_NUM_LEAVES(map, seg->shadow_base[seg_map_idx],
+                              seg->shadow_end[seg_map_idx]) * sizeof(byte *);
+    seg->shadow_uniform[seg_map_idx] = global_alloc(size, HEAPSTAT_SHADOW);
+    memset((void *)seg->shadow_uniform[seg_map_idx], 0, size);
     seg->reserve_base[seg_map_idx] =
         umbra_xl8_app_to_shadow(map, seg->shadow_base[seg_map_idx]);
     seg->reserve_end[seg_map_idx] =
@@ -705,6 +721,275 @@ umbra_shadow_block_exist(umbra_map_t *map, app_pc shdw_addr)
     return false;
 }
 
+static void
+umbra_clear_shadow_bitmap(umbra_map_t *map, app_pc shdw_addr)
+{
+    uint i, map_idx = map->index;
+    for (i = 0; i < MAX_NUM_APP_SEGMENTS; i++) {
+        if (app_segments[i].app_used &&
+            app_segments[i].map[map_idx] == map &&
+            app_segments[i].shadow_base[map_idx] <= shdw_addr &&
+            app_segments[i].shadow_end[map_idx]  >  shdw_addr) {
+            uint byte_idx =
+                BITMAP_BYTE_INDEX(map, shdw_addr,
+                                  app_segments[i].shadow_base[map_idx]);
+            uint bit_idx =
+                BITMAP_BIT_INDEX(map, shdw_addr,
+                                 app_segments[i].shadow_base[map_idx]);
+            app_segments[i].shadow_bitmap[map_idx][byte_idx] &= ~(1<<bit_idx);
+            return;
+        }
+    }
+}
+
+/***************************************************************************
+ * UNIFORM SHADOW BLOCKS
+ *
+ * A whole shadow block set to a single value is not backed by private
+ * memory: like the 32-bit special blocks, it is recorded in its segment's
+ * shadow_uniform table against a read-only block holding that value, so
+ * setting a large range costs one table update per block instead of a
+ * memset and the committed pages of any block it replaces are released.
+ * We cannot redirect the direct-mapped translation, so the shadow address
+ * itself stays unmapped: an app reference faults and umbra_handle_fault()
+ * privatizes the block with its recorded value, while queries through
+ * umbra_get_shadow_memory() see the shared block.
+ */
+
+
+/* Returns whether value_size is 1, 2, 4 or 8 and value fits in it. */
+static inline bool
+umbra_value_size_valid(ptr_uint_t value, size_t value_size)
+{
+    if (value_size != 1 && value_size != 2 && value_size != 4 && value_size != 8)
+        return false;
+    return value_size == sizeof(value) || (value >> (value_size * 8)) == 0;
+}
+
+/* Replicates value across a 64-bit word. */
+static inline uint64
+umbra_value_pattern(ptr_uint_t value, size_t value_size)
+{
+    switch (value_size) {
+    case 1: return 0x0101010101010101ULL * (byte)value;
+    case 2: return 0x0001000100010001ULL * (ushort)value;
+    case 4: return 0x0000000100000001ULL * (uint)value;
+    default: return (uint64)value;
+    }
+}
+
+/* Fills [dst, dst+size) with value_size-byte copies of value, laid out from
+ * dst.  Multi-byte values are stored a replicated word at a time, which the
+ * compiler turns into vector stores.
+ */
+static void
+umbra_fill_shadow_value(byte *dst, size_t size, ptr_uint_t value, size_t value_size)
+{
+    uint64 pattern;
+    size_t i;
+    if (value_size == 1) {
+        memset(dst, (int)value, size);
+        return;
+    }
+    ASSERT(ALIGNED(size, value_size), "unaligned shadow fill");
+    pattern = umbra_value_pattern(value, value_size);
+    for (i = 0; i + sizeof(pattern) <= size; i += sizeof(pattern))
+        *(uint64 *)(dst + i) = pattern;
+    /* the tail is whole elements, which on little-endian are the low bytes */
+    memcpy(dst + i, &pattern, size - i);
+}
+
+/* Returns the first value_size-byte element, counting from start, that
+ * holds value, or NULL.  Multi-byte values are compared a word at a time
+ * with the usual zero-lane test on (word ^ pattern): the lowest flagged
+ * lane is always a true match, so we only inspect lanes of a flagged word.
+ */
+static byte *
+umbra_find_shadow_value(byte *start, size_t size, ptr_uint_t value,
+                        size_t value_size)
+{
+    uint64 pattern, lsb, msb, lane_mask, diff;
+    size_t i, j;
+    if (value_size == 1)
+        return memchr(start, (int)value, size);
+    ASSERT(ALIGNED(size, value_size), "unaligned shadow scan");
+    pattern = umbra_value_pattern(value, value_size);
+    lsb = umbra_value_pattern(1, value_size);
+    msb = lsb << (value_size * 8 - 1);
+    lane_mask = (value_size == sizeof(uint64)) ? ~(uint64)0 :
+        ((uint64)1 << (value_size * 8)) - 1;
+    for (i = 0; i + sizeof(uint64) <= size; i += sizeof(uint64)) {
+        diff = *(uint64 *)(start + i) ^ pattern;
+        if (((diff - lsb) & ~diff & msb) == 0)
+            continue;
+        for (j = 0; j < sizeof(uint64); j += value_size) {
+            if (((diff >> (j * 8)) & lane_mask) == 0)
+                return start + i + j;
+        }
+        ASSERT(false, "zero-lane test flagged no lane");
+    }
+    for (; i < size; i += value_size) {
+        diff = 0;
+        memcpy(&diff, start + i, value_size);
+        if (diff == (pattern & lane_mask))
+            return start + i;
+    }
+    return NULL;
+}
+
+/* Uniform blocks need the fault handler to materialize unmapped shadow. */
+static inline bool
+umbra_uniform_blocks_enabled(umbra_map_t *map)
+{
+    return TEST(UMBRA_MAP_CREATE_SHADOW_ON_TOUCH, map->options.flags);
+}
+
+/* Returns the shared block for value, creating it if requested.
+ * Values of different sizes that fill a block identically share it.
+ * The caller must hold the map lock to create.
+ */
+static special_block_t *
+umbra_uniform_block_lookup(umbra_map_t *map, ptr_uint_t value, size_t value_size,
+                           bool create)
+{
+    uint i;
+    special_block_t *block;
+    uint64 pattern = umbra_value_pattern(value, value_size);
+    for (i = 0; i < map->num_uniform_blocks; i++) {
+        if (umbra_value_pattern(map->uniform_blocks[i].value,
+                                map->uniform_blocks[i].value_size) == pattern)
+            return &map->uniform_blocks[i];
+    }
+    if (!create || map->num_uniform_blocks >= MAX_NUM_SPECIAL_BLOCKS)
+        return NULL;
+    block = &map->uniform_blocks[map->num_uniform_blocks];
+    block->start = dr_raw_mem_alloc(map->shadow_block_size,
+                                    DR_MEMPROT_READ | DR_MEMPROT_WRITE, NULL);
+    if (block->start == NULL)
+        return NULL;
+    umbra_fill_shadow_value(block->start, map->shadow_block_size, value, value_size);
+    if (!dr_memory_protect(block->start, map->shadow_block_size, DR_MEMPROT_READ))
+        ASSERT(false, "fail to protect uniform shadow block");
+    block->value = value;
+    block->value_size = value_size;
+    /* publish only once filled, as lookups do not take the lock */
+    map->num_uniform_blocks++;
+    LOG(UMBRA_VERBOSE, "created uniform block "PFX" for value "PIFX"\n",
+        block->start, value);
+    return block;
+}
+
+/* Returns the uniform table entry for the shadow block at shadow_blk, or
+ * NULL if its leaf does not exist and !create.  Leaves are only allocated,
+ * under the map lock, and are freed at exit, so lookups need no lock.
+ */
+static byte *
+umbra_uniform_slot(umbra_map_t *map, byte *shadow_blk, bool create)
+{
+    uint i, map_idx = map->index;
+    for (i = 0; i < MAX_NUM_APP_SEGMENTS; i++) {
+        if (app_segments[i].app_used &&
+            app_segments[i].map[map_idx] == map &&
+            app_segments[i].shadow_base[map_idx] <= shadow_blk &&
+            app_segments[i].shadow_end[map_idx]  >  shadow_blk) {
+            size_t blk_idx = (shadow_blk - app_segments[i].shadow_base[map_idx]) /
+                map->shadow_block_size;
+            byte * volatile *leaf = &app_segments[i].shadow_uniform[map_idx]
+                [blk_idx / UNIFORM_LEAF_BLOCKS];
+            byte *table = *leaf;
+            if (table == NULL) {
+                if (!create)
+                    return NULL;
+                /* Fresh pages are zero, so a racing lookup that sees the new
+                 * leaf never reads uninitialized entries.
+                 */
+                table = dr_raw_mem_alloc(UNIFORM_LEAF_BLOCKS,
+                                         DR_MEMPROT_READ | DR_MEMPROT_WRITE, NULL);
+                if (table == NULL)
+                    return NULL;
+                *leaf = table;
+            }
+            return &table[blk_idx % UNIFORM_LEAF_BLOCKS];
+        }
+    }
+    return NULL;
+}
+
+/* Returns the shared block standing in for the unallocated shadow block
+ * at shadow_blk, or NULL.
+ */
+static inline special_block_t *
+umbra_uniform_block_of(umbra_map_t *map, byte *shadow_blk)
+{
+    byte *slot;
+    byte entry;
+    if (map->num_uniform_blocks == 0)
+        return NULL;
+    slot = umbra_uniform_slot(map, shadow_blk, false/*!create*/);
+    if (slot == NULL)
+        return NULL;
+    entry = *(volatile byte *)slot;
+    return (entry == 0) ? NULL : &map->uniform_blocks[entry - 1];
+}
+
+static bool
+umbra_address_in_uniform_block(umbra_map_t *map, byte *addr)
+{
+    uint i;
+    for (i = 0; i < map->num_uniform_blocks; i++) {
+        if (addr >= map->uniform_blocks[i].start &&
+            addr <  map->uniform_blocks[i].start + map->shadow_block_size)
+            return true;
+    }
+    return false;
+}
+
+/* Turns the whole shadow block at shadow_blk into a uniform block of value,
+ * releasing its private memory if any.  The caller must hold the map lock.
+ */
+static bool
+umbra_shadow_block_set_uniform(umbra_map_t *map, byte *shadow_blk,
+                               ptr_uint_t value, size_t value_size)
+{
+    special_block_t *block =
+        umbra_uniform_block_lookup(map, value, value_size, true/*create*/);
+    byte *slot = umbra_uniform_slot(map, shadow_blk, true/*create*/);
+    if (block == NULL || slot == NULL)
+        return false;
+    /* Publish before dropping the private block so lookups always find one */
+    *(volatile byte *)slot = (byte)(block - map->uniform_blocks) + 1;
+    if (umbra_shadow_block_exist(map, shadow_blk)) {
+        umbra_clear_shadow_bitmap(map, shadow_blk);
+        dr_raw_mem_free(shadow_blk, map->shadow_block_size);
+    }
+    return true;
+}
+
+/* Gives a uniform shadow block private memory holding its value.
+ * Returns false if shadow_blk is not a uniform block or allocation fails.
+ * The caller must hold the map lock.
+ */
+static bool
+umbra_shadow_block_privatize(umbra_map_t *map, byte *shadow_blk)
+{
+    byte *res;
+    special_block_t *block = umbra_uniform_block_of(map, shadow_blk);
+    if (block == NULL)
+        return false;
+    res = dr_raw_mem_alloc(map->shadow_block_size,
+                           DR_MEMPROT_READ | DR_MEMPROT_WRITE, shadow_blk);
+    if (res != shadow_blk) {
+        if (res != NULL)
+            dr_raw_mem_free(res, map->shadow_block_size);
+        return false;
+    }
+    memcpy(res, block->start, map->shadow_block_size);
+    umbra_set_shadow_bitmap(map, res);
+    *(volatile byte *)umbra_uniform_slot(map, shadow_blk, false/*!create*/) = 0;
+    LOG(UMBRA_VERBOSE, "privatized uniform shadow block "PFX"\n", shadow_blk);
+    return true;
+}
+
 /***************************************************************************
  * EXPORT UMBRA X64 SPECIFIC CODE
  */
@@ -772,6 +1057,7 @@ umbra_map_arch_init(umbra_map_t *map, umbra_map_options_t *ops)
         map->disp += umbra_map_scale_shadow_to_app
             (map, map->index * 2*NUM_SEGMENTS*segment_size(num_seg_bits));
     }
+    map->num_uniform_blocks = 0;
     /* now we add shadow memory segment */
     for (i = 0; i < MAX_NUM_APP_SEGMENTS; i++) {
         if (app_segments[i].app_used &&
@@ -789,7 +1075,9 @@ umbra_map_shadow_free(umbra_map_t *map,
                       umbra_shadow_memory_info_t *info,
                       void *user_data)
 {
-    dr_raw_mem_free(info->shadow_base, info->shadow_size);
+    /* uniform blocks are freed separately below */
+    if (info->shadow_type == UMBRA_SHADOW_MEMORY_TYPE_NORMAL)
+        dr_raw_mem_free(info->shadow_base, info->shadow_size);
     return true;
 }
 
@@ -798,14 +1086,28 @@ umbra_map_arch_exit(umbra_map_t *map)
 {
     uint i;
     umbra_iterate_shadow_memory(map, NULL, umbra_map_shadow_free);
+    for (i = 0; i < map->num_uniform_blocks; i++)
+        dr_raw_mem_free(map->uniform_blocks[i].start, map->shadow_block_size);
+    map->num_uniform_blocks = 0;
     for (i = 0; i < MAX_NUM_APP_SEGMENTS; i++) {
         if (app_segments[i].app_used && app_segments[i].map[map->index] == map) {
-            size_t size;
+            size_t size, num_leaves, j;
             app_segment_t *seg = &app_segments[i];
             size = seg->shadow_end[map->index] - seg->shadow_base[map->index];
             size = size / map->shadow_block_size / BIT_PER_BYTE;
             global_free(seg->shadow_bitmap[map->index], size, HEAPSTAT_SHADOW);
             seg->shadow_bitmap[map->index] = NULL;
+            num_leaves = UNIFORM_NUM_LEAVES(map, seg->shadow_base[map->index],
+                                            seg->shadow_end[map->index]);
+            for (j = 0; j < num_leaves; j++) {
+                if (seg->shadow_uniform[map->index][j] != NULL) {
+                    dr_raw_mem_free(seg->shadow_uniform[map->index][j],
+                                    UNIFORM_LEAF_BLOCKS);
+                }
+            }
+            global_free((void *)seg->shadow_uniform[map->index],
+                        num_leaves * sizeof(byte *), HEAPSTAT_SHADOW);
+            seg->shadow_uniform[map->index] = NULL;
             seg->shadow_base[map->index] = NULL;
             seg->shadow_end[map->index] = NULL;
             seg->reserve_base[map->index] = NULL;
@@ -815,6 +1117,11 @@ umbra_map_arch_exit(umbra_map_t *map)
     }
 }
 
+static drmf_status_t
+umbra_shadow_set_range_common(umbra_map_t *map, app_pc app_addr, size_t app_size,
+                              size_t *shadow_size, ptr_uint_t value,
+                              size_t value_size, bool allow_uniform);
+
 drmf_status_t
 umbra_create_shadow_memory_arch(umbra_map_t *map,
                                 uint   flags,
@@ -829,7 +1136,7 @@ umbra_create_shadow_memory_arch(umbra_map_t *map,
     size_t size, iter_size;
     byte  *shadow_blk, *res;
 
-    if (value_size != 1 || value >= UCHAR_MAX)
+    if (!umbra_value_size_valid(value, value_size))
         return DRMF_ERROR_FEATURE_NOT_AVAILABLE;
     if (POINTER_OVERFLOW_ON_ADD(app_addr, app_size-1)) /* just hitting top is ok */
         return DRMF_ERROR_INVALID_SIZE;
@@ -840,9 +1147,15 @@ umbra_create_shadow_memory_arch(umbra_map_t *map,
     APP_RANGE_LOOP(app_addr, app_size, app_blk_base, app_blk_end, app_src_end,
                    start, end, iter_size, {
         shadow_blk  = (byte *)umbra_xl8_app_to_shadow(map, app_blk_base);
+        if (TEST(UMBRA_CREATE_SHADOW_SHARED_READONLY, flags) &&
+            umbra_uniform_blocks_enabled(map) &&
+            start == app_blk_base && end == app_blk_end &&
+            umbra_shadow_block_set_uniform(map, shadow_blk, value, value_size))
+            continue;
         if (!umbra_shadow_block_exist(map, shadow_blk)) {
             umbra_map_lock(map);
-            if (!umbra_shadow_block_exist(map, shadow_blk)) {
+            if (!umbra_shadow_block_exist(map, shadow_blk) &&
+                !umbra_shadow_block_privatize(map, shadow_blk)) {
                 res = dr_raw_mem_alloc(map->shadow_block_size,
                                        DR_MEMPROT_READ | DR_MEMPROT_WRITE,
                                        shadow_blk);
@@ -858,8 +1171,9 @@ umbra_create_shadow_memory_arch(umbra_map_t *map,
             }
             umbra_map_unlock(map);
         }
-        if (umbra_shadow_set_range_arch(map, start, iter_size, &size,
-                                        value, value_size) != DRMF_SUCCESS) {
+        if (umbra_shadow_set_range_common(map, start, iter_size, &size,
+                                          value, value_size,
+                                          false/*private*/) != DRMF_SUCCESS) {
             umbra_map_unlock(map);
             return DRMF_ERROR;
         }
@@ -868,6 +1182,28 @@ umbra_create_shadow_memory_arch(umbra_map_t *map,
     return DRMF_SUCCESS;
 }
 
+/* Backs the shadow block of app_blk_base with private memory for direct
+ * access, keeping the value of a uniform block.
+ */
+static drmf_status_t
+umbra_shadow_block_materialize(umbra_map_t *map, app_pc app_blk_base)
+{
+    byte *shadow_blk = umbra_xl8_app_to_shadow(map, app_blk_base);
+    bool exists;
+    if (!TEST(UMBRA_MAP_CREATE_SHADOW_ON_TOUCH, map->options.flags))
+        return DRMF_ERROR_INVALID_PARAMETER;
+    umbra_map_lock(map);
+    exists = umbra_shadow_block_exist(map, shadow_blk) ||
+        umbra_shadow_block_privatize(map, shadow_blk);
+    umbra_map_unlock(map);
+    if (exists)
+        return DRMF_SUCCESS;
+    return umbra_create_shadow_memory_arch(map, 0, app_blk_base,
+                                           map->app_block_size,
+                                           map->options.default_value,
+                                           map->options.default_value_size);
+}
+
 drmf_status_t
 umbra_delete_shadow_memory_arch(umbra_map_t *map,
                                 app_pc       app_addr,
@@ -905,12 +1241,7 @@ umbra_read_shadow_memory_arch(IN    umbra_map_t *map,
         shadow_start = umbra_xl8_app_to_shadow(map, start);
         if (!umbra_shadow_block_exist(map, shadow_start)) {
             drmf_status_t res;
-            if (!TEST(UMBRA_MAP_CREATE_SHADOW_ON_TOUCH, map->options.flags))
-                return DRMF_ERROR_INVALID_PARAMETER;
-            res = umbra_create_shadow_memory_arch(map, 0, app_blk_base,
-                                                  map->app_block_size,
-                                                  map->options.default_value,
-                                                  map->options.default_value_size);
+            res = umbra_shadow_block_materialize(map, app_blk_base);
             if (res != DRMF_SUCCESS)
                 return res;
         }
@@ -948,12 +1279,7 @@ umbra_write_shadow_memory_arch(IN    umbra_map_t *map,
         shadow_start = umbra_xl8_app_to_shadow(map, start);
         if (!umbra_shadow_block_exist(map, shadow_start)) {
             drmf_status_t res;
-            if (!TEST(UMBRA_MAP_CREATE_SHADOW_ON_TOUCH, map->options.flags))
-                return DRMF_ERROR_INVALID_PARAMETER;
-            res = umbra_create_shadow_memory_arch(map, 0, app_blk_base,
-                                                  map->app_block_size,
-                                                  map->options.default_value,
-                                                  map->options.default_value_size);
+            res = umbra_shadow_block_materialize(map, app_blk_base);
             if (res != DRMF_SUCCESS)
                 return res;
         }
@@ -966,48 +1292,73 @@ umbra_write_shadow_memory_arch(IN    umbra_map_t *map,
     return DRMF_SUCCESS;
 }
 
-drmf_status_t
-umbra_shadow_set_range_arch(IN   umbra_map_t *map,
-                            IN   app_pc       app_addr,
-                            IN   size_t       app_size,
-                            OUT  size_t      *shadow_size,
-                            IN   ptr_uint_t   value,
-                            IN   size_t       value_size)
+/* If allow_uniform, whole blocks become uniform blocks rather than being
+ * written, which callers that go on to write the shadow directly must avoid.
+ */
+static drmf_status_t
+umbra_shadow_set_range_common(umbra_map_t *map, app_pc app_addr, size_t app_size,
+                              size_t *shadow_size, ptr_uint_t value,
+                              size_t value_size, bool allow_uniform)
 {
     /* i#1260: end pointers are all closed (i.e., inclusive) to handle overflow */
     app_pc app_blk_base, app_blk_end, app_src_end;
     app_pc start, end;
     size_t size, shdw_size, iter_size;
     byte  *shadow_start;
+    bool   uniform;
 
-    if (value_size != 1 || value > UCHAR_MAX)
+    if (!umbra_value_size_valid(value, value_size))
         return DRMF_ERROR_NOT_IMPLEMENTED;
     if (POINTER_OVERFLOW_ON_ADD(app_addr, app_size-1)) /* just hitting top is ok */
         return DRMF_ERROR_INVALID_SIZE;
+    /* elements are laid out from app_addr's shadow */
+    if (!ALIGNED(umbra_map_scale_app_to_shadow(map, app_size), value_size))
+        return DRMF_ERROR_INVALID_SIZE;
+    /* uniform blocks are tracked in the segment bitmaps so need a segment */
+    allow_uniform = allow_uniform && umbra_uniform_blocks_enabled(map) &&
+        TEST(UMBRA_MAP_SHADOW_SHARED_READONLY, map->options.flags) &&
+        umbra_add_app_segment(app_addr, app_size, map);
 
     shdw_size = 0;
     APP_RANGE_LOOP(app_addr, app_size, app_blk_base, app_blk_end, app_src_end,
                    start, end, iter_size, {
         shadow_start = umbra_xl8_app_to_shadow(map, start);
+        if (allow_uniform && start == app_blk_base && end == app_blk_end) {
+            umbra_map_lock(map);
+            uniform = umbra_shadow_block_set_uniform(map, shadow_start,
+                                                     value, value_size);
+            umbra_map_unlock(map);
+            if (uniform) {
+                shdw_size += map->shadow_block_size;
+                continue;
+            }
+        }
         if (!umbra_shadow_block_exist(map, shadow_start)) {
             drmf_status_t res;
-            if (!TEST(UMBRA_MAP_CREATE_SHADOW_ON_TOUCH, map->options.flags))
-                return DRMF_ERROR_INVALID_PARAMETER;
-            res = umbra_create_shadow_memory_arch(map, 0, app_blk_base,
-                                                  map->app_block_size,
-                                                  map->options.default_value,
-                                                  map->options.default_value_size);
+            res = umbra_shadow_block_materialize(map, app_blk_base);
             if (res != DRMF_SUCCESS)
                 return res;
         }
         size = umbra_map_scale_app_to_shadow(map, iter_size);
-        memset(shadow_start, value, size);
+        umbra_fill_shadow_value(shadow_start, size, value, value_size);
         shdw_size += size;
     });
     *shadow_size = shdw_size;
     return DRMF_SUCCESS;
 }
 
+drmf_status_t
+umbra_shadow_set_range_arch(IN   umbra_map_t *map,
+                            IN   app_pc       app_addr,
+                            IN   size_t       app_size,
+                            OUT  size_t      *shadow_size,
+                            IN   ptr_uint_t   value,
+                            IN   size_t       value_size)
+{
+    return umbra_shadow_set_range_common(map, app_addr, app_size, shadow_size,
+                                         value, value_size, true/*uniform ok*/);
+}
+
 drmf_status_t
 umbra_shadow_copy_range_arch(IN  umbra_map_t *map,
                              IN  app_pc  app_src,
@@ -1044,12 +1395,7 @@ umbra_shadow_copy_range_arch(IN  umbra_map_t *map,
         shadow_start = umbra_xl8_app_to_shadow(map, start);
         if (!umbra_shadow_block_exist(map, shadow_start)) {
             drmf_status_t res;
-            if (!TEST(UMBRA_MAP_CREATE_SHADOW_ON_TOUCH, map->options.flags))
-                return DRMF_ERROR_INVALID_PARAMETER;
-            res = umbra_create_shadow_memory_arch(map, 0, app_blk_base,
-                                                  map->app_block_size,
-                                                  map->options.default_value,
-                                                  map->options.default_value_size);
+            res = umbra_shadow_block_materialize(map, app_blk_base);
             if (res != DRMF_SUCCESS)
                 return res;
         }
@@ -1096,10 +1442,11 @@ umbra_value_in_shadow_memory_arch(IN    umbra_map_t *map,
     /* i#1260: end pointers are all closed (i.e., inclusive) to handle overflow */
     app_pc app_blk_base, app_blk_end, app_src_end;
     app_pc start, end;
-    byte  *shadow_start, *shadow_addr = NULL;
+    byte  *shadow_start, *scan_start, *shadow_addr = NULL;
     size_t shadow_size, iter_size;
+    special_block_t *block;
 
-    if (value > USHRT_MAX || (value_size != 1 && value_size != 2))
+    if (!umbra_value_size_valid(value, value_size))
         return DRMF_ERROR_NOT_IMPLEMENTED;
     if (POINTER_OVERFLOW_ON_ADD(*app_addr, app_size-1)) /* just hitting top is ok */
         return DRMF_ERROR_INVALID_SIZE;
@@ -1108,44 +1455,35 @@ umbra_value_in_shadow_memory_arch(IN    umbra_map_t *map,
     APP_RANGE_LOOP(*app_addr, app_size, app_blk_base, app_blk_end, app_src_end,
                    start, end, iter_size, {
         shadow_start = umbra_xl8_app_to_shadow(map, start);
+        scan_start = shadow_start;
+        /* elements are counted from *app_addr's shadow: skip a partial one */
+        shadow_size = ALIGN_BACKWARD(umbra_map_scale_app_to_shadow(map, iter_size),
+                                     value_size);
         if (!umbra_shadow_block_exist(map, shadow_start)) {
             drmf_status_t res;
-            if (!TEST(UMBRA_MAP_CREATE_SHADOW_ON_TOUCH, map->options.flags))
-                return DRMF_ERROR_INVALID_PARAMETER;
-            res = umbra_create_shadow_memory_arch(map, 0, app_blk_base,
-                                                  map->app_block_size,
-                                                  map->options.default_value,
-                                                  map->options.default_value_size);
-            if (res != DRMF_SUCCESS)
-                return res;
-            if (value == map->options.default_value &&
-                value_size == map->options.default_value_size) {
-                *app_addr = start;
-                *found = true;
-                return DRMF_SUCCESS;
-            }
-            continue;
-        }
-        shadow_size = umbra_map_scale_app_to_shadow(map, iter_size);
-        if (value_size == 1) {
-            shadow_addr = memchr(shadow_start, (int)value, shadow_size);
-        } else if (shadow_size > 0) {
-            byte *first_byte = shadow_start;
-            while (first_byte != NULL) {
-                first_byte = memchr(first_byte, (char)value,
-                                    shadow_size - 1 - (first_byte - shadow_start));
-                if (first_byte != NULL) {
-                    if (*(first_byte + 1) == (char)(value>>8)) {
-                        shadow_addr = first_byte;
-                        break;
-                    } else
-                        first_byte++;
-                }
+            byte *shadow_blk = umbra_xl8_app_to_shadow(map, app_blk_base);
+            block = umbra_uniform_block_of(map, shadow_blk);
+            if (block != NULL) {
+                /* No need to touch a uniform block to scan it: we scan its
+                 * shared block instead.  That repeats every 8 bytes, so any
+                 * match is within the first two words from any offset, and
+                 * a value of another size may match (e.g., 2-byte 0x0101 in
+                 * a block of 1-byte 0x01).
+                 */
+                scan_start = block->start + (shadow_start - shadow_blk);
+                if (shadow_size > 2*sizeof(uint64))
+                    shadow_size = 2*sizeof(uint64);
+            } else {
+                res = umbra_shadow_block_materialize(map, app_blk_base);
+                if (res != DRMF_SUCCESS)
+                    return res;
             }
         }
+        shadow_addr = umbra_find_shadow_value(scan_start, shadow_size,
+                                              value, value_size);
         if (shadow_addr != NULL) {
             app_pc found_addr = start +
-                umbra_map_scale_shadow_to_app(map, shadow_addr - shadow_start);
+                umbra_map_scale_shadow_to_app(map, shadow_addr - scan_start);
             /* We can go beyond the app size due to shadow size rounding up. */
             if (found_addr > *app_addr + app_size)
                 return DRMF_SUCCESS; /* not found */
@@ -1234,6 +1572,39 @@ umbra_iterate_shadow_memory_arch(umbra_map_t *map,
         ASSERT(shdw_addr >= app_segments[i].shadow_end[map->index],
                "fail to query shadow memory");
     }
+    /* Uniform blocks have no memory at their shadow address, so we report
+     * them from the tables as shared, like the 32-bit special blocks.
+     * Changes to the tables are made under the map lock.
+     */
+    umbra_map_lock(map);
+    for (i = 0; i < MAX_NUM_APP_SEGMENTS; i++) {
+        app_segment_t *seg = &app_segments[i];
+        size_t leaf, j, num_leaves;
+        if (!seg->app_used || seg->map[map->index] != map)
+            continue;
+        num_leaves = UNIFORM_NUM_LEAVES(map, seg->shadow_base[map->index],
+                                        seg->shadow_end[map->index]);
+        for (leaf = 0; leaf < num_leaves; leaf++) {
+            byte *table = seg->shadow_uniform[map->index][leaf];
+            if (table == NULL)
+                continue;
+            for (j = 0; j < UNIFORM_LEAF_BLOCKS; j++) {
+                size_t blk_idx = leaf * UNIFORM_LEAF_BLOCKS + j;
+                if (table[j] == 0)
+                    continue;
+                info.app_base = seg->app_base + blk_idx * map->app_block_size;
+                info.app_size = map->app_block_size;
+                info.shadow_base = map->uniform_blocks[table[j] - 1].start;
+                info.shadow_size = map->shadow_block_size;
+                info.shadow_type = UMBRA_SHADOW_MEMORY_TYPE_SHARED;
+                if (!iter_func(map, &info, user_data)) {
+                    umbra_map_unlock(map);
+                    return DRMF_SUCCESS;
+                }
+            }
+        }
+    }
+    umbra_map_unlock(map);
     return DRMF_SUCCESS;
 }
 
@@ -1242,7 +1613,10 @@ umbra_shadow_memory_is_shared_arch(IN  umbra_map_t *map,
                                    IN  byte *shadow_addr,
                                    OUT umbra_shadow_memory_type_t *shadow_type)
 {
-    *shadow_type = UMBRA_SHADOW_MEMORY_TYPE_UNKNOWN;
+    if (umbra_address_in_uniform_block(map, shadow_addr))
+        *shadow_type = UMBRA_SHADOW_MEMORY_TYPE_SHARED;
+    else
+        *shadow_type = UMBRA_SHADOW_MEMORY_TYPE_UNKNOWN;
     return DRMF_SUCCESS;
 }
 
@@ -1252,6 +1626,9 @@ umbra_get_shadow_memory_type_arch(umbra_map_t *map,
                                   umbra_shadow_memory_type_t *shadow_type)
 {
     uint i;
+    umbra_shadow_memory_is_shared_arch(map, shadow_addr, shadow_type);
+    if (*shadow_type == UMBRA_SHADOW_MEMORY_TYPE_SHARED)
+        return DRMF_SUCCESS;
     *shadow_type = UMBRA_SHADOW_MEMORY_TYPE_NOT_SHADOW;
     for (i = 0; i < MAX_NUM_APP_SEGMENTS; i++) {
         if ((shadow_addr >= app_segments[i].app_base &&
@@ -1263,6 +1640,11 @@ umbra_get_shadow_memory_type_arch(umbra_map_t *map,
                    shadow_addr <= app_segments[i].shadow_end[map->index]) {
             if (umbra_shadow_block_exist(map, shadow_addr))
                 *shadow_type = UMBRA_SHADOW_MEMORY_TYPE_NORMAL;
+            else if (umbra_uniform_block_of(map, (byte *)
+                                            ALIGN_BACKWARD(shadow_addr,
+                                                           map->shadow_block_size))
+                     != NULL)
+                *shadow_type = UMBRA_SHADOW_MEMORY_TYPE_SHARED;
             else
                 *shadow_type = UMBRA_SHADOW_MEMORY_TYPE_SHADOW_NOT_ALLOC;
             break;
@@ -1286,6 +1668,16 @@ umbra_get_shadow_memory_arch(umbra_map_t *map,
         shadow_info->shadow_size = map->shadow_block_size;
         shadow_info->shadow_base =
             umbra_xl8_app_to_shadow(map, shadow_info->app_base);
+        if (!umbra_shadow_block_exist(map, shadow_info->shadow_base)) {
+            special_block_t *block =
+                umbra_uniform_block_of(map, shadow_info->shadow_base);
+            if (block != NULL) {
+                /* *shadow_addr keeps the real translation, as for faults */
+                shadow_info->shadow_base = block->start;
+                shadow_info->shadow_type = UMBRA_SHADOW_MEMORY_TYPE_SHARED;
+                return DRMF_SUCCESS;
+            }
+        }
         return umbra_get_shadow_memory_type_arch(map,
                                                  shadow_info->shadow_base,
                                                  &shadow_info->shadow_type);
@@ -1321,6 +1713,12 @@ umbra_replace_shared_shadow_memory_arch(umbra_map_t *map,
                                         app_pc app_addr,
                                         byte **shadow_addr)
 {
+    byte *shadow_blk = umbra_xl8_app_to_shadow
+        (map, (app_pc)ALIGN_BACKWARD(app_addr, map->app_block_size));
+    umbra_map_lock(map);
+    if (!umbra_shadow_block_exist(map, shadow_blk))
+        umbra_shadow_block_privatize(map, shadow_blk);
+    umbra_map_unlock(map);
     *shadow_addr = umbra_xl8_app_to_shadow(map, app_addr);
     return DRMF_SUCCESS;
 }
@@ -1331,7 +1729,20 @@ umbra_create_shared_shadow_block_arch(IN  umbra_map_t *map,
                                       IN  size_t       value_size,
                                       OUT byte       **block)
 {
-    return DRMF_ERROR_FEATURE_NOT_AVAILABLE;
+    special_block_t *uniform;
+    if (!umbra_uniform_blocks_enabled(map))
+        return DRMF_ERROR_FEATURE_NOT_AVAILABLE;
+    if (value_size != 1 && value_size != 2 && value_size != 4 && value_size != 8)
+        return DRMF_ERROR_INVALID_PARAMETER;
+    umbra_map_lock(map);
+    uniform = umbra_uniform_block_lookup(map, value, value_size, true/*create*/);
+    umbra_map_unlock(map);
+    if (uniform == NULL) {
+        *block = NULL;
+        return DRMF_ERROR_NOMEM;
+    }
+    *block = uniform->start;
+    return DRMF_SUCCESS;
 }
 
 drmf_status_t
@@ -1340,8 +1751,73 @@ umbra_get_shared_shadow_block_arch(IN  umbra_map_t *map,
                                    IN  size_t       value_size,
                                    OUT byte       **block)
 {
-    *block = NULL;
-    return DRMF_ERROR_FEATURE_NOT_AVAILABLE;
+    special_block_t *uniform =
+        umbra_uniform_block_lookup(map, value, value_size, false/*!create*/);
+    *block = (uniform == NULL) ? NULL : uniform->start;
+    return DRMF_SUCCESS;
+}
+
+/* Creates shadow for the faulting app block and for up to
+ * options.fault_batch_blocks-1 following blocks of the same app mapping
+ * that have no shadow yet, with a single allocation, so touching a large
+ * new region sequentially does not take a fault per block.  Returns false
+ * to leave the fault to the one-block path.  The caller must hold the map
+ * lock.
+ */
+static bool
+umbra_create_shadow_batch(umbra_map_t *map, app_pc app_addr)
+{
+#ifdef UNIX
+    /* On Windows a batch could not be released one block at a time. */
+    dr_mem_info_t info;
+    app_pc app_blk = (app_pc)ALIGN_BACKWARD(app_addr, map->app_block_size);
+    byte *shadow_blk = umbra_xl8_app_to_shadow(map, app_blk);
+    byte *res;
+    uint i, num_blks;
+    size_t alloc_size;
+
+    if (map->options.fault_batch_blocks <= 1)
+        return false;
+    if (!dr_query_memory_ex(app_addr, &info) || info.type == DR_MEMTYPE_FREE)
+        return false;
+    for (num_blks = 1; num_blks < map->options.fault_batch_blocks; num_blks++) {
+        app_pc next_app;
+        byte *next_shadow = shadow_blk + num_blks * map->shadow_block_size;
+        if (POINTER_OVERFLOW_ON_ADD(app_blk, num_blks * map->app_block_size))
+            break;
+        next_app = app_blk + num_blks * map->app_block_size;
+        /* stop at the end of the app mapping, at a segment boundary where the
+         * shadow is not contiguous, and at blocks that already have shadow
+         */
+        if (next_app >= info.base_pc + info.size ||
+            umbra_xl8_app_to_shadow(map, next_app) != next_shadow ||
+            umbra_shadow_block_exist(map, next_shadow) ||
+            umbra_uniform_block_of(map, next_shadow) != NULL)
+            break;
+    }
+    if (!umbra_add_app_segment(app_blk, num_blks * map->app_block_size, map))
+        return false;
+    alloc_size = num_blks * map->shadow_block_size;
+    res = dr_raw_mem_alloc(alloc_size, DR_MEMPROT_READ | DR_MEMPROT_WRITE, shadow_blk);
+    if (res != shadow_blk) {
+        if (res != NULL)
+            dr_raw_mem_free(res, alloc_size);
+        return false;
+    }
+    /* fresh memory is already zero */
+    if (map->options.default_value != 0) {
+        umbra_fill_shadow_value(res, alloc_size, map->options.default_value,
+                                map->options.default_value_size);
+    }
+    for (i = 0; i < num_blks; i++)
+        umbra_set_shadow_bitmap(map, res + i * map->shadow_block_size);
+    map->num_fault_blocks += num_blks;
+    LOG(UMBRA_VERBOSE, "fault at "PFX" created %d shadow blocks at "PFX"\n",
+        app_addr, num_blks, res);
+    return true;
+#else
+    return false;
+#endif
 }
 
 bool
@@ -1360,9 +1836,24 @@ umbra_handle_fault(void *drcontext, byte *target, dr_mcontext_t *raw_mc,
                     app_segments[i].app_base +
                     umbra_map_scale_shadow_to_app
                     (map, target - app_segments[i].shadow_base[j]);
-                umbra_create_shadow_memory_arch(map, 0, app_addr, 8,
-                                                map->options.default_value,
-                                                map->options.default_value_size);
+                byte *shadow_blk = umbra_xl8_app_to_shadow
+                    (map, (app_pc)ALIGN_BACKWARD(app_addr, map->app_block_size));
+                bool handled;
+                /* A uniform block, or one another thread just backed, keeps
+                 * its contents: we must not reset any of it to the default.
+                 */
+                umbra_map_lock(map);
+                map->num_faults++;
+                handled = umbra_shadow_block_exist(map, shadow_blk) ||
+                    umbra_shadow_block_privatize(map, shadow_blk) ||
+                    umbra_create_shadow_batch(map, app_addr);
+                if (!handled) {
+                    umbra_create_shadow_memory_arch(map, 0, app_addr, 8,
+                                                    map->options.default_value,
+                                                    map->options.default_value_size);
+                    map->num_fault_blocks++;
+                }
+                umbra_map_unlock(map);
                 return true;
             }
         }
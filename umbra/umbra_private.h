@@ -71,7 +71,16 @@ struct _umbra_map_t {
 #else
     ptr_uint_t disp;
     ptr_uint_t mask;
+    /* Whole shadow blocks holding a single value are left unallocated and
+     * recorded in the per-segment uniform tables (see umbra_64.c), which
+     * point each at one of the read-only per-value blocks in uniform_blocks.
+     */
+    uint num_uniform_blocks;
+    special_block_t uniform_blocks[MAX_NUM_SPECIAL_BLOCKS];
 #endif
+    /* shadow faults handled and shadow blocks they created, under lock */
+    uint64 num_faults;
+    uint64 num_fault_blocks;
     void *lock;
 };
 
@@ -119,6 +119,24 @@ typedef enum _THREADINFOCLASS
     MaxThreadInfoClass
 } THREADINFOCLASS;
 
+//
+// Information Structures for NtQueryInformationProcess
+//
+typedef struct _VM_COUNTERS
+{
+    SIZE_T PeakVirtualSize;
+    SIZE_T VirtualSize;
+    ULONG PageFaultCount;
+    SIZE_T PeakWorkingSetSize;
+    SIZE_T WorkingSetSize;
+    SIZE_T QuotaPeakPagedPoolUsage;
+    SIZE_T QuotaPagedPoolUsage;
+    SIZE_T QuotaPeakNonPagedPoolUsage;
+    SIZE_T QuotaNonPagedPoolUsage;
+    SIZE_T PagefileUsage;
+    SIZE_T PeakPagefileUsage;
+} VM_COUNTERS, *PVM_COUNTERS;
+
 /* Reverse engineered, not from ReactOS.
  * This is the data structure for ProcessThreadStackAllocation (0x29).
  */